@@ -0,0 +1,89 @@
+//
+//  dec_schedule_bench.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with:
+// cc -O2 -maes -msse4.1 -I../src dec_schedule_bench.c ../src/AESni.c ../src/AESCore.c
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file dec_schedule_bench.c
+ 
+ Microbenchmark comparing single block decryption with the inverse mix columns applied to the round keys on every
+ block (the previous aes_ni_dec) against the precomputed equivalent inverse cipher schedule of the key context.
+ 
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <x86intrin.h>
+
+#include "AESni.h"
+
+#define BENCH_BYTES  (16 * 1024)
+#define BENCH_ROUNDS 2000
+
+#pragma mark - Reference Kernel
+// the decryption kernel as it was before the schedule was precomputed
+__attribute__((target("aes"), noinline))
+static void aes_ni_dec_per_block_imc(__m128i * data, __m128i * key_schedule, AESKeyMode keymode) {
+	*data = _mm_xor_si128(*data, key_schedule[0]);
+	for (int i = 1; i < (int)keymode; i++) {
+		*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[i]));
+	}
+	*data = _mm_aesdeclast_si128(*data, key_schedule[keymode]);
+}
+
+__attribute__((target("aes"), noinline))
+static void aes_ni_dec_precomputed(__m128i * data, __m128i * key_schedule, AESKeyMode keymode) {
+	aes_ni_dec(data, key_schedule, keymode);
+}
+
+#pragma mark - Measurement
+static double cycles_per_byte(void (*kernel)(__m128i *, __m128i *, AESKeyMode), __m128i * buffer, __m128i * key_schedule, AESKeyMode keymode) {
+	uint64_t best = UINT64_MAX;
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		uint64_t start = __rdtsc();
+		for (size_t i = 0; i < BENCH_BYTES / 16; i++) {
+			kernel(&buffer[i], key_schedule, keymode);
+		}
+		uint64_t took = __rdtsc() - start;
+		if (took < best) {
+			best = took;
+		}
+	}
+	return (double)best / BENCH_BYTES;
+}
+
+int main(void) {
+	static __m128i buffer[BENCH_BYTES / 16];
+	uint8_t key[32];
+	AESKeyMode modes[3] = {aes_128, aes_192, aes_256};
+	
+	memset(buffer, 0xa5, sizeof(buffer));
+	for (int i = 0; i < 32; i++) {
+		key[i] = (uint8_t)i;
+	}
+	
+	printf("%-8s %18s %18s %8s\n", "mode", "per block [c/B]", "precomputed [c/B]", "speedup");
+	for (int m = 0; m < 3; m++) {
+		AESKeyContext ctx;
+		__m128i raw_sched[AES_MAX_ROUND_KEYS];
+		aes_ni_key_context_init(&ctx, key, modes[m]);
+		
+		// undo the precomputation to feed the reference kernel the plain reversed schedule
+		raw_sched[0] = ((__m128i *)ctx.enc_schedule)[modes[m]];
+		for (int i = 1; i <= (int)modes[m]; i++) {
+			raw_sched[i] = ((__m128i *)ctx.enc_schedule)[modes[m] - i];
+		}
+		
+		double before = cycles_per_byte(aes_ni_dec_per_block_imc, buffer, raw_sched, modes[m]);
+		double after  = cycles_per_byte(aes_ni_dec_precomputed, buffer, (__m128i *)ctx.dec_schedule, modes[m]);
+		printf("AES-%-4d %18.3f %18.3f %7.2fx\n", (modes[m] - 6) * 32, before, after, before / after);
+		aes_key_context_clear(&ctx);
+	}
+	
+	return 0;
+}
@@ -0,0 +1,103 @@
+//
+//  parallel_bench.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with:
+// cc -O2 -pthread -maes -mpclmul -msse4.1 -mssse3 -I../src parallel_bench.c ../src/AESparallel.c ../src/AESstream.c ../src/AESdispatch.c ../src/AESstats.c ../src/AESvaes.c ../src/AESni.c ../src/AESvpaes.c ../src/AESbs.c ../src/AESgen.c ../src/AESarm.c ../src/AESCore.c
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file parallel_bench.c
+
+ Scaling benchmark for the chunk parallel CTR and CBC decryption, sweeps the thread count on a buffer far larger than
+ the last level cache and reports the throughput and the speedup over one thread.
+
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "AESparallel.h"
+#include "AESdispatch.h"
+
+// large enough that the buffers are streamed from memory, so the point where bandwidth runs out is visible
+#define BENCH_BYTES  (1024UL * 1024 * 1024)
+#define BENCH_ROUNDS 5
+
+static uint8_t ivec[16], key[32];
+
+#pragma mark - Measurement
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// best of several rounds [GB/s]
+static double throughput(AESPool * pool, int cbc, uint8_t * inpt, uint8_t * outt, unsigned long length, const AESKeyContext * ctx) {
+	double best = 0;
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		double start = now();
+		if (cbc) {
+			aes_cbc_parallel_dec_ctx(pool, inpt, outt, ivec, length, ctx);
+		} else {
+			aes_ctr_parallel_ctx(pool, inpt, outt, ivec, length, ctx);
+		}
+		double rate = length / (now() - start) * 1e-9;
+		if (rate > best) {
+			best = rate;
+		}
+	}
+	return best;
+}
+
+int main(int argc, char ** argv) {
+	// usage: parallel_bench [max threads] [chunk size]
+	long online = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int max_threads = argc > 1 ? (unsigned int)atoi(argv[1]) : (unsigned int)(online > 0 ? online : 1);
+	unsigned long chunk = argc > 2 ? strtoul(argv[2], NULL, 0) : AES_POOL_CHUNK_SIZE;
+	AESKeyContext ctx;
+
+	uint8_t * inpt = malloc(BENCH_BYTES);
+	uint8_t * outt = malloc(BENCH_BYTES);
+	if (!inpt || !outt) {
+		fprintf(stderr, "could not allocate the %lu byte buffers\n", BENCH_BYTES);
+		return 1;
+	}
+	// touch every page up front so the first round does not measure page faults
+	memset(inpt, 0xa5, BENCH_BYTES);
+	memset(outt, 0, BENCH_BYTES);
+	for (int i = 0; i < 32; i++) {
+		key[i] = (uint8_t)i;
+	}
+	aes_key_context_init(&ctx, key, aes_128);
+
+	printf("backend: %s, buffer: %lu MiB, chunk: %lu KiB\n", aes_backend_name(), BENCH_BYTES >> 20, chunk >> 10);
+	printf("%8s %14s %9s %14s %9s\n", "threads", "CTR [GB/s]", "speedup", "CBC-D [GB/s]", "speedup");
+
+	double ctr_one = 0, cbc_one = 0;
+	// powers of two, then the maximum
+	for (unsigned int threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+		AESPool * pool = aes_pool_create(threads, chunk);
+		double ctr = throughput(pool, 0, inpt, outt, BENCH_BYTES, &ctx);
+		double cbc = throughput(pool, 1, inpt, outt, BENCH_BYTES, &ctx);
+		aes_pool_destroy(pool);
+		if (threads == 1) {
+			ctr_one = ctr;
+			cbc_one = cbc;
+		}
+		printf("%8u %14.2f %8.2fx %14.2f %8.2fx\n", threads, ctr, ctr / ctr_one, cbc, cbc / cbc_one);
+		if (threads == max_threads) {
+			break;
+		}
+	}
+
+	aes_key_context_clear(&ctx);
+	free(inpt);
+	free(outt);
+	return 0;
+}
@@ -0,0 +1,79 @@
+//
+//  small_bench.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with:
+// cc -O2 -maes -mpclmul -msse4.1 -I../src small_bench.c ../src/AESni.c ../src/AESCore.c
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file small_bench.c
+
+ Latency benchmark comparing the small message functions specialized per key size against the general `_ctx`
+ functions, reports nanoseconds per call for messages of 16 to 1024 bytes.
+
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "AESni.h"
+
+#define BENCH_CALLS  200000
+#define BENCH_ROUNDS 7
+
+typedef void (*kernel)(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+static uint8_t inpt[1024], outt[1024];
+static uint8_t key[32], ivec[16];
+
+#pragma mark - Measurement
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// best of several rounds [ns per call], the output feeds the next input so the calls can not overlap
+static double ns_per_call(kernel fn, unsigned long length, const AESKeyContext * ctx) {
+	double best = 1e30;
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		double start = now();
+		for (int c = 0; c < BENCH_CALLS; c++) {
+			fn(inpt, outt, ivec, length, ctx);
+			inpt[0] ^= outt[0];
+		}
+		double took = (now() - start) / BENCH_CALLS;
+		if (took < best) {
+			best = took;
+		}
+	}
+	return best;
+}
+
+int main(void) {
+	const unsigned long lengths[] = {16, 32, 64, 128, 256, 512, 1024};
+	const AESKeyMode modes[] = {aes_128, aes_256};
+	const kernel small_ctr[] = {aes_ctr_ni_128_small_ctx, aes_ctr_ni_256_small_ctx};
+	const kernel small_cbc[] = {aes_cbc_ni_128_small_enc_ctx, aes_cbc_ni_256_small_enc_ctx};
+	AESKeyContext ctx;
+
+	for (int i = 0; i < 32; i++) {
+		key[i] = (uint8_t)i;
+	}
+
+	printf("%-8s %6s %12s %12s %12s %12s\n", "key", "bytes", "ctr [ns]", "ctr small", "cbc [ns]", "cbc small");
+	for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+		aes_ni_key_context_init(&ctx, key, modes[m]);
+		for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+			printf("AES-%-4d %6lu %12.1f %12.1f %12.1f %12.1f\n", modes[m] == aes_128 ? 128 : 256, lengths[l],
+				   ns_per_call(aes_ctr_ni_ctx, lengths[l], &ctx), ns_per_call(small_ctr[m], lengths[l], &ctx),
+				   ns_per_call(aes_cbc_ni_enc_ctx, lengths[l], &ctx), ns_per_call(small_cbc[m], lengths[l], &ctx));
+		}
+		aes_key_context_clear(&ctx);
+	}
+	return 0;
+}
@@ -0,0 +1,141 @@
+//
+//  startup_bench.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with:
+// cc -O2 -pthread -maes -mpclmul -msse4.1 -mssse3 -I../src startup_bench.c ../src/AESdispatch.c ../src/AESstats.c ../src/AESvaes.c ../src/AESni.c ../src/AESvpaes.c ../src/AESbs.c ../src/AESgen.c ../src/AESarm.c ../src/AESCore.c
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file startup_bench.c
+
+ Benchmark of the start up latency of a short lived tool: the time from `exec` to `main` and to the end of the first
+ encryption (key setup and one 16 byte CTR call through the dispatcher, which probes the CPU on first use).
+
+ The benchmark starts itself as a child process for every run, the child reports its `CLOCK_MONOTONIC` time stamps
+ (which are comparable across processes) through a pipe on descriptor 3. The median and the best of all runs are
+ printed.
+
+ @code
+ ./startup_bench [runs]
+ @endcode
+
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <time.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "AESdispatch.h"
+
+#define BENCH_RUNS 200
+// the child reports on its own descriptor, so library output on stdout can not mix into the time stamps
+#define BENCH_REPORT_FD 3
+
+extern char ** environ;
+
+static uint64_t now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// the child: time stamps at main, after the first and after a second (warm) encryption
+static int child(void) {
+	uint64_t stamps[3];
+	uint8_t key[16] = {0}, ivec[16] = {0}, block[16] = {0};
+	AESKeyContext ctx;
+
+	stamps[0] = now();
+	aes_key_context_init(&ctx, key, aes_128);
+	aes_ctr_ctx(block, block, ivec, sizeof(block), &ctx);
+	stamps[1] = now();
+	aes_key_context_init(&ctx, key, aes_128);
+	aes_ctr_ctx(block, block, ivec, sizeof(block), &ctx);
+	stamps[2] = now();
+
+	return write(BENCH_REPORT_FD, stamps, sizeof(stamps)) == sizeof(stamps) ? 0 : 1;
+}
+
+static int compare(const void * a, const void * b) {
+	const uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x > y) - (x < y);
+}
+
+static void report(const char * name, uint64_t * samples, int runs) {
+	qsort(samples, runs, sizeof(uint64_t), compare);
+	printf("%-24s %12.1f %12.1f\n", name, samples[runs / 2] / 1000.0, samples[0] / 1000.0);
+}
+
+int main(int argc, char ** argv) {
+	// usage: startup_bench [runs], the child is started with -c
+	if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+		return child();
+	}
+	int runs = argc > 1 ? atoi(argv[1]) : BENCH_RUNS;
+	if (runs < 1) {
+		fprintf(stderr, "usage: %s [runs >= 1]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	uint64_t * to_main = calloc(runs, sizeof(uint64_t));
+	uint64_t * to_first = calloc(runs, sizeof(uint64_t));
+	uint64_t * first_call = calloc(runs, sizeof(uint64_t));
+	uint64_t * warm_call = calloc(runs, sizeof(uint64_t));
+	char * const child_argv[] = {argv[0], "-c", NULL};
+
+	for (int r = 0; r < runs; r++) {
+		int channel[2];
+		pid_t pid;
+		posix_spawn_file_actions_t actions;
+		uint64_t stamps[3];
+
+		if (pipe(channel) != 0) {
+			perror("pipe");
+			return EXIT_FAILURE;
+		}
+		posix_spawn_file_actions_init(&actions);
+		// the read end usually is descriptor 3 itself, so it is closed before the write end is moved there
+		posix_spawn_file_actions_addclose(&actions, channel[0]);
+		posix_spawn_file_actions_adddup2(&actions, channel[1], BENCH_REPORT_FD);
+
+		uint64_t start = now();
+		if (posix_spawn(&pid, argv[0], &actions, NULL, child_argv, environ) != 0) {
+			perror("posix_spawn");
+			return EXIT_FAILURE;
+		}
+		posix_spawn_file_actions_destroy(&actions);
+		close(channel[1]);
+
+		ssize_t got = read(channel[0], stamps, sizeof(stamps));
+		close(channel[0]);
+		waitpid(pid, NULL, 0);
+		if (got != sizeof(stamps)) {
+			fprintf(stderr, "run %d: the child did not report\n", r);
+			return EXIT_FAILURE;
+		}
+
+		to_main[r] = stamps[0] - start;
+		to_first[r] = stamps[1] - start;
+		first_call[r] = stamps[1] - stamps[0];
+		warm_call[r] = stamps[2] - stamps[1];
+	}
+
+	printf("backend: %s, %d runs\n", aes_backend_name(), runs);
+	printf("%-24s %12s %12s\n", "", "median [us]", "best [us]");
+	report("exec to main", to_main, runs);
+	report("exec to first encrypt", to_first, runs);
+	report("first key setup + ctr", first_call, runs);
+	report("warm key setup + ctr", warm_call, runs);
+
+	free(to_main);
+	free(to_first);
+	free(first_call);
+	free(warm_call);
+	return 0;
+}
@@ -0,0 +1,104 @@
+//
+//  stream_bench.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with:
+// cc -O2 -pthread -maes -mpclmul -msse4.1 -mssse3 -I../src stream_bench.c ../src/AESstream.c ../src/AESdispatch.c ../src/AESstats.c ../src/AESvaes.c ../src/AESni.c ../src/AESvpaes.c ../src/AESbs.c ../src/AESgen.c ../src/AESarm.c ../src/AESCore.c
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file stream_bench.c
+
+ Microbenchmark comparing the streaming CBC and CTR functions (fed in chunks) against the one-shot functions of the
+ active backend over the same message.
+
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <x86intrin.h>
+
+#include "AESstream.h"
+#include "AESdispatch.h"
+
+// small enough to stay in the L2 cache, so memory bandwidth does not hide the per call overhead
+#define BENCH_BYTES  (256 * 1024)
+#define BENCH_ROUNDS 200
+
+static uint8_t inpt[BENCH_BYTES], outt[BENCH_BYTES + 16];
+static uint8_t key[32], ivec[16];
+
+#pragma mark - Kernels
+static void ctr_one_shot(unsigned long chunk) {
+	AESKeyContext ctx;
+	(void)chunk;
+	aes_key_context_init(&ctx, key, aes_128);
+	aes_ctr_ctx(inpt, outt, ivec, BENCH_BYTES, &ctx);
+}
+
+static void ctr_stream(unsigned long chunk) {
+	AESStream stream;
+	aes_ctr_stream_init(&stream, key, aes_128, ivec);
+	for (unsigned long i = 0; i < BENCH_BYTES; i += chunk) {
+		aes_ctr_stream_update(&stream, inpt + i, outt + i, chunk);
+	}
+	aes_ctr_stream_final(&stream);
+}
+
+static void cbc_one_shot(unsigned long chunk) {
+	AESKeyContext ctx;
+	(void)chunk;
+	aes_key_context_init(&ctx, key, aes_128);
+	aes_cbc_enc_ctx(inpt, outt, ivec, BENCH_BYTES, &ctx);
+}
+
+static void cbc_stream(unsigned long chunk) {
+	AESStream stream;
+	unsigned long written = 0;
+	aes_cbc_stream_init(&stream, key, aes_128, ivec);
+	for (unsigned long i = 0; i < BENCH_BYTES; i += chunk) {
+		written += aes_cbc_stream_enc_update(&stream, inpt + i, outt + written, chunk);
+	}
+	aes_cbc_stream_enc_final(&stream, outt + written);
+}
+
+#pragma mark - Measurement
+static double cycles_per_byte(void (*kernel)(unsigned long), unsigned long chunk) {
+	uint64_t best = UINT64_MAX;
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		uint64_t start = __rdtsc();
+		kernel(chunk);
+		uint64_t took = __rdtsc() - start;
+		if (took < best) {
+			best = took;
+		}
+	}
+	return (double)best / BENCH_BYTES;
+}
+
+int main(void) {
+	// block aligned chunks go straight to the backend, the odd sizes exercise the partial block buffer
+	const unsigned long chunks[] = {1024, 4096, 65536, 1000, 4099};
+
+	memset(inpt, 0xa5, sizeof(inpt));
+	for (int i = 0; i < 32; i++) {
+		key[i] = (uint8_t)i;
+	}
+
+	printf("backend: %s\n", aes_backend_name());
+	printf("%-6s %8s %16s %16s %8s\n", "mode", "chunk", "one-shot [c/B]", "stream [c/B]", "loss");
+	for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+		double once = cycles_per_byte(ctr_one_shot, chunks[c]);
+		double streamed = cycles_per_byte(ctr_stream, chunks[c]);
+		printf("%-6s %8lu %16.3f %16.3f %7.2f%%\n", "CTR", chunks[c], once, streamed, 100.0 * (streamed - once) / once);
+	}
+	for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+		double once = cycles_per_byte(cbc_one_shot, chunks[c]);
+		double streamed = cycles_per_byte(cbc_stream, chunks[c]);
+		printf("%-6s %8lu %16.3f %16.3f %7.2f%%\n", "CBC", chunks[c], once, streamed, 100.0 * (streamed - once) / once);
+	}
+
+	return 0;
+}
@@ -0,0 +1,246 @@
+//
+//  suite_bench.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with:
+// cc -O2 -maes -mpclmul -msse4.1 -I../src suite_bench.c ../src/AESni.c ../src/AESCore.c
+// and with OpenSSL as a reference point:
+// cc -O2 -maes -mpclmul -msse4.1 -DBENCH_OPENSSL -I../src suite_bench.c ../src/AESni.c ../src/AESCore.c -lcrypto
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file suite_bench.c
+
+ Benchmark suite for the AES-NI implementation. Measures the single block latency of `aes_ni_enc` / `aes_ni_dec` and
+ the throughput of CBC encryption, CBC decryption and CTR for all key sizes over messages of 16 bytes up to 1 GiB, and
+ reports cycles per byte (`rdtsc`), GB/s and nanoseconds per call.
+
+ The results are printed as a table, or with `-j` as one JSON document so runs of different commits can be diffed
+ or loaded into a script. With `BENCH_OPENSSL` defined the same runs are repeated on OpenSSL (EVP, key set up once).
+
+ @code
+ ./suite_bench                    # table, messages up to 1 GiB
+ ./suite_bench -j 16777216 > a.json  # JSON, messages up to 16 MiB
+ @endcode
+
+ @note `rdtsc` counts reference cycles, with turbo enabled they differ from core cycles; compare runs of one machine.
+
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <time.h>
+#include <x86intrin.h>
+
+#include "AESni.h"
+
+#ifdef BENCH_OPENSSL
+#include <openssl/evp.h>
+#endif
+
+// every measurement runs at least this many bytes (or one call) per round, the best round is reported
+#define BENCH_MIN_BYTES   (64UL * 1024 * 1024)
+#define BENCH_ROUNDS      5
+#define BENCH_MAX_BYTES   (1024UL * 1024 * 1024)
+#define BENCH_LATENCY_OPS 1000000
+
+typedef enum {
+	op_cbc_enc,
+	op_cbc_dec,
+	op_ctr
+} BenchOp;
+
+static const char * op_names[] = {"cbc_enc", "cbc_dec", "ctr"};
+
+typedef struct {
+	double cycles;
+	double ns;
+} BenchTime;
+
+static uint8_t key[32], ivec[16];
+static int json_rows;
+
+#pragma mark - Measurement
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#ifdef BENCH_OPENSSL
+static const EVP_CIPHER * openssl_cipher(BenchOp op, AESKeyMode keymode) {
+	if (op == op_ctr) {
+		return keymode == aes_128 ? EVP_aes_128_ctr() : keymode == aes_192 ? EVP_aes_192_ctr() : EVP_aes_256_ctr();
+	}
+	return keymode == aes_128 ? EVP_aes_128_cbc() : keymode == aes_192 ? EVP_aes_192_cbc() : EVP_aes_256_cbc();
+}
+
+// the context is set up once, like the key context of the library, every call only resets the IV
+static void openssl_run(EVP_CIPHER_CTX * evp, uint8_t * buffer, unsigned long length) {
+	int written;
+	EVP_CipherInit_ex(evp, NULL, NULL, NULL, ivec, -1);
+	EVP_CipherUpdate(evp, buffer, &written, buffer, (int)length);
+}
+#endif
+
+// runs one call on OpenSSL if an EVP context is passed, on the library otherwise
+static void run(BenchOp op, uint8_t * buffer, unsigned long length, const AESKeyContext * ctx, void * evp) {
+#ifdef BENCH_OPENSSL
+	if (evp) {
+		openssl_run(evp, buffer, length);
+		return;
+	}
+#endif
+	(void)evp;
+	switch (op) {
+		case op_cbc_enc:
+			aes_cbc_ni_enc_ctx(buffer, buffer, ivec, length, ctx);
+			break;
+		case op_cbc_dec:
+			aes_cbc_ni_dec_ctx(buffer, buffer, ivec, length, ctx);
+			break;
+		case op_ctr:
+			aes_ctr_ni_ctx(buffer, buffer, ivec, length, ctx);
+			break;
+	}
+}
+
+// best of several rounds, each round repeats the call until BENCH_MIN_BYTES are processed [per call]
+static BenchTime measure(BenchOp op, uint8_t * buffer, unsigned long length, const AESKeyContext * ctx, void * evp) {
+	BenchTime best = {1e300, 1e300};
+	unsigned long calls = BENCH_MIN_BYTES / length;
+	if (calls == 0) {
+		calls = 1;
+	}
+
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		double start = now();
+		uint64_t cycles = __rdtsc();
+		for (unsigned long c = 0; c < calls; c++) {
+			run(op, buffer, length, ctx, evp);
+			// the next IV depends on this output, so short calls can not overlap in the pipeline
+			ivec[0] ^= buffer[length - 1];
+		}
+		cycles = __rdtsc() - cycles;
+		double took = now() - start;
+		if (took / calls < best.ns) {
+			best.ns = took / calls;
+			best.cycles = (double)cycles / calls;
+		}
+	}
+	return best;
+}
+
+// one block at a time, every block depends on the one before so this is the latency and not the throughput
+static BenchTime measure_latency(int decrypt, const AESKeyContext * ctx) {
+	BenchTime best = {1e300, 1e300};
+	__m128i block = _mm_loadu_si128((__m128i *)ivec);
+
+	for (int r = 0; r < BENCH_ROUNDS; r++) {
+		double start = now();
+		uint64_t cycles = __rdtsc();
+		for (int i = 0; i < BENCH_LATENCY_OPS; i++) {
+			if (decrypt) {
+				aes_ni_dec(&block, (__m128i *)ctx->dec_schedule, ctx->keymode);
+			} else {
+				aes_ni_enc(&block, (__m128i *)ctx->enc_schedule, ctx->keymode);
+			}
+		}
+		cycles = __rdtsc() - cycles;
+		double took = now() - start;
+		if (took / BENCH_LATENCY_OPS < best.ns) {
+			best.ns = took / BENCH_LATENCY_OPS;
+			best.cycles = (double)cycles / BENCH_LATENCY_OPS;
+		}
+	}
+	_mm_storeu_si128((__m128i *)ivec, block);
+	return best;
+}
+
+#pragma mark - Reporting
+static void report(int json, const char * impl, const char * op, int bits, unsigned long length, BenchTime time) {
+	double cpb = time.cycles / length;
+	double gbps = length / time.ns;
+	if (json) {
+		printf("%s\n    {\"impl\": \"%s\", \"op\": \"%s\", \"key_bits\": %d, \"bytes\": %lu, "
+			   "\"cycles_per_byte\": %.4f, \"gb_per_s\": %.4f, \"ns_per_call\": %.2f}",
+			   json_rows++ ? "," : "", impl, op, bits, length, cpb, gbps, time.ns);
+	} else {
+		printf("%-12s %-9s %4d %11lu %10.3f %10.3f %14.1f\n", impl, op, bits, length, cpb, gbps, time.ns);
+	}
+	fflush(stdout);
+}
+
+int main(int argc, char ** argv) {
+	// usage: suite_bench [-j] [max bytes]
+	const AESKeyMode modes[] = {aes_128, aes_192, aes_256};
+	const int bits[] = {128, 192, 256};
+	unsigned long max_bytes = BENCH_MAX_BYTES;
+	int json = 0;
+
+	for (int a = 1; a < argc; a++) {
+		if (strcmp(argv[a], "-j") == 0) {
+			json = 1;
+		} else {
+			max_bytes = strtoul(argv[a], NULL, 0);
+		}
+	}
+	if (max_bytes < 16) {
+		fprintf(stderr, "usage: %s [-j] [max bytes >= 16]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	uint8_t * buffer = aligned_alloc(64, (max_bytes + 63) & ~63UL);
+	if (buffer == NULL) {
+		fprintf(stderr, "could not allocate %lu bytes\n", max_bytes);
+		return EXIT_FAILURE;
+	}
+	// touch every page up front so the first large run does not pay for the page faults
+	memset(buffer, 0xa5, max_bytes);
+	for (int i = 0; i < 32; i++) {
+		key[i] = (uint8_t)i;
+	}
+
+	// the first rounds otherwise run while the core is still clocking up
+	AESKeyContext warm;
+	aes_ni_key_context_init(&warm, key, aes_128);
+	measure(op_ctr, buffer, max_bytes < BENCH_MIN_BYTES ? max_bytes : BENCH_MIN_BYTES, &warm, NULL);
+	aes_key_context_clear(&warm);
+
+	if (json) {
+		printf("{\n  \"rounds\": %d,\n  \"results\": [", BENCH_ROUNDS);
+	} else {
+		printf("%-12s %-9s %4s %11s %10s %10s %14s\n", "impl", "op", "key", "bytes", "cycles/B", "GB/s", "ns/call");
+	}
+
+	for (int m = 0; m < 3; m++) {
+		AESKeyContext ctx;
+		aes_ni_key_context_init(&ctx, key, modes[m]);
+
+		report(json, "simplecrypt", "enc_block", bits[m], 16, measure_latency(0, &ctx));
+		report(json, "simplecrypt", "dec_block", bits[m], 16, measure_latency(1, &ctx));
+
+		for (BenchOp op = op_cbc_enc; op <= op_ctr; op++) {
+			// 16 B to 1 GiB in powers of four
+			for (unsigned long length = 16; length <= max_bytes; length *= 4) {
+				report(json, "simplecrypt", op_names[op], bits[m], length, measure(op, buffer, length, &ctx, NULL));
+#ifdef BENCH_OPENSSL
+				EVP_CIPHER_CTX * evp = EVP_CIPHER_CTX_new();
+				EVP_CipherInit_ex(evp, openssl_cipher(op, modes[m]), NULL, key, ivec, op != op_cbc_dec);
+				EVP_CIPHER_CTX_set_padding(evp, 0);
+				report(json, "openssl", op_names[op], bits[m], length, measure(op, buffer, length, &ctx, evp));
+				EVP_CIPHER_CTX_free(evp);
+#endif
+			}
+		}
+		aes_key_context_clear(&ctx);
+	}
+
+	if (json) {
+		printf("\n  ]\n}\n");
+	}
+	free(buffer);
+	return 0;
+}
@@ -26,20 +26,71 @@
 const int i = 1;
 #define is_bigendian() ( (*(char*)&i) == 0 )
 
-__attribute__((constructor))
-static void initializer(void) {
-	printf("[%s] initialized\n", __FILE__);
+#pragma mark - Core Errors
+char * aes_mode_error(void) {
+	return "Fatal Error: an invalid aes mode was passed. \n                     > Even though Rijndael supports several lengths of key bits, AES is defined to only support 128, 192, or 256 bits.\n";
 }
 
-// destructor
-__attribute__((destructor))
-static void finalizer(void) {
-	printf("[%s] finalized\n", __FILE__);
+char * aes_mb_mode_error(void) {
+	return "Fatal Error: the jobs of a multi-buffer batch use different aes modes. \n                     > All lanes run through the rounds together, so every job of a batch must use the same key length.\n";
 }
 
-#pragma mark - Core Errors
-char * aes_mode_error(void) {
-	return "Fatal Error: an invalid aes mode was passed. \n                     > Even though Rijndael supports several lengths of key bits, AES is defined to only support 128, 192, or 256 bits.\n";
+char * aes_gcm_order_error(void) {
+	return "Fatal Error: additional authenticated data was passed after the gcm message data. \n                     > GHASH covers the associated data first, pass all of it before the first update with message data.\n";
+}
+
+char * aes_gcm_limit_error(void) {
+	return "Fatal Error: the gcm message exceeds the length limit. \n                     > The 32 bit block counter allows at most 2^32 - 2 blocks (about 64 GiB) per message, use a new IV for more data.\n";
+}
+
+char * aes_xts_length_error(void) {
+	return "Fatal Error: the xts data unit is shorter than one block. \n                     > Ciphertext stealing borrows from the previous block, so a data unit must hold at least 16 bytes.\n";
+}
+
+char * aes_pool_error(void) {
+	return "Fatal Error: the aes thread pool could not be created. \n                     > The system refused to allocate the worker threads or their state, try fewer threads.\n";
+}
+
+char * aes_backend_error(void) {
+	return "Fatal Error: the active aes backend does not implement this function. \n                     > Force a different backend through SIMPLECRYPT_BACKEND or call the implementation directly.\n";
+}
+
+#pragma mark - Key Management
+void aes_expand_key(uint8_t schedule[][16], const uint8_t * key, AESKeyMode keymode) {
+	aes_expand_key_with(schedule, key, keymode, sub_word);
+}
+
+void aes_expand_key_with(uint8_t schedule[][16], const uint8_t * key, AESKeyMode keymode, uint32_t (*subword)(uint32_t inp)) {
+	uint8_t * w = schedule[0];
+	// words of the user key (4, 6, or 8) and of the full schedule
+	const int nk = keymode - 6;
+	const int nw = 4 * (keymode + 1);
+	uint32_t temp, rcon = 0x01;
+	
+	for (int i = 0; i < 4 * nk; i++) {
+		w[i] = key[i];
+	}
+	
+	for (int i = nk; i < nw; i++) {
+		temp = ((uint32_t)w[4 * i - 4] << 24) | ((uint32_t)w[4 * i - 3] << 16) | ((uint32_t)w[4 * i - 2] << 8) | (uint32_t)w[4 * i - 1];
+		if (i % nk == 0) {
+			temp = subword(rot_word(temp)) ^ (rcon << 24);
+			rcon = (rcon << 1) ^ ((rcon >> 7) * 0x11b);
+		} else if (nk > 6 && i % nk == 4) {
+			temp = subword(temp);
+		}
+		w[4 * i    ] = w[4 * (i - nk)    ] ^ (uint8_t)(temp >> 24);
+		w[4 * i + 1] = w[4 * (i - nk) + 1] ^ (uint8_t)(temp >> 16);
+		w[4 * i + 2] = w[4 * (i - nk) + 2] ^ (uint8_t)(temp >>  8);
+		w[4 * i + 3] = w[4 * (i - nk) + 3] ^ (uint8_t)(temp      );
+	}
+}
+
+void aes_key_context_clear(AESKeyContext * ctx) {
+	volatile uint8_t * raw = (volatile uint8_t *)ctx;
+	for (size_t i = 0; i < sizeof(AESKeyContext); i++) {
+		raw[i] = 0;
+	}
 }
 
 #pragma mark - S Box Internals
@@ -75,7 +126,7 @@ static uint8_t sBoxInv[256] = {
 	0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
 	0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89, 0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
 	0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
-	0x1c, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
+	0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
 	0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d, 0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
 	0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
 	0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d
@@ -89,6 +140,20 @@ uint8_t inv_s_box(uint8_t byte) {
 	return sBoxInv[byte];
 }
 
+#pragma mark - Finite Field
+uint8_t gf_mul(uint8_t a, uint8_t b) {
+	uint8_t p = 0;
+	while (b) {
+		if (b & 1) {
+			p ^= a;
+		}
+		// xtime: multiply by x modulo x^8 + x^4 + x^3 + x + 1
+		a = (uint8_t)((a << 1) ^ ((a & 0x80) ? 0x1b : 0x00));
+		b >>= 1;
+	}
+	return p;
+}
+
 #pragma mark - Sub and Rotate Word
 extern inline uint32_t sub_word(uint32_t inp) {
 	return (
@@ -134,41 +199,22 @@ extern inline void inv_shift_rows(uint8_t * inp) {
 }
 
 extern inline void mix_columns(uint8_t * inp) {
-	uint8_t * temp = inp;
-	inp[ 0] = (0x02 * temp[ 0]) ^ (0x03 * temp[ 4]) ^ temp[ 8] ^ temp[12];
-	inp[ 1] = (0x02 * temp[ 1]) ^ (0x03 * temp[ 5]) ^ temp[ 9] ^ temp[13];
-	inp[ 2] = (0x02 * temp[ 2]) ^ (0x03 * temp[ 6]) ^ temp[10] ^ temp[14];
-	inp[ 3] = (0x02 * temp[ 3]) ^ (0x03 * temp[ 7]) ^ temp[11] ^ temp[15];
-	inp[ 4] = temp[ 0] ^ (0x02 * temp[ 4]) ^ (0x03 * temp[ 8]) ^ temp[12];
-	inp[ 5] = temp[ 1] ^ (0x02 * temp[ 5]) ^ (0x03 * temp[ 9]) ^ temp[13];
-	inp[ 6] = temp[ 2] ^ (0x02 * temp[ 6]) ^ (0x03 * temp[10]) ^ temp[14];
-	inp[ 7] = temp[ 3] ^ (0x02 * temp[ 7]) ^ (0x03 * temp[11]) ^ temp[15];
-	inp[ 8] = temp[ 0] ^ temp[ 4] ^ (0x02 * temp[ 8]) ^ (0x03 * temp[12]);
-	inp[ 9] = temp[ 1] ^ temp[ 5] ^ (0x02 * temp[ 9]) ^ (0x03 * temp[13]);
-	inp[10] = temp[ 2] ^ temp[ 6] ^ (0x02 * temp[10]) ^ (0x03 * temp[14]);
-	inp[11] = temp[ 3] ^ temp[ 7] ^ (0x02 * temp[11]) ^ (0x03 * temp[15]);
-	inp[12] = (0x03 * temp[ 0]) ^ temp[ 4] ^ temp[ 8] ^ (0x02 * temp[12]);
-	inp[13] = (0x03 * temp[ 1]) ^ temp[ 5] ^ temp[ 9] ^ (0x02 * temp[13]);
-	inp[14] = (0x03 * temp[ 2]) ^ temp[ 6] ^ temp[10] ^ (0x02 * temp[14]);
-	inp[15] = (0x03 * temp[ 3]) ^ temp[ 7] ^ temp[11] ^ (0x02 * temp[15]);
+	// the state is row major: column c is {inp[c], inp[4 + c], inp[8 + c], inp[12 + c]}
+	for (int c = 0; c < 4; c++) {
+		const uint8_t a0 = inp[c], a1 = inp[4 + c], a2 = inp[8 + c], a3 = inp[12 + c];
+		inp[     c] = gf_mul(a0, 0x02) ^ gf_mul(a1, 0x03) ^ a2 ^ a3;
+		inp[ 4 + c] = a0 ^ gf_mul(a1, 0x02) ^ gf_mul(a2, 0x03) ^ a3;
+		inp[ 8 + c] = a0 ^ a1 ^ gf_mul(a2, 0x02) ^ gf_mul(a3, 0x03);
+		inp[12 + c] = gf_mul(a0, 0x03) ^ a1 ^ a2 ^ gf_mul(a3, 0x02);
+	}
 }
 
 extern inline void inv_mix_columns(uint8_t * inp) {
-	uint8_t * temp = inp;
-	inp[ 0] = (0x0e * temp[ 0]) ^ (0x0b * temp[ 4]) ^ temp[ 8] ^ temp[12];
-	inp[ 1] = (0x0e * temp[ 1]) ^ (0x0b * temp[ 5]) ^ temp[ 9] ^ temp[13];
-	inp[ 2] = (0x0e * temp[ 2]) ^ (0x0b * temp[ 6]) ^ temp[10] ^ temp[14];
-	inp[ 3] = (0x0e * temp[ 3]) ^ (0x0b * temp[ 7]) ^ temp[11] ^ temp[15];
-	inp[ 4] = temp[ 0] ^ (0x02 * temp[ 4]) ^ (0x03 * temp[ 8]) ^ temp[12];
-	inp[ 5] = temp[ 1] ^ (0x02 * temp[ 5]) ^ (0x03 * temp[ 9]) ^ temp[13];
-	inp[ 6] = temp[ 2] ^ (0x02 * temp[ 6]) ^ (0x03 * temp[10]) ^ temp[14];
-	inp[ 7] = temp[ 3] ^ (0x02 * temp[ 7]) ^ (0x03 * temp[11]) ^ temp[15];
-	inp[ 8] = temp[ 0] ^ temp[ 4] ^ (0x02 * temp[ 8]) ^ (0x03 * temp[12]);
-	inp[ 9] = temp[ 1] ^ temp[ 5] ^ (0x02 * temp[ 9]) ^ (0x03 * temp[13]);
-	inp[10] = temp[ 2] ^ temp[ 6] ^ (0x02 * temp[10]) ^ (0x03 * temp[14]);
-	inp[11] = temp[ 3] ^ temp[ 7] ^ (0x02 * temp[11]) ^ (0x03 * temp[15]);
-	inp[12] = (0x03 * temp[ 0]) ^ temp[ 4] ^ temp[ 8] ^ (0x02 * temp[12]);
-	inp[13] = (0x03 * temp[ 1]) ^ temp[ 5] ^ temp[ 9] ^ (0x02 * temp[13]);
-	inp[14] = (0x03 * temp[ 2]) ^ temp[ 6] ^ temp[10] ^ (0x02 * temp[14]);
-	inp[15] = (0x03 * temp[ 3]) ^ temp[ 7] ^ temp[11] ^ (0x02 * temp[15]);
+	for (int c = 0; c < 4; c++) {
+		const uint8_t a0 = inp[c], a1 = inp[4 + c], a2 = inp[8 + c], a3 = inp[12 + c];
+		inp[     c] = gf_mul(a0, 0x0e) ^ gf_mul(a1, 0x0b) ^ gf_mul(a2, 0x0d) ^ gf_mul(a3, 0x09);
+		inp[ 4 + c] = gf_mul(a0, 0x09) ^ gf_mul(a1, 0x0e) ^ gf_mul(a2, 0x0b) ^ gf_mul(a3, 0x0d);
+		inp[ 8 + c] = gf_mul(a0, 0x0d) ^ gf_mul(a1, 0x09) ^ gf_mul(a2, 0x0e) ^ gf_mul(a3, 0x0b);
+		inp[12 + c] = gf_mul(a0, 0x0b) ^ gf_mul(a1, 0x0d) ^ gf_mul(a2, 0x09) ^ gf_mul(a3, 0x0e);
+	}
 }
@@ -25,6 +25,245 @@
 #include <stdio.h>
 #include <stdint.h>
 
+#pragma mark - Key Management
+/*!
+ @name Key Management
+ Definitions pertaining to the Key Management (expansion) shared by all implementations
+ */
+///@{
+/*!
+ @typedef AESKeyMode
+
+ @brief An enum setting the key mode.
+
+ This enum allows to set which key mode for AES is being uesd: either 128 bits, 192 bits, or 256 bits. By setting this also the rounds of AES are defined
+
+ Possible values for the key mode and what it specifies:
+ - aes_128: @code AES-128 [key = 128bits, AES rounds = 10] @endcode
+ - aes_192: @code AES-192 [key = 192bits, AES rounds = 12] @endcode
+ - aes_256: @code AES-256 [key = 256bits, AES rounds = 14] @endcode
+ */
+typedef enum {
+	aes_128 = 10,
+	aes_192 = 12,
+	aes_256 = 14
+} AESKeyMode;
+
+/*!
+ @define AES_MAX_ROUND_KEYS
+ The number of round keys of the longest schedule (AES-256: 14 rounds + the initial whitening key)
+ */
+#define AES_MAX_ROUND_KEYS 15
+
+/*!
+ @define aes_specialize
+ Calls `kernel(..., keymode)` with the key mode as a compile time constant, one branch per call instead of per block
+
+ The kernel has to be `always_inline` and take the key mode as its last parameter, every case then becomes a copy
+ of the kernel with a fixed round count (fully unrolled, no key mode branches inside the block loop). Unknown key
+ modes are treated as AES-256 (the schedule has room for it), the key context init functions reject them.
+
+ @code
+ static inline __attribute__((always_inline)) void cbc_enc_kernel(uint8_t * inpt, ..., const AESKeyMode keymode);
+ aes_specialize(ctx->keymode, cbc_enc_kernel, inpt, outt, ivec, mlength, ctx);
+ @endcode
+ */
+#define aes_specialize(keymode, kernel, ...)\
+			do {\
+				switch (keymode) {\
+					case aes_128: kernel(__VA_ARGS__, aes_128); break;\
+					case aes_192: kernel(__VA_ARGS__, aes_192); break;\
+					default:      kernel(__VA_ARGS__, aes_256); break;\
+				}\
+			} while (0)
+
+/*!
+ @typedef AESKeyContext
+
+ @brief An expanded key which can be reused for any number of messages.
+
+ Holds the encryption and the decryption key schedule inline (no heap allocation) so that the key expansion
+ only has to be run once per key instead of once per message. The context can live on the stack, in an arena, or
+ in any other storage of the callers choosing; both schedules are 64 byte aligned so every round key sits in a
+ single cache line.
+
+ The schedules are stored in the native format of the implementation which filled the context, a context must thus
+ only be passed to functions of the same implementation (e.g. a context set up by `aes_ni_key_context_init` may only
+ be used with the `aes_*_ni_*` functions).
+
+ - enc_schedule: The round keys in the order they are used for encryption
+ - dec_schedule: The round keys in the order they are used for decryption (equivalent inverse cipher)
+ - keymode: The AES mode the schedules were expanded for
+
+ @code
+ AESKeyContext ctx;
+ aes_ni_key_context_init(&ctx, userKey, aes_128);
+ for (size_t i = 0; i < records; i++) {
+	aes_cbc_ni_enc_ctx(msg[i], cipher[i], iv[i], len[i], &ctx);
+ }
+ aes_key_context_clear(&ctx);
+ @endcode
+ */
+typedef struct {
+	uint8_t enc_schedule[AES_MAX_ROUND_KEYS][16] __attribute__((aligned(64)));
+	uint8_t dec_schedule[AES_MAX_ROUND_KEYS][16] __attribute__((aligned(64)));
+	AESKeyMode keymode;
+} AESKeyContext;
+
+/*!
+ @brief Portable implementation of the key expansion defined by the AES standard
+
+ Expands the user key into `keymode + 1` round keys. The round keys are written as bytes in the same order as they
+ are XORed onto the state (i.e. the byte order used by the Intel and ARM AES instructions).
+
+ @warning The function does not validate the key mode, this is up to the caller
+
+ @param schedule The location to write the round keys to (at least `keymode + 1` round keys)
+ @param key The user key (`16`, `24`, or `32` bytes depending on the key mode)
+ @param keymode The AES version to expand the key for
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2)))
+void aes_expand_key(uint8_t schedule[][16], const uint8_t * key, AESKeyMode keymode);
+
+/*!
+ @brief Portable key expansion with a caller provided SubWord
+
+ Same as `aes_expand_key` but runs SubWord through the passed function. The S-box lookups of `aes_expand_key` depend
+ on the key, implementations which must not leak the key through the cache pass a constant time SubWord here.
+
+ @param schedule The location to write the round keys to (at least `keymode + 1` round keys)
+ @param key The user key (`16`, `24`, or `32` bytes depending on the key mode)
+ @param keymode The AES version to expand the key for
+ @param subword Applies the S-box to every byte of a word (see `sub_word`)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 4)))
+void aes_expand_key_with(uint8_t schedule[][16], const uint8_t * key, AESKeyMode keymode, uint32_t (*subword)(uint32_t inp));
+
+/*!
+ @brief Wipes an expanded key
+
+ Overwrites both schedules of the context with zeros in a way that is not removed by the optimizer. Call this once
+ a context is no longer needed.
+
+ @param ctx The context to wipe
+ */
+__attribute__((visibility("hidden"), nonnull(1)))
+void aes_key_context_clear(AESKeyContext * ctx);
+///@}
+
+#pragma mark - Counter Mode
+/*!
+ @name Counter Mode
+ Definitions shared by the CounTeR mode implementations
+ */
+///@{
+/*!
+ @typedef AESCounterWidth
+
+ @brief An enum setting how many (big endian) bits of the counter block are incremented.
+
+ The counter block is interpreted as a big endian number of which only the lowest `width` bits are incremented, a
+ carry out of these bits is dropped (the counter wraps) and the remaining bits (the nonce) stay untouched.
+
+ Possible values for the counter width and what it specifies:
+ - ctr_32: @code [nonce = 96bits, counter = 32bits] (e.g. GCM) @endcode
+ - ctr_64: @code [nonce = 64bits, counter = 64bits] @endcode
+ - ctr_128: @code [counter = 128bits] (NIST SP 800-38A) @endcode
+ */
+typedef enum {
+	ctr_32 = 32,
+	ctr_64 = 64,
+	ctr_128 = 128
+} AESCounterWidth;
+
+// the counter block is kept as two host order halves and only converted to a (big endian) block when needed
+static inline uint64_t aes_load_be64(const uint8_t * p) {
+	return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) | ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+		   ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) | ((uint64_t)p[6] <<  8) | ((uint64_t)p[7]);
+}
+
+static inline void aes_store_be64(uint8_t * p, uint64_t v) {
+	for (int b = 7; b >= 0; b--, v >>= 8) {
+		p[b] = (uint8_t)v;
+	}
+}
+
+// increments the lowest `width` bits of the counter block held as two halves, the carry out of them is dropped
+static inline void aes_ctr_increment(uint64_t * hi, uint64_t * lo, AESCounterWidth width) {
+	switch (width) {
+		case ctr_32:
+			*lo = (*lo & 0xffffffff00000000ULL) | (uint32_t)(*lo + 1);
+			break;
+		case ctr_64:
+			*lo += 1;
+			break;
+		default:
+			*lo += 1;
+			*hi += (*lo == 0);
+			break;
+	}
+}
+
+// adds `blocks` to the (big endian) 128 bit counter block in memory
+static inline void aes_ctr_add(uint8_t * counter, unsigned long long blocks) {
+	uint64_t hi = aes_load_be64(counter), lo = aes_load_be64(counter + 8) + blocks;
+	hi += (lo < blocks);
+	aes_store_be64(counter, hi);
+	aes_store_be64(counter + 8, lo);
+}
+///@}
+
+#pragma mark - Multi-Buffer
+/*!
+ @name Multi-Buffer
+ Definitions shared by the multi-buffer implementations which interleave independent messages
+ */
+///@{
+/*!
+ @typedef AESCBCJob
+
+ @brief One independent CBC message of a multi-buffer batch.
+
+ Every job carries its own message, IV and key context. Jobs may share a context (one key for the whole batch) or
+ each use their own (one key per lane), but all contexts of a batch must use the same key mode.
+
+ - inpt: The data to encrypt
+ - outt: The location where the encrypted data will be written
+ - ivec: The IV (Initial Vector) of this message
+ - mlength: The length of the message [in bytes] (a multiple of 16)
+ - ctx: The key context to encrypt this message with
+ - completed: Set to `1` as soon as the last block of this job has been written
+ - user_data: Free for the caller, e.g. to find the record belonging to a completed job
+ */
+typedef struct {
+	uint8_t * inpt;
+	uint8_t * outt;
+	uint8_t * ivec;
+	unsigned long mlength;
+	const AESKeyContext * ctx;
+	int completed;
+	void * user_data;
+} AESCBCJob;
+
+/*!
+ @typedef AESXTSSector
+
+ @brief One sector (data unit) of an XTS batch.
+
+ All sectors of a batch have the same size and are encrypted with the same pair of keys, the tweak of a sector is
+ derived from its number (IEEE P1619: the sector number as a 128 bit little endian value).
+
+ - inpt: The data of the sector
+ - outt: The location where the encrypted (decrypted) sector will be written (may be `inpt`)
+ - sector: The number of the sector
+ */
+typedef struct {
+	uint8_t * inpt;
+	uint8_t * outt;
+	uint64_t sector;
+} AESXTSSector;
+///@}
+
 #pragma mark - Core Errors
 /*!
   @name AES Core Error String
@@ -44,6 +283,89 @@
  */
 __attribute__((visibility("hidden")))
 char * aes_mode_error(void);
+/*!
+  @brief Returns the standardized error message for a multi-buffer batch mixing key modes
+
+  Returns the standardized error message for when the jobs of a multi-buffer batch do not all use the same AES key
+  mode. Message is:
+  @code
+  Fatal Error: the jobs of a multi-buffer batch use different aes modes.
+               > All lanes run through the rounds together, so every job of a batch must use the same key length
+  @endcode
+
+  @returns A string for the specific error.
+ */
+__attribute__((visibility("hidden")))
+char * aes_mb_mode_error(void);
+/*!
+  @brief Returns the standardized error message for associated data passed after GCM message data
+
+  Returns the standardized error message for when additional authenticated data is passed to a GCM context which
+  already processed message data. Message is:
+  @code
+  Fatal Error: additional authenticated data was passed after the gcm message data.
+               > GHASH covers the associated data first, pass all of it before the first update with message data
+  @endcode
+
+  @returns A string for the specific error.
+ */
+__attribute__((visibility("hidden")))
+char * aes_gcm_order_error(void);
+/*!
+  @brief Returns the standardized error message for a GCM message which is too long
+
+  Returns the standardized error message for when more message data is passed to a GCM context than the 32 bit block
+  counter can cover. Message is:
+  @code
+  Fatal Error: the gcm message exceeds the length limit.
+               > The 32 bit block counter allows at most 2^32 - 2 blocks (about 64 GiB) per message, use a new IV for more data
+  @endcode
+
+  @returns A string for the specific error.
+ */
+__attribute__((visibility("hidden")))
+char * aes_gcm_limit_error(void);
+/*!
+  @brief Returns the standardized error message for an XTS data unit shorter than one block
+
+  Returns the standardized error message for when less than 16 bytes are passed to an XTS function. Message is:
+  @code
+  Fatal Error: the xts data unit is shorter than one block.
+               > Ciphertext stealing borrows from the previous block, so a data unit must hold at least 16 bytes
+  @endcode
+
+  @returns A string for the specific error.
+ */
+__attribute__((visibility("hidden")))
+char * aes_xts_length_error(void);
+/*!
+  @brief Returns the standardized error message for a thread pool which could not be started
+
+  Returns the standardized error message for when the memory or the threads of a thread pool could not be
+  allocated. Message is:
+  @code
+  Fatal Error: the aes thread pool could not be created.
+               > The system refused to allocate the worker threads or their state, try fewer threads
+  @endcode
+
+  @returns A string for the specific error.
+ */
+__attribute__((visibility("hidden")))
+char * aes_pool_error(void);
+/*!
+  @brief Returns the standardized error message for a function the active backend does not implement
+
+  Returns the standardized error message for when a dispatched function is called which the active backend does
+  not provide. Message is:
+  @code
+  Fatal Error: the active aes backend does not implement this function.
+               > Force a different backend through SIMPLECRYPT_BACKEND or call the implementation directly
+  @endcode
+
+  @returns A string for the specific error.
+ */
+__attribute__((visibility("hidden")))
+char * aes_backend_error(void);
 ///@}
 
 #pragma mark - S Box Internals
@@ -98,7 +420,7 @@ uint8_t s_box(uint8_t byte);
   0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8, 0x1c, 0x75, 0xdf, 0x6e,
   0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89, 0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b,
   0xfc, 0x56, 0x3e, 0x4b, 0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
-  0x1c, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
+  0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59, 0x27, 0x80, 0xec, 0x5f,
   0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d, 0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef,
   0xa0, 0xe0, 0x3b, 0x4d, 0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
   0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d
@@ -112,6 +434,26 @@ __attribute__((visibility("hidden")))
 uint8_t inv_s_box(uint8_t byte);
 ///@}
 
+#pragma mark - Finite Field
+/*!
+  @name Finite Field
+  Arithmetic in GF(2^8) as used by MixColumns and the table generation of the general c implementation
+ */
+///@{
+/*!
+  @brief Multiplies two elements of GF(2^8)
+
+  Carry-less multiplication of two bytes reduced by the AES polynomial `x^8 + x^4 + x^3 + x + 1`.
+
+  @param a The first factor
+  @param b The second factor
+
+  @returns The product `a * b` in GF(2^8)
+ */
+__attribute__((visibility("hidden")))
+uint8_t gf_mul(uint8_t a, uint8_t b);
+///@}
+
 #pragma mark - Sub and Rot Words
 /*!
   @name Sub and Rot Words
@@ -10,6 +10,8 @@
 
 #include "AESarm.h"
 
+#ifdef arm_active
+
 /*!
  @file AESarm.c
  
@@ -21,161 +23,52 @@
  @author Jan Niegsch
  */
 
-#pragma mark - Internal Core
-__attribute__((constructor))
-static void initializer(void) {
-	printf("[%s] initialized\n", __FILE__);
-}
-
-// destructor
-__attribute__((destructor))
-static void finalizer(void) {
-	printf("[%s] finalized\n", __FILE__);
-}
-
-#pragma mark - Key Management 128
-static inline uint32x4_t aes_128_expAssist(uint32x4_t prev, uint32_t rcon) {
-	uint32_t round[4], prv[4];
-	// load neon vector type into array
-	vst1q_32(prv, prev);
-
-	round[0] = sub_word(rot_word(  prv[3])) ^ rcon ^ prv[0];
-	round[1] = sub_word(rot_word(round[0])) ^ rcon ^ prv[1];
-	round[2] = sub_word(rot_word(round[1])) ^ rcon ^ prv[2];
-	round[3] = sub_word(rot_word(round[2])) ^ rcon ^ prv[3];
-
-	return vld1q_u3(round);
-}
-
-static void key_expansion_128(uint32x4_t * schedule[11], uint8x16_t encKey) {
-	(*schedule)[ 0] = vld1q_u32(encKey);
-	(*schedule)[ 1] = aes_128_expAssist((*schedule)[0], 0x01);
-	(*schedule)[ 2] = aes_128_expAssist((*schedule)[1], 0x02);
-	(*schedule)[ 3] = aes_128_expAssist((*schedule)[2], 0x04);
-	(*schedule)[ 4] = aes_128_expAssist((*schedule)[3], 0x08);
-	(*schedule)[ 5] = aes_128_expAssist((*schedule)[4], 0x10);
-	(*schedule)[ 6] = aes_128_expAssist((*schedule)[5], 0x20);
-	(*schedule)[ 7] = aes_128_expAssist((*schedule)[6], 0x40);
-	(*schedule)[ 8] = aes_128_expAssist((*schedule)[7], 0x80);
-	(*schedule)[ 9] = aes_128_expAssist((*schedule)[8], 0x1b);
-	(*schedule)[10] = aes_128_expAssist((*schedule)[9], 0x36);
-}
-
-#pragma mark - Key Management 192
-static inline uint32x4_t * aes_192_expAssist(uint32x4_t prev, uint32x2_t * temp, uint32_t rcon1, uint32_t rcon2) {
-	uint32_t round1[4], round2[4], round3[4], tmp[2], prv[4];
-
-	vst1_u32(tmp, *temp);
-	vst1q_u32(prv, prev);
-	 
-	round1[ 0] = tmp[0];
-	round1[ 1] = tmp[1];
-	round1[ 2] = sub_word(rot_word( round1[1])) ^ rcon1 ^    prv[0];
-	round1[ 3] = sub_word(rot_word( round1[2])) ^ rcon1 ^    prv[1];
-
-	round2[ 0] = sub_word(rot_word( round1[3])) ^ rcon1 ^    prv[2];
-	round2[ 1] = sub_word(rot_word( round2[0])) ^ rcon1 ^    prv[3];
-	round2[ 2] = sub_word(rot_word( round2[1])) ^ rcon1 ^ round1[0];
-	round2[ 3] = sub_word(rot_word( round2[2])) ^ rcon1 ^ round1[1];
-
-	round3[ 0] = sub_word(rot_word( round2[3])) ^ rcon2 ^ round1[2];
-	round3[ 1] = sub_word(rot_word( round3[0])) ^ rcon2 ^ round1[3];
-	round3[ 2] = sub_word(rot_word( round3[1])) ^ rcon2 ^ round2[0];
-	round3[ 3] = sub_word(rot_word( round3[2])) ^ rcon2 ^ round2[1];
-	
-	    tmp[0] = sub_word(rot_word( round3[3])) ^ rcon2 ^ round2[2];
-	    tmp[1] = sub_word(rot_word(    tmp[0])) ^ rcon2 ^ round2[3];
-
-	uint32x4_t expansion[3] = {vld1q_u3(round1), vld1q_u3(round2), vld1q_u3(round3)};
-
-	return expansion;
-}
-
-static void key_expansion_192(uint32x4_t * schedule[13], uint8x16_t encKey) {
-	uint32x2_t temp;
-	uint32x4_t * trippleRounds = NULL;
-
-	(*schedule)[0]    = vld1q_u32(encKey);
-	temp           = vld1_u32(encKey + 16);
-	trippleRounds  = aes_192_expAssist((*schedule)[0], &temp, 0x01, 0x02);
-	(*schedule)[ 1]   = trippleRounds[0];
-	(*schedule)[ 2]   = trippleRounds[1];
-	(*schedule)[ 3]   = trippleRounds[2];
-	trippleRounds  = aes_192_expAssist((*schedule)[3], &temp, 0x04, 0x08);
-	(*schedule)[ 4]   = trippleRounds[0];
-	(*schedule)[ 5]   = trippleRounds[1];
-	(*schedule)[ 6]   = trippleRounds[2];
-	trippleRounds  = aes_192_expAssist((*schedule)[6], &temp, 0x10, 0x20);
-	(*schedule)[ 7]   = trippleRounds[0];
-	(*schedule)[ 8]   = trippleRounds[1];
-	(*schedule)[ 9]   = trippleRounds[2];
-	trippleRounds  = aes_192_expAssist((*schedule)[9], &temp, 0x40, 0x80);
-	(*schedule)[10]   = trippleRounds[0];
-	(*schedule)[11]   = trippleRounds[1];
-	(*schedule)[12]   = trippleRounds[2];
-}
-
-#pragma mark - Key Management 256
-static inline uint32x4_t * aes_256_expAssist(uint32x4_t prev1, uint32x4_t prev2, uint32_t rcon) {
-	uint32_t round1[4], round2[4], prv1[4], prv2[4];
-
-	vst1q_u32(prv1, prev1);
-	vst1q_u32(prv2, prev2);
-
-	round1[0] = sub_word(rot_word(  prv2[3])) ^ rcon ^ prv1[0];
-	round1[1] = sub_word(rot_word(round1[0])) ^ rcon ^ prv1[1];
-	round1[2] = sub_word(rot_word(round1[1])) ^ rcon ^ prv1[2];
-	round1[3] = sub_word(rot_word(round1[2])) ^ rcon ^ prv1[3];
-
-	round2[0] = sub_word(rot_word(round1[3])) ^ rcon ^ prv2[0];
-	round2[1] = sub_word(rot_word(round2[0])) ^ rcon ^ prv2[1];
-	round2[2] = sub_word(rot_word(round2[1])) ^ rcon ^ prv2[2];
-	round2[3] = sub_word(rot_word(round2[2])) ^ rcon ^ prv2[3];
-
-	uint32x4_t expansion[2] = {vld1q_u3(round1), vld1q_u3(round2)};
-
-	return expansion;
-}
-
-static void key_expansion_256(uint32x4_t * schedule[15], uint8x16_t encKey) {
-	uint32x4_t * doubleRound = NULL;
-
-	(*schedule)[ 0] = vld1q_u32(encKey);
-	(*schedule)[ 1] = vld1q_u32(encKey + 16);
-	doubleRound     = aes_256_expAssist((*schedule)[ 0], (*schedule)[ 1], 0x01);
-	(*schedule)[ 2] = doubleRound[0];
-	(*schedule)[ 3] = doubleRound[1];
-	doubleRound     = aes_256_expAssist((*schedule)[ 2], (*schedule)[ 3], 0x02);
-	(*schedule)[ 4] = doubleRound[0];
-	(*schedule)[ 5] = doubleRound[1];
-	doubleRound     = aes_256_expAssist((*schedule)[ 4], (*schedule)[ 5], 0x04);
-	(*schedule)[ 6] = doubleRound[0];
-	(*schedule)[ 7] = doubleRound[1];
-	doubleRound     = aes_256_expAssist((*schedule)[ 6], (*schedule)[ 7], 0x08);
-	(*schedule)[ 8] = doubleRound[0];
-	(*schedule)[ 9] = doubleRound[1];
-	doubleRound     = aes_256_expAssist((*schedule)[ 8], (*schedule)[ 9], 0x10);
-	(*schedule)[10] = doubleRound[0];
-	(*schedule)[11] = doubleRound[1];
-	doubleRound     = aes_256_expAssist((*schedule)[10], (*schedule)[11], 0x20);
-	(*schedule)[12] = doubleRound[0];
-	(*schedule)[13] = doubleRound[1];
-	doubleRound     = aes_256_expAssist((*schedule)[12], (*schedule)[13], 0x40);
-	(*schedule)[14] = doubleRound[0];
-}
+#pragma mark - Internal Core Definitions
+/*!
+ @define aese_8
+ Runs one AES encryption round (with mix columns) on eight independent blocks
+ */
+#define aese_8(b, key)\
+			b[0] = vaesmcq_u8(vaeseq_u8(b[0], key)); b[1] = vaesmcq_u8(vaeseq_u8(b[1], key));\
+			b[2] = vaesmcq_u8(vaeseq_u8(b[2], key)); b[3] = vaesmcq_u8(vaeseq_u8(b[3], key));\
+			b[4] = vaesmcq_u8(vaeseq_u8(b[4], key)); b[5] = vaesmcq_u8(vaeseq_u8(b[5], key));\
+			b[6] = vaesmcq_u8(vaeseq_u8(b[6], key)); b[7] = vaesmcq_u8(vaeseq_u8(b[7], key))
+/*!
+ @define aeselast_8
+ Runs the last AES encryption round (no mix columns, final key XOR) on eight independent blocks
+ */
+#define aeselast_8(b, key, last)\
+			b[0] = veorq_u8(vaeseq_u8(b[0], key), last); b[1] = veorq_u8(vaeseq_u8(b[1], key), last);\
+			b[2] = veorq_u8(vaeseq_u8(b[2], key), last); b[3] = veorq_u8(vaeseq_u8(b[3], key), last);\
+			b[4] = veorq_u8(vaeseq_u8(b[4], key), last); b[5] = veorq_u8(vaeseq_u8(b[5], key), last);\
+			b[6] = veorq_u8(vaeseq_u8(b[6], key), last); b[7] = veorq_u8(vaeseq_u8(b[7], key), last)
+/*!
+ @define aesd_8
+ Runs one AES decryption round (with inverse mix columns) on eight independent blocks
+ */
+#define aesd_8(b, key)\
+			b[0] = vaesimcq_u8(vaesdq_u8(b[0], key)); b[1] = vaesimcq_u8(vaesdq_u8(b[1], key));\
+			b[2] = vaesimcq_u8(vaesdq_u8(b[2], key)); b[3] = vaesimcq_u8(vaesdq_u8(b[3], key));\
+			b[4] = vaesimcq_u8(vaesdq_u8(b[4], key)); b[5] = vaesimcq_u8(vaesdq_u8(b[5], key));\
+			b[6] = vaesimcq_u8(vaesdq_u8(b[6], key)); b[7] = vaesimcq_u8(vaesdq_u8(b[7], key))
+/*!
+ @define aesdlast_8
+ Runs the last AES decryption round (no inverse mix columns, final key XOR) on eight independent blocks
+ */
+#define aesdlast_8(b, key, last)\
+			b[0] = veorq_u8(vaesdq_u8(b[0], key), last); b[1] = veorq_u8(vaesdq_u8(b[1], key), last);\
+			b[2] = veorq_u8(vaesdq_u8(b[2], key), last); b[3] = veorq_u8(vaesdq_u8(b[3], key), last);\
+			b[4] = veorq_u8(vaesdq_u8(b[4], key), last); b[5] = veorq_u8(vaesdq_u8(b[5], key), last);\
+			b[6] = veorq_u8(vaesdq_u8(b[6], key), last); b[7] = veorq_u8(vaesdq_u8(b[7], key), last)
 
 #pragma mark - Key Management Core
-inline uint32x4_t * load_key_expansion(uint8_t * key, AESKeyMode keymode) {
-	uint32x4_t * keySchedule = malloc((keymode + 1) * sizeof(uint32x4_t));
+void aes_arm_key_context_init(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode) {
 	switch(keymode) {
 		case aes_128:
-			key_expansion_128(&keySchedule, vld1q_u8(key));
-			break;
 		case aes_192:
-			key_expansion_192(&keySchedule, vld1q_u8(key));
-			break;
 		case aes_256:
-			key_expansion_256(&keySchedule, vld1q_u8(key));
+			// ARMv8 has no key generation assist, so the portable expansion is used
+			aes_expand_key(ctx->enc_schedule, key, keymode);
 			break;
 		default:
 			fprintf(stderr, "[%s] %s", __FILE__, aes_mode_error());
@@ -183,123 +76,242 @@ inline uint32x4_t * load_key_expansion(uint8_t * key, AESKeyMode keymode) {
 			break;
 	}
 
-	return keySchedule;
+	// decryption walks the schedule backwards, the inner round keys are run through inverse mix columns
+	// once here (equivalent inverse cipher) so that aes_arm_dec can use them directly for every block
+	vst1q_u8(ctx->dec_schedule[0], vld1q_u8(ctx->enc_schedule[keymode]));
+	for (int i = 1; i < (int)keymode; i++) {
+		vst1q_u8(ctx->dec_schedule[i], vaesimcq_u8(vld1q_u8(ctx->enc_schedule[keymode - i])));
+	}
+	vst1q_u8(ctx->dec_schedule[keymode], vld1q_u8(ctx->enc_schedule[0]));
+	ctx->keymode = keymode;
 }
 
 #pragma mark - Encryption and Decryption Core
-inline void aes_arm_enc(uint8x16_t * data, uint32x4_t * keySchedule, AESKeyMode keymode) {
-	*data = veorq_u8(*data, keySchedule[ 0]);
+inline __attribute__((always_inline)) void aes_arm_enc(uint8x16_t * data, uint8x16_t * keySchedule, AESKeyMode keymode) {
 	//			 mix cols		encrypt
-	*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[1]));
-	*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[2]));
-	*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[3]));
-	*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[4]));
-	*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[5]));
-	*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[6]));
-	*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[7]));
-	*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[8]));
-	*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[9]));
+	*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[ 0]));
+	*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[ 1]));
+	*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[ 2]));
+	*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[ 3]));
+	*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[ 4]));
+	*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[ 5]));
+	*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[ 6]));
+	*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[ 7]));
+	*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[ 8]));
 	if (keymode > 10) {
-		*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[10]));
-		*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[11]));
+		*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[ 9]));
+		*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[10]));
 		if (keymode > 12) {
-			*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[12]));
-			*data = vaesmcq_u8(vaeseq_u8(*data, (uint8x16_t)keySchedule[13]));
+			*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[11]));
+			*data = vaesmcq_u8(vaeseq_u8(*data, keySchedule[12]));
 		}
 	}
-	*data = vaeseq_u8(*data, keySchedule[keymode]);
+	// last round has no mix cols, the final key is a plain xor
+	*data = veorq_u8(vaeseq_u8(*data, keySchedule[keymode - 1]), keySchedule[keymode]);
 }
 
-inline void aes_arm_dec(uint8x16_t * data, uint32x4_t * keySchedule, AESKeyMode keymode) {
-	*data = veorq_u8(*data, keySchedule[keymode]);
-	if (keymode > 12) {
-		*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[13]));
-		*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[12]));
+inline __attribute__((always_inline)) void aes_arm_dec(uint8x16_t * data, uint8x16_t * keySchedule, AESKeyMode keymode) {
+	//			 inv mix cols	decrypt
+	*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[ 0]));
+	*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[ 1]));
+	*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[ 2]));
+	*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[ 3]));
+	*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[ 4]));
+	*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[ 5]));
+	*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[ 6]));
+	*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[ 7]));
+	*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[ 8]));
+	if (keymode > 10) {
+		*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[ 9]));
+		*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[10]));
+		if (keymode > 12) {
+			*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[11]));
+			*data = vaesimcq_u8(vaesdq_u8(*data, keySchedule[12]));
+		}
 	}
+	*data = veorq_u8(vaesdq_u8(*data, keySchedule[keymode - 1]), keySchedule[keymode]);
+}
+
+static inline __attribute__((always_inline)) void aes_arm_enc_8(uint8x16_t * blocks, uint8x16_t * keySchedule, AESKeyMode keymode) {
+	aese_8(blocks, keySchedule[ 0]);
+	aese_8(blocks, keySchedule[ 1]);
+	aese_8(blocks, keySchedule[ 2]);
+	aese_8(blocks, keySchedule[ 3]);
+	aese_8(blocks, keySchedule[ 4]);
+	aese_8(blocks, keySchedule[ 5]);
+	aese_8(blocks, keySchedule[ 6]);
+	aese_8(blocks, keySchedule[ 7]);
+	aese_8(blocks, keySchedule[ 8]);
 	if (keymode > 10) {
-		*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[11]));
-		*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[10]));
+		aese_8(blocks, keySchedule[ 9]);
+		aese_8(blocks, keySchedule[10]);
+		if (keymode > 12) {
+			aese_8(blocks, keySchedule[11]);
+			aese_8(blocks, keySchedule[12]);
+		}
 	}
-	*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[ 9]));
-	*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[ 8]));
-	*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[ 7]));
-	*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[ 6]));
-	*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[ 5]));
-	*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[ 4]));
-	*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[ 3]));
-	*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[ 2]));
-	*data = vaesimcq_u8(vaesdq_u8(*data, (uint8x16_t)keySchedule[ 1]));
-	*data = vaesdq_u8(*data, (uint8x16_t)keySchedule[0]);
+	aeselast_8(blocks, keySchedule[keymode - 1], keySchedule[keymode]);
+}
+
+static inline __attribute__((always_inline)) void aes_arm_dec_8(uint8x16_t * blocks, uint8x16_t * keySchedule, AESKeyMode keymode) {
+	aesd_8(blocks, keySchedule[ 0]);
+	aesd_8(blocks, keySchedule[ 1]);
+	aesd_8(blocks, keySchedule[ 2]);
+	aesd_8(blocks, keySchedule[ 3]);
+	aesd_8(blocks, keySchedule[ 4]);
+	aesd_8(blocks, keySchedule[ 5]);
+	aesd_8(blocks, keySchedule[ 6]);
+	aesd_8(blocks, keySchedule[ 7]);
+	aesd_8(blocks, keySchedule[ 8]);
+	if (keymode > 10) {
+		aesd_8(blocks, keySchedule[ 9]);
+		aesd_8(blocks, keySchedule[10]);
+		if (keymode > 12) {
+			aesd_8(blocks, keySchedule[11]);
+			aesd_8(blocks, keySchedule[12]);
+		}
+	}
+	aesdlast_8(blocks, keySchedule[keymode - 1], keySchedule[keymode]);
 }
 
 #pragma mark - CBC Core
 void aes_cbc_arm_enc(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, uint8_t * epochKey, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_arm_key_context_init(&ctx, epochKey, keymode);
+	aes_cbc_arm_enc_ctx(input, output, ivec, mlength, &ctx);
+	aes_key_context_clear(&ctx);
+}
+
+static inline __attribute__((always_inline)) void cbc_enc_kernel(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, const AESKeyMode keymode) {
 	uint8x16_t feedback, data;
+	uint8x16_t * keySched = (uint8x16_t *)ctx->enc_schedule;
 
-	// check message length
-	if (mlength % 16) {
-		mlength = mlength / 16 + 1;
-	} else {
-		mlength /= 16;
-	}
+	// only full blocks are processed, a trailing partial block is never read or written
+	mlength /= 16;
 
-	// key exp
-	uint32x4_t * keySched = load_key_expansion(epochKey, keymode);
-	feedback = vld1q_u8((uint8x16_t *)ivec);
+	feedback = vld1q_u8(ivec);
 	for (size_t i = 0; i < mlength; i++) {
 		data = vld1q_u8(&input[i * 16]);
-		feedback = veor_u8(data, feedback);
+		feedback = veorq_u8(data, feedback);
 		aes_arm_enc(&feedback, keySched, keymode);
 		vst1q_u8(&output[i * 16], feedback);
 	}
 }
 
+void aes_cbc_arm_enc_ctx(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	aes_specialize(ctx->keymode, cbc_enc_kernel, input, output, ivec, mlength, ctx);
+}
+
 void aes_cbc_arm_dec(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, uint8_t * epochKey, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_arm_key_context_init(&ctx, epochKey, keymode);
+	aes_cbc_arm_dec_ctx(input, output, ivec, mlength, &ctx);
+	aes_key_context_clear(&ctx);
+}
+
+static inline __attribute__((always_inline)) void cbc_dec_kernel(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, const AESKeyMode keymode) {
 	uint8x16_t feedback, data, lastIn;
+	uint8x16_t * keySched = (uint8x16_t *)ctx->dec_schedule;
 
-	// check message length
-	if (mlength % 16) {
-		mlength = mlength / 16 + 1;
-	} else {
-		mlength /= 16;
-	}
+	// only full blocks are processed, a trailing partial block is never read or written
+	mlength /= 16;
 
-	// key exp
-	uint32x4_t * keySched = load_key_expansion(epochKey, keymode);
 	feedback = vld1q_u8(ivec);
-	for (size_t i = 0; i < mlength; i++) {
+	size_t i = 0;
+
+	// eight blocks per iteration, all cipher blocks are loaded before any output is written (in place safe)
+	for (; i + 8 <= mlength; i += 8) {
+		uint8x16_t cipher[8], blocks[8];
+		for (int b = 0; b < 8; b++) {
+			cipher[b] = vld1q_u8(&input[(i + b) * 16]);
+			blocks[b] = cipher[b];
+		}
+		aes_arm_dec_8(blocks, keySched, keymode);
+		vst1q_u8(&output[i * 16], veorq_u8(blocks[0], feedback));
+		for (int b = 1; b < 8; b++) {
+			vst1q_u8(&output[(i + b) * 16], veorq_u8(blocks[b], cipher[b - 1]));
+		}
+		feedback = cipher[7];
+	}
+
+	// tail [up to seven blocks]
+	for (; i < mlength; i++) {
 		data = vld1q_u8(&input[i * 16]);
 		lastIn = data;
-		aes_arm_enc(&data, keySched, keymode);
-		data = veor_u8(data, feedback);
+		aes_arm_dec(&data, keySched, keymode);
+		data = veorq_u8(data, feedback);
 		vst1q_u8(&output[i * 16], data);
 		feedback = lastIn;
 	}
 }
 
+void aes_cbc_arm_dec_ctx(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	aes_specialize(ctx->keymode, cbc_dec_kernel, input, output, ivec, mlength, ctx);
+}
+
 #pragma mark - CTR Core
 void aes_ctr_arm(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, uint8_t * epochKey, AESKeyMode keymode) {
-	uint8x16_t iv, feedback, data, ONE;
+	AESKeyContext ctx;
+	aes_arm_key_context_init(&ctx, epochKey, keymode);
+	aes_ctr_arm_ctx(input, output, ivec, mlength, &ctx);
+	aes_key_context_clear(&ctx);
+}
 
-	if (mlength % 16) {
-		mlength = mlength / 16 + 1;
-	} else {
-		mlength /= 16;
-	}
+void aes_ctr_arm_ctx(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	aes_ctr_arm_counter_ctx(input, output, ivec, mlength, ctx, ctr_128);
+}
 
-	uint32x4_t * keySched = load_key_expansion(epochKey, keymode);
+#pragma mark - CTR Internals
+// the big endian counter block of the two host order halves (see `aes_load_be64`)
+static inline uint8x16_t ctr_block(uint64_t hi, uint64_t lo) {
+	uint64x2_t block = vcombine_u64(vcreate_u64(hi), vcreate_u64(lo));
+	// byte swap within each half, the block is stored big endian
+	return vrev64q_u8(vreinterpretq_u8_u64(block));
+}
 
-	iv = vld1q_u8(ivec);
-	uint8_t one = 1;
-	ONE = vld1q_dup_u8(&one);
+static inline __attribute__((always_inline)) void ctr_kernel(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, AESCounterWidth width, const AESKeyMode keymode) {
+	uint8x16_t blocks[8], feedback;
+	uint8x16_t * keySched = (uint8x16_t *)ctx->enc_schedule;
+	uint64_t hi, lo;
+	size_t i = 0, full = mlength / 16;
 
-	for (size_t i = 0; i < mlength; i++) {
-		if (i != 0) {
-			iv = vaddq_u8(iv, ONE);
+	hi = aes_load_be64(ivec);
+	lo = aes_load_be64(ivec + 8);
+
+	// eight blocks per iteration, the AESE/AESMC pairs of the independent blocks fill the pipeline
+	for (; i + 8 <= full; i += 8) {
+		for (int b = 0; b < 8; b++) {
+			blocks[b] = ctr_block(hi, lo);
+			aes_ctr_increment(&hi, &lo, width);
+		}
+		aes_arm_enc_8(blocks, keySched, keymode);
+		for (int b = 0; b < 8; b++) {
+			vst1q_u8(&output[(i + b) * 16], veorq_u8(blocks[b], vld1q_u8(&input[(i + b) * 16])));
 		}
-		feedback = iv;
+	}
+
+	// tail [up to seven full blocks]
+	for (; i < full; i++) {
+		feedback = ctr_block(hi, lo);
+		aes_ctr_increment(&hi, &lo, width);
+		aes_arm_enc(&feedback, keySched, keymode);
+		vst1q_u8(&output[i * 16], veorq_u8(feedback, vld1q_u8(&input[i * 16])));
+	}
+
+	// partial last block, only mlength bytes are read and written
+	if (mlength % 16) {
+		uint8_t stream[16];
+		feedback = ctr_block(hi, lo);
 		aes_arm_enc(&feedback, keySched, keymode);
-		data = veor_u8(feedback, vld1q_u8(&(input[i * 16])));
-		vst1q_u8(&(input[i * 16]), data);
+		vst1q_u8(stream, feedback);
+		for (size_t b = full * 16; b < mlength; b++) {
+			output[b] = input[b] ^ stream[b - full * 16];
+		}
 	}
 }
+
+void aes_ctr_arm_counter_ctx(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, AESCounterWidth width) {
+	aes_specialize(ctx->keymode, ctr_kernel, input, output, ivec, mlength, ctx, width);
+}
+
+#endif /* protection */
@@ -26,17 +26,17 @@
 #include <stdint.h>
 
 #include "AESCore.h"
-#include <arm_neon.h>
 
 // check arm
-#if defined(__arm__) || defined(__aarch32__) || defined(__arm64__) || defined(__aarch64__) || defined(_M_ARM)
-	#if defined(__ARM_NEON) || defined(__MSC_VER) || defined(_M_ARM)
-		#include <armintr.h>
-		#include <arm_neon.h>
-	#endif
+#if defined(__arm__) || defined(__aarch32__) || defined(__arm64__) || defined(__aarch64__) || defined(_M_ARM) || defined(_M_ARM64)
 	#if defined(_M_ARM64)
 		#include <arm64intr.h>
 		#include <arm64_neon.h>
+	#elif defined(_MSC_VER)
+		#include <armintr.h>
+		#include <arm_neon.h>
+	#else
+		#include <arm_neon.h>
 	#endif
 	#if defined(__GNUC__) && !defined(__apple_build_version__)
 		// apparently not supported on apple sas: https://github.com/noloader/AES-Intrinsics/blob/master/aes-arm.c
@@ -44,31 +44,10 @@
 			#include <arm_acl.h>
 		#endif
 	#endif
+	#define arm_active
 #endif
 
-#pragma mark - Key Management Internals
-/*!
- @group Key Management Internals
- */
-
-/*!
- @typedef AESKeyMode
- 
- @brief An enum setting the key mode.
- 
- This enum allows to set which key mode for AES is being uesd: either 128 bits, 192 bits, or 256 bits. By setting this also the rounds of AES are defined
- 
- Possible values for the key mode and what it specifies:
- - aes_128: @code AES-128 [key = 128bits, AES rounds = 10] @endcode
- - aes_192: @code AES-192 [key = 192bits, AES rounds = 12] @endcode
- - aes_256: @code AES-256 [key = 256bits, AES rounds = 14] @endcode
- */
-typedef enum {
-	aes_128 = 10,
-	aes_192 = 12,
-	aes_256 = 14
-} AESKeyMode;
-
+#ifdef arm_active
 #pragma mark - Key Management Core
 /*!
 	@name Key Management Core
@@ -76,26 +55,26 @@ typedef enum {
  */
 /// @{
 /*!
-	@brief Intrinsic implementation of the key loading (expansion) sequence
+	@brief Expands a user key into a reusable key context
 
 	Takes an externally definied epoch key (usually passed by the user or generated
-	using a PRG). Based on the key mode chosen (AES-128, AES-192 or AES-256) the specific 
-	sequence is run and the key schedule is returned. 
+	using a PRG). Based on the key mode chosen (AES-128, AES-192 or AES-256) the key 
+	expansion is run once and the encryption and decryption schedules are stored 
+	inline in the context. 
 
 	@see AESKeyMode for information regarding the modes. 
+	@see AESKeyContext for information regarding the context.
 
 	@warning Only call this loader on ARM CPUs.
-	@information If you require CTR or CBC mode, you do not need to call this function, both
-	implementations take care of the key expansion internally.
+	@information If you require CTR or CBC mode without reusing the key, you do not need to 
+	call this function, both implementations take care of the key expansion internally.
 
-	@param key A `16 btye` userkey used for the key expansion
+	@param ctx The (caller owned) context to fill
+	@param key The user key (`16`, `24`, or `32` bytes depending on the key mode)
 	@param keymode The AES version to use
-
-	@returns The generated key schedule, where each key are 4 32 byte words (`uint32x4_t`) 
-	and the overall length depends on the amount of rounds defined by the AES version.
  */
-__attribute__((visibility("hidden"), nonnull(1), target("arch=armv8-a+crypto")))
-extern inline uint32x4_t * load_key_expansion(uint8_t * key, AESKeyMode keymode);
+__attribute__((visibility("hidden"), nonnull(1, 2), target("arch=armv8-a+crypto")))
+void aes_arm_key_context_init(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode);
 /// @}
 
 #pragma mark - Encryption and Decryption Core
@@ -113,9 +92,11 @@ extern inline uint32x4_t * load_key_expansion(uint8_t * key, AESKeyMode keymode)
  @code
  char * fullMessage = ...;
  uint8_t * userKey = ...; // 128bits using AES-128
- uint8x16_t * keySchedule = load_key_expansion(userKey, aes_128);
+ AESKeyContext ctx;
+ aes_arm_key_context_init(&ctx, userKey, aes_128);
  // Encrypt the first 16 bytes AES-128
- aes_arm_enc((uint8x16_t *)fullMessage[0], keySchedule, aes_128);
+ uint8x16_t block = vld1q_u8(fullMessage);
+ aes_arm_enc(&block, (uint8x16_t *)ctx.enc_schedule, aes_128);
  @endcode
 
  @param data The data to encrypt
@@ -127,25 +108,164 @@ __attribute__((visibility("hidden"), nonnull(1, 2), target("arch=armv8-a+crypto"
 extern inline void aes_arm_enc(uint8x16_t * data, uint8x16_t * keySchedule, AESKeyMode keymode);
 
 /*!
-	@brief Decrypts the data using AES implemented directly on the Intel Chip
+	@brief Decrypts the data using AES implemented directly on the ARM Chip
  
- 	Decrypts the data passed with the specified Key Schedule through AES using the key length set. The function is implemented using intel Intrinsics for greater performance.
+ 	Decrypts the data passed with the specified Key Schedule through AES using the key length set. The function is implemented using ARM Intrinsics for greater performance.
  
  	@warning The decryption is done directly on the passed data array which must be 128 bits (16 bytes)
+ 	@note The key schedule is the decryption schedule (`dec_schedule` of an `AESKeyContext`), which holds the round keys in the order decryption consumes them with the inverse mix columns already applied to the inner round keys (equivalent inverse cipher)
  
  	@code
  	uint8_t * fullCipher = ...;
  	uint8_t * userKey = ...; // 128bits using AES-128
- 	uint8x16_t * keySchedule = load_key_expansion(userKey, aes_128);
+ 	AESKeyContext ctx;
+ 	aes_arm_key_context_init(&ctx, userKey, aes_128);
  	// Decrypt the first 16 bytes AES-128
- 	aes_arm_dec((uint8x16_t *)fullCipher[0], keySchedule, aes_128);
+ 	uint8x16_t block = vld1q_u8(fullCipher);
+ 	aes_arm_dec(&block, (uint8x16_t *)ctx.dec_schedule, aes_128);
  	@endcode
  
  	@param data The data to decrypt
- 	@param keySchedule The key schedule to use
+ 	@param keySchedule The decryption key schedule to use
  	@param keymode The key mode specifying the key schedule length and AES mode
  */
 __attribute__((visibility("hidden"), nonnull(1, 2), target("arch=armv8-a+crypto")))
 extern inline void aes_arm_dec(uint8x16_t * data, uint8x16_t * keySchedule, AESKeyMode keymode);
+///@}
+
+#pragma mark - CBC Core
+/*!
+	@name CBC Core
+	The functions related to encrypting and decrypting using the Cipher Block Chain approach.
+ */
+///@{
+/*!
+	@brief Encrypts the data using Cipher Block Chain (CBC) AES implemented directly on the ARM Chip
+
+	Encrypts the passed input data using CBC. The function is implemented using ARM Intrinsics for greater performance.
+
+	@note CBC requires padding, which this function assumes you have already done
+	@warning The input length <b>must</b> be a multiple of 16 (use padding if necessary) . No checks are run to ensure input, ivec, or epoch key are the correct lengths
+
+	@param input The data to encrypt using AES and CBC
+	@param output A pointer to a `malloc`ed location where the encrypted data will be written
+	@param ivec The IV (Initial Vector) to be used for CBC
+	@param mlength The length of the input message [in bytes] which is also the output (cipher) message length
+	@param epochKey The key that will be used for the key expansion to make the key schedule
+	@param keymode The AES mode (also defines the key length and number of rounds)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("arch=armv8-a+crypto")))
+void aes_cbc_arm_enc(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, uint8_t * epochKey, AESKeyMode keymode);
+
+/*!
+	@brief Encrypts the data using Cipher Block Chain (CBC) AES with an already expanded key
+
+	Same as `aes_cbc_arm_enc` but uses the key schedule of the passed context instead of expanding the key on every call.
+
+	@param input The data to encrypt using AES and CBC
+	@param output A pointer to a `malloc`ed location where the encrypted data will be written
+	@param ivec The IV (Initial Vector) to be used for CBC
+	@param mlength The length of the input message [in bytes] which is also the output (cipher) message length
+	@param ctx The key context set up with `aes_arm_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("arch=armv8-a+crypto")))
+void aes_cbc_arm_enc_ctx(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+	@brief Decrypts the data using Cipher Block Chain (CBC) AES implemented directly on the ARM Chip
+
+	Decrypts the passed input data using CBC. The function is implemented using ARM Intrinsics for greater performance.
+
+	@note CBC requires padding, which this function assumes you will remove yourself after returning
+	@warning The input length <b>must</b> be a multiple of 16. No checks are run to ensure input, ivec, or epoch key are the correct lengths
+
+	@param input The data to decrypt using AES and CBC
+	@param output A pointer to a `malloc`ed location where the decrypted data will be written
+	@param ivec The IV (Initial Vector) to be used for CBC decryption
+	@param mlength The length of the input cipher [in bytes] which is also the output (message) length
+	@param epochKey The key that will be used for the key expansion to make the key schedule
+	@param keymode The AES mode (also defines the key length and number of rounds)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("arch=armv8-a+crypto")))
+void aes_cbc_arm_dec(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, uint8_t * epochKey, AESKeyMode keymode);
+
+/*!
+	@brief Decrypts the data using Cipher Block Chain (CBC) AES with an already expanded key
+
+	Same as `aes_cbc_arm_dec` but uses the key schedule of the passed context instead of expanding the key on every call.
+	As CBC decryption has no dependency between blocks, eight blocks are decrypted in parallel per iteration.
+
+	@note The decryption can be done in place (`input == output`)
+
+	@param input The data to decrypt using AES and CBC
+	@param output A pointer to a `malloc`ed location where the decrypted data will be written
+	@param ivec The IV (Initial Vector) to be used for CBC decryption
+	@param mlength The length of the input cipher [in bytes] which is also the output (message) length
+	@param ctx The key context set up with `aes_arm_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("arch=armv8-a+crypto")))
+void aes_cbc_arm_dec_ctx(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+///@}
+
+#pragma mark - CTR Core
+/*!
+	@name CTR Core
+	The functions related to encrypting and decrypting using the CounTeR approach.
+ */
+///@{
+/*!
+	@brief Encrypts or Decrypts the data using Counter Mode (CTR) AES implemented directly on the ARM Chip
+
+	Encrypts or Decrypts the passed input data using CTR. The function is implemented using ARM Intrinsics for greater performance.
+
+	@note Due to the nature of CTR, encryption and decryption are the same so that does not have to be specified.
+	@warning No checks are run to ensure input, ivec, or epoch key are the correct lengths
+
+	@param input The data to decrypt/decrypt using AES and CTR
+	@param output A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+	@param ivec The IV (Initial Vector) to be used during the CTR process
+	@param mlength The length of the input [in bytes] which is also the output length
+	@param epochKey The key that will be used for the key expansion to make the key schedule
+	@param keymode The AES mode (also defines the key length and number of rounds)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("arch=armv8-a+crypto")))
+void aes_ctr_arm(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, uint8_t * epochKey, AESKeyMode keymode);
+
+/*!
+	@brief Encrypts or Decrypts the data using Counter Mode (CTR) AES with an already expanded key
+
+	Same as `aes_ctr_arm` but uses the key schedule of the passed context instead of expanding the key on every call.
+	The full 128 bits of the counter block are incremented (see `aes_ctr_arm_counter_ctx`).
+
+	@param input The data to decrypt/decrypt using AES and CTR
+	@param output A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+	@param ivec The IV (Initial Vector) to be used during the CTR process
+	@param mlength The length of the input [in bytes] which is also the output length
+	@param ctx The key context set up with `aes_arm_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("arch=armv8-a+crypto")))
+void aes_ctr_arm_ctx(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+	@brief Encrypts or Decrypts the data using Counter Mode (CTR) AES with a selectable counter width
+
+	Same as `aes_ctr_arm_ctx` but only increments the lowest `width` bits of the (big endian) counter block. Eight
+	counter blocks are encrypted per iteration with their rounds interleaved.
+
+	@note The input length does not have to be a multiple of 16, only `mlength` bytes are read and written
+
+	@param input The data to decrypt/decrypt using AES and CTR
+	@param output A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+	@param ivec The initial counter block to be used during the CTR process
+	@param mlength The length of the input [in bytes] which is also the output length
+	@param ctx The key context set up with `aes_arm_key_context_init`
+	@param width The amount of low order bits of the counter block which make up the counter
+
+	@see AESCounterWidth for information regarding the widths.
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("arch=armv8-a+crypto")))
+void aes_ctr_arm_counter_ctx(uint8_t * input, uint8_t * output, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, AESCounterWidth width);
+///@}
 
+#endif /* protection */
 #endif /* AESarm_h */
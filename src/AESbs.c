@@ -0,0 +1,578 @@
+//
+//  AESbs.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden.
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file AESbs.c
+
+ The source file for the AES encryption (basic as well as CBC and CTR mode) implemented in constant time general c
+ through bitslicing
+
+ Eight blocks are transposed so that every register holds one bit position of every byte of all blocks. SubBytes then
+ is a fixed circuit of boolean operations (Boyar-Peralta) and ShiftRows and MixColumns are shifts and rotations, so
+ there are no table lookups and no memory access depends on the key or the data.
+
+ @compilerflag -fvisibility=hidden
+ @version 0.0.1
+ */
+
+#include <string.h>
+
+#include "AESbs.h"
+
+#pragma mark - Convenience Definitions
+// two lanes of 64 bits, each lane holds one bit of four blocks (an SSE2 / NEON register, or two general registers)
+typedef uint64_t bs_word __attribute__((vector_size(16)));
+// the compressed round keys are kept in the byte rows of the key context
+typedef uint64_t __attribute__((may_alias)) bs_key_word;
+
+static inline uint32_t load_le32(const uint8_t * p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void store_le32(uint8_t * p, uint32_t w) {
+	p[0] = (uint8_t)w; p[1] = (uint8_t)(w >> 8); p[2] = (uint8_t)(w >> 16); p[3] = (uint8_t)(w >> 24);
+}
+
+static inline bs_word bs_splat(uint64_t x) {
+	return (bs_word){x, x};
+}
+
+#pragma mark - Bitslice Conversion
+// spreads the four words of a block over two 64 bit words (16 bits per row of the state)
+static inline void interleave_in(uint64_t * q0, uint64_t * q1, const uint32_t * w) {
+	uint64_t x0 = w[0], x1 = w[1], x2 = w[2], x3 = w[3];
+
+	x0 |= (x0 << 16); x1 |= (x1 << 16); x2 |= (x2 << 16); x3 |= (x3 << 16);
+	x0 &= 0x0000ffff0000ffffULL; x1 &= 0x0000ffff0000ffffULL; x2 &= 0x0000ffff0000ffffULL; x3 &= 0x0000ffff0000ffffULL;
+	x0 |= (x0 << 8); x1 |= (x1 << 8); x2 |= (x2 << 8); x3 |= (x3 << 8);
+	x0 &= 0x00ff00ff00ff00ffULL; x1 &= 0x00ff00ff00ff00ffULL; x2 &= 0x00ff00ff00ff00ffULL; x3 &= 0x00ff00ff00ff00ffULL;
+	*q0 = x0 | (x2 << 8);
+	*q1 = x1 | (x3 << 8);
+}
+
+static inline void interleave_out(uint32_t * w, uint64_t q0, uint64_t q1) {
+	uint64_t x0, x1, x2, x3;
+
+	x0 = q0 & 0x00ff00ff00ff00ffULL;
+	x1 = q1 & 0x00ff00ff00ff00ffULL;
+	x2 = (q0 >> 8) & 0x00ff00ff00ff00ffULL;
+	x3 = (q1 >> 8) & 0x00ff00ff00ff00ffULL;
+	x0 |= (x0 >> 8); x1 |= (x1 >> 8); x2 |= (x2 >> 8); x3 |= (x3 >> 8);
+	x0 &= 0x0000ffff0000ffffULL; x1 &= 0x0000ffff0000ffffULL; x2 &= 0x0000ffff0000ffffULL; x3 &= 0x0000ffff0000ffffULL;
+	w[0] = (uint32_t)x0 | (uint32_t)(x0 >> 16);
+	w[1] = (uint32_t)x1 | (uint32_t)(x1 >> 16);
+	w[2] = (uint32_t)x2 | (uint32_t)(x2 >> 16);
+	w[3] = (uint32_t)x3 | (uint32_t)(x3 >> 16);
+}
+
+// transposes the 8 x 8 bit matrices (bit i of a byte ends up in q[i]), the transposition is its own inverse
+#define swap_bits(cl, ch, s, x, y)\
+			do {\
+				bs_word a = (x), b = (y);\
+				(x) = (a & (cl)) | ((b & (cl)) << (s));\
+				(y) = ((a & (ch)) >> (s)) | (b & (ch));\
+			} while (0)
+
+static inline void ortho(bs_word * q) {
+	swap_bits(0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL, 1, q[0], q[1]);
+	swap_bits(0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL, 1, q[2], q[3]);
+	swap_bits(0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL, 1, q[4], q[5]);
+	swap_bits(0x5555555555555555ULL, 0xaaaaaaaaaaaaaaaaULL, 1, q[6], q[7]);
+
+	swap_bits(0x3333333333333333ULL, 0xccccccccccccccccULL, 2, q[0], q[2]);
+	swap_bits(0x3333333333333333ULL, 0xccccccccccccccccULL, 2, q[1], q[3]);
+	swap_bits(0x3333333333333333ULL, 0xccccccccccccccccULL, 2, q[4], q[6]);
+	swap_bits(0x3333333333333333ULL, 0xccccccccccccccccULL, 2, q[5], q[7]);
+
+	swap_bits(0x0f0f0f0f0f0f0f0fULL, 0xf0f0f0f0f0f0f0f0ULL, 4, q[0], q[4]);
+	swap_bits(0x0f0f0f0f0f0f0f0fULL, 0xf0f0f0f0f0f0f0f0ULL, 4, q[1], q[5]);
+	swap_bits(0x0f0f0f0f0f0f0f0fULL, 0xf0f0f0f0f0f0f0f0ULL, 4, q[2], q[6]);
+	swap_bits(0x0f0f0f0f0f0f0f0fULL, 0xf0f0f0f0f0f0f0f0ULL, 4, q[3], q[7]);
+}
+
+// blocks [0, 4) go to the first lane, blocks [4, 8) to the second one
+static inline void bs_load(bs_word * q, const uint8_t * blocks) {
+	uint64_t lanes[2][8];
+
+	for (int l = 0; l < 2; l++) {
+		for (int i = 0; i < 4; i++) {
+			const uint8_t * b = blocks + 16 * (4 * l + i);
+			const uint32_t w[4] = {load_le32(b), load_le32(b + 4), load_le32(b + 8), load_le32(b + 12)};
+			interleave_in(&lanes[l][i], &lanes[l][i + 4], w);
+		}
+	}
+	for (int j = 0; j < 8; j++) {
+		q[j] = (bs_word){lanes[0][j], lanes[1][j]};
+	}
+	ortho(q);
+}
+
+static inline void bs_store(uint8_t * blocks, bs_word * q) {
+	uint32_t w[4];
+
+	ortho(q);
+	for (int l = 0; l < 2; l++) {
+		for (int i = 0; i < 4; i++) {
+			uint8_t * b = blocks + 16 * (4 * l + i);
+			interleave_out(w, q[i][l], q[i + 4][l]);
+			store_le32(b, w[0]); store_le32(b + 4, w[1]); store_le32(b + 8, w[2]); store_le32(b + 12, w[3]);
+		}
+	}
+}
+
+#pragma mark - Bitsliced Round Functions
+static inline void bs_sub_bytes(bs_word * q) {
+	bs_word x0, x1, x2, x3, x4, x5, x6, x7;
+	bs_word y1, y2, y3, y4, y5, y6, y7, y8, y9, y10, y11, y12, y13, y14, y15, y16, y17, y18, y19, y20, y21;
+	bs_word z0, z1, z2, z3, z4, z5, z6, z7, z8, z9, z10, z11, z12, z13, z14, z15, z16, z17;
+	bs_word t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12, t13, t14, t15, t16, t17, t18, t19, t20, t21, t22;
+	bs_word t23, t24, t25, t26, t27, t28, t29, t30, t31, t32, t33, t34, t35, t36, t37, t38, t39, t40, t41, t42, t43;
+	bs_word t44, t45, t46, t47, t48, t49, t50, t51, t52, t53, t54, t55, t56, t57, t58, t59, t60, t61, t62, t63, t64;
+	bs_word t65, t66, t67;
+	bs_word s0, s1, s2, s3, s4, s5, s6, s7;
+
+	x0 = q[7]; x1 = q[6]; x2 = q[5]; x3 = q[4];
+	x4 = q[3]; x5 = q[2]; x6 = q[1]; x7 = q[0];
+
+	// top linear transformation
+	y14 = x3 ^ x5;
+	y13 = x0 ^ x6;
+	y9 = x0 ^ x3;
+	y8 = x0 ^ x5;
+	t0 = x1 ^ x2;
+	y1 = t0 ^ x7;
+	y4 = y1 ^ x3;
+	y12 = y13 ^ y14;
+	y2 = y1 ^ x0;
+	y5 = y1 ^ x6;
+	y3 = y5 ^ y8;
+	t1 = x4 ^ y12;
+	y15 = t1 ^ x5;
+	y20 = t1 ^ x1;
+	y6 = y15 ^ x7;
+	y10 = y15 ^ t0;
+	y11 = y20 ^ y9;
+	y7 = x7 ^ y11;
+	y17 = y10 ^ y11;
+	y19 = y10 ^ y8;
+	y16 = t0 ^ y11;
+	y21 = y13 ^ y16;
+	y18 = x0 ^ y16;
+
+	// non-linear section (inversion in GF(2^8) through GF(2^4))
+	t2 = y12 & y15;
+	t3 = y3 & y6;
+	t4 = t3 ^ t2;
+	t5 = y4 & x7;
+	t6 = t5 ^ t2;
+	t7 = y13 & y16;
+	t8 = y5 & y1;
+	t9 = t8 ^ t7;
+	t10 = y2 & y7;
+	t11 = t10 ^ t7;
+	t12 = y9 & y11;
+	t13 = y14 & y17;
+	t14 = t13 ^ t12;
+	t15 = y8 & y10;
+	t16 = t15 ^ t12;
+	t17 = t4 ^ t14;
+	t18 = t6 ^ t16;
+	t19 = t9 ^ t14;
+	t20 = t11 ^ t16;
+	t21 = t17 ^ y20;
+	t22 = t18 ^ y19;
+	t23 = t19 ^ y21;
+	t24 = t20 ^ y18;
+
+	t25 = t21 ^ t22;
+	t26 = t21 & t23;
+	t27 = t24 ^ t26;
+	t28 = t25 & t27;
+	t29 = t28 ^ t22;
+	t30 = t23 ^ t24;
+	t31 = t22 ^ t26;
+	t32 = t31 & t30;
+	t33 = t32 ^ t24;
+	t34 = t23 ^ t33;
+	t35 = t27 ^ t33;
+	t36 = t24 & t35;
+	t37 = t36 ^ t34;
+	t38 = t27 ^ t36;
+	t39 = t29 & t38;
+	t40 = t25 ^ t39;
+
+	t41 = t40 ^ t37;
+	t42 = t29 ^ t33;
+	t43 = t29 ^ t40;
+	t44 = t33 ^ t37;
+	t45 = t42 ^ t41;
+	z0 = t44 & y15;
+	z1 = t37 & y6;
+	z2 = t33 & x7;
+	z3 = t43 & y16;
+	z4 = t40 & y1;
+	z5 = t29 & y7;
+	z6 = t42 & y11;
+	z7 = t45 & y17;
+	z8 = t41 & y10;
+	z9 = t44 & y12;
+	z10 = t37 & y3;
+	z11 = t33 & y4;
+	z12 = t43 & y13;
+	z13 = t40 & y5;
+	z14 = t29 & y2;
+	z15 = t42 & y9;
+	z16 = t45 & y14;
+	z17 = t41 & y8;
+
+	// bottom linear transformation
+	t46 = z15 ^ z16;
+	t47 = z10 ^ z11;
+	t48 = z5 ^ z13;
+	t49 = z9 ^ z10;
+	t50 = z2 ^ z12;
+	t51 = z2 ^ z5;
+	t52 = z7 ^ z8;
+	t53 = z0 ^ z3;
+	t54 = z6 ^ z7;
+	t55 = z16 ^ z17;
+	t56 = z12 ^ t48;
+	t57 = t50 ^ t53;
+	t58 = z4 ^ t46;
+	t59 = z3 ^ t54;
+	t60 = t46 ^ t57;
+	t61 = z14 ^ t57;
+	t62 = t52 ^ t58;
+	t63 = t49 ^ t58;
+	t64 = z4 ^ t59;
+	t65 = t61 ^ t62;
+	t66 = z1 ^ t63;
+	s0 = t59 ^ t63;
+	s6 = t56 ^ ~t62;
+	s7 = t48 ^ ~t60;
+	t67 = t64 ^ t65;
+	s3 = t53 ^ t66;
+	s4 = t51 ^ t66;
+	s5 = t47 ^ t65;
+	s1 = t64 ^ ~s3;
+	s2 = t55 ^ ~t67;
+
+	q[7] = s0; q[6] = s1; q[5] = s2; q[4] = s3;
+	q[3] = s4; q[2] = s5; q[1] = s6; q[0] = s7;
+}
+
+// the inverse affine transformation (which is its own counterpart around the forward S-box)
+static inline void bs_affine_inv(bs_word * q) {
+	const bs_word q0 = ~q[0], q1 = ~q[1], q2 = q[2], q3 = q[3], q4 = q[4], q5 = ~q[5], q6 = ~q[6], q7 = q[7];
+
+	q[7] = q1 ^ q4 ^ q6;
+	q[6] = q0 ^ q3 ^ q5;
+	q[5] = q7 ^ q2 ^ q4;
+	q[4] = q6 ^ q1 ^ q3;
+	q[3] = q5 ^ q0 ^ q2;
+	q[2] = q4 ^ q7 ^ q1;
+	q[1] = q3 ^ q6 ^ q0;
+	q[0] = q2 ^ q5 ^ q7;
+}
+
+// S^-1 = A^-1 o S o A^-1, the inversion of the forward circuit is reused
+static inline void bs_inv_sub_bytes(bs_word * q) {
+	bs_affine_inv(q);
+	bs_sub_bytes(q);
+	bs_affine_inv(q);
+}
+
+static inline void bs_shift_rows(bs_word * q) {
+	for (int i = 0; i < 8; i++) {
+		const bs_word x = q[i];
+		q[i] = (x & 0x000000000000ffffULL)
+			 | ((x & 0x00000000fff00000ULL) >> 4) | ((x & 0x00000000000f0000ULL) << 12)
+			 | ((x & 0x0000ff0000000000ULL) >> 8) | ((x & 0x000000ff00000000ULL) << 8)
+			 | ((x & 0xf000000000000000ULL) >> 12) | ((x & 0x0fff000000000000ULL) << 4);
+	}
+}
+
+static inline void bs_inv_shift_rows(bs_word * q) {
+	for (int i = 0; i < 8; i++) {
+		const bs_word x = q[i];
+		q[i] = (x & 0x000000000000ffffULL)
+			 | ((x & 0x000000000fff0000ULL) << 4) | ((x & 0x00000000f0000000ULL) >> 12)
+			 | ((x & 0x000000ff00000000ULL) << 8) | ((x & 0x0000ff0000000000ULL) >> 8)
+			 | ((x & 0x000f000000000000ULL) << 12) | ((x & 0xfff0000000000000ULL) >> 4);
+	}
+}
+
+static inline bs_word rotr16(bs_word x) {
+	return (x >> 16) | (x << 48);
+}
+
+static inline bs_word rotr32(bs_word x) {
+	return (x << 32) | (x >> 32);
+}
+
+static inline void bs_mix_columns(bs_word * q) {
+	const bs_word q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3], q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+	const bs_word r0 = rotr16(q0), r1 = rotr16(q1), r2 = rotr16(q2), r3 = rotr16(q3);
+	const bs_word r4 = rotr16(q4), r5 = rotr16(q5), r6 = rotr16(q6), r7 = rotr16(q7);
+
+	q[0] = q7 ^ r7 ^ r0 ^ rotr32(q0 ^ r0);
+	q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ rotr32(q1 ^ r1);
+	q[2] = q1 ^ r1 ^ r2 ^ rotr32(q2 ^ r2);
+	q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ rotr32(q3 ^ r3);
+	q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ rotr32(q4 ^ r4);
+	q[5] = q4 ^ r4 ^ r5 ^ rotr32(q5 ^ r5);
+	q[6] = q5 ^ r5 ^ r6 ^ rotr32(q6 ^ r6);
+	q[7] = q6 ^ r6 ^ r7 ^ rotr32(q7 ^ r7);
+}
+
+static inline void bs_inv_mix_columns(bs_word * q) {
+	const bs_word q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3], q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+	const bs_word r0 = rotr16(q0), r1 = rotr16(q1), r2 = rotr16(q2), r3 = rotr16(q3);
+	const bs_word r4 = rotr16(q4), r5 = rotr16(q5), r6 = rotr16(q6), r7 = rotr16(q7);
+
+	q[0] = q5 ^ q6 ^ q7 ^ r0 ^ r5 ^ r7 ^ rotr32(q0 ^ q5 ^ q6 ^ r0 ^ r5);
+	q[1] = q0 ^ q5 ^ r0 ^ r1 ^ r5 ^ r6 ^ r7 ^ rotr32(q1 ^ q5 ^ q7 ^ r1 ^ r5 ^ r6);
+	q[2] = q0 ^ q1 ^ q6 ^ r1 ^ r2 ^ r6 ^ r7 ^ rotr32(q0 ^ q2 ^ q6 ^ r2 ^ r6 ^ r7);
+	q[3] = q0 ^ q1 ^ q2 ^ q5 ^ q6 ^ r0 ^ r2 ^ r3 ^ r5 ^ rotr32(q0 ^ q1 ^ q3 ^ q5 ^ q6 ^ q7 ^ r0 ^ r3 ^ r5 ^ r7);
+	q[4] = q1 ^ q2 ^ q3 ^ q5 ^ r1 ^ r3 ^ r4 ^ r5 ^ r6 ^ r7 ^ rotr32(q1 ^ q2 ^ q4 ^ q5 ^ q7 ^ r1 ^ r4 ^ r5 ^ r6);
+	q[5] = q2 ^ q3 ^ q4 ^ q6 ^ r2 ^ r4 ^ r5 ^ r6 ^ r7 ^ rotr32(q2 ^ q3 ^ q5 ^ q6 ^ r2 ^ r5 ^ r6 ^ r7);
+	q[6] = q3 ^ q4 ^ q5 ^ q7 ^ r3 ^ r5 ^ r6 ^ r7 ^ rotr32(q3 ^ q4 ^ q6 ^ q7 ^ r3 ^ r6 ^ r7);
+	q[7] = q4 ^ q5 ^ q6 ^ r4 ^ r6 ^ r7 ^ rotr32(q4 ^ q5 ^ q7 ^ r4 ^ r7);
+}
+
+static inline void bs_add_round_key(bs_word * q, const bs_word * sk) {
+	q[0] ^= sk[0]; q[1] ^= sk[1]; q[2] ^= sk[2]; q[3] ^= sk[3];
+	q[4] ^= sk[4]; q[5] ^= sk[5]; q[6] ^= sk[6]; q[7] ^= sk[7];
+}
+
+#pragma mark - Key Management Core
+void aes_bs_key_context_init(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode) {
+	bs_key_word * comp = (bs_key_word *)ctx->enc_schedule;
+
+	switch(keymode) {
+		case aes_128:
+		case aes_192:
+		case aes_256:
+			aes_expand_key(ctx->enc_schedule, key, keymode);
+			break;
+		default:
+			fprintf(stderr, "[%s] %s", __FILE__, aes_mode_error());
+			exit(EXIT_FAILURE);
+			break;
+	}
+
+	// a round key is the same for all blocks, so after the transposition every nibble of a bitsliced key word is
+	// either 0 or f and one bit per nibble suffices: the eight key words of a round compress into 16 bytes
+	for (int r = 0; r <= (int)keymode; r++) {
+		const uint8_t * k = ctx->enc_schedule[r];
+		const uint32_t w[4] = {load_le32(k), load_le32(k + 4), load_le32(k + 8), load_le32(k + 12)};
+		uint64_t x0, x1;
+		bs_word q[8];
+
+		interleave_in(&x0, &x1, w);
+		q[0] = q[1] = q[2] = q[3] = bs_splat(x0);
+		q[4] = q[5] = q[6] = q[7] = bs_splat(x1);
+		ortho(q);
+		comp[2 * r] = (q[0][0] & 0x1111111111111111ULL) | (q[1][0] & 0x2222222222222222ULL)
+					| (q[2][0] & 0x4444444444444444ULL) | (q[3][0] & 0x8888888888888888ULL);
+		comp[2 * r + 1] = (q[4][0] & 0x1111111111111111ULL) | (q[5][0] & 0x2222222222222222ULL)
+						| (q[6][0] & 0x4444444444444444ULL) | (q[7][0] & 0x8888888888888888ULL);
+	}
+	ctx->keymode = keymode;
+}
+
+#pragma mark - Encryption and Decryption Internals
+/*!
+ @define BS_SCHEDULE_WORDS
+ The amount of bitsliced key words of the longest schedule (eight per round key)
+ */
+#define BS_SCHEDULE_WORDS (8 * AES_MAX_ROUND_KEYS)
+
+// undoes the compression of aes_bs_key_context_init, done once per call and not once per block
+static void bs_expand_schedule(bs_word * sk, const AESKeyContext * ctx) {
+	const bs_key_word * comp = (const bs_key_word *)ctx->enc_schedule;
+
+	for (int u = 0; u < 2 * ((int)ctx->keymode + 1); u++) {
+		const uint64_t x0 = comp[u] & 0x1111111111111111ULL;
+		const uint64_t x1 = (comp[u] & 0x2222222222222222ULL) >> 1;
+		const uint64_t x2 = (comp[u] & 0x4444444444444444ULL) >> 2;
+		const uint64_t x3 = (comp[u] & 0x8888888888888888ULL) >> 3;
+		sk[4 * u + 0] = bs_splat((x0 << 4) - x0);
+		sk[4 * u + 1] = bs_splat((x1 << 4) - x1);
+		sk[4 * u + 2] = bs_splat((x2 << 4) - x2);
+		sk[4 * u + 3] = bs_splat((x3 << 4) - x3);
+	}
+}
+
+static void bs_wipe_schedule(bs_word * sk) {
+	volatile uint8_t * p = (volatile uint8_t *)sk;
+	for (size_t i = 0; i < sizeof(bs_word) * BS_SCHEDULE_WORDS; i++) {
+		p[i] = 0;
+	}
+}
+
+// encrypts the AES_BS_BLOCKS blocks (128 bytes) in place
+static inline void bs_encrypt(uint8_t * blocks, const bs_word * sk, AESKeyMode keymode) {
+	bs_word q[8];
+
+	bs_load(q, blocks);
+	bs_add_round_key(q, sk);
+	for (int r = 1; r < (int)keymode; r++) {
+		bs_sub_bytes(q);
+		bs_shift_rows(q);
+		bs_mix_columns(q);
+		bs_add_round_key(q, sk + 8 * r);
+	}
+	bs_sub_bytes(q);
+	bs_shift_rows(q);
+	bs_add_round_key(q, sk + 8 * keymode);
+	bs_store(blocks, q);
+}
+
+// decrypts the AES_BS_BLOCKS blocks (128 bytes) in place, the encryption schedule is walked backwards
+static inline void bs_decrypt(uint8_t * blocks, const bs_word * sk, AESKeyMode keymode) {
+	bs_word q[8];
+
+	bs_load(q, blocks);
+	bs_add_round_key(q, sk + 8 * keymode);
+	for (int r = keymode - 1; r > 0; r--) {
+		bs_inv_shift_rows(q);
+		bs_inv_sub_bytes(q);
+		bs_add_round_key(q, sk + 8 * r);
+		bs_inv_mix_columns(q);
+	}
+	bs_inv_shift_rows(q);
+	bs_inv_sub_bytes(q);
+	bs_add_round_key(q, sk);
+	bs_store(blocks, q);
+}
+
+static inline void xor_bytes(uint8_t * out, const uint8_t * a, const uint8_t * b, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		out[i] = a[i] ^ b[i];
+	}
+}
+
+#pragma mark - CBC Core
+void aes_cbc_bs_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_bs_key_context_init(&ctx, epoch_key, keymode);
+	aes_cbc_bs_enc_ctx(inpt, outt, ivec, mlength, &ctx);
+	aes_key_context_clear(&ctx);
+}
+
+void aes_cbc_bs_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	bs_word sk[BS_SCHEDULE_WORDS];
+	uint8_t blocks[16 * AES_BS_BLOCKS] = {0};
+	uint8_t feedback[16];
+
+	// only full blocks are processed, a trailing partial block is never read or written
+	mlength /= 16;
+
+	bs_expand_schedule(sk, ctx);
+	memcpy(feedback, ivec, 16);
+	// every block depends on the one before, only the first of the bitsliced blocks carries data
+	for (size_t i = 0; i < mlength; i++) {
+		xor_bytes(blocks, inpt + 16 * i, feedback, 16);
+		bs_encrypt(blocks, sk, ctx->keymode);
+		memcpy(feedback, blocks, 16);
+		memcpy(outt + 16 * i, blocks, 16);
+	}
+	bs_wipe_schedule(sk);
+}
+
+void aes_cbc_bs_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_bs_key_context_init(&ctx, epoch_key, keymode);
+	aes_cbc_bs_dec_ctx(inpt, outt, ivec, clength, &ctx);
+	aes_key_context_clear(&ctx);
+}
+
+void aes_cbc_bs_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx) {
+	bs_word sk[BS_SCHEDULE_WORDS];
+	uint8_t cipher[16 * AES_BS_BLOCKS], blocks[16 * AES_BS_BLOCKS];
+	uint8_t feedback[16];
+
+	// only full blocks are processed, a trailing partial block is never read or written
+	clength /= 16;
+
+	bs_expand_schedule(sk, ctx);
+	memcpy(feedback, ivec, 16);
+	for (size_t i = 0; i < clength; i += AES_BS_BLOCKS) {
+		const size_t n = (clength - i < AES_BS_BLOCKS) ? clength - i : AES_BS_BLOCKS;
+
+		// the cipher blocks are copied before any output is written (in place safe)
+		memset(cipher + 16 * n, 0, 16 * (AES_BS_BLOCKS - n));
+		memcpy(cipher, inpt + 16 * i, 16 * n);
+		memcpy(blocks, cipher, sizeof(blocks));
+		bs_decrypt(blocks, sk, ctx->keymode);
+
+		xor_bytes(outt + 16 * i, blocks, feedback, 16);
+		xor_bytes(outt + 16 * (i + 1), blocks + 16, cipher, 16 * (n - 1));
+		memcpy(feedback, cipher + 16 * (n - 1), 16);
+	}
+	bs_wipe_schedule(sk);
+}
+
+#pragma mark - CTR Core
+void aes_ctr_bs(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_bs_key_context_init(&ctx, epoch_key, keymode);
+	aes_ctr_bs_ctx(inpt, outt, ivec, mlength, &ctx);
+	aes_key_context_clear(&ctx);
+}
+
+void aes_ctr_bs_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	aes_ctr_bs_counter_ctx(inpt, outt, ivec, mlength, ctx, ctr_128);
+}
+
+#pragma mark - CTR Internals
+// the counter block is kept as four host order (big endian interpreted) words
+static inline void ctr_increment(uint32_t * counter, AESCounterWidth width) {
+	counter[3] += 1;
+	if (width == ctr_32 || counter[3] != 0) {
+		return;
+	}
+	counter[2] += 1;
+	if (width == ctr_64 || counter[2] != 0) {
+		return;
+	}
+	counter[1] += 1;
+	counter[0] += (counter[1] == 0);
+}
+
+static inline uint32_t load_be32(const uint8_t * p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline void store_be32(uint8_t * p, uint32_t w) {
+	p[0] = (uint8_t)(w >> 24); p[1] = (uint8_t)(w >> 16); p[2] = (uint8_t)(w >> 8); p[3] = (uint8_t)w;
+}
+
+void aes_ctr_bs_counter_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, AESCounterWidth width) {
+	bs_word sk[BS_SCHEDULE_WORDS];
+	uint8_t stream[16 * AES_BS_BLOCKS];
+	uint32_t counter[4] = {load_be32(ivec), load_be32(ivec + 4), load_be32(ivec + 8), load_be32(ivec + 12)};
+
+	bs_expand_schedule(sk, ctx);
+	for (size_t i = 0; i < mlength; i += sizeof(stream)) {
+		const size_t n = (mlength - i < sizeof(stream)) ? mlength - i : sizeof(stream);
+
+		for (int b = 0; b < AES_BS_BLOCKS; b++) {
+			store_be32(stream + 16 * b, counter[0]);
+			store_be32(stream + 16 * b + 4, counter[1]);
+			store_be32(stream + 16 * b + 8, counter[2]);
+			store_be32(stream + 16 * b + 12, counter[3]);
+			ctr_increment(counter, width);
+		}
+		bs_encrypt(stream, sk, ctx->keymode);
+		xor_bytes(outt + i, inpt + i, stream, n);
+	}
+	bs_wipe_schedule(sk);
+}
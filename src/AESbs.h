@@ -0,0 +1,198 @@
+//
+//  AESbs.h
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden
+// * * * * * * * * * * * * * * * * * * * *
+
+/*!
+ @file AESbs.h
+
+ The header file for the AES encryption (basic as well as CBC and CTR mode) implemented in constant time general c
+ through bitslicing
+
+ @version 0.0.1
+ */
+#ifndef AESbs_h
+#define AESbs_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "AESCore.h"
+
+#pragma mark - Convenience Definitions
+/*!
+ @define AES_BS_BLOCKS
+ The amount of blocks which run through the bitsliced rounds together
+ */
+#define AES_BS_BLOCKS 8
+
+#pragma mark - Key Management Core
+/*!
+  @name Key Management Core
+  Bitsliced implementation of the key loading sequence
+ */
+///@{
+/*!
+  @brief Expands a user key into a reusable key context
+
+  Runs the key expansion for the passed key mode once and stores the bitsliced round keys (in a compressed form of
+  `16` bytes per round key) in the encryption schedule of the context. Decryption uses the same round keys in reverse
+  order, the decryption schedule of the context is not used.
+
+  @see AESKeyMode for information regarding the modes.
+  @see AESKeyContext for information regarding the context.
+
+  @param ctx The (caller owned) context to fill
+  @param key The user key (`16`, `24`, or `32` bytes depending on the key mode)
+  @param keymode The AES version to use
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2)))
+void aes_bs_key_context_init(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode);
+///@}
+
+#pragma mark - CBC Core
+/*!
+	@name CBC Core
+	The functions related to encrypting and decrypting using the Cipher Block Chain approach.
+ */
+///@{
+/*!
+ @brief Encrypts the data using Cipher Block Chain (CBC) AES implemented in constant time general c
+
+ Encrypts the passed input data using CBC. No memory access depends on the key or the data.
+
+ @note CBC encryption is serial, so only one of the `AES_BS_BLOCKS` bitsliced blocks carries data. Prefer CTR or use
+ this backend for decryption where throughput matters.
+ @warning The input length <b>must</b> be a multiple of 16 (use padding if necessary) . No checks are run to ensure input, ivec, or epoch key are the correct lengths
+
+ @param inpt The data to encrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC
+ @param mlength The length of the input message [in bytes] which is also the output (cipher) message length
+ @param epoch_key The key (either defined by the user or generated by the software) that will be used for the key expansion to make the key schedule
+ @param keymode The AES mode (also defines the key length and number of rounds)
+
+ @see https://en.wikipedia.org/wiki/Block_cipher_mode_of_operation#Cipher_Block_Chaining_(CBC)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_cbc_bs_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Encrypts the data using Cipher Block Chain (CBC) AES with an already expanded key
+
+ Same as `aes_cbc_bs_enc` but uses the key schedule of the passed context instead of expanding the key on every call.
+
+ @param inpt The data to encrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC
+ @param mlength The length of the input message [in bytes] which is also the output (cipher) message length
+ @param ctx The key context set up with `aes_bs_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_cbc_bs_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Decrypts the data using Cipher Block Chain (CBC) AES implemented in constant time general c
+
+ Decrypts the passed input data using CBC. No memory access depends on the key or the data.
+
+ @note CBC requires padding, which this function assumes you will remove yourself after returning
+ @warning The input length <b>must</b> be a multiple of 16. No checks are run to ensure input, ivec, or epoch key are the correct lengths
+
+ @param inpt The data to decrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC decryption
+ @param clength The length of the input cipher [in bytes] which is also the output (message) length
+ @param epoch_key The key (passed by the user) that will be used for the key expansion to make the key schedule to decrypt
+ @param keymode The AES mode (also defines the key length and number of rounds)
+
+ @see https://en.wikipedia.org/wiki/Block_cipher_mode_of_operation#Cipher_Block_Chaining_(CBC)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_cbc_bs_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Decrypts the data using Cipher Block Chain (CBC) AES with an already expanded key
+
+ Same as `aes_cbc_bs_dec` but uses the key schedule of the passed context instead of expanding the key on every call.
+ `AES_BS_BLOCKS` blocks are decrypted per iteration.
+
+ @note The decryption can be done in place (`inpt == outt`)
+
+ @param inpt The data to decrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC decryption
+ @param clength The length of the input cipher [in bytes] which is also the output (message) length
+ @param ctx The key context set up with `aes_bs_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_cbc_bs_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx);
+///@}
+
+#pragma mark - CTR Core
+/*!
+	@name CTR Core
+	The functions related to encrypting and decrypting using the CounTeR approach.
+ */
+///@{
+/*!
+ @brief Encrypts or Decrypts the data using Counter Mode (CTR) AES implemented in constant time general c
+
+ Encrypts or Decrypts the passed input data using CTR. No memory access depends on the key or the data.
+
+ @note Due to the nature of CTR, encryption and decryption are the same so that does not have to be specified. If a non encrypted message is passed it will be encrypted, if an encrypted message is passed it will be decrypted
+ @warning No checks are run to ensure input, ivec, or epoch key are the correct lengths
+
+ @param inpt The data to decrypt/decrypt using AES and CTR
+ @param outt A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used during the CTR process
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param epoch_key The key (passed by the user) that will be used for the key expansion to make the key schedule to encrypt/decrypt
+ @param keymode The AES mode (also defines the key length and number of rounds)
+
+ @see https://en.wikipedia.org/wiki/Block_cipher_mode_of_operation#Counter_(CTR)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_ctr_bs(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Encrypts or Decrypts the data using Counter Mode (CTR) AES with an already expanded key
+
+ Same as `aes_ctr_bs` but uses the key schedule of the passed context instead of expanding the key on every call.
+ The full 128 bits of the counter block are incremented (see `aes_ctr_bs_counter_ctx`).
+
+ @param inpt The data to decrypt/decrypt using AES and CTR
+ @param outt A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used during the CTR process
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_bs_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_ctr_bs_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts or Decrypts the data using Counter Mode (CTR) AES with a selectable counter width
+
+ Same as `aes_ctr_bs_ctx` but only increments the lowest `width` bits of the (big endian) counter block.
+ `AES_BS_BLOCKS` counter blocks are encrypted per iteration.
+
+ @note The input length does not have to be a multiple of 16, only `mlength` bytes are read and written
+
+ @param inpt The data to decrypt/decrypt using AES and CTR
+ @param outt A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+ @param ivec The initial counter block to be used during the CTR process
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_bs_key_context_init`
+ @param width The amount of low order bits of the counter block which make up the counter
+
+ @see AESCounterWidth for information regarding the widths.
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_ctr_bs_counter_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, AESCounterWidth width);
+///@}
+
+#endif /* AESbs_h */
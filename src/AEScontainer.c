@@ -0,0 +1,399 @@
+//
+//  AEScontainer.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -pthread.
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file AEScontainer.c
+
+ The source file for the seekable container format, which stores a message as fixed size, independently encrypted
+ chunks followed by an index of their tags so any byte range can be read without decrypting the rest
+
+ @compilerflag -fvisibility=hidden -pthread
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "AEScontainer.h"
+#include "AESdispatch.h"
+#include "AESstream.h"
+
+#pragma mark - Internal Core
+#define CONTAINER_VERSION 1
+#define CONTAINER_TRAILER_SIZE 16
+// header, chunk number and last chunk flag
+#define CONTAINER_AAD_SIZE (AES_CONTAINER_HEADER_SIZE + 16)
+
+static inline void put_le32(uint8_t * p, uint32_t v) {
+	for (int b = 0; b < 4; b++) {
+		p[b] = (uint8_t)(v >> (8 * b));
+	}
+}
+
+static inline void put_le64(uint8_t * p, uint64_t v) {
+	for (int b = 0; b < 8; b++) {
+		p[b] = (uint8_t)(v >> (8 * b));
+	}
+}
+
+static inline uint32_t get_le32(const uint8_t * p) {
+	uint32_t v = 0;
+	for (int b = 3; b >= 0; b--) {
+		v = (v << 8) | p[b];
+	}
+	return v;
+}
+
+static inline uint64_t get_le64(const uint8_t * p) {
+	uint64_t v = 0;
+	for (int b = 7; b >= 0; b--) {
+		v = (v << 8) | p[b];
+	}
+	return v;
+}
+
+static inline const uint8_t * header_nonce(const uint8_t * header) {
+	return header + 24;
+}
+
+// the IV and the additional authenticated data of a GCM chunk
+static void chunk_gcm_params(const uint8_t * header, unsigned long long chunk, int last, uint8_t * ivec, uint8_t * aad) {
+	memcpy(ivec, header_nonce(header), 8);
+	ivec[ 8] = (uint8_t)(chunk >> 24);
+	ivec[ 9] = (uint8_t)(chunk >> 16);
+	ivec[10] = (uint8_t)(chunk >>  8);
+	ivec[11] = (uint8_t)(chunk      );
+	memcpy(aad, header, AES_CONTAINER_HEADER_SIZE);
+	put_le64(aad + AES_CONTAINER_HEADER_SIZE, chunk);
+	put_le64(aad + AES_CONTAINER_HEADER_SIZE + 8, (uint64_t)last);
+}
+
+// GCM containers need a backend with GCM, the dispatcher would otherwise exit on the first chunk
+static int gcm_available(void) {
+	const AESBackend * backend = aes_active_backend();
+	return backend->gcm_enc && backend->gcm_dec;
+}
+
+static int write_all(int fd, const uint8_t * data, size_t length) {
+	while (length) {
+		ssize_t n = write(fd, data, length);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return 0;
+		}
+		data += n;
+		length -= (size_t)n;
+	}
+	return 1;
+}
+
+// a writer which failed to open (or was closed) is zeroed and has no chunk buffer
+static int writer_usable(const AESContainerWriter * writer) {
+	if (!writer->chunk || !writer->chunk_size) {
+		errno = EBADF;
+		return 0;
+	}
+	return 1;
+}
+
+static void wipe(void * data, size_t length) {
+	volatile uint8_t * raw = (volatile uint8_t *)data;
+	for (size_t i = 0; i < length; i++) {
+		raw[i] = 0;
+	}
+}
+
+#pragma mark - Container Writer
+// encrypts the buffered chunk in place, appends it to the file and its tag to the index
+static int writer_flush(AESContainerWriter * writer, int last) {
+	unsigned long long chunk = writer->chunks;
+	uint8_t tag[16] = {0};
+
+	if (get_le32(writer->header + 12) == container_gcm) {
+		uint8_t ivec[12], aad[CONTAINER_AAD_SIZE];
+		// the chunk number is the 32 bit counter part of the IV
+		if (chunk > UINT32_MAX) {
+			errno = EFBIG;
+			return 0;
+		}
+		chunk_gcm_params(writer->header, chunk, last, ivec, aad);
+		aes_gcm_enc_ctx(writer->chunk, writer->chunk, writer->buffered, aad, sizeof(aad), ivec, sizeof(ivec), tag, writer->ctx);
+	} else {
+		aes_ctr_range_ctx(writer->chunk, writer->chunk, (uint8_t *)header_nonce(writer->header), chunk * writer->chunk_size, writer->buffered, writer->ctx);
+	}
+
+	if (chunk == writer->capacity) {
+		unsigned long long capacity = writer->capacity ? 2 * writer->capacity : 1024;
+		void * tags = realloc(writer->tags, capacity * 16);
+		if (!tags) {
+			errno = ENOMEM;
+			return 0;
+		}
+		writer->tags = tags;
+		writer->capacity = capacity;
+	}
+	memcpy(writer->tags[chunk], tag, 16);
+
+	if (!write_all(writer->fd, writer->chunk, writer->buffered)) {
+		return 0;
+	}
+	writer->chunks++;
+	writer->buffered = 0;
+	return 1;
+}
+
+int aes_container_writer_open(AESContainerWriter * writer, const char * path, AESContainerMode mode, unsigned long chunk_size, const uint8_t * nonce, const AESKeyContext * ctx) {
+	memset(writer, 0, sizeof(AESContainerWriter));
+	writer->fd = -1;
+	if (!chunk_size || chunk_size % 16 || chunk_size > UINT32_MAX || (mode != container_ctr && mode != container_gcm)) {
+		errno = EINVAL;
+		return 0;
+	}
+	if (mode == container_gcm && !gcm_available()) {
+		errno = ENOTSUP;
+		return 0;
+	}
+
+	writer->chunk = malloc(chunk_size);
+	if (!writer->chunk) {
+		errno = ENOMEM;
+		return 0;
+	}
+	writer->chunk_size = chunk_size;
+	writer->ctx = ctx;
+
+	memcpy(writer->header, AES_CONTAINER_MAGIC, 8);
+	put_le32(writer->header + 8, CONTAINER_VERSION);
+	put_le32(writer->header + 12, (uint32_t)mode);
+	put_le32(writer->header + 16, (uint32_t)chunk_size);
+	put_le32(writer->header + 20, (uint32_t)ctx->keymode);
+	memcpy(writer->header + 24, nonce, 16);
+
+	writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (writer->fd < 0 || !write_all(writer->fd, writer->header, AES_CONTAINER_HEADER_SIZE)) {
+		int saved = errno;
+		if (writer->fd >= 0) {
+			close(writer->fd);
+		}
+		free(writer->chunk);
+		memset(writer, 0, sizeof(AESContainerWriter));
+		writer->fd = -1;
+		errno = saved;
+		return 0;
+	}
+	return 1;
+}
+
+int aes_container_write(AESContainerWriter * writer, const uint8_t * inpt, unsigned long mlength) {
+	if (!writer_usable(writer)) {
+		return 0;
+	}
+	while (mlength) {
+		// a full chunk is only written once more data shows it is not the last one
+		if (writer->buffered == writer->chunk_size && !writer_flush(writer, 0)) {
+			return 0;
+		}
+		unsigned long take = writer->chunk_size - writer->buffered;
+		if (take > mlength) {
+			take = mlength;
+		}
+		memcpy(writer->chunk + writer->buffered, inpt, take);
+		writer->buffered += take;
+		writer->length += take;
+		inpt += take;
+		mlength -= take;
+	}
+	return 1;
+}
+
+int aes_container_writer_close(AESContainerWriter * writer) {
+	uint8_t trailer[CONTAINER_TRAILER_SIZE];
+	if (!writer_usable(writer)) {
+		return 0;
+	}
+	int ok = writer_flush(writer, 1);
+
+	put_le64(trailer, writer->length);
+	memcpy(trailer + 8, AES_CONTAINER_INDEX_MAGIC, 8);
+	ok = ok && write_all(writer->fd, (uint8_t *)writer->tags, writer->chunks * 16);
+	ok = ok && write_all(writer->fd, trailer, sizeof(trailer));
+
+	int saved = errno;
+	if (close(writer->fd) < 0 && ok) {
+		saved = errno;
+		ok = 0;
+	}
+	wipe(writer->chunk, writer->chunk_size);
+	free(writer->chunk);
+	free(writer->tags);
+	wipe(writer, sizeof(AESContainerWriter));
+	errno = saved;
+	return ok;
+}
+
+#pragma mark - Container Reader
+int aes_container_open(AESContainerReader * reader, const char * path, const AESKeyContext * ctx) {
+	struct stat st;
+
+	memset(reader, 0, sizeof(AESContainerReader));
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+	if (fstat(fd, &st) < 0) {
+		int saved = errno;
+		close(fd);
+		errno = saved;
+		return 0;
+	}
+	if (st.st_size < AES_CONTAINER_HEADER_SIZE + 16 + CONTAINER_TRAILER_SIZE || (unsigned long long)st.st_size > (size_t)-1) {
+		close(fd);
+		errno = EINVAL;
+		return 0;
+	}
+
+	size_t size = (size_t)st.st_size;
+	void * map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	int saved = errno;
+	close(fd);
+	if (map == MAP_FAILED) {
+		errno = saved;
+		return 0;
+	}
+	// reads jump to the chunks they need, read ahead would only pull in unused data
+	madvise(map, size, MADV_RANDOM);
+
+	const uint8_t * header = map;
+	const uint8_t * trailer = (const uint8_t *)map + size - CONTAINER_TRAILER_SIZE;
+	unsigned long chunk_size = get_le32(header + 16);
+	unsigned long long length = get_le64(trailer);
+	unsigned long long chunks = chunk_size ? (length ? (length - 1) / chunk_size + 1 : 1) : 0;
+	uint32_t mode = get_le32(header + 12);
+
+	// the sizes of the chunks and the index must add up to the file exactly
+	int valid = memcmp(header, AES_CONTAINER_MAGIC, 8) == 0 && memcmp(trailer + 8, AES_CONTAINER_INDEX_MAGIC, 8) == 0
+		&& get_le32(header + 8) == CONTAINER_VERSION && (mode == container_ctr || mode == container_gcm)
+		&& chunk_size && chunk_size % 16 == 0 && get_le32(header + 20) == (uint32_t)ctx->keymode
+		&& length <= size && chunks <= size / 16
+		&& AES_CONTAINER_HEADER_SIZE + length + chunks * 16 + CONTAINER_TRAILER_SIZE == size;
+	if (!valid) {
+		munmap(map, size);
+		errno = EINVAL;
+		return 0;
+	}
+	if (mode == container_gcm && !gcm_available()) {
+		munmap(map, size);
+		errno = ENOTSUP;
+		return 0;
+	}
+
+	reader->map = map;
+	reader->size = size;
+	reader->mode = (AESContainerMode)mode;
+	reader->chunk_size = chunk_size;
+	reader->length = length;
+	reader->chunks = chunks;
+	reader->tags = (const uint8_t (*)[16])(reader->map + AES_CONTAINER_HEADER_SIZE + length);
+	reader->ctx = ctx;
+	return 1;
+}
+
+unsigned long long aes_container_length(const AESContainerReader * reader) {
+	return reader->length;
+}
+
+/*!
+ @typedef AESContainerRead
+
+ @brief One range read, shared by the threads decoding its chunks.
+ */
+typedef struct {
+	AESContainerReader * reader;
+	unsigned long long offset;
+	unsigned long long first;
+	uint8_t * outt;
+	unsigned long mlength;
+	int error;
+} AESContainerRead;
+
+// decodes the part of one chunk which overlaps the range
+static void read_chunk(void * arg, unsigned long index) {
+	AESContainerRead * job = (AESContainerRead *)arg;
+	AESContainerReader * reader = job->reader;
+	unsigned long long chunk = job->first + index;
+	unsigned long long start = chunk * reader->chunk_size;
+	unsigned long length = reader->length - start < reader->chunk_size ? (unsigned long)(reader->length - start) : reader->chunk_size;
+	unsigned long long lo = job->offset > start ? job->offset : start;
+	unsigned long long hi = job->offset + job->mlength < start + length ? job->offset + job->mlength : start + length;
+	uint8_t * cipher = reader->map + AES_CONTAINER_HEADER_SIZE + start;
+
+	if (reader->mode == container_ctr) {
+		aes_ctr_range_ctx(cipher + (lo - start), job->outt + (lo - job->offset), (uint8_t *)header_nonce(reader->map), lo, (unsigned long)(hi - lo), reader->ctx);
+		return;
+	}
+
+	// the tag covers the whole chunk, a chunk cut by the range is decrypted into a scratch buffer first
+	uint8_t ivec[12], aad[CONTAINER_AAD_SIZE];
+	chunk_gcm_params(reader->map, chunk, chunk == reader->chunks - 1, ivec, aad);
+	int whole = lo == start && hi == start + length;
+	uint8_t * plain = whole ? job->outt + (start - job->offset) : malloc(length ? length : 1);
+	if (!plain) {
+		__atomic_store_n(&job->error, ENOMEM, __ATOMIC_RELAXED);
+		return;
+	}
+	if (!aes_gcm_dec_ctx(cipher, plain, length, aad, sizeof(aad), ivec, sizeof(ivec), reader->tags[chunk], reader->ctx)) {
+		__atomic_store_n(&job->error, EBADMSG, __ATOMIC_RELAXED);
+	} else if (!whole) {
+		memcpy(job->outt + (lo - job->offset), plain + (lo - start), (size_t)(hi - lo));
+	}
+	if (!whole) {
+		wipe(plain, length);
+		free(plain);
+	}
+}
+
+int aes_container_read(AESContainerReader * reader, AESPool * pool, unsigned long long offset, uint8_t * outt, unsigned long mlength) {
+	if (offset > reader->length || mlength > reader->length - offset) {
+		errno = ERANGE;
+		return 0;
+	}
+	if (!mlength) {
+		return 1;
+	}
+
+	AESContainerRead job = {reader, offset, offset / reader->chunk_size, outt, mlength, 0};
+	unsigned long long last = (offset + mlength - 1) / reader->chunk_size;
+	unsigned long long count = last - job.first + 1;
+
+	if (pool && count > 1 && count <= UINT32_MAX) {
+		aes_pool_for_each(pool, (uint32_t)count, read_chunk, &job);
+	} else {
+		for (unsigned long long c = 0; c < count; c++) {
+			read_chunk(&job, c);
+		}
+	}
+
+	if (job.error) {
+		wipe(outt, mlength);
+		errno = job.error;
+		return 0;
+	}
+	return 1;
+}
+
+void aes_container_close(AESContainerReader * reader) {
+	munmap(reader->map, (size_t)reader->size);
+	memset(reader, 0, sizeof(AESContainerReader));
+}
@@ -0,0 +1,263 @@
+//
+//  AEScontainer.h
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -pthread
+// * * * * * * * * * * * * * * * * * * * *
+
+/*!
+ @file AEScontainer.h
+
+ The header file for the seekable container format, which stores a message as fixed size, independently encrypted
+ chunks followed by an index of their tags so any byte range can be read without decrypting the rest
+
+ @version 0.0.1
+ */
+
+#ifndef AEScontainer_h
+#define AEScontainer_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "AESCore.h"
+#include "AESparallel.h"
+
+#pragma mark - Container Format
+/*!
+ @name Container Format
+ Definitions of the on disk layout (all integers are little endian)
+
+ @code
+ [header: 64 bytes] [chunk 0] [chunk 1] ... [chunk n - 1] [index: n * 16 byte tags] [trailer: 16 bytes]
+ @endcode
+
+ - header: `AES_CONTAINER_MAGIC`, version (u32), mode (u32), chunk size (u32), key mode (u32), nonce (16 bytes), zeros
+ - chunks: every chunk but the last one holds exactly `chunk size` bytes, the last one holds the rest (and is empty
+   for an empty message, so a container always has at least one chunk)
+ - trailer: the message length (u64), `AES_CONTAINER_INDEX_MAGIC`
+ */
+///@{
+/*!
+ @define AES_CONTAINER_MAGIC
+ The `8` bytes a container starts with
+ */
+#define AES_CONTAINER_MAGIC "SCRYPTCT"
+
+/*!
+ @define AES_CONTAINER_INDEX_MAGIC
+ The `8` bytes a container ends with
+ */
+#define AES_CONTAINER_INDEX_MAGIC "SCRYPTIX"
+
+/*!
+ @define AES_CONTAINER_HEADER_SIZE
+ The size of the header [in bytes]
+ */
+#define AES_CONTAINER_HEADER_SIZE 64
+
+/*!
+ @typedef AESContainerMode
+
+ @brief An enum setting how the chunks of a container are encrypted.
+
+ Possible values for the container mode and what it specifies:
+ - container_ctr: @code CTR, the chunks are ranges of one CTR message [counter block = nonce + offset / 16], no tags @endcode
+ - container_gcm: @code GCM, every chunk is its own GCM message [IV = nonce[0..7] || chunk (u32, big endian)] @endcode
+
+ A GCM chunk authenticates the header, its position and whether it is the last chunk (as additional authenticated
+ data), so chunks can not be swapped, moved between containers, or cut off the end without the read failing.
+
+ @warning A CTR container is not authenticated, only use it where the storage is trusted
+ */
+typedef enum {
+	container_ctr = 0,
+	container_gcm = 1
+} AESContainerMode;
+
+/*!
+ @typedef AESContainerWriter
+
+ @brief The state of a container being written.
+
+ Holds one chunk of message data, the chunk is only encrypted once it is known whether it is the last one. The tags
+ of the written chunks are collected and appended as the index when the writer is closed.
+
+ - fd: The file written to
+ - header: The header as written to the file
+ - ctx: The key context
+ - chunk: The buffer of the chunk being filled (`chunk_size` bytes)
+ - buffered: The amount of bytes in the buffer
+ - chunks: The amount of chunks written
+ - length: The amount of message bytes written
+ - tags: The tags of the written chunks
+ - capacity: The amount of tags `tags` has room for
+ */
+typedef struct {
+	int fd;
+	uint8_t header[AES_CONTAINER_HEADER_SIZE];
+	const AESKeyContext * ctx;
+	uint8_t * chunk;
+	unsigned long chunk_size;
+	unsigned long buffered;
+	unsigned long long chunks;
+	unsigned long long length;
+	uint8_t (* tags)[16];
+	unsigned long long capacity;
+} AESContainerWriter;
+
+/*!
+ @typedef AESContainerReader
+
+ @brief An opened container.
+
+ The container is mapped read only, reads decrypt straight from the mapping.
+
+ - map: The mapped file
+ - size: The size of the file [in bytes]
+ - mode: The mode the chunks were encrypted with
+ - chunk_size: The size of a chunk [in bytes]
+ - length: The length of the message [in bytes]
+ - chunks: The amount of chunks
+ - tags: The index (points into the mapping)
+ - ctx: The key context
+ */
+typedef struct {
+	uint8_t * map;
+	unsigned long long size;
+	AESContainerMode mode;
+	unsigned long chunk_size;
+	unsigned long long length;
+	unsigned long long chunks;
+	const uint8_t (* tags)[16];
+	const AESKeyContext * ctx;
+} AESContainerReader;
+///@}
+
+#pragma mark - Container Writer
+/*!
+ @name Container Writer
+ Writing a container on the active backend
+ */
+///@{
+/*!
+ @brief Creates (or truncates) a container file and writes its header
+
+ @code
+ AESContainerWriter writer;
+ aes_container_writer_open(&writer, "blob.sct", container_gcm, 64 * 1024, nonce, &ctx);
+ while ((n = read(source, buffer, sizeof(buffer))) > 0) {
+	aes_container_write(&writer, buffer, n);
+ }
+ aes_container_writer_close(&writer);
+ @endcode
+
+ @warning Never use the same nonce twice with the same key. GCM containers need a backend which implements GCM (see
+ `aes_gcm_enc_ctx`), on any other backend the writer is not opened.
+
+ @param writer The (caller owned) state to set up
+ @param path The path of the container
+ @param mode How the chunks are encrypted
+ @param chunk_size The size of a chunk [in bytes, a multiple of 16]
+ @param nonce The `16` byte nonce (GCM only uses the first `8` bytes)
+ @param ctx The key context set up with `aes_key_context_init` (must outlive the writer)
+
+ @returns `1` on success, `0` if the file could not be created or written (`errno` is set) or the active backend
+ has no GCM for a GCM container (`errno` is `ENOTSUP`)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 5, 6)))
+int aes_container_writer_open(AESContainerWriter * writer, const char * path, AESContainerMode mode, unsigned long chunk_size, const uint8_t * nonce, const AESKeyContext * ctx);
+
+/*!
+ @brief Appends message data to a container
+
+ @param writer The state of the container
+ @param inpt The message data
+ @param mlength The length of the data [in bytes]
+
+ @returns `1` on success, `0` if the file could not be written (`errno` is set) or the writer is not open (`errno` is
+ `EBADF`)
+ */
+__attribute__((visibility("hidden"), nonnull(1)))
+int aes_container_write(AESContainerWriter * writer, const uint8_t * inpt, unsigned long mlength);
+
+/*!
+ @brief Writes the last chunk, the index and the trailer and closes the container
+
+ The writer is freed and wiped, also if writing failed. A writer which failed to open (or is already closed) is left
+ alone.
+
+ @param writer The state of the container
+
+ @returns `1` on success, `0` if the file could not be written (`errno` is set) or the writer is not open (`errno` is
+ `EBADF`)
+ */
+__attribute__((visibility("hidden"), nonnull(1)))
+int aes_container_writer_close(AESContainerWriter * writer);
+///@}
+
+#pragma mark - Container Reader
+/*!
+ @name Container Reader
+ Random access reads from a container on the active backend
+ */
+///@{
+/*!
+ @brief Opens and maps a container and checks its layout
+
+ @param reader The (caller owned) state to set up
+ @param path The path of the container
+ @param ctx The key context set up with `aes_key_context_init` (must outlive the reader)
+
+ @returns `1` on success, `0` if the file could not be mapped (`errno` is set), is not a container of this key
+ mode (`errno` is `EINVAL`) or is a GCM container and the active backend has no GCM (`errno` is `ENOTSUP`)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3)))
+int aes_container_open(AESContainerReader * reader, const char * path, const AESKeyContext * ctx);
+
+/*!
+ @brief Returns the length of the message stored in a container
+
+ @param reader The opened container
+
+ @returns The length of the message [in bytes]
+ */
+__attribute__((visibility("hidden"), nonnull(1)))
+unsigned long long aes_container_length(const AESContainerReader * reader);
+
+/*!
+ @brief Decrypts a byte range of the message stored in a container
+
+ Only the chunks overlapping `[offset, offset + mlength)` are decrypted (and, for GCM, verified as a whole). Chunks
+ which are completely inside the range are decrypted straight into `outt`, the (at most two) chunks which are cut by
+ the range go through a scratch buffer. With a pool the chunks are decoded on all of its threads.
+
+ @code
+ // read 64 KiB from the middle of a 10 GB container
+ aes_container_read(&reader, NULL, 5000000000ULL, buffer, 65536);
+ @endcode
+
+ @param reader The opened container
+ @param pool The pool to decode the chunks on (`NULL` to decode them on the calling thread)
+ @param offset The offset of the range in the message [in bytes]
+ @param outt The location where the `mlength` bytes of the range will be written
+ @param mlength The length of the range [in bytes]
+
+ @returns `1` on success, `0` if the range is not inside the message (`errno` is `ERANGE`), a tag does not match
+ (`errno` is `EBADMSG`, `outt` is wiped), or no memory was available (`errno` is `ENOMEM`)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 4)))
+int aes_container_read(AESContainerReader * reader, AESPool * pool, unsigned long long offset, uint8_t * outt, unsigned long mlength);
+
+/*!
+ @brief Unmaps a container
+
+ @param reader The opened container
+ */
+__attribute__((visibility("hidden"), nonnull(1)))
+void aes_container_close(AESContainerReader * reader);
+///@}
+
+#endif /* AEScontainer_h */
@@ -0,0 +1,352 @@
+//
+//  AESdispatch.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -pthread.
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file AESdispatch.c
+ 
+ The source file for the runtime selection of the fastest AES implementation available on the executing CPU
+ 
+ @compilerflag -fvisibility=hidden -pthread
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "AESdispatch.h"
+#include "AESgen.h"
+#include "AESbs.h"
+#include "AESni.h"
+#include "AESvaes.h"
+#include "AESvpaes.h"
+#include "AESarm.h"
+#include "AESstats.h"
+
+#if defined(intel_active) || defined(vpaes_active)
+	#include <cpuid.h>
+#endif
+#if defined(arm_active) && defined(__linux__)
+	#include <sys/auxv.h>
+#endif
+
+#pragma mark - Backends
+static const AESBackend gen_backend = {
+	aes_backend_gen, "gen",
+	aes_gen_key_context_init,
+	aes_cbc_gen_enc_ctx,
+	aes_cbc_gen_dec_ctx,
+	aes_ctr_gen_ctx,
+	NULL,
+	NULL
+};
+
+static const AESBackend bs_backend = {
+	aes_backend_bs, "bs",
+	aes_bs_key_context_init,
+	aes_cbc_bs_enc_ctx,
+	aes_cbc_bs_dec_ctx,
+	aes_ctr_bs_ctx,
+	NULL,
+	NULL
+};
+
+#ifdef intel_active
+static const AESBackend ni_backend = {
+	aes_backend_ni, "ni",
+	aes_ni_key_context_init,
+	aes_cbc_ni_enc_ctx,
+	aes_cbc_ni_dec_ctx,
+	aes_ctr_ni_ctx,
+	aes_gcm_ni_enc_ctx,
+	aes_gcm_ni_dec_ctx
+};
+#endif
+
+#ifdef vaes_active
+// the key contexts and the serial CBC encryption are the ones of AES-NI
+static const AESBackend vaes256_backend = {
+	aes_backend_vaes, "vaes",
+	aes_ni_key_context_init,
+	aes_cbc_ni_enc_ctx,
+	aes_cbc_vaes256_dec_ctx,
+	aes_ctr_vaes256_ctx,
+	aes_gcm_vaes256_enc_ctx,
+	aes_gcm_vaes256_dec_ctx
+};
+
+static const AESBackend vaes512_backend = {
+	aes_backend_vaes, "vaes",
+	aes_ni_key_context_init,
+	aes_cbc_ni_enc_ctx,
+	aes_cbc_vaes512_dec_ctx,
+	aes_ctr_vaes512_ctx,
+	aes_gcm_vaes512_enc_ctx,
+	aes_gcm_vaes512_dec_ctx
+};
+#endif
+
+#ifdef vpaes_active
+static const AESBackend vpaes_backend = {
+	aes_backend_vpaes, "vpaes",
+	aes_vpaes_key_context_init,
+	aes_cbc_vpaes_enc_ctx,
+	aes_cbc_vpaes_dec_ctx,
+	aes_ctr_vpaes_ctx,
+	NULL,
+	NULL
+};
+#endif
+
+#ifdef arm_active
+static const AESBackend arm_backend = {
+	aes_backend_arm, "arm",
+	aes_arm_key_context_init,
+	aes_cbc_arm_enc_ctx,
+	aes_cbc_arm_dec_ctx,
+	aes_ctr_arm_ctx,
+	NULL,
+	NULL
+};
+#endif
+
+// set once by select_backend on the first dispatched call (see active_backend)
+static const AESBackend * selected_backend;
+static pthread_once_t selection_once = PTHREAD_ONCE_INIT;
+
+#pragma mark - CPU Probing
+#if defined(intel_active) || defined(vpaes_active)
+/*!
+ @typedef AESCPULeaves
+
+ @brief The CPUID leaves the backends are probed with (zero if the CPU does not have a leaf).
+
+ CPUID is serializing and traps to the hypervisor in most virtual machines (several microseconds each), so the leaves
+ are read only once for all probes.
+ */
+typedef struct {
+	unsigned int leaf1_ecx;
+	unsigned int leaf7_ebx;
+	unsigned int leaf7_ecx;
+	unsigned long long xcr0;
+} AESCPULeaves;
+
+static AESCPULeaves cpu_leaves;
+static pthread_once_t cpu_leaves_once = PTHREAD_ONCE_INIT;
+
+static void read_cpu_leaves(void) {
+	unsigned int eax, ebx, ecx, edx;
+	const unsigned int max_leaf = __get_cpuid_max(0, NULL);
+
+	if (max_leaf >= 1) {
+		__cpuid(1, eax, ebx, ecx, edx);
+		cpu_leaves.leaf1_ecx = ecx;
+		if (ecx & bit_OSXSAVE) {
+			// xgetbv is emitted directly, the intrinsic would need -mxsave for the whole file
+			__asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			cpu_leaves.xcr0 = ((unsigned long long)edx << 32) | eax;
+		}
+	}
+	if (max_leaf >= 7) {
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		cpu_leaves.leaf7_ebx = ebx;
+		cpu_leaves.leaf7_ecx = ecx;
+	}
+}
+
+static const AESCPULeaves * cpu(void) {
+	pthread_once(&cpu_leaves_once, read_cpu_leaves);
+	return &cpu_leaves;
+}
+#endif
+
+#ifdef intel_active
+static int cpu_has_aesni(void) {
+	return (cpu()->leaf1_ecx & bit_AES) != 0;
+}
+#endif
+
+#ifdef vaes_active
+// the XCR0 bits of the register state the OS saves (SSE, AVX and, for AVX-512, the opmask and the upper ZMM registers)
+#define XCR0_AVX    0x06
+#define XCR0_AVX512 0xe6
+
+// `wide` asks for the 512 bit kernels (AVX-512F, BW and VL), otherwise for the 256 bit ones (AVX2), GCM and XTS need
+// VPCLMULQDQ next to VAES (both came with the same CPU generations)
+static int cpu_has_vaes(int wide) {
+	const AESCPULeaves * leaves = cpu();
+	const unsigned int vector = bit_VAES | bit_VPCLMULQDQ;
+	if (!cpu_has_aesni() || (leaves->leaf7_ecx & vector) != vector) {
+		return 0;
+	}
+	if (wide) {
+		const unsigned int avx512 = bit_AVX512F | bit_AVX512BW | bit_AVX512VL;
+		return (leaves->leaf7_ebx & avx512) == avx512 && (leaves->xcr0 & XCR0_AVX512) == XCR0_AVX512;
+	}
+	return (leaves->leaf7_ebx & bit_AVX2) && (leaves->xcr0 & XCR0_AVX) == XCR0_AVX;
+}
+#endif
+
+#ifdef vpaes_active
+static int cpu_has_ssse3(void) {
+	return (cpu()->leaf1_ecx & bit_SSSE3) != 0;
+}
+#endif
+
+#ifdef arm_active
+static int cpu_has_arm_aes(void) {
+#if defined(__linux__) && defined(__aarch64__)
+	return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#elif defined(__linux__) && defined(__arm__)
+	return (getauxval(AT_HWCAP2) & HWCAP2_AES) != 0;
+#elif defined(__APPLE__)
+	// every Apple ARM CPU implements the crypto extension
+	return 1;
+#elif defined(__ARM_FEATURE_CRYPTO)
+	return 1;
+#else
+	return 0;
+#endif
+}
+#endif
+
+static const AESBackend * backend_for(AESBackendKind kind) {
+	switch (kind) {
+		case aes_backend_gen:
+			return &gen_backend;
+		case aes_backend_bs:
+			return &bs_backend;
+#ifdef intel_active
+		case aes_backend_ni:
+			return cpu_has_aesni() ? &ni_backend : NULL;
+#endif
+#ifdef vaes_active
+		case aes_backend_vaes:
+			return cpu_has_vaes(1) ? &vaes512_backend : cpu_has_vaes(0) ? &vaes256_backend : NULL;
+#endif
+#ifdef vpaes_active
+		case aes_backend_vpaes:
+			return cpu_has_ssse3() ? &vpaes_backend : NULL;
+#endif
+#ifdef arm_active
+		case aes_backend_arm:
+			return cpu_has_arm_aes() ? &arm_backend : NULL;
+#endif
+		default:
+			// not compiled into this library
+			return NULL;
+	}
+}
+
+#pragma mark - Backend Selection
+static void select_backend(void) {
+	// without AES instructions the constant time backends win over the faster, but table based, general c one
+	const AESBackendKind preference[] = {aes_backend_vaes, aes_backend_ni, aes_backend_arm, aes_backend_vpaes, aes_backend_bs, aes_backend_gen};
+	const char * names[] = {"gen", "ni", "vaes", "arm", "bs", "vpaes"};
+	const int count = sizeof(names) / sizeof(names[0]);
+	const char * forced = getenv("SIMPLECRYPT_BACKEND");
+	const AESBackend * backend = NULL;
+	
+	if (forced && *forced) {
+		for (int kind = 0; kind < count; kind++) {
+			if (strcmp(forced, names[kind]) == 0) {
+				backend = backend_for((AESBackendKind)kind);
+			}
+		}
+		if (!backend) {
+			fprintf(stderr, "[%s] SIMPLECRYPT_BACKEND=%s is not available on this CPU, using the probed backend\n", __FILE__, forced);
+		}
+	}
+	
+	for (int i = 0; i < count && !backend; i++) {
+		backend = backend_for(preference[i]);
+	}
+	// the counters are switched before the first call can check them
+	aes_stats_init();
+	__atomic_store_n(&selected_backend, backend, __ATOMIC_RELEASE);
+}
+
+// nothing runs at load time, the first call probes the CPU and every later one only pays the (predicted) NULL check
+static inline const AESBackend * active_backend(void) {
+	const AESBackend * backend = __atomic_load_n(&selected_backend, __ATOMIC_ACQUIRE);
+	if (__builtin_expect(backend == NULL, 0)) {
+		pthread_once(&selection_once, select_backend);
+		backend = selected_backend;
+	}
+	return backend;
+}
+
+const AESBackend * aes_active_backend(void) {
+	return active_backend();
+}
+
+const char * aes_backend_name(void) {
+	return active_backend()->name;
+}
+
+int aes_backend_available(AESBackendKind kind) {
+	return backend_for(kind) != NULL;
+}
+
+#pragma mark - Dispatched Key Management
+// the counters cost one predicted branch while they are off (see AESstats.h)
+#define dispatch_counted(backend, fn, op, length, ...)\
+			if (aes_stats_on()) {\
+				uint64_t start = aes_stats_ticks();\
+				backend->fn(__VA_ARGS__);\
+				aes_stats_record(op, length, aes_stats_ticks() - start);\
+			} else {\
+				backend->fn(__VA_ARGS__);\
+			}
+
+void aes_key_context_init(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode) {
+	const AESBackend * backend = active_backend();
+	dispatch_counted(backend, key_context_init, aes_stats_key_setup, 0, ctx, key, keymode);
+}
+
+#pragma mark - Dispatched CBC and CTR
+// every dispatched call goes through here so a missing implementation is reported instead of crashing
+#define dispatch_check(backend, fn)\
+			if (!backend->fn) {\
+				fprintf(stderr, "[%s] %s", __FILE__, aes_backend_error());\
+				exit(EXIT_FAILURE);\
+			}
+
+#define dispatch(fn, op, length, ...)\
+			const AESBackend * backend = active_backend();\
+			dispatch_check(backend, fn)\
+			dispatch_counted(backend, fn, op, length, __VA_ARGS__)
+
+void aes_cbc_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	dispatch(cbc_enc, aes_stats_cbc_enc, mlength, inpt, outt, ivec, mlength, ctx);
+}
+
+void aes_cbc_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx) {
+	dispatch(cbc_dec, aes_stats_cbc_dec, clength, inpt, outt, ivec, clength, ctx);
+}
+
+void aes_ctr_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	dispatch(ctr, aes_stats_ctr, mlength, inpt, outt, ivec, mlength, ctx);
+}
+
+#pragma mark - Dispatched GCM
+void aes_gcm_enc_ctx(uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx) {
+	dispatch(gcm_enc, aes_stats_gcm_enc, mlength, inpt, outt, mlength, aad, alength, ivec, ivlength, tag, ctx);
+}
+
+int aes_gcm_dec_ctx(uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx) {
+	const AESBackend * backend = active_backend();
+	dispatch_check(backend, gcm_dec)
+	if (aes_stats_on()) {
+		uint64_t start = aes_stats_ticks();
+		int valid = backend->gcm_dec(inpt, outt, clength, aad, alength, ivec, ivlength, tag, ctx);
+		aes_stats_record(aes_stats_gcm_dec, clength, aes_stats_ticks() - start);
+		return valid;
+	}
+	return backend->gcm_dec(inpt, outt, clength, aad, alength, ivec, ivlength, tag, ctx);
+}
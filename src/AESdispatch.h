@@ -0,0 +1,182 @@
+//
+//  AESdispatch.h
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden
+// * * * * * * * * * * * * * * * * * * * *
+
+/*!
+ @file AESdispatch.h
+ 
+ The header file for the runtime selection of the fastest AES implementation available on the executing CPU
+ 
+ @version 0.0.1
+ */
+
+#ifndef AESdispatch_h
+#define AESdispatch_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "AESCore.h"
+
+#pragma mark - Backend Selection
+/*!
+ @name Backend Selection
+ Definitions pertaining to which implementation (backend) is used
+ */
+///@{
+/*!
+ @typedef AESBackendKind
+ 
+ @brief An enum naming the available implementations.
+ 
+ Possible values for the backend and what it specifies:
+ - aes_backend_gen: @code general c implementation [AESgen.c, any CPU] @endcode
+ - aes_backend_ni: @code Intel AES-NI implementation [AESni.c, x86 with AES-NI] @endcode
+ - aes_backend_vaes: @code Intel VAES implementation [AESvaes.c, x86 with VAES, VPCLMULQDQ and AVX-512 (4 blocks per instruction) or AVX2 (2 blocks)] @endcode
+ - aes_backend_arm: @code ARMv8 crypto extension implementation [AESarm.c, ARM with the AES extension] @endcode
+ - aes_backend_bs: @code constant time bitsliced implementation [AESbs.c, any CPU] @endcode
+ - aes_backend_vpaes: @code constant time vector permute implementation [AESvpaes.c, x86 with SSSE3] @endcode
+ */
+typedef enum {
+	aes_backend_gen = 0,
+	aes_backend_ni,
+	aes_backend_vaes,
+	aes_backend_arm,
+	aes_backend_bs,
+	aes_backend_vpaes
+} AESBackendKind;
+
+/*!
+ @typedef AESBackend
+ 
+ @brief The set of functions implementing AES on one kind of hardware.
+ 
+ Every entry mirrors the `_ctx` function of the respective implementation (e.g. `cbc_enc` is `aes_cbc_ni_enc_ctx`
+ for the Intel backend). An entry is `NULL` if the implementation does not provide the function (GCM is only
+ implemented by the Intel backends).
+ */
+typedef struct {
+	AESBackendKind kind;
+	const char * name;
+	void (*key_context_init)(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode);
+	void (*cbc_enc)(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+	void (*cbc_dec)(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx);
+	void (*ctr)(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+	void (*gcm_enc)(uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx);
+	int (*gcm_dec)(uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx);
+} AESBackend;
+
+/*!
+ @brief Returns the backend all dispatched calls are bound to
+ 
+ The CPU is probed once, on the first dispatched call (CPUID on x86, HWCAP on ARM), and the fastest backend compiled
+ into the library and supported by the CPU is chosen. Without AES instructions the constant time backends (vector
+ permute, then bitsliced) are preferred over the table based general c backend. For benchmarking, a specific backend can be forced by setting
+ the environment variable `SIMPLECRYPT_BACKEND` to `gen`, `ni`, `vaes`, `arm`, `bs`, or `vpaes`. If the forced backend is not
+ available, a warning is written to `stderr` and the probed backend is used.
+ 
+ @returns The active backend
+ */
+__attribute__((visibility("hidden")))
+const AESBackend * aes_active_backend(void);
+
+/*!
+ @brief Returns the name of the backend all dispatched calls are bound to
+ 
+ @returns The name of the active backend (`gen`, `ni`, `vaes`, `arm`, `bs`, or `vpaes`)
+ */
+__attribute__((visibility("hidden")))
+const char * aes_backend_name(void);
+
+/*!
+ @brief Returns whether the executing CPU supports a backend
+ 
+ @param kind The backend to check
+ 
+ @returns `1` if the backend is compiled in and supported by the CPU, `0` otherwise
+ */
+__attribute__((visibility("hidden")))
+int aes_backend_available(AESBackendKind kind);
+///@}
+
+#pragma mark - Dispatched Key Management
+/*!
+ @name Dispatched Key Management
+ Key setup through the active backend
+ */
+///@{
+/*!
+ @brief Expands a user key into a reusable key context using the active backend
+ 
+ @warning The context is stored in the format of the active backend and may only be used with the dispatched functions
+ 
+ @param ctx The (caller owned) context to fill
+ @param key The user key (`16`, `24`, or `32` bytes depending on the key mode)
+ @param keymode The AES version to use
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2)))
+void aes_key_context_init(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode);
+///@}
+
+#pragma mark - Dispatched CBC and CTR
+/*!
+ @name Dispatched CBC and CTR
+ The CBC and CTR functions of the active backend
+ */
+///@{
+/*!
+ @brief Encrypts the data using CBC AES on the active backend
+ 
+ @see aes_cbc_ni_enc_ctx for the description of the parameters
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_cbc_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Decrypts the data using CBC AES on the active backend
+ 
+ @see aes_cbc_ni_dec_ctx for the description of the parameters
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_cbc_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts or Decrypts the data using CTR AES on the active backend
+ 
+ @see aes_ctr_ni_ctx for the description of the parameters
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_ctr_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+///@}
+
+#pragma mark - Dispatched GCM
+/*!
+ @name Dispatched GCM
+ The GCM functions of the active backend, exits with `aes_backend_error` if the backend does not implement GCM
+ */
+///@{
+/*!
+ @brief Encrypts and authenticates the data using GCM AES on the active backend
+
+ @see aes_gcm_ni_enc_ctx for the description of the parameters
+ */
+__attribute__((visibility("hidden"), nonnull(6, 8, 9)))
+void aes_gcm_enc_ctx(uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx);
+
+/*!
+ @brief Verifies and decrypts the data using GCM AES on the active backend
+
+ @see aes_gcm_ni_dec_ctx for the description of the parameters
+
+ @returns `1` if the tag matches (the data is authentic), `0` otherwise
+ */
+__attribute__((visibility("hidden"), nonnull(6, 8, 9)))
+int aes_gcm_dec_ctx(uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx);
+///@}
+
+#endif /* AESdispatch_h */
@@ -0,0 +1,155 @@
+//
+//  AESfile.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -pthread.
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file AESfile.c
+
+ The source file for the encryption and decryption of whole files, which are memory mapped and processed in chunks
+ on a thread pool
+
+ @compilerflag -fvisibility=hidden -pthread
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "AESfile.h"
+
+#pragma mark - Internal Core
+static unsigned long llc_size(void) {
+#ifdef _SC_LEVEL3_CACHE_SIZE
+	long size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+	if (size > 0) {
+		return (unsigned long)size;
+	}
+#endif
+	return AES_FILE_LLC_SIZE;
+}
+
+// maps the whole file, the hints are best effort and their failure is ignored
+static uint8_t * map_file(int fd, size_t length, int writable) {
+	void * map = mmap(NULL, length, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+	madvise(map, length, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+	madvise(map, length, MADV_HUGEPAGE);
+#endif
+	return (uint8_t *)map;
+}
+
+// closes the descriptors without overwriting the errno of the failure
+static void close_files(int in, int out) {
+	int saved = errno;
+	if (out >= 0 && out != in) {
+		close(out);
+	}
+	if (in >= 0) {
+		close(in);
+	}
+	errno = saved;
+}
+
+// opens the output without truncating it, `created` tells whether it did not exist before (and so may be removed)
+static int open_output(const char * path, mode_t mode, int * created) {
+	int fd = open(path, O_RDWR | O_CREAT | O_EXCL, mode);
+	*created = fd >= 0;
+	if (fd < 0 && errno == EEXIST) {
+		fd = open(path, O_RDWR);
+	}
+	return fd;
+}
+
+#pragma mark - CTR Files
+int aes_ctr_file(AESPool * pool, const char * inpath, const char * outpath, uint8_t * ivec, const AESKeyContext * ctx) {
+	int in_place = !outpath;
+	int in = -1, out = -1, created = 0;
+	uint8_t * inmap = NULL, * outmap = NULL;
+	struct stat st, outst;
+
+	in = open(inpath, in_place ? O_RDWR : O_RDONLY);
+	if (in < 0 || fstat(in, &st) < 0) {
+		close_files(in, out);
+		return 0;
+	}
+	if ((unsigned long long)st.st_size > (size_t)-1 || (unsigned long long)st.st_size > (unsigned long)-1) {
+		errno = EFBIG;
+		close_files(in, out);
+		return 0;
+	}
+	size_t length = (size_t)st.st_size;
+
+	if (in_place) {
+		out = in;
+	} else {
+		out = open_output(outpath, st.st_mode & 0777, &created);
+		if (out < 0 || fstat(out, &outst) < 0) {
+			goto fail;
+		}
+		// another name of the input (./a.bin, a symlink, a hard link) is in place, the output is the writable one
+		if (outst.st_dev == st.st_dev && outst.st_ino == st.st_ino) {
+			close(in);
+			in = out;
+			in_place = 1;
+		}
+	}
+
+	// an empty file cannot be mapped, and there is nothing to do
+	if (!length) {
+		if (!in_place && ftruncate(out, 0) < 0) {
+			goto fail;
+		}
+		close_files(in, out);
+		return 1;
+	}
+
+	inmap = map_file(in, length, in_place);
+	// the output is mapped before it is sized, so an existing output stays untouched if anything fails until here
+	outmap = in_place ? inmap : map_file(out, length, 1);
+	if (!inmap || !outmap || (!in_place && ftruncate(out, (off_t)length) < 0)) {
+		goto fail;
+	}
+
+	if (length > llc_size()) {
+		aes_ctr_parallel_nt_ctx(pool, inmap, outmap, ivec, length, ctx);
+	} else {
+		aes_ctr_parallel_ctx(pool, inmap, outmap, ivec, length, ctx);
+	}
+
+	if (!in_place) {
+		munmap(outmap, length);
+	}
+	munmap(inmap, length);
+	close_files(in, out);
+	return 1;
+
+fail:
+	{
+		int saved = errno;
+		if (outmap && outmap != inmap) {
+			munmap(outmap, length);
+		}
+		if (inmap) {
+			munmap(inmap, length);
+		}
+		// an output this call created is removed again, no empty or partial file is left behind
+		if (created) {
+			unlink(outpath);
+		}
+		errno = saved;
+	}
+	close_files(in, out);
+	return 0;
+}
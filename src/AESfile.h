@@ -0,0 +1,76 @@
+//
+//  AESfile.h
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -pthread
+// * * * * * * * * * * * * * * * * * * * *
+
+/*!
+ @file AESfile.h
+
+ The header file for the encryption and decryption of whole files, which are memory mapped and processed in chunks
+ on a thread pool
+
+ @version 0.0.1
+ */
+
+#ifndef AESfile_h
+#define AESfile_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "AESCore.h"
+#include "AESparallel.h"
+
+#pragma mark - Convenience Definitions
+/*!
+ @define AES_FILE_LLC_SIZE
+ The last level cache size [in bytes] assumed when the system does not report it, files larger than the last level
+ cache are written with non-temporal stores
+ */
+#define AES_FILE_LLC_SIZE (32 * 1024 * 1024)
+
+#pragma mark - CTR Files
+/*!
+ @name CTR Files
+ CounTeR mode encryption and decryption of files on the active backend
+ */
+///@{
+/*!
+ @brief Encrypts or Decrypts a file using CTR AES on all threads of the pool
+
+ The input is mapped read only (or read write when working in place) and advised for sequential access and, where the
+ system supports it, for transparent huge pages. The output file is created (or resized) with the size of the input
+ and mapped as well, so the data never goes through a user space buffer. An output which is the input under another
+ name (a relative path, a symbolic or a hard link) is detected by its device and inode and processed in place. An
+ existing output is only resized once everything else succeeded, a newly created one is removed again on failure. The mapping is split into the chunks of the
+ pool (see `aes_ctr_parallel_ctx`); outputs larger than the last level cache are written with non-temporal stores
+ (see `aes_ctr_parallel_nt_ctx`).
+
+ @code
+ AESPool * pool = aes_pool_create(0, 0);
+ AESKeyContext ctx;
+ aes_key_context_init(&ctx, userKey, aes_256);
+ if (!aes_ctr_file(pool, "archive.tar", "archive.tar.enc", iv, &ctx)) {
+	perror("archive.tar");
+ }
+ @endcode
+
+ @note The written data is in the page cache when the function returns, call `fsync` on the file for durability
+
+ @param pool The pool to run on
+ @param inpath The path of the file to encrypt/decrypt
+ @param outpath The path of the file the result is written to (`NULL` or the input file to work in place)
+ @param ivec The `16` byte initial counter block (the full 128 bits are incremented)
+ @param ctx The key context set up with `aes_key_context_init`
+
+ @returns `1` on success, `0` if a file could not be opened, sized, or mapped (`errno` is set)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 4, 5)))
+int aes_ctr_file(AESPool * pool, const char * inpath, const char * outpath, uint8_t * ivec, const AESKeyContext * ctx);
+///@}
+
+#endif /* AESfile_h */
@@ -6,7 +6,7 @@
 //  Copyright © 2018 jniegsch. All rights reserved.
 //
 // * * * * * * * * * * * * * * * * * * * * * * * * * *
-// Compile with -fvisibility=hidden.
+// Compile with -fvisibility=hidden -pthread.
 // * * * * * * * * * * * * * * * * * * * * * * * * * *
 //
 
@@ -16,287 +16,274 @@
  The source file for the AES encryption (basic as well as CBC and CTR mode) implemented in general c
  
  @updated 08-31-2018
- @compilerflag -fvisibility=hidden
+ @compilerflag -fvisibility=hidden -pthread
  @version 0.0.1
  @author Jan Niegsch
  */
 
-#include "AESgen.h"
-
-#pragma mark - Preprocessor Definitions
-#define prepareNextThree uint32x4 n[3]
-#define nextThree(a, b, c) \
-          n[0] = (*schedule)[a]; \
-          n[1] = (*schedule)[b]; \
-          n[2] = (*schedule)[c]
-
-#define prepareNextAndPrevTwo uint32x4 n[2]; uint32x4 p[2]
-#define nextTwo(a, b) \
-          n[0] = (*schedule)[a]; \
-          n[1] = (*schedule)[b]
+#include <pthread.h>
 
-#define prevTwo(a, b) \
-          p[0] = (*schedule)[a]; \
-          p[1] = (*schedule)[b]
-
-#pragma mark - Internal Core
-__attribute__((constructor))
-static void initializer(void) {
-	printf("[%s] initialized\n", __FILE__);
-}
-
-// destructor
-__attribute__((destructor))
-static void finalizer(void) {
-	printf("[%s] finalized\n", __FILE__);
-}
-
-#pragma mark - Internal Converters
-static inline uint32x2 u8x16_u32x2(uint8x16 x) {
-  uint32x2 ret;
-  ret._[0] = (uint32_t)(((uint32_t) x._[ 0]) << 24) + (((uint32_t) x._[ 1]) << 16) + (((uint32_t) x._[ 2]) << 8) + ((uint32_t) x._[ 3]);
-  ret._[1] = (uint32_t)(((uint32_t) x._[ 4]) << 24) + (((uint32_t) x._[ 5]) << 16) + (((uint32_t) x._[ 6]) << 8) + ((uint32_t) x._[ 7]);
-  return ret;
-}
+#include "AESgen.h"
 
-static inline uint32x4 u8x16_u32x4(uint8x16 x) {
-  uint32x4 ret;
-  ret._[0] = (uint32_t)(((uint32_t) x._[ 0]) << 24) + (((uint32_t) x._[ 1]) << 16) + (((uint32_t) x._[ 2]) << 8) + ((uint32_t) x._[ 3]);
-  ret._[1] = (uint32_t)(((uint32_t) x._[ 4]) << 24) + (((uint32_t) x._[ 5]) << 16) + (((uint32_t) x._[ 6]) << 8) + ((uint32_t) x._[ 7]);
-  ret._[2] = (uint32_t)(((uint32_t) x._[ 8]) << 24) + (((uint32_t) x._[ 9]) << 16) + (((uint32_t) x._[10]) << 8) + ((uint32_t) x._[11]);
-  ret._[3] = (uint32_t)(((uint32_t) x._[12]) << 24) + (((uint32_t) x._[13]) << 16) + (((uint32_t) x._[14]) << 8) + ((uint32_t) x._[15]);
-  return ret;
-}
+#pragma mark - T-Tables
+// Te0[x] holds the column {2 * S[x], S[x], S[x], 3 * S[x]}, i.e. SubBytes and MixColumns of a single byte, Te1..Te3 are
+// the same column rotated by one byte each so that ShiftRows only decides which byte indexes which table.
+// Td0..Td3 do the same for the inverse cipher with {14, 9, 13, 11}, Td4 is the plain inverse S-box for the last round.
+static uint32_t Te0[256], Te1[256], Te2[256], Te3[256];
+static uint32_t Td0[256], Td1[256], Td2[256], Td3[256];
+static uint8_t Td4[256];
 
-static inline uint8x16 u8t_u8x16(uint8_t * x) {
-  // no check for actually 16 -> assume external interface checks this
-  uint8x16 ret;
-  ret._[ 0] = x[ 0]; ret._[ 1] = x[ 1]; ret._[ 2] = x[ 2]; ret._[ 3] = x[ 3];
-  ret._[ 4] = x[ 4]; ret._[ 5] = x[ 5]; ret._[ 6] = x[ 6]; ret._[ 7] = x[ 7];
-  ret._[ 8] = x[ 8]; ret._[ 9] = x[ 9]; ret._[10] = x[10]; ret._[11] = x[11];
-  ret._[12] = x[12]; ret._[13] = x[13]; ret._[14] = x[14]; ret._[15] = x[15];
-  return ret;
+static inline uint32_t ror8(uint32_t w) {
+	return (w >> 8) | (w << 24);
 }
 
-static inline uint8x16 u8x24_u8x16_f(uint8x24 x) {
-  uint8x16 ret;
-  ret._[ 0] = x._[ 0]; ret._[ 1] = x._[ 1]; ret._[ 2] = x._[ 2]; ret._[ 3] = x._[ 3];
-  ret._[ 4] = x._[ 4]; ret._[ 5] = x._[ 5]; ret._[ 6] = x._[ 6]; ret._[ 7] = x._[ 7];
-  ret._[ 8] = x._[ 8]; ret._[ 9] = x._[ 9]; ret._[10] = x._[10]; ret._[11] = x._[11];
-  ret._[12] = x._[12]; ret._[13] = x._[13]; ret._[14] = x._[14]; ret._[15] = x._[15];
-  return ret;
+// generated on the first key setup, every function using the tables needs a key context (and so a key setup) first
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void generate_tables(void) {
+	for (int x = 0; x < 256; x++) {
+		const uint8_t s = s_box((uint8_t)x), si = inv_s_box((uint8_t)x);
+		
+		Te0[x] = ((uint32_t)gf_mul(s, 0x02) << 24) | ((uint32_t)s << 16) | ((uint32_t)s << 8) | (uint32_t)gf_mul(s, 0x03);
+		Te1[x] = ror8(Te0[x]);
+		Te2[x] = ror8(Te1[x]);
+		Te3[x] = ror8(Te2[x]);
+		
+		Td0[x] = ((uint32_t)gf_mul(si, 0x0e) << 24) | ((uint32_t)gf_mul(si, 0x09) << 16) |
+				 ((uint32_t)gf_mul(si, 0x0d) <<  8) |  (uint32_t)gf_mul(si, 0x0b);
+		Td1[x] = ror8(Td0[x]);
+		Td2[x] = ror8(Td1[x]);
+		Td3[x] = ror8(Td2[x]);
+		Td4[x] = si;
+	}
 }
 
-static inline uint8x16 u8x24_u8x16_l(uint8x24 x) {
-  uint8x16 ret;
-  ret._[ 0] = x._[16]; ret._[ 1] = x._[17]; ret._[ 2] = x._[18]; ret._[ 3] = x._[19];
-  ret._[ 4] = x._[20]; ret._[ 5] = x._[21]; ret._[ 6] = x._[22]; ret._[ 7] = x._[23];
-  ret._[ 8] = 0x00000; ret._[ 9] = 0x00000; ret._[10] = 0x00000; ret._[11] = 0x00000;
-  ret._[12] = 0x00000; ret._[13] = 0x00000; ret._[14] = 0x00000; ret._[15] = 0x00000;
-  return ret;
+#pragma mark - Internal Core
+static inline uint32_t load_be32(const uint8_t * p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
 }
 
-static inline uint32x4 u8x24_u32x4_rem(uint8x24 x, uint32x2 * r) {
-  *r = u8x16_u32x2(u8x24_u8x16_l(x));
-  return u8x16_u32x4(u8x24_u8x16_f(x));
+static inline void store_be32(uint8_t * p, uint32_t w) {
+	p[0] = (uint8_t)(w >> 24); p[1] = (uint8_t)(w >> 16); p[2] = (uint8_t)(w >> 8); p[3] = (uint8_t)w;
 }
 
-static inline uint8x16 u8x32_u8x16_drpl(uint8x32 x) {
-  uint8x16 ret;
-  ret._[ 0] = x._[16]; ret._[ 1] = x._[17]; ret._[ 2] = x._[18]; ret._[ 3] = x._[19];
-  ret._[ 4] = x._[20]; ret._[ 5] = x._[21]; ret._[ 6] = x._[22]; ret._[ 7] = x._[23];
-  ret._[ 8] = x._[24]; ret._[ 9] = x._[25]; ret._[10] = x._[26]; ret._[11] = x._[27];
-  ret._[12] = x._[28]; ret._[13] = x._[29]; ret._[14] = x._[30]; ret._[15] = x._[31];
-  return ret;
+#pragma mark - Key Management Core
+void aes_gen_key_context_init(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode) {
+	aes_word * enc_sched = (aes_word *)ctx->enc_schedule;
+	aes_word * dec_sched = (aes_word *)ctx->dec_schedule;
+	
+	pthread_once(&tables_once, generate_tables);
+	switch(keymode) {
+		case aes_128:
+		case aes_192:
+		case aes_256:
+			aes_expand_key(ctx->enc_schedule, key, keymode);
+			break;
+		default:
+			fprintf(stderr, "[%s] %s", __FILE__, aes_mode_error());
+			exit(EXIT_FAILURE);
+			break;
+	}
+	
+	// the tables work on (big endian) columns, so the schedule is stored as words
+	for (int i = 0; i < 4 * ((int)keymode + 1); i++) {
+		enc_sched[i] = load_be32(&ctx->enc_schedule[i / 4][4 * (i % 4)]);
+	}
+	
+	// decryption walks the schedule backwards with inverse mix columns applied to the inner round keys (equivalent
+	// inverse cipher), Td[S[x]] is exactly InvMixColumns of a single byte
+	for (int i = 0; i <= (int)keymode; i++) {
+		for (int j = 0; j < 4; j++) {
+			const uint32_t w = enc_sched[4 * (keymode - i) + j];
+			if (i == 0 || i == (int)keymode) {
+				dec_sched[4 * i + j] = w;
+			} else {
+				dec_sched[4 * i + j] = Td0[s_box(w >> 24)] ^ Td1[s_box((w >> 16) & 0xff)] ^
+									   Td2[s_box((w >> 8) & 0xff)] ^ Td3[s_box(w & 0xff)];
+			}
+		}
+	}
+	ctx->keymode = keymode;
 }
 
-static inline uint8x16 u8x32_u8x16_drpf(uint8x32 x) {
-  uint8x16 ret;
-  ret._[ 0] = x._[ 0]; ret._[ 1] = x._[ 1]; ret._[ 2] = x._[ 2]; ret._[ 3] = x._[ 3];
-  ret._[ 4] = x._[ 4]; ret._[ 5] = x._[ 5]; ret._[ 6] = x._[ 6]; ret._[ 7] = x._[ 7];
-  ret._[ 8] = x._[ 8]; ret._[ 9] = x._[ 9]; ret._[10] = x._[10]; ret._[11] = x._[11];
-  ret._[12] = x._[12]; ret._[13] = x._[13]; ret._[14] = x._[14]; ret._[15] = x._[15];
-  return ret;
+#pragma mark - Encryption and Decryption Internals
+// one output column of a full round, the arguments are the input columns in ShiftRows order
+#define te_column(a, b, c, d, k) \
+	(Te0[(a) >> 24] ^ Te1[((b) >> 16) & 0xff] ^ Te2[((c) >> 8) & 0xff] ^ Te3[(d) & 0xff] ^ (k))
+#define td_column(a, b, c, d, k) \
+	(Td0[(a) >> 24] ^ Td1[((b) >> 16) & 0xff] ^ Td2[((c) >> 8) & 0xff] ^ Td3[(d) & 0xff] ^ (k))
+// the last round has no MixColumns, so only the S-box byte of each lookup is kept
+#define te_last(a, b, c, d, k) \
+	((Te2[(a) >> 24] & 0xff000000) ^ (Te3[((b) >> 16) & 0xff] & 0x00ff0000) ^ \
+	 (Te0[((c) >> 8) & 0xff] & 0x0000ff00) ^ (Te1[(d) & 0xff] & 0x000000ff) ^ (k))
+#define td_last(a, b, c, d, k) \
+	(((uint32_t)Td4[(a) >> 24] << 24) ^ ((uint32_t)Td4[((b) >> 16) & 0xff] << 16) ^ \
+	 ((uint32_t)Td4[((c) >> 8) & 0xff] << 8) ^ (uint32_t)Td4[(d) & 0xff] ^ (k))
+
+static inline void gen_encrypt(uint32_t * state, const aes_word * rk, AESKeyMode keymode) {
+	uint32_t s0 = state[0] ^ rk[0], s1 = state[1] ^ rk[1], s2 = state[2] ^ rk[2], s3 = state[3] ^ rk[3];
+	uint32_t t0, t1, t2, t3;
+	
+	for (int r = 1; r < (int)keymode; r++) {
+		rk += 4;
+		t0 = te_column(s0, s1, s2, s3, rk[0]);
+		t1 = te_column(s1, s2, s3, s0, rk[1]);
+		t2 = te_column(s2, s3, s0, s1, rk[2]);
+		t3 = te_column(s3, s0, s1, s2, rk[3]);
+		s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+	}
+	rk += 4;
+	state[0] = te_last(s0, s1, s2, s3, rk[0]);
+	state[1] = te_last(s1, s2, s3, s0, rk[1]);
+	state[2] = te_last(s2, s3, s0, s1, rk[2]);
+	state[3] = te_last(s3, s0, s1, s2, rk[3]);
 }
 
-static inline void u8x32_u32_4_split2(uint32x4 * f, uint32x4 * s, uint8x32 x) {
-  *f = u8x16_u32x4(u8x32_u8x16_drpl(x));
-  *s = u8x16_u32x4(u8x32_u8x16_drpf(x));
+static inline void gen_decrypt(uint32_t * state, const aes_word * rk, AESKeyMode keymode) {
+	uint32_t s0 = state[0] ^ rk[0], s1 = state[1] ^ rk[1], s2 = state[2] ^ rk[2], s3 = state[3] ^ rk[3];
+	uint32_t t0, t1, t2, t3;
+	
+	for (int r = 1; r < (int)keymode; r++) {
+		rk += 4;
+		t0 = td_column(s0, s3, s2, s1, rk[0]);
+		t1 = td_column(s1, s0, s3, s2, rk[1]);
+		t2 = td_column(s2, s1, s0, s3, rk[2]);
+		t3 = td_column(s3, s2, s1, s0, rk[3]);
+		s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+	}
+	rk += 4;
+	state[0] = td_last(s0, s3, s2, s1, rk[0]);
+	state[1] = td_last(s1, s0, s3, s2, rk[1]);
+	state[2] = td_last(s2, s1, s0, s3, rk[2]);
+	state[3] = td_last(s3, s2, s1, s0, rk[3]);
 }
 
-static inline void * flatten_uint8(uint8_t * x, int sz) {
-  uint8x16 * ret16 = NULL; uint8x24 * ret24 = NULL; uint8x32 * ret32 = NULL; 
-  switch (sz) {
-    case 16:
-      ret16 = (uint8x16 *) x;
-      return ret16;
-    case 24:
-      ret24 = (uint8x24 *) x;
-      return ret24;
-    case 32:
-      ret32 = (uint8x32 *) x;
-      return ret32;
-    default:
-      // error!
-      return NULL;
-  }
+#pragma mark - Encryption and Decryption Core
+void aes_gen_enc(uint8_t * data, const aes_word * key_schedule, AESKeyMode keymode) {
+	uint32_t state[4] = {load_be32(data), load_be32(data + 4), load_be32(data + 8), load_be32(data + 12)};
+	gen_encrypt(state, key_schedule, keymode);
+	store_be32(data, state[0]); store_be32(data + 4, state[1]); store_be32(data + 8, state[2]); store_be32(data + 12, state[3]);
 }
 
-#pragma mark - Key Management: 128
-static inline void __gen_aes_128_expAssist(uint32x4 nextRound, uint32_t rcon, uint32x4 prevRound) {
-  nextRound._[0] = sub_word(rot_word(prevRound._[3])) ^ rcon ^ prevRound._[0];
-  nextRound._[1] = sub_word(rot_word(nextRound._[0])) ^ rcon ^ prevRound._[1];
-  nextRound._[2] = sub_word(rot_word(nextRound._[0])) ^ rcon ^ prevRound._[2];
-  nextRound._[3] = sub_word(rot_word(nextRound._[0])) ^ rcon ^ prevRound._[3];
+void aes_gen_dec(uint8_t * data, const aes_word * key_schedule, AESKeyMode keymode) {
+	uint32_t state[4] = {load_be32(data), load_be32(data + 4), load_be32(data + 8), load_be32(data + 12)};
+	gen_decrypt(state, key_schedule, keymode);
+	store_be32(data, state[0]); store_be32(data + 4, state[1]); store_be32(data + 8, state[2]); store_be32(data + 12, state[3]);
 }
 
-static void __gen_key_expansion_128(uint32x4 * schedule[11], uint8x16 encKey) {
-  (*schedule)[0] = u8x16_u32x4(encKey);
-  __gen_aes_128_expAssist((*schedule)[ 1], 0x01, (*schedule)[0]);
-  __gen_aes_128_expAssist((*schedule)[ 2], 0x02, (*schedule)[1]);
-  __gen_aes_128_expAssist((*schedule)[ 3], 0x04, (*schedule)[2]);
-  __gen_aes_128_expAssist((*schedule)[ 4], 0x08, (*schedule)[3]);
-  __gen_aes_128_expAssist((*schedule)[ 5], 0x10, (*schedule)[4]);
-  __gen_aes_128_expAssist((*schedule)[ 6], 0x20, (*schedule)[5]);
-  __gen_aes_128_expAssist((*schedule)[ 7], 0x40, (*schedule)[6]);
-  __gen_aes_128_expAssist((*schedule)[ 8], 0x80, (*schedule)[7]);
-  __gen_aes_128_expAssist((*schedule)[ 9], 0x1b, (*schedule)[8]);
-  __gen_aes_128_expAssist((*schedule)[10], 0x36, (*schedule)[9]);
+#pragma mark - CBC Core
+void aes_cbc_gen_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_gen_key_context_init(&ctx, epoch_key, keymode);
+	aes_cbc_gen_enc_ctx(inpt, outt, ivec, mlength, &ctx);
+	aes_key_context_clear(&ctx);
 }
 
-#pragma mark - Key Management: 192
-static inline void __gen_aes_192_expAssist(uint32x4 prev, uint32x4 next1, uint32x4 next2, uint32x4 next3, uint32x2 * temp, uint32_t rcon1, uint32_t rcon2) {
-  next1._[0] = temp->_[0];
-  next1._[1] = temp->_[1];
-  next1._[2] = sub_word(rot_word(next1._[1])) ^ rcon1 ^  prev._[0];
-  next1._[3] = sub_word(rot_word(next1._[2])) ^ rcon1 ^  prev._[1];
-
-  next2._[0] = sub_word(rot_word(next1._[3])) ^ rcon1 ^  prev._[2];
-  next2._[1] = sub_word(rot_word(next2._[0])) ^ rcon1 ^  prev._[3];
-  next2._[2] = sub_word(rot_word(next2._[1])) ^ rcon1 ^ next1._[0];
-  next2._[3] = sub_word(rot_word(next2._[2])) ^ rcon1 ^ next1._[1];
-
-  next3._[0] = sub_word(rot_word(next2._[3])) ^ rcon2 ^ next1._[2];
-  next3._[1] = sub_word(rot_word(next3._[0])) ^ rcon2 ^ next1._[3];
-  next3._[2] = sub_word(rot_word(next3._[1])) ^ rcon2 ^ next2._[0];
-  next3._[3] = sub_word(rot_word(next3._[2])) ^ rcon2 ^ next2._[1];
-
-  temp->_[0] = sub_word(rot_word(next3._[3])) ^ rcon2 ^ next2._[2];
-  temp->_[1] = sub_word(rot_word(temp->_[0])) ^ rcon2 ^ next2._[3];
+void aes_cbc_gen_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	const aes_word * key_sched = (const aes_word *)ctx->enc_schedule;
+	AESKeyMode keymode = ctx->keymode;
+	uint32_t feedback[4] = {load_be32(ivec), load_be32(ivec + 4), load_be32(ivec + 8), load_be32(ivec + 12)};
+	
+	// only full blocks are processed, a trailing partial block is never read or written
+	mlength /= 16;
+	
+	for (size_t i = 0; i < mlength; i++) {
+		uint8_t * in = inpt + 16 * i, * out = outt + 16 * i;
+		for (int w = 0; w < 4; w++) {
+			feedback[w] ^= load_be32(in + 4 * w);
+		}
+		gen_encrypt(feedback, key_sched, keymode);
+		for (int w = 0; w < 4; w++) {
+			store_be32(out + 4 * w, feedback[w]);
+		}
+	}
 }
 
-static void __gen_key_expansion_192(uint32x4 * schedule[13], uint8x24 encKey) {
-  uint32x2 temp;
-  
-  (*schedule)[0] = u8x24_u32x4_rem(encKey, &temp);
-  __gen_aes_192_expAssist((*schedule)[0], (*schedule)[ 1], (*schedule)[ 2], (*schedule)[ 3], &temp, 0x01, 0x02);
-  __gen_aes_192_expAssist((*schedule)[3], (*schedule)[ 4], (*schedule)[ 5], (*schedule)[ 6], &temp, 0x04, 0x08);
-  __gen_aes_192_expAssist((*schedule)[6], (*schedule)[ 7], (*schedule)[ 8], (*schedule)[ 9], &temp, 0x10, 0x20);
-  __gen_aes_192_expAssist((*schedule)[9], (*schedule)[10], (*schedule)[11], (*schedule)[12], &temp, 0x40, 0x80);
+void aes_cbc_gen_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_gen_key_context_init(&ctx, epoch_key, keymode);
+	aes_cbc_gen_dec_ctx(inpt, outt, ivec, clength, &ctx);
+	aes_key_context_clear(&ctx);
 }
 
-#pragma mark - Key Management: 256
-static inline void __gen_aes_256_expAssist(uint32x4 prev1, uint32x4 prev2, uint32x4 next1, uint32x4 next2, uint32_t rcon, int half) {
-  next1._[0] = sub_word(rot_word(prev2._[3])) ^ rcon ^ prev1._[0];
-  next1._[1] = sub_word(rot_word(next1._[0])) ^ rcon ^ prev1._[1];
-  next1._[2] = sub_word(rot_word(next1._[1])) ^ rcon ^ prev1._[2];
-  next1._[3] = sub_word(rot_word(next1._[2])) ^ rcon ^ prev1._[3];
-  if (half) { return; }
-  next2._[0] = sub_word(rot_word(next1._[3])) ^ rcon ^ prev2._[0];
-  next2._[1] = sub_word(rot_word(next2._[0])) ^ rcon ^ prev2._[1];
-  next2._[2] = sub_word(rot_word(next2._[1])) ^ rcon ^ prev2._[2];
-  next2._[3] = sub_word(rot_word(next2._[2])) ^ rcon ^ prev2._[3];
+void aes_cbc_gen_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx) {
+	const aes_word * key_sched = (const aes_word *)ctx->dec_schedule;
+	AESKeyMode keymode = ctx->keymode;
+	uint32_t feedback[4] = {load_be32(ivec), load_be32(ivec + 4), load_be32(ivec + 8), load_be32(ivec + 12)};
+	uint32_t cipher[4], data[4];
+	
+	// only full blocks are processed, a trailing partial block is never read or written
+	clength /= 16;
+	
+	for (size_t i = 0; i < clength; i++) {
+		uint8_t * in = inpt + 16 * i, * out = outt + 16 * i;
+		// the cipher block is read before the output is written (in place safe)
+		for (int w = 0; w < 4; w++) {
+			cipher[w] = load_be32(in + 4 * w);
+			data[w] = cipher[w];
+		}
+		gen_decrypt(data, key_sched, keymode);
+		for (int w = 0; w < 4; w++) {
+			store_be32(out + 4 * w, data[w] ^ feedback[w]);
+			feedback[w] = cipher[w];
+		}
+	}
 }
 
-static void __gen_key_expansion_256(uint32x4 * schedule[15], uint8x32 encKey) {
-	uint32x4 dummy = {0,0,0,0};
-  
-  u8x32_u32_4_split2(&(*schedule)[0], &(*schedule)[1], encKey);
-  __gen_aes_256_expAssist((*schedule)[ 0], (*schedule)[ 1], (*schedule)[ 2], (*schedule)[ 3], 0x01, 0);
-  __gen_aes_256_expAssist((*schedule)[ 2], (*schedule)[ 3], (*schedule)[ 4], (*schedule)[ 5], 0x02, 0);
-  __gen_aes_256_expAssist((*schedule)[ 4], (*schedule)[ 5], (*schedule)[ 6], (*schedule)[ 7], 0x04, 0);
-  __gen_aes_256_expAssist((*schedule)[ 6], (*schedule)[ 7], (*schedule)[ 8], (*schedule)[ 9], 0x08, 0);
-  __gen_aes_256_expAssist((*schedule)[ 8], (*schedule)[ 9], (*schedule)[10], (*schedule)[11], 0x10, 0);
-  __gen_aes_256_expAssist((*schedule)[10], (*schedule)[11], (*schedule)[12], (*schedule)[13], 0x20, 0);
-  __gen_aes_256_expAssist((*schedule)[12], (*schedule)[12], (*schedule)[14],           dummy, 0x40, 1);
+#pragma mark - CTR Core
+void aes_ctr_gen(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_gen_key_context_init(&ctx, epoch_key, keymode);
+	aes_ctr_gen_ctx(inpt, outt, ivec, mlength, &ctx);
+	aes_key_context_clear(&ctx);
 }
 
-inline uint32x4 * load_key_expansion(uint8_t * key, AESKeyMode keymode) {
-  uint32x4 * keySchedule = malloc((keymode + 1) * sizeof(uint32x4));
-  switch(keymode) {
-    case aes_128:
-      __gen_key_expansion_128(&keySchedule, *((uint8x16 *)flatten_uint8(key, 16)));
-      break;
-    case aes_192:
-      __gen_key_expansion_192(&keySchedule, *((uint8x24 *)flatten_uint8(key, 24)));
-      break;
-    case aes_256:
-      __gen_key_expansion_256(&keySchedule, *((uint8x32 *)flatten_uint8(key, 32)));
-      break;
-    default:
-      fprintf(stderr, "[%s] %s", __FILE__, aes_mode_error());
-			exit(EXIT_FAILURE);
-			break;
-  }
-
-  return keySchedule;
+void aes_ctr_gen_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	aes_ctr_gen_counter_ctx(inpt, outt, ivec, mlength, ctx, ctr_128);
 }
 
-#pragma mark - Encryption and Decryption Internal Core
-/*!
-  @brief One round of AES encryption using the round specific key
-
-  Takes the 16 byte data word and encrypts it - dependent on the round - with a specific passed key.
-  It is up to the implementation to ensure that the right key is passed for the correct round. This
-  function is thus "dumb" and does not know what round it is. Also note that the function edits the
-  pointer directly to streamline linking in the overall AES encryption process.
-
-  @warning For the last round, do not use this function use: __gen_aes_encl()
-
-  @param data The pointer to the 16 bytes of data to encrypt
-  @param key The specific key, based on the round, to encrypt with
- */
-static inline void __gen_aes_encs(uint8x16 * data, uint8x16 key) {
-	// process: sub -> shift -> mix -> addrkey
-	uint8_t * raw = data->_;
-	sub_bytes(raw); shift_rows(raw); mix_columns(raw);
-	// addrkey
-	raw[ 0] = raw[ 0] ^ key._[ 0]; raw[ 1] = raw[ 1] ^ key._[ 1]; raw[ 2] = raw[ 2] ^ key._[ 2];
-	raw[ 3] = raw[ 3] ^ key._[ 3]; raw[ 4] = raw[ 4] ^ key._[ 4]; raw[ 5] = raw[ 5] ^ key._[ 5];
-	raw[ 6] = raw[ 6] ^ key._[ 6]; raw[ 7] = raw[ 7] ^ key._[ 7]; raw[ 8] = raw[ 8] ^ key._[ 8];
-	raw[ 9] = raw[ 9] ^ key._[ 9]; raw[10] = raw[10] ^ key._[10]; raw[11] = raw[11] ^ key._[11];
-	raw[12] = raw[12] ^ key._[12]; raw[13] = raw[13] ^ key._[13]; raw[14] = raw[14] ^ key._[14];
-	raw[15] = raw[15] ^ key._[15];
-}
-/*!
- @brief One round of AES decryption using the round specific key
- 
- Takes the 16 byte data word and encrypts it - dependent on the round - with a specific passed key.
- It is up to the implementation to ensure that the right key is passed for the correct round. This
- function is thus "dumb" and does not know what round it is. Also note that the function edits the
- pointer directly to streamline linking in the overall AES encryption process.
- 
- @warning For the last round, do not use this function use: __gen_aes_decf()
- 
- @param data The pointer to the 16 bytes of data to encrypt
- @param key The specific key, based on the round, to encrypt with
- */
-static inline void __gen_aes_decs(uint8x16 * data, uint8x16 key) {
-	// process: xor -> mix -> shift -> sub
-	uint8_t * raw = data->_;
-	// xor
-	raw[ 0] = raw[ 0] ^ key._[ 0]; raw[ 1] = raw[ 1] ^ key._[ 1]; raw[ 2] = raw[ 2] ^ key._[ 2];
-	raw[ 3] = raw[ 3] ^ key._[ 3]; raw[ 4] = raw[ 4] ^ key._[ 4]; raw[ 5] = raw[ 5] ^ key._[ 5];
-	raw[ 6] = raw[ 6] ^ key._[ 6]; raw[ 7] = raw[ 7] ^ key._[ 7]; raw[ 8] = raw[ 8] ^ key._[ 8];
-	raw[ 9] = raw[ 9] ^ key._[ 9]; raw[10] = raw[10] ^ key._[10]; raw[11] = raw[11] ^ key._[11];
-	raw[12] = raw[12] ^ key._[12]; raw[13] = raw[13] ^ key._[13]; raw[14] = raw[14] ^ key._[14];
-	raw[15] = raw[15] ^ key._[15];
-	// mix & shift & sub
-	inv_mix_columns(raw); inv_shift_rows(raw); inv_sub_bytes(raw);
+#pragma mark - CTR Internals
+// the counter block is kept as four host order columns, which is exactly the form the tables work on
+static inline void ctr_increment(uint32_t * counter, AESCounterWidth width) {
+	counter[3] += 1;
+	if (width == ctr_32 || counter[3] != 0) {
+		return;
+	}
+	counter[2] += 1;
+	if (width == ctr_64 || counter[2] != 0) {
+		return;
+	}
+	counter[1] += 1;
+	counter[0] += (counter[1] == 0);
 }
 
-static inline void __gen_aes_decf(uint8x16 * data, uint8x16 key) {
-	// process: xor -> shift -> sub
-	uint8_t * raw = data->_;
+void aes_ctr_gen_counter_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, AESCounterWidth width) {
+	const aes_word * key_sched = (const aes_word *)ctx->enc_schedule;
+	AESKeyMode keymode = ctx->keymode;
+	uint32_t counter[4] = {load_be32(ivec), load_be32(ivec + 4), load_be32(ivec + 8), load_be32(ivec + 12)};
+	uint32_t stream[4];
+	size_t full = mlength / 16;
+	
+	for (size_t i = 0; i < full; i++) {
+		uint8_t * in = inpt + 16 * i, * out = outt + 16 * i;
+		stream[0] = counter[0]; stream[1] = counter[1]; stream[2] = counter[2]; stream[3] = counter[3];
+		ctr_increment(counter, width);
+		gen_encrypt(stream, key_sched, keymode);
+		for (int w = 0; w < 4; w++) {
+			store_be32(out + 4 * w, load_be32(in + 4 * w) ^ stream[w]);
+		}
+	}
 	
+	// partial last block
+	if (mlength % 16) {
+		uint8_t bytes[16];
+		stream[0] = counter[0]; stream[1] = counter[1]; stream[2] = counter[2]; stream[3] = counter[3];
+		gen_encrypt(stream, key_sched, keymode);
+		for (int w = 0; w < 4; w++) {
+			store_be32(bytes + 4 * w, stream[w]);
+		}
+		for (size_t b = full * 16; b < mlength; b++) {
+			outt[b] = inpt[b] ^ bytes[b - full * 16];
+		}
+	}
 }
@@ -24,51 +24,222 @@
 #include "AESCore.h"
 
 #pragma mark - Convenience Definitions
-#if !defined(__arm__) && !defined(__aarch32__) && !defined(__arm64__) && !defined(__aarch64__) && !defined(_M_ARM)
+/*!
+ @typedef aes_word
+ A column of the state or of a round key, interpreted as a big endian 32 bit word. The general c implementation keeps
+ the schedules of an `AESKeyContext` as `aes_word`s, which is why the type may alias the bytes of the context.
+ */
+typedef uint32_t __attribute__((may_alias)) aes_word;
 
-typedef struct uint8x16_t {
-  uint8_t _[16];
-} uint8x16;
+#pragma mark - Key Management Core
+/*!
+  @name Key Management Core
+  General c implementation of the key loading sequence
+ */
+///@{
+/*!
+  @brief Expands a user key into a reusable key context
 
-typedef struct uint8x24_t {
-  uint8_t _[24];
-} uint8x24;
+  Runs the key expansion for the passed key mode once and stores the encryption and decryption schedules inline in
+  the context, so that the key does not have to be expanded again for every message. The round keys are stored as
+  `aes_word`s (the decryption schedule in the equivalent inverse cipher form) which is the form the tables work on.
 
-typedef struct uint8x32_t {
-  uint8_t _[32];
-} uint8x32;
+  @see AESKeyMode for information regarding the modes.
+  @see AESKeyContext for information regarding the context.
 
-typedef struct uint32x2_t {
-  uint32_t _[2];
-} uint32x2;
+  @param ctx The (caller owned) context to fill
+  @param key The user key (`16`, `24`, or `32` bytes depending on the key mode)
+  @param keymode The AES version to use
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2)))
+void aes_gen_key_context_init(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode);
+///@}
 
-typedef struct uint32x4_t {
-  uint32_t _[4];
-} uint32x4;
+#pragma mark - Encryption and Decryption Core
+/*!
+	@name Encryption and Decryption Core
+	The core functions of AES encryption and decryption
+ */
+///@{
+/*!
+ @brief Encrypts the data using AES implemented in general c
+ 
+ Encrypts the data passed with the specified Key Schedule through AES using the key length set. Every round is done
+ with four table lookups per column (T-tables), which combine SubBytes, ShiftRows and MixColumns.
+ 
+ @warning The encryption is done directly on the passed data array which must be 128 bits (16 bytes)
+ 
+ @code
+ uint8_t * fullMessage = ...;
+ uint8_t * userKey = ...; // 128bits using AES-128
+ AESKeyContext ctx;
+ aes_gen_key_context_init(&ctx, userKey, aes_128);
+ // Encrypt the first 16 bytes AES-128
+ aes_gen_enc(fullMessage, (aes_word *)ctx.enc_schedule, aes_128);
+ @endcode
+ 
+ @param data The data to encrypt
+ @param key_schedule The key schedule to use
+ @param keymode The key mode specifying the key schedule length and AES mode
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2)))
+void aes_gen_enc(uint8_t * data, const aes_word * key_schedule, AESKeyMode keymode);
 
-#endif
+/*!
+ @brief Decrypts the data using AES implemented in general c
+ 
+ Decrypts the data passed with the specified Key Schedule through AES using the key length set. Every round is done
+ with four table lookups per column (T-tables), which combine the inverse SubBytes, ShiftRows and MixColumns.
+ 
+ @warning The decryption is done directly on the passed data array which must be 128 bits (16 bytes)
+ 
+ @note The key schedule is the decryption schedule (`dec_schedule` of an `AESKeyContext`) in the equivalent inverse
+ cipher form (see `aes_ni_dec`)
+ 
+ @param data The data to decrypt
+ @param key_schedule The decryption key schedule to use
+ @param keymode The key mode specifying the key schedule length and AES mode
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2)))
+void aes_gen_dec(uint8_t * data, const aes_word * key_schedule, AESKeyMode keymode);
+///@}
 
-#pragma mark - Key Management Internals
+#pragma mark - CBC Core
 /*!
- @group Key Management Internals
+	@name CBC Core
+	The functions related to encrypting and decrypting using the Cipher Block Chain approach.
  */
+///@{
+/*!
+ @brief Encrypts the data using Cipher Block Chain (CBC) AES implemented in general c
+ 
+ Encrypts the passed input data using CBC.
+ 
+ @note CBC requires padding, which this function assumes you have already done
+ @warning The input length <b>must</b> be a multiple of 16 (use padding if necessary) . No checks are run to ensure input, ivec, or epoch key are the correct lengths
+ 
+ @param inpt The data to encrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC
+ @param mlength The length of the input message [in bytes] which is also the output (cipher) message length
+ @param epoch_key The key (either defined by the user or generated by the software) that will be used for the key expansion to make the key schedule
+ @param keymode The AES mode (also defines the key length and number of rounds)
+ 
+ @see https://en.wikipedia.org/wiki/Block_cipher_mode_of_operation#Cipher_Block_Chaining_(CBC)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_cbc_gen_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode);
 
 /*!
- @typedef AESKeyMode
+ @brief Encrypts the data using Cipher Block Chain (CBC) AES with an already expanded key
+ 
+ Same as `aes_cbc_gen_enc` but uses the key schedule of the passed context instead of expanding the key on every call.
+ 
+ @param inpt The data to encrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC
+ @param mlength The length of the input message [in bytes] which is also the output (cipher) message length
+ @param ctx The key context set up with `aes_gen_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_cbc_gen_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Decrypts the data using Cipher Block Chain (CBC) AES implemented in general c
+ 
+ Decrypts the passed input data using CBC.
+ 
+ @note CBC requires padding, which this function assumes you will remove yourself after returning
+ @warning The input length <b>must</b> be a multiple of 16. No checks are run to ensure input, ivec, or epoch key are the correct lengths
+ 
+ @param inpt The data to decrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC decryption
+ @param clength The length of the input cipher [in bytes] which is also the output (message) length
+ @param epoch_key The key (passed by the user) that will be used for the key expansion to make the key schedule to decrypt
+ @param keymode The AES mode (also defines the key length and number of rounds)
+ 
+ @see https://en.wikipedia.org/wiki/Block_cipher_mode_of_operation#Cipher_Block_Chaining_(CBC)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_cbc_gen_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Decrypts the data using Cipher Block Chain (CBC) AES with an already expanded key
+ 
+ Same as `aes_cbc_gen_dec` but uses the key schedule of the passed context instead of expanding the key on every call.
+ 
+ @note The decryption can be done in place (`inpt == outt`)
+ 
+ @param inpt The data to decrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC decryption
+ @param clength The length of the input cipher [in bytes] which is also the output (message) length
+ @param ctx The key context set up with `aes_gen_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_cbc_gen_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx);
+///@}
+
+#pragma mark - CTR Core
+/*!
+	@name CTR Core
+	The functions related to encrypting and decrypting using the CounTeR approach.
+ */
+///@{
+/*!
+ @brief Encrypts or Decrypts the data using Counter Mode (CTR) AES implemented in general c
+ 
+ Encrypts or Decrypts the passed input data using CTR.
+ 
+ @note Due to the nature of CTR, encryption and decryption are the same so that does not have to be specified. If a non encrypted message is passed it will be encrypted, if an encrypted message is passed it will be decrypted
+ @warning No checks are run to ensure input, ivec, or epoch key are the correct lengths
+ 
+ @param inpt The data to decrypt/decrypt using AES and CTR
+ @param outt A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used during the CTR process
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param epoch_key The key (passed by the user) that will be used for the key expansion to make the key schedule to encrypt/decrypt
+ @param keymode The AES mode (also defines the key length and number of rounds)
+ 
+ @see https://en.wikipedia.org/wiki/Block_cipher_mode_of_operation#Counter_(CTR)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_ctr_gen(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Encrypts or Decrypts the data using Counter Mode (CTR) AES with an already expanded key
+ 
+ Same as `aes_ctr_gen` but uses the key schedule of the passed context instead of expanding the key on every call.
+ The full 128 bits of the counter block are incremented (see `aes_ctr_gen_counter_ctx`).
+ 
+ @param inpt The data to decrypt/decrypt using AES and CTR
+ @param outt A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used during the CTR process
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_gen_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_ctr_gen_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts or Decrypts the data using Counter Mode (CTR) AES with a selectable counter width
+ 
+ Same as `aes_ctr_gen_ctx` but only increments the lowest `width` bits of the (big endian) counter block.
  
- @brief An enum setting the key mode.
+ @note The input length does not have to be a multiple of 16, only `mlength` bytes are read and written
  
- This enum allows to set which key mode for AES is being uesd: either 128 bits, 192 bits, or 256 bits. By setting this also the rounds of AES are defined
+ @param inpt The data to decrypt/decrypt using AES and CTR
+ @param outt A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+ @param ivec The initial counter block to be used during the CTR process
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_gen_key_context_init`
+ @param width The amount of low order bits of the counter block which make up the counter
  
- Possible values for the key mode and what it specifies:
- - aes_128: @code AES-128 [key = 128bits, AES rounds = 10] @endcode
- - aes_192: @code AES-192 [key = 192bits, AES rounds = 12] @endcode
- - aes_256: @code AES-256 [key = 256bits, AES rounds = 14] @endcode
+ @see AESCounterWidth for information regarding the widths.
  */
-typedef enum {
-	aes_128 = 10,
-	aes_192 = 12,
-	aes_256 = 14
-} AESKeyMode;
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5)))
+void aes_ctr_gen_counter_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, AESCounterWidth width);
+///@}
 
 #endif /* AESgen_h */
\ No newline at end of file
@@ -0,0 +1,235 @@
+//
+//  AESiov.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden.
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file AESiov.c
+
+ The source file for the scatter-gather CBC, CTR and GCM functions which read and write messages held in chains of
+ non-contiguous buffers (`struct iovec` arrays) without linearizing them
+
+ @compilerflag -fvisibility=hidden
+ @version 0.0.1
+ */
+
+#include <string.h>
+
+#include "AESiov.h"
+#include "AESdispatch.h"
+
+#pragma mark - Internal Core
+/*!
+ @typedef AESIovCursor
+
+ @brief A position in a buffer chain.
+
+ - iov: The buffers
+ - count: The amount of buffers
+ - index: The buffer the position is in
+ - pos: The offset in that buffer
+ */
+typedef struct {
+	const struct iovec * iov;
+	int count;
+	int index;
+	size_t pos;
+} AESIovCursor;
+
+typedef enum {
+	iov_ctr,
+	iov_cbc_enc,
+	iov_cbc_dec
+} AESIovMode;
+
+static unsigned long iov_total(const struct iovec * iov, int count) {
+	unsigned long total = 0;
+	for (int i = 0; i < count; i++) {
+		total += iov[i].iov_len;
+	}
+	return total;
+}
+
+// the bytes left in the current buffer, empty buffers are skipped
+static size_t cursor_avail(AESIovCursor * cursor) {
+	while (cursor->index < cursor->count && cursor->pos == cursor->iov[cursor->index].iov_len) {
+		cursor->index++;
+		cursor->pos = 0;
+	}
+	return cursor->index < cursor->count ? cursor->iov[cursor->index].iov_len - cursor->pos : 0;
+}
+
+static inline uint8_t * cursor_ptr(const AESIovCursor * cursor) {
+	return (uint8_t *)cursor->iov[cursor->index].iov_base + cursor->pos;
+}
+
+// copies `length` bytes between the chain and a flat buffer (across buffer boundaries) and moves the cursor past them
+static void cursor_copy(AESIovCursor * cursor, uint8_t * flat, size_t length, int gather) {
+	while (length) {
+		size_t n = cursor_avail(cursor);
+		if (n > length) {
+			n = length;
+		}
+		if (gather) {
+			memcpy(flat, cursor_ptr(cursor), n);
+		} else {
+			memcpy(cursor_ptr(cursor), flat, n);
+		}
+		cursor->pos += n;
+		flat += n;
+		length -= n;
+	}
+}
+
+// runs the backend over contiguous data and moves the chaining value (counter or IV) past it
+static void iov_run(AESIovMode mode, uint8_t * inpt, uint8_t * outt, uint8_t * chain, unsigned long length, const AESKeyContext * ctx) {
+	uint8_t next[16];
+	switch (mode) {
+		case iov_ctr:
+			aes_ctr_ctx(inpt, outt, chain, length, ctx);
+			aes_ctr_add(chain, length / 16);
+			break;
+		case iov_cbc_enc:
+			aes_cbc_enc_ctx(inpt, outt, chain, length, ctx);
+			memcpy(chain, outt + length - 16, 16);
+			break;
+		case iov_cbc_dec:
+			// the last cipher block is saved first, it may be overwritten in place
+			memcpy(next, inpt + length - 16, 16);
+			aes_cbc_dec_ctx(inpt, outt, chain, length, ctx);
+			memcpy(chain, next, 16);
+			break;
+	}
+}
+
+static unsigned long iov_process(AESIovMode mode, const struct iovec * inpt, int incount, const struct iovec * outt, int outcount, uint8_t * ivec, const AESKeyContext * ctx) {
+	AESIovCursor in = {inpt, incount, 0, 0}, out = {outt, outcount, 0, 0};
+	uint8_t chain[16], block[16];
+	unsigned long total = iov_total(inpt, incount), done = 0;
+	unsigned long outtotal = iov_total(outt, outcount);
+
+	if (outtotal < total) {
+		total = outtotal;
+	}
+	// CBC only processes full blocks, like the backends
+	if (mode != iov_ctr) {
+		total &= ~15UL;
+	}
+	memcpy(chain, ivec, 16);
+
+	while (done < total) {
+		unsigned long run = total - done;
+		size_t inavail = cursor_avail(&in), outavail = cursor_avail(&out);
+		if (inavail < run) {
+			run = inavail;
+		}
+		if (outavail < run) {
+			run = outavail;
+		}
+		run &= ~15UL;
+
+		if (run) {
+			// whole blocks within one input and one output buffer go straight to the backend
+			iov_run(mode, cursor_ptr(&in), cursor_ptr(&out), chain, run, ctx);
+			in.pos += run;
+			out.pos += run;
+		} else {
+			// a block straddling a buffer boundary (or the partial last CTR block) goes through the stack
+			run = total - done < 16 ? total - done : 16;
+			cursor_copy(&in, block, run, 1);
+			iov_run(mode, block, block, chain, run, ctx);
+			cursor_copy(&out, block, run, 0);
+		}
+		done += run;
+	}
+
+	memset(chain, 0, 16);
+	memset(block, 0, 16);
+	return total;
+}
+
+#pragma mark - Scatter-Gather CBC and CTR
+unsigned long aes_ctr_iov_ctx(const struct iovec * inpt, int incount, const struct iovec * outt, int outcount, uint8_t * ivec, const AESKeyContext * ctx) {
+	return iov_process(iov_ctr, inpt, incount, outt, outcount, ivec, ctx);
+}
+
+unsigned long aes_cbc_iov_enc_ctx(const struct iovec * inpt, int incount, const struct iovec * outt, int outcount, uint8_t * ivec, const AESKeyContext * ctx) {
+	return iov_process(iov_cbc_enc, inpt, incount, outt, outcount, ivec, ctx);
+}
+
+unsigned long aes_cbc_iov_dec_ctx(const struct iovec * inpt, int incount, const struct iovec * outt, int outcount, uint8_t * ivec, const AESKeyContext * ctx) {
+	return iov_process(iov_cbc_dec, inpt, incount, outt, outcount, ivec, ctx);
+}
+
+#ifdef intel_active
+#pragma mark - Scatter-Gather GCM
+// feeds the chains to the incremental GCM functions, one update per run within one input and one output buffer
+static unsigned long iov_gcm(AESGCMContext * gcm, int decrypt, const struct iovec * inpt, int incount, const struct iovec * outt, int outcount) {
+	AESIovCursor in = {inpt, incount, 0, 0}, out = {outt, outcount, 0, 0};
+	unsigned long total = iov_total(inpt, incount), done = 0;
+	unsigned long outtotal = iov_total(outt, outcount);
+
+	if (outtotal < total) {
+		total = outtotal;
+	}
+	while (done < total) {
+		unsigned long run = total - done;
+		size_t inavail = cursor_avail(&in), outavail = cursor_avail(&out);
+		if (inavail < run) {
+			run = inavail;
+		}
+		if (outavail < run) {
+			run = outavail;
+		}
+		if (decrypt) {
+			aes_gcm_ni_dec_update(gcm, cursor_ptr(&in), cursor_ptr(&out), run);
+		} else {
+			aes_gcm_ni_enc_update(gcm, cursor_ptr(&in), cursor_ptr(&out), run);
+		}
+		in.pos += run;
+		out.pos += run;
+		done += run;
+	}
+	return total;
+}
+
+unsigned long aes_gcm_ni_iov_enc_ctx(const struct iovec * inpt, int incount, const struct iovec * outt, int outcount, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx) {
+	AESGCMContext gcm;
+	aes_gcm_ni_init(&gcm, ctx, ivec, ivlength);
+	if (alength) {
+		aes_gcm_ni_aad(&gcm, aad, alength);
+	}
+	unsigned long total = iov_gcm(&gcm, 0, inpt, incount, outt, outcount);
+	aes_gcm_ni_enc_final(&gcm, tag, 16);
+	return total;
+}
+
+int aes_gcm_ni_iov_dec_ctx(const struct iovec * inpt, int incount, const struct iovec * outt, int outcount, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx) {
+	AESGCMContext gcm;
+	aes_gcm_ni_init(&gcm, ctx, ivec, ivlength);
+	if (alength) {
+		aes_gcm_ni_aad(&gcm, aad, alength);
+	}
+	unsigned long total = iov_gcm(&gcm, 1, inpt, incount, outt, outcount);
+	if (aes_gcm_ni_dec_final(&gcm, tag, 16)) {
+		return 1;
+	}
+
+	// the plain text of a forged message is not handed out
+	AESIovCursor out = {outt, outcount, 0, 0};
+	while (total) {
+		size_t n = cursor_avail(&out);
+		if (n > total) {
+			n = total;
+		}
+		memset(cursor_ptr(&out), 0, n);
+		out.pos += n;
+		total -= n;
+	}
+	return 0;
+}
+#endif
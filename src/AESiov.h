@@ -0,0 +1,144 @@
+//
+//  AESiov.h
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden
+// * * * * * * * * * * * * * * * * * * * *
+
+/*!
+ @file AESiov.h
+
+ The header file for the scatter-gather CBC, CTR and GCM functions which read and write messages held in chains of
+ non-contiguous buffers (`struct iovec` arrays) without linearizing them
+
+ @version 0.0.1
+ */
+
+#ifndef AESiov_h
+#define AESiov_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "AESCore.h"
+#include "AESni.h"
+
+#pragma mark - Scatter-Gather CBC and CTR
+/*!
+ @name Scatter-Gather CBC and CTR
+ CBC and CTR over `struct iovec` arrays on the active backend
+
+ The input and the output are separate vectors whose buffers may be split at different places. All blocks which lie
+ within one input and one output buffer are passed to the backend directly; only a block which straddles a buffer
+ boundary (of either side) is gathered into a `16` byte stack buffer and scattered back, the message itself is never
+ copied. Empty buffers are skipped. The output may be the same memory as the input (in place), the vectors do not
+ have to be split the same way for this.
+ */
+///@{
+/*!
+ @brief Encrypts or Decrypts the data using CTR AES from one buffer chain into another
+
+ @code
+ struct iovec packet[3] = {{header, 20}, {payload, 1400}, {trailer, 12}};
+ aes_ctr_iov_ctx(packet, 3, packet, 3, iv, &ctx);
+ @endcode
+
+ @param inpt The buffers of the data to encrypt/decrypt
+ @param incount The amount of input buffers
+ @param outt The buffers the encrypted/decrypted data will be written to
+ @param outcount The amount of output buffers
+ @param ivec The `16` byte initial counter block (the full 128 bits are incremented, it is not changed)
+ @param ctx The key context set up with `aes_key_context_init`
+
+ @returns The amount of bytes processed (the smaller of the input and the output length)
+ */
+__attribute__((visibility("hidden"), nonnull(5, 6)))
+unsigned long aes_ctr_iov_ctx(const struct iovec * inpt, int incount, const struct iovec * outt, int outcount, uint8_t * ivec, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts the data using CBC AES from one buffer chain into another
+
+ @param inpt The buffers of the data to encrypt
+ @param incount The amount of input buffers
+ @param outt The buffers the encrypted data will be written to
+ @param outcount The amount of output buffers
+ @param ivec The IV (Initial Vector) to be used for CBC encryption (it is not changed)
+ @param ctx The key context set up with `aes_key_context_init`
+
+ @returns The amount of bytes processed (the smaller of the input and the output length, rounded down to full blocks)
+ */
+__attribute__((visibility("hidden"), nonnull(5, 6)))
+unsigned long aes_cbc_iov_enc_ctx(const struct iovec * inpt, int incount, const struct iovec * outt, int outcount, uint8_t * ivec, const AESKeyContext * ctx);
+
+/*!
+ @brief Decrypts the data using CBC AES from one buffer chain into another
+
+ @param inpt The buffers of the cipher to decrypt
+ @param incount The amount of input buffers
+ @param outt The buffers the decrypted data will be written to
+ @param outcount The amount of output buffers
+ @param ivec The IV (Initial Vector) to be used for CBC decryption (it is not changed)
+ @param ctx The key context set up with `aes_key_context_init`
+
+ @returns The amount of bytes processed (the smaller of the input and the output length, rounded down to full blocks)
+ */
+__attribute__((visibility("hidden"), nonnull(5, 6)))
+unsigned long aes_cbc_iov_dec_ctx(const struct iovec * inpt, int incount, const struct iovec * outt, int outcount, uint8_t * ivec, const AESKeyContext * ctx);
+///@}
+
+#ifdef intel_active
+#pragma mark - Scatter-Gather GCM
+/*!
+ @name Scatter-Gather GCM
+ GCM over `struct iovec` arrays implemented directly on the Intel Chip
+
+ Every run of bytes within one input and one output buffer is one `aes_gcm_ni_enc_update` (`aes_gcm_ni_dec_update`)
+ call, the incremental GCM functions carry a block which straddles a buffer boundary over to the next run.
+ */
+///@{
+/*!
+ @brief Encrypts and authenticates the data using GCM AES from one buffer chain into another
+
+ @param inpt The buffers of the data to encrypt
+ @param incount The amount of input buffers
+ @param outt The buffers the encrypted data will be written to
+ @param outcount The amount of output buffers
+ @param aad The additional authenticated data (may be `NULL` if `alength` is `0`)
+ @param alength The length of the additional authenticated data [in bytes]
+ @param ivec The IV (`12` bytes are recommended)
+ @param ivlength The length of the IV [in bytes]
+ @param tag The location where the `16` byte authentication tag will be written
+ @param ctx The key context set up with `aes_ni_key_context_init`
+
+ @returns The amount of bytes processed (the smaller of the input and the output length)
+ */
+__attribute__((visibility("hidden"), nonnull(7, 9, 10), target("aes,pclmul")))
+unsigned long aes_gcm_ni_iov_enc_ctx(const struct iovec * inpt, int incount, const struct iovec * outt, int outcount, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx);
+
+/*!
+ @brief Verifies and decrypts the data using GCM AES from one buffer chain into another
+
+ If the tag does not match, the written plain text is wiped.
+
+ @param inpt The buffers of the cipher to decrypt
+ @param incount The amount of input buffers
+ @param outt The buffers the decrypted data will be written to
+ @param outcount The amount of output buffers
+ @param aad The additional authenticated data (may be `NULL` if `alength` is `0`)
+ @param alength The length of the additional authenticated data [in bytes]
+ @param ivec The IV the data was encrypted with
+ @param ivlength The length of the IV [in bytes]
+ @param tag The `16` byte authentication tag to check
+ @param ctx The key context set up with `aes_ni_key_context_init`
+
+ @returns `1` if the tag matches (the data is authentic), `0` otherwise
+ */
+__attribute__((visibility("hidden"), nonnull(7, 9, 10), target("aes,pclmul")))
+int aes_gcm_ni_iov_dec_ctx(const struct iovec * inpt, int incount, const struct iovec * outt, int outcount, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx);
+///@}
+#endif
+
+#endif /* AESiov_h */
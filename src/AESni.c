@@ -6,7 +6,7 @@
 //  Copyright © 2018 jniegsch. All rights reserved.
 //
 // * * * * * * * * * * * * * * * * * * * * * * * * * *
-// Compile with -fvisibility=hidden.
+// Compile with -fvisibility=hidden -maes -mpclmul -msse4.1
 // * * * * * * * * * * * * * * * * * * * * * * * * * *
 //
 
@@ -16,31 +16,33 @@
  The source file for the AES encryption (basic as well as CBC and CTR mode) implemented with Intel Intrinsics
  
  @updated 08-23-2018
- @compilerflag -fvisibility=hidden -maes
+ @compilerflag -fvisibility=hidden -maes -mpclmul -msse4.1
  @version 0.0.1
  @author Jan Niegsch
  */
 
 #include "AESni.h"
+#include "AESprobes.h"
 
+#ifdef intel_active
 #pragma mark - Internal Core Definitions
 /*!
  @define keygen_once_128
  Abstracts and cleans the key generation (expansion step) for AES-128 [1 step]
  */
 #define keygen_once_128(i, p, rcon)\
-			*schedule[i] = aes_128_expAssist(*schedule[p], _mm_aeskeygenassist_si128(*schedule[p], rcon))
+			schedule[i] = aes_128_expAssist(schedule[p], _mm_aeskeygenassist_si128(schedule[p], rcon))
 /*!
  @define keygen_three_192
  Abstracts and cleans the key generation (expansion step) for AES-192 [three steps]
  */
 #define keygen_three_192(i, rcon1, rcon2)\
-			*schedule[i] = temp1;\
-			*schedule[i+1] = temp3;\
+			schedule[i] = temp1;\
+			schedule[i+1] = temp3;\
 			temp2 = _mm_aeskeygenassist_si128 (temp3, rcon1);\
 			aes_192_expAssist(&temp1, &temp2, &temp3);\
-			*schedule[i+1] = (__m128i)_mm_shuffle_pd((__m128d)*schedule[i+1], (__m128d)temp1,0);\
-			*schedule[i+2] = (__m128i)_mm_shuffle_pd((__m128d)temp1, (__m128d)temp3, 1);\
+			schedule[i+1] = (__m128i)_mm_shuffle_pd((__m128d)schedule[i+1], (__m128d)temp1,0);\
+			schedule[i+2] = (__m128i)_mm_shuffle_pd((__m128d)temp1, (__m128d)temp3, 1);\
 			temp2 = _mm_aeskeygenassist_si128 (temp3, rcon2);\
 			aes_192_expAssist(&temp1, &temp2, &temp3)
 /*!
@@ -50,22 +52,72 @@
 #define keygen_twice_256(i, rcon)\
 			temp2 = _mm_aeskeygenassist_si128 (temp3, rcon);\
 			aes_256_expAssist1(&temp1, &temp2);\
-			*schedule[i] = temp1;\
+			schedule[i] = temp1;\
 			aes_256_expAssist2(&temp1, &temp3);\
-			*schedule[i+1] = temp3
-
-#pragma mark - Internal Core
-// initializer
-__attribute__((constructor))
-static void initializer(void) {
-	printf("[%s] initialized\n", __FILE__);
-}
-
-// destroctor
-__attribute__((destructor))
-static void finalizer(void) {
-	printf("[%s] finalized\n", __FILE__);
-}
+			schedule[i+1] = temp3
+/*!
+ @define aesenc_8
+ Runs one AES round on eight independent blocks [interleaved to hide the instruction latency]
+ */
+#define aesenc_8(b, key)\
+			b[0] = _mm_aesenc_si128(b[0], key); b[1] = _mm_aesenc_si128(b[1], key);\
+			b[2] = _mm_aesenc_si128(b[2], key); b[3] = _mm_aesenc_si128(b[3], key);\
+			b[4] = _mm_aesenc_si128(b[4], key); b[5] = _mm_aesenc_si128(b[5], key);\
+			b[6] = _mm_aesenc_si128(b[6], key); b[7] = _mm_aesenc_si128(b[7], key)
+/*!
+ @define aesenclast_8
+ Runs the last AES round on eight independent blocks
+ */
+#define aesenclast_8(b, key)\
+			b[0] = _mm_aesenclast_si128(b[0], key); b[1] = _mm_aesenclast_si128(b[1], key);\
+			b[2] = _mm_aesenclast_si128(b[2], key); b[3] = _mm_aesenclast_si128(b[3], key);\
+			b[4] = _mm_aesenclast_si128(b[4], key); b[5] = _mm_aesenclast_si128(b[5], key);\
+			b[6] = _mm_aesenclast_si128(b[6], key); b[7] = _mm_aesenclast_si128(b[7], key)
+/*!
+ @define aesdec_8
+ Runs one AES decryption round on eight independent blocks [interleaved to hide the instruction latency]
+ */
+#define aesdec_8(b, key)\
+			b[0] = _mm_aesdec_si128(b[0], key); b[1] = _mm_aesdec_si128(b[1], key);\
+			b[2] = _mm_aesdec_si128(b[2], key); b[3] = _mm_aesdec_si128(b[3], key);\
+			b[4] = _mm_aesdec_si128(b[4], key); b[5] = _mm_aesdec_si128(b[5], key);\
+			b[6] = _mm_aesdec_si128(b[6], key); b[7] = _mm_aesdec_si128(b[7], key)
+/*!
+ @define aesdeclast_8
+ Runs the last AES decryption round on eight independent blocks
+ */
+#define aesdeclast_8(b, key)\
+			b[0] = _mm_aesdeclast_si128(b[0], key); b[1] = _mm_aesdeclast_si128(b[1], key);\
+			b[2] = _mm_aesdeclast_si128(b[2], key); b[3] = _mm_aesdeclast_si128(b[3], key);\
+			b[4] = _mm_aesdeclast_si128(b[4], key); b[5] = _mm_aesdeclast_si128(b[5], key);\
+			b[6] = _mm_aesdeclast_si128(b[6], key); b[7] = _mm_aesdeclast_si128(b[7], key)
+/*!
+ @define aesenc_8_lanes
+ Runs one AES round on eight independent blocks where each block (lane) uses its own key schedule
+ */
+#define aesenc_8_lanes(b, keys, r)\
+			b[0] = _mm_aesenc_si128(b[0], keys[0][r]); b[1] = _mm_aesenc_si128(b[1], keys[1][r]);\
+			b[2] = _mm_aesenc_si128(b[2], keys[2][r]); b[3] = _mm_aesenc_si128(b[3], keys[3][r]);\
+			b[4] = _mm_aesenc_si128(b[4], keys[4][r]); b[5] = _mm_aesenc_si128(b[5], keys[5][r]);\
+			b[6] = _mm_aesenc_si128(b[6], keys[6][r]); b[7] = _mm_aesenc_si128(b[7], keys[7][r])
+/*!
+ @define aesenclast_8_lanes
+ Runs the last AES round on eight independent blocks where each block (lane) uses its own key schedule
+ */
+#define aesenclast_8_lanes(b, keys, r)\
+			b[0] = _mm_aesenclast_si128(b[0], keys[0][r]); b[1] = _mm_aesenclast_si128(b[1], keys[1][r]);\
+			b[2] = _mm_aesenclast_si128(b[2], keys[2][r]); b[3] = _mm_aesenclast_si128(b[3], keys[3][r]);\
+			b[4] = _mm_aesenclast_si128(b[4], keys[4][r]); b[5] = _mm_aesenclast_si128(b[5], keys[5][r]);\
+			b[6] = _mm_aesenclast_si128(b[6], keys[6][r]); b[7] = _mm_aesenclast_si128(b[7], keys[7][r])
+/*!
+ @define xor_8
+ XORs the same value onto eight blocks
+ */
+#define xor_8(b, key)\
+			b[0] = _mm_xor_si128(b[0], key); b[1] = _mm_xor_si128(b[1], key);\
+			b[2] = _mm_xor_si128(b[2], key); b[3] = _mm_xor_si128(b[3], key);\
+			b[4] = _mm_xor_si128(b[4], key); b[5] = _mm_xor_si128(b[5], key);\
+			b[6] = _mm_xor_si128(b[6], key); b[7] = _mm_xor_si128(b[7], key)
 
 #pragma mark - Key Management 128
 static inline __m128i aes_128_expAssist(__m128i temp1, __m128i temp2) {
@@ -81,8 +133,8 @@ static inline __m128i aes_128_expAssist(__m128i temp1, __m128i temp2) {
 	return temp1;
 }
 
-static void aes_128_key_expansion(__m128i ** schedule, uint8_t * encKey) {
-	*schedule[0] = _mm_loadu_si128((const __m128i *) encKey);
+static void aes_128_key_expansion(__m128i * schedule, uint8_t * encKey) {
+	schedule[0] = _mm_loadu_si128((const __m128i *) encKey);
 	keygen_once_128( 1, 0, 0x01);
 	keygen_once_128( 2, 1, 0x02);
 	keygen_once_128( 3, 2, 0x04);
@@ -112,7 +164,7 @@ static inline void aes_192_expAssist(__m128i * temp1, __m128i * temp2, __m128i *
 	*temp3 = _mm_xor_si128 (*temp3, *temp2);
 }
 
-static void aes_192_key_expansion(__m128i ** schedule, uint8_t * encKey) {
+static void aes_192_key_expansion(__m128i * schedule, uint8_t * encKey) {
 	__m128i temp1, temp2, temp3;
 	
 	temp1 = _mm_loadu_si128((__m128i *)encKey);
@@ -122,7 +174,7 @@ static void aes_192_key_expansion(__m128i ** schedule, uint8_t * encKey) {
 	keygen_three_192(3, 0x04, 0x08);
 	keygen_three_192(6, 0x10, 0x20);
 	keygen_three_192(9, 0x40, 0x80);
-	*schedule[12] = temp1;
+	schedule[12] = temp1;
 	
 }
 #pragma mark - Key Management 256
@@ -151,14 +203,14 @@ static inline void aes_256_expAssist2(__m128i * temp1, __m128i * temp3) {
 	*temp3 = _mm_xor_si128 (*temp3, temp2);
 }
 
-static void aes_256_key_expansion(__m128i ** schedule, uint8_t * encKey) {
+static void aes_256_key_expansion(__m128i * schedule, uint8_t * encKey) {
 	__m128i temp1, temp2, temp3;
 	
 	temp1 = _mm_loadu_si128((__m128i *)encKey);
 	temp3 = _mm_loadu_si128((__m128i *)(encKey + 16));
 	
-	*schedule[0] = temp1;
-	*schedule[1] = temp3;
+	schedule[0] = temp1;
+	schedule[1] = temp3;
 	keygen_twice_256( 2, 0x01);
 	keygen_twice_256( 4, 0x02);
 	keygen_twice_256( 6, 0x04);
@@ -167,23 +219,23 @@ static void aes_256_key_expansion(__m128i ** schedule, uint8_t * encKey) {
 	keygen_twice_256(12, 0x20);
 	temp2 = _mm_aeskeygenassist_si128 (temp3, 0x40);
 	aes_256_expAssist1(&temp1, &temp2);
-	*schedule[14] = temp1;
+	schedule[14] = temp1;
 }
 
 #pragma mark - Key Management Core
-static inline __m128i * load_key_expansion(uint8_t * key, AESKeyMode keymode) {
-	__m128i * keySchedule = malloc((keymode + 1) * sizeof(__m128i));
+static inline void load_key_expansion(__m128i * schedule, uint8_t * key, AESKeyMode keymode) {
+	aes_probe_key_entry(keymode);
 	switch (keymode) {
 		case aes_128:
-			aes_128_key_expansion(&keySchedule, key);
+			aes_128_key_expansion(schedule, key);
 			break;
 			
 		case aes_192:
-			aes_192_key_expansion(&keySchedule, key);
+			aes_192_key_expansion(schedule, key);
 			break;
 			
 		case aes_256:
-			aes_256_key_expansion(&keySchedule, key);
+			aes_256_key_expansion(schedule, key);
 			break;
 			
 		default:
@@ -191,12 +243,26 @@ static inline __m128i * load_key_expansion(uint8_t * key, AESKeyMode keymode) {
 			exit(EXIT_FAILURE);
 			break;
 	}
+	aes_probe_key_return(keymode);
+}
+
+void aes_ni_key_context_init(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode) {
+	__m128i * enc_sched = (__m128i *)ctx->enc_schedule;
+	__m128i * dec_sched = (__m128i *)ctx->dec_schedule;
 	
-	return keySchedule;
+	load_key_expansion(enc_sched, key, keymode);
+	// decryption walks the schedule backwards, the inner round keys are run through inverse mix columns
+	// once here (equivalent inverse cipher) so that aes_ni_dec can use them directly for every block
+	dec_sched[0] = enc_sched[keymode];
+	for (int i = 1; i < (int)keymode; i++) {
+		dec_sched[i] = _mm_aesimc_si128(enc_sched[keymode - i]);
+	}
+	dec_sched[keymode] = enc_sched[0];
+	ctx->keymode = keymode;
 }
 
 #pragma mark - Encryption and Decryption Core
-inline void aes_ni_enc(__m128i * data, __m128i * key_schedule, AESKeyMode keymode) {
+inline __attribute__((always_inline)) void aes_ni_enc(__m128i * data, __m128i * key_schedule, AESKeyMode keymode) {
 	*data = _mm_xor_si128(*data, key_schedule[0]);
 	// unrolled for performance
 	*data = _mm_aesenc_si128(*data, key_schedule[1]);
@@ -219,42 +285,89 @@ inline void aes_ni_enc(__m128i * data, __m128i * key_schedule, AESKeyMode keymod
 	*data = _mm_aesenclast_si128(*data, key_schedule[keymode]);
 }
 
-inline void aes_ni_dec(__m128i * data, __m128i * key_schedule, AESKeyMode keymode) {
-	*data = _mm_xor_si128(*data, key_schedule[keymode]);
+inline __attribute__((always_inline)) void aes_ni_dec(__m128i * data, __m128i * key_schedule, AESKeyMode keymode) {
+	*data = _mm_xor_si128(*data, key_schedule[0]);
 	// unrolled for performance
-	if (keymode > 12) {
-		*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[13]));
-		*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[12]));
+	*data = _mm_aesdec_si128(*data, key_schedule[1]);
+	*data = _mm_aesdec_si128(*data, key_schedule[2]);
+	*data = _mm_aesdec_si128(*data, key_schedule[3]);
+	*data = _mm_aesdec_si128(*data, key_schedule[4]);
+	*data = _mm_aesdec_si128(*data, key_schedule[5]);
+	*data = _mm_aesdec_si128(*data, key_schedule[6]);
+	*data = _mm_aesdec_si128(*data, key_schedule[7]);
+	*data = _mm_aesdec_si128(*data, key_schedule[8]);
+	*data = _mm_aesdec_si128(*data, key_schedule[9]);
+	if (keymode > 10) {
+		*data = _mm_aesdec_si128(*data, key_schedule[10]);
+		*data = _mm_aesdec_si128(*data, key_schedule[11]);
+		if (keymode > 12) {
+			*data = _mm_aesdec_si128(*data, key_schedule[12]);
+			*data = _mm_aesdec_si128(*data, key_schedule[13]);
+		}
 	}
+	*data = _mm_aesdeclast_si128(*data, key_schedule[keymode]);
+}
+
+static inline __attribute__((always_inline)) void aes_ni_enc_8(__m128i * blocks, __m128i * key_schedule, AESKeyMode keymode) {
+	xor_8(blocks, key_schedule[0]);
+	// unrolled for performance
+	aesenc_8(blocks, key_schedule[1]);
+	aesenc_8(blocks, key_schedule[2]);
+	aesenc_8(blocks, key_schedule[3]);
+	aesenc_8(blocks, key_schedule[4]);
+	aesenc_8(blocks, key_schedule[5]);
+	aesenc_8(blocks, key_schedule[6]);
+	aesenc_8(blocks, key_schedule[7]);
+	aesenc_8(blocks, key_schedule[8]);
+	aesenc_8(blocks, key_schedule[9]);
 	if (keymode > 10) {
-		*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[11]));
-		*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[10]));
+		aesenc_8(blocks, key_schedule[10]);
+		aesenc_8(blocks, key_schedule[11]);
+		if (keymode > 12) {
+			aesenc_8(blocks, key_schedule[12]);
+			aesenc_8(blocks, key_schedule[13]);
+		}
 	}
-	*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[9]));
-	*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[8]));
-	*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[7]));
-	*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[6]));
-	*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[5]));
-	*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[4]));
-	*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[3]));
-	*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[2]));
-	*data = _mm_aesdec_si128(*data, _mm_aesimc_si128(key_schedule[1]));
-	*data = _mm_aesdeclast_si128(*data, key_schedule[0]);
+	aesenclast_8(blocks, key_schedule[keymode]);
+}
+
+static inline __attribute__((always_inline)) void aes_ni_dec_8(__m128i * blocks, __m128i * key_schedule, AESKeyMode keymode) {
+	xor_8(blocks, key_schedule[0]);
+	// unrolled for performance
+	aesdec_8(blocks, key_schedule[1]);
+	aesdec_8(blocks, key_schedule[2]);
+	aesdec_8(blocks, key_schedule[3]);
+	aesdec_8(blocks, key_schedule[4]);
+	aesdec_8(blocks, key_schedule[5]);
+	aesdec_8(blocks, key_schedule[6]);
+	aesdec_8(blocks, key_schedule[7]);
+	aesdec_8(blocks, key_schedule[8]);
+	aesdec_8(blocks, key_schedule[9]);
+	if (keymode > 10) {
+		aesdec_8(blocks, key_schedule[10]);
+		aesdec_8(blocks, key_schedule[11]);
+		if (keymode > 12) {
+			aesdec_8(blocks, key_schedule[12]);
+			aesdec_8(blocks, key_schedule[13]);
+		}
+	}
+	aesdeclast_8(blocks, key_schedule[keymode]);
 }
 
 #pragma mark - CBC Core
 void aes_cbc_ni_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_ni_key_context_init(&ctx, epoch_key, keymode);
+	aes_cbc_ni_enc_ctx(inpt, outt, ivec, mlength, &ctx);
+	aes_key_context_clear(&ctx);
+}
+
+static inline __attribute__((always_inline)) void cbc_enc_kernel(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, const AESKeyMode keymode) {
 	__m128i feedback, data;
+	__m128i * key_sched = (__m128i *)ctx->enc_schedule;
 	
-	
-	
-	if (mlength % 16) {
-		mlength = mlength / 16 + 1;
-	} else {
-		mlength /= 16;
-	}
-	
-	__m128i * key_sched = load_key_expansion(epoch_key, keymode);
+	// only full blocks are processed, a trailing partial block is never read or written
+	mlength /= 16;
 	
 	feedback = _mm_loadu_si128((__m128i *)ivec);
 	for (size_t i = 0; i < mlength; i++) {
@@ -265,19 +378,46 @@ void aes_cbc_ni_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned lon
 	}
 }
 
+void aes_cbc_ni_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	aes_probe_cipher_entry("cbc_enc", ctx->keymode, mlength);
+	aes_specialize(ctx->keymode, cbc_enc_kernel, inpt, outt, ivec, mlength, ctx);
+	aes_probe_cipher_return("cbc_enc", ctx->keymode, mlength);
+}
+
 void aes_cbc_ni_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_ni_key_context_init(&ctx, epoch_key, keymode);
+	aes_cbc_ni_dec_ctx(inpt, outt, ivec, clength, &ctx);
+	aes_key_context_clear(&ctx);
+}
+
+static inline __attribute__((always_inline)) void cbc_dec_kernel(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx, const AESKeyMode keymode) {
 	__m128i feedback, data, last_in;
+	__m128i * key_sched = (__m128i *)ctx->dec_schedule;
 	
-	if (clength % 16) {
-		clength = clength / 16 + 1;
-	} else {
-		clength /= 16;
-	}
-	
-	__m128i * key_sched = load_key_expansion(epoch_key, keymode);
+	// only full blocks are processed, a trailing partial block is never read or written
+	clength /= 16;
 	
 	feedback = _mm_loadu_si128((__m128i *) ivec);
-	for (size_t i = 0; i < clength; i++) {
+	size_t i = 0;
+	
+	// eight blocks per iteration, all cipher blocks are loaded before any output is written (in place safe)
+	for (; i + 8 <= clength; i += 8) {
+		__m128i cipher[8], blocks[8];
+		for (int b = 0; b < 8; b++) {
+			cipher[b] = _mm_loadu_si128(&((__m128i *)inpt)[i + b]);
+			blocks[b] = cipher[b];
+		}
+		aes_ni_dec_8(blocks, key_sched, keymode);
+		_mm_storeu_si128(&((__m128i *)outt)[i], _mm_xor_si128(blocks[0], feedback));
+		for (int b = 1; b < 8; b++) {
+			_mm_storeu_si128(&((__m128i *)outt)[i + b], _mm_xor_si128(blocks[b], cipher[b - 1]));
+		}
+		feedback = cipher[7];
+	}
+	
+	// tail [up to seven blocks]
+	for (; i < clength; i++) {
 		last_in = _mm_loadu_si128(&((__m128i *)inpt)[i]);
 		data = last_in;
 		aes_ni_dec(&data, key_sched, keymode);
@@ -287,27 +427,878 @@ void aes_cbc_ni_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned lon
 	}
 }
 
+void aes_cbc_ni_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx) {
+	aes_probe_cipher_entry("cbc_dec", ctx->keymode, clength);
+	aes_specialize(ctx->keymode, cbc_dec_kernel, inpt, outt, ivec, clength, ctx);
+	aes_probe_cipher_return("cbc_dec", ctx->keymode, clength);
+}
+
+#pragma mark - Multi-Buffer CBC Core
+/*!
+ @define MB_LANES
+ The amount of independent messages which are interleaved by the multi-buffer functions
+ */
+#define MB_LANES 8
+
+typedef struct {
+	AESCBCJob * job;
+	__m128i * key_sched;
+	__m128i feedback;
+	size_t block;
+	size_t blocks;
+} mb_lane;
+
+// refills the lane with the next job of the batch, returns 0 if the batch is drained
+static inline int mb_lane_fill(mb_lane * lane, AESCBCJob * jobs, size_t count, size_t * next, AESKeyMode keymode, void (*on_complete)(AESCBCJob * job)) {
+	while (*next < count) {
+		AESCBCJob * job = &jobs[(*next)++];
+		if (job->ctx->keymode != keymode) {
+			fprintf(stderr, "[%s] %s", __FILE__, aes_mb_mode_error());
+			exit(EXIT_FAILURE);
+		}
+		
+		lane->job = job;
+		lane->key_sched = (__m128i *)job->ctx->enc_schedule;
+		lane->feedback = _mm_loadu_si128((__m128i *)job->ivec);
+		lane->block = 0;
+		lane->blocks = job->mlength / 16;
+		job->completed = (lane->blocks == 0);
+		if (!job->completed) {
+			return 1;
+		}
+		// nothing to encrypt
+		if (on_complete) {
+			on_complete(job);
+		}
+	}
+	
+	lane->job = NULL;
+	return 0;
+}
+
+void aes_cbc_ni_enc_mb(AESCBCJob * jobs, size_t count, void (*on_complete)(AESCBCJob * job)) {
+	mb_lane lanes[MB_LANES];
+	__m128i * keys[MB_LANES];
+	__m128i blocks[MB_LANES];
+	size_t next = 0;
+	int active = 0;
+	
+	if (count == 0) {
+		return;
+	}
+	AESKeyMode keymode = jobs[0].ctx->keymode;
+	
+	for (int l = 0; l < MB_LANES; l++) {
+		active += mb_lane_fill(&lanes[l], jobs, count, &next, keymode, on_complete);
+	}
+	
+	// interleave the lanes while more than one of them has work, idle lanes encrypt a dummy block
+	while (active > 1) {
+		for (int l = 0; l < MB_LANES; l++) {
+			if (lanes[l].job) {
+				keys[l] = lanes[l].key_sched;
+				blocks[l] = _mm_xor_si128(_mm_loadu_si128(&((__m128i *)lanes[l].job->inpt)[lanes[l].block]), lanes[l].feedback);
+			} else {
+				keys[l] = (__m128i *)jobs[0].ctx->enc_schedule;
+				blocks[l] = _mm_setzero_si128();
+			}
+			blocks[l] = _mm_xor_si128(blocks[l], keys[l][0]);
+		}
+		
+		for (int r = 1; r < (int)keymode; r++) {
+			aesenc_8_lanes(blocks, keys, r);
+		}
+		aesenclast_8_lanes(blocks, keys, keymode);
+		
+		for (int l = 0; l < MB_LANES; l++) {
+			if (!lanes[l].job) {
+				continue;
+			}
+			_mm_storeu_si128(&((__m128i *)lanes[l].job->outt)[lanes[l].block], blocks[l]);
+			lanes[l].feedback = blocks[l];
+			if (++lanes[l].block == lanes[l].blocks) {
+				lanes[l].job->completed = 1;
+				if (on_complete) {
+					on_complete(lanes[l].job);
+				}
+				active -= 1 - mb_lane_fill(&lanes[l], jobs, count, &next, keymode, on_complete);
+			}
+		}
+	}
+	
+	// a single remaining lane gains nothing from interleaving
+	for (int l = 0; l < MB_LANES && active; l++) {
+		if (!lanes[l].job) {
+			continue;
+		}
+		for (; lanes[l].block < lanes[l].blocks; lanes[l].block++) {
+			lanes[l].feedback = _mm_xor_si128(_mm_loadu_si128(&((__m128i *)lanes[l].job->inpt)[lanes[l].block]), lanes[l].feedback);
+			aes_ni_enc(&lanes[l].feedback, lanes[l].key_sched, keymode);
+			_mm_storeu_si128(&((__m128i *)lanes[l].job->outt)[lanes[l].block], lanes[l].feedback);
+		}
+		lanes[l].job->completed = 1;
+		if (on_complete) {
+			on_complete(lanes[l].job);
+		}
+		active = 0;
+	}
+}
+
 #pragma mark - CTR Core
 void aes_ctr_ni(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode) {
-	__m128i iv, feedback, data, ONE;
+	AESKeyContext ctx;
+	aes_ni_key_context_init(&ctx, epoch_key, keymode);
+	aes_ctr_ni_ctx(inpt, outt, ivec, mlength, &ctx);
+	aes_key_context_clear(&ctx);
+}
+
+void aes_ctr_ni_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	aes_ctr_ni_counter_ctx(inpt, outt, ivec, mlength, ctx, ctr_128);
+}
+
+#pragma mark - CTR Internals
+// the big endian counter block of the two host order halves (see `aes_load_be64`)
+static inline __m128i ctr_block(uint64_t hi, uint64_t lo) {
+	return _mm_set_epi64x((long long)__builtin_bswap64(lo), (long long)__builtin_bswap64(hi));
+}
+
+static inline __attribute__((always_inline)) void ctr_kernel(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, AESCounterWidth width, const AESKeyMode keymode) {
+	__m128i blocks[8], feedback;
+	__m128i * key_sched = (__m128i *)ctx->enc_schedule;
+	uint64_t hi, lo;
+	size_t i = 0, full = mlength / 16;
+	
+	hi = aes_load_be64(ivec);
+	lo = aes_load_be64(ivec + 8);
+	
+	// eight blocks per iteration
+	for (; i + 8 <= full; i += 8) {
+		for (int b = 0; b < 8; b++) {
+			blocks[b] = ctr_block(hi, lo);
+			aes_ctr_increment(&hi, &lo, width);
+		}
+		aes_ni_enc_8(blocks, key_sched, keymode);
+		for (int b = 0; b < 8; b++) {
+			_mm_storeu_si128(&((__m128i *)outt)[i + b], _mm_xor_si128(blocks[b], _mm_loadu_si128(&((__m128i *)inpt)[i + b])));
+		}
+	}
+	
+	// tail [up to seven full blocks]
+	for (; i < full; i++) {
+		feedback = ctr_block(hi, lo);
+		aes_ctr_increment(&hi, &lo, width);
+		aes_ni_enc(&feedback, key_sched, keymode);
+		_mm_storeu_si128(&((__m128i *)outt)[i], _mm_xor_si128(feedback, _mm_loadu_si128(&((__m128i *)inpt)[i])));
+	}
 	
+	// partial last block
 	if (mlength % 16) {
-		mlength = mlength / 16 + 1;
+		uint8_t stream[16];
+		feedback = ctr_block(hi, lo);
+		aes_ni_enc(&feedback, key_sched, keymode);
+		_mm_storeu_si128((__m128i *)stream, feedback);
+		for (size_t b = full * 16; b < mlength; b++) {
+			outt[b] = inpt[b] ^ stream[b - full * 16];
+		}
+	}
+}
+
+void aes_ctr_ni_counter_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, AESCounterWidth width) {
+	aes_probe_cipher_entry("ctr", ctx->keymode, mlength);
+	aes_specialize(ctx->keymode, ctr_kernel, inpt, outt, ivec, mlength, ctx, width);
+	aes_probe_cipher_return("ctr", ctx->keymode, mlength);
+}
+
+#pragma mark - GCM Internals
+/*!
+ @define GCM_MAX_BLOCKS
+ The most blocks one GCM message may hold (the 32 bit counter starts at 2 and must not wrap)
+ */
+#define GCM_MAX_BLOCKS 0xfffffffeULL
+
+// hashes up to eight (reflected) blocks with a single reduction: (X + B0) * H^n + B1 * H^(n-1) + ... + Bn-1 * H
+__attribute__((target("pclmul")))
+static inline __m128i ghash_blocks(const AESGCMContext * gcm, __m128i x, __m128i * blocks, int count) {
+	__m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+	blocks[0] = _mm_xor_si128(blocks[0], x);
+	for (int b = 0; b < count; b++) {
+		ghash_mul_acc(blocks[b], gcm->htable[count - 1 - b], gcm->hkarat[count - 1 - b], &lo, &mid, &hi);
+	}
+	return ghash_reduce(lo, mid, hi);
+}
+
+// hashes the zero padded partial block
+__attribute__((target("pclmul")))
+static inline void gcm_flush_block(AESGCMContext * gcm) {
+	if (gcm->partial) {
+		for (unsigned int b = gcm->partial; b < 16; b++) {
+			gcm->block[b] = 0;
+		}
+		__m128i block = gcm_reflect(_mm_loadu_si128((__m128i *)gcm->block));
+		gcm->hash = ghash_mul(_mm_xor_si128(gcm->hash, block), gcm->htable[0]);
+		gcm->partial = 0;
+	}
+}
+
+static inline __m128i gcm_counter_block(const AESGCMContext * gcm, uint32_t counter) {
+	return _mm_insert_epi32(gcm->j0, (int)__builtin_bswap32(counter), 3);
+}
+
+static inline void gcm_begin_data(AESGCMContext * gcm, unsigned long length) {
+	if (gcm->phase == 0) {
+		gcm_flush_block(gcm);
+		gcm->phase = 1;
+	}
+	if ((gcm->mlength + length + 15) / 16 > GCM_MAX_BLOCKS) {
+		fprintf(stderr, "[%s] %s", __FILE__, aes_gcm_limit_error());
+		exit(EXIT_FAILURE);
+	}
+	gcm->mlength += length;
+}
+
+static void gcm_wipe(AESGCMContext * gcm) {
+	volatile uint8_t * raw = (volatile uint8_t *)gcm;
+	for (size_t i = 0; i < sizeof(AESGCMContext); i++) {
+		raw[i] = 0;
+	}
+}
+
+// encrypts full groups of eight blocks, the AES rounds of a group are interleaved with the GHASH of the previous group
+__attribute__((target("aes,pclmul")))
+static inline __attribute__((always_inline)) void gcm_enc_8_kernel(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, size_t groups, const AESKeyMode keymode) {
+	__m128i blocks[8], cipher[8];
+	__m128i * key_sched = (__m128i *)gcm->ctx->enc_schedule;
+	__m128i x = gcm->hash;
+	
+	for (size_t g = 0; g < groups; g++) {
+		__m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+		for (int b = 0; b < 8; b++) {
+			blocks[b] = gcm_counter_block(gcm, gcm->counter++);
+		}
+		
+		xor_8(blocks, key_sched[0]);
+		if (g) {
+			// one block of the previous group is multiplied per round, the reduction follows the ninth round
+			cipher[0] = _mm_xor_si128(cipher[0], x);
+			for (int r = 1; r <= 8; r++) {
+				aesenc_8(blocks, key_sched[r]);
+				ghash_mul_acc(cipher[r - 1], gcm->htable[8 - r], gcm->hkarat[8 - r], &lo, &mid, &hi);
+			}
+			aesenc_8(blocks, key_sched[9]);
+			x = ghash_reduce(lo, mid, hi);
+		} else {
+			for (int r = 1; r <= 9; r++) {
+				aesenc_8(blocks, key_sched[r]);
+			}
+		}
+		for (int r = 10; r < (int)keymode; r++) {
+			aesenc_8(blocks, key_sched[r]);
+		}
+		aesenclast_8(blocks, key_sched[keymode]);
+		
+		for (int b = 0; b < 8; b++) {
+			blocks[b] = _mm_xor_si128(blocks[b], _mm_loadu_si128(&((__m128i *)inpt)[8 * g + b]));
+			_mm_storeu_si128(&((__m128i *)outt)[8 * g + b], blocks[b]);
+			cipher[b] = gcm_reflect(blocks[b]);
+		}
+	}
+	
+	// the last group has no successor to hide behind
+	gcm->hash = ghash_blocks(gcm, x, cipher, 8);
+}
+
+__attribute__((target("aes,pclmul")))
+static void gcm_enc_8(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, size_t groups) {
+	aes_specialize(gcm->ctx->keymode, gcm_enc_8_kernel, gcm, inpt, outt, groups);
+}
+
+// decrypts full groups of eight blocks, the cipher text is known up front so a group is hashed during its own rounds
+__attribute__((target("aes,pclmul")))
+static inline __attribute__((always_inline)) void gcm_dec_8_kernel(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, size_t groups, const AESKeyMode keymode) {
+	__m128i blocks[8], cipher[8];
+	__m128i * key_sched = (__m128i *)gcm->ctx->enc_schedule;
+	__m128i x = gcm->hash;
+	
+	for (size_t g = 0; g < groups; g++) {
+		__m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+		for (int b = 0; b < 8; b++) {
+			blocks[b] = gcm_counter_block(gcm, gcm->counter++);
+			cipher[b] = gcm_reflect(_mm_loadu_si128(&((__m128i *)inpt)[8 * g + b]));
+		}
+		
+		xor_8(blocks, key_sched[0]);
+		cipher[0] = _mm_xor_si128(cipher[0], x);
+		for (int r = 1; r <= 8; r++) {
+			aesenc_8(blocks, key_sched[r]);
+			ghash_mul_acc(cipher[r - 1], gcm->htable[8 - r], gcm->hkarat[8 - r], &lo, &mid, &hi);
+		}
+		aesenc_8(blocks, key_sched[9]);
+		x = ghash_reduce(lo, mid, hi);
+		for (int r = 10; r < (int)keymode; r++) {
+			aesenc_8(blocks, key_sched[r]);
+		}
+		aesenclast_8(blocks, key_sched[keymode]);
+		
+		// the output is only written after the input of the group was read (in place safe)
+		for (int b = 0; b < 8; b++) {
+			_mm_storeu_si128(&((__m128i *)outt)[8 * g + b], _mm_xor_si128(blocks[b], _mm_loadu_si128(&((__m128i *)inpt)[8 * g + b])));
+		}
+	}
+	
+	gcm->hash = x;
+}
+
+__attribute__((target("aes,pclmul")))
+static void gcm_dec_8(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, size_t groups) {
+	aes_specialize(gcm->ctx->keymode, gcm_dec_8_kernel, gcm, inpt, outt, groups);
+}
+
+// runs a GCM update, `cipher_in` selects whether the input (decryption) or the output (encryption) is hashed
+__attribute__((target("aes,pclmul")))
+static void gcm_update(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, unsigned long length, int cipher_in) {
+	__m128i * key_sched = (__m128i *)gcm->ctx->enc_schedule;
+	AESKeyMode keymode = gcm->ctx->keymode;
+	size_t i = 0;
+	
+	gcm_begin_data(gcm, length);
+	
+	// complete the partial block of the previous call
+	while (gcm->partial && i < length) {
+		uint8_t c = inpt[i];
+		outt[i] = c ^ gcm->stream[gcm->partial];
+		gcm->block[gcm->partial++] = cipher_in ? c : outt[i];
+		i++;
+		if (gcm->partial == 16) {
+			gcm_flush_block(gcm);
+		}
+	}
+	
+	// eight blocks per iteration
+	size_t groups = (length - i) / 128;
+	if (groups) {
+		if (cipher_in) {
+			gcm_dec_8(gcm, inpt + i, outt + i, groups);
+		} else {
+			gcm_enc_8(gcm, inpt + i, outt + i, groups);
+		}
+		i += groups * 128;
+	}
+	
+	// tail [up to seven full blocks] hashed together
+	size_t full = (length - i) / 16;
+	if (full) {
+		__m128i cipher[8], data;
+		for (size_t b = 0; b < full; b++) {
+			__m128i in = _mm_loadu_si128(&((__m128i *)(inpt + i))[b]);
+			data = gcm_counter_block(gcm, gcm->counter++);
+			aes_ni_enc(&data, key_sched, keymode);
+			data = _mm_xor_si128(data, in);
+			cipher[b] = gcm_reflect(cipher_in ? in : data);
+			_mm_storeu_si128(&((__m128i *)(outt + i))[b], data);
+		}
+		gcm->hash = ghash_blocks(gcm, gcm->hash, cipher, (int)full);
+		i += full * 16;
+	}
+	
+	// start a partial block with the rest
+	if (i < length) {
+		__m128i data = gcm_counter_block(gcm, gcm->counter++);
+		aes_ni_enc(&data, key_sched, keymode);
+		_mm_storeu_si128((__m128i *)gcm->stream, data);
+		for (; i < length; i++) {
+			uint8_t c = inpt[i];
+			outt[i] = c ^ gcm->stream[gcm->partial];
+			gcm->block[gcm->partial++] = cipher_in ? c : outt[i];
+		}
+	}
+}
+
+// computes the (unmasked) tag and wipes the message state
+__attribute__((target("aes,pclmul")))
+static void gcm_tag(AESGCMContext * gcm, uint8_t * tag) {
+	gcm_flush_block(gcm);
+	// the length block holds the bit lengths as two big endian 64 bit numbers, reflected they swap places
+	__m128i lengths = _mm_set_epi64x((long long)(gcm->alength * 8), (long long)(gcm->mlength * 8));
+	__m128i x = ghash_mul(_mm_xor_si128(gcm->hash, lengths), gcm->htable[0]);
+	_mm_storeu_si128((__m128i *)tag, _mm_xor_si128(gcm_reflect(x), gcm->tag_mask));
+	gcm_wipe(gcm);
+}
+
+#pragma mark - GCM Core
+void aes_gcm_ni_init(AESGCMContext * gcm, const AESKeyContext * ctx, uint8_t * ivec, unsigned long ivlength) {
+	__m128i * key_sched = (__m128i *)ctx->enc_schedule;
+	__m128i h = _mm_setzero_si128();
+	
+	gcm->ctx = ctx;
+	aes_ni_enc(&h, key_sched, ctx->keymode);
+	gcm->htable[0] = gcm_reflect(h);
+	for (int p = 1; p < 8; p++) {
+		gcm->htable[p] = ghash_mul(gcm->htable[p - 1], gcm->htable[0]);
+	}
+	for (int p = 0; p < 8; p++) {
+		gcm->hkarat[p] = ghash_karatsuba_key(gcm->htable[p]);
+	}
+	
+	// the pre-counter block J0 is the IV with a counter of 1 (96 bit IV) or the GHASH of the IV and its length
+	if (ivlength == 12) {
+		uint8_t j0[16] = {0};
+		for (int b = 0; b < 12; b++) {
+			j0[b] = ivec[b];
+		}
+		j0[15] = 1;
+		gcm->j0 = _mm_loadu_si128((__m128i *)j0);
 	} else {
-		mlength /= 16;
+		gcm->hash = _mm_setzero_si128();
+		gcm->partial = 0;
+		gcm->phase = 0;
+		aes_gcm_ni_aad(gcm, ivec, ivlength);
+		gcm_flush_block(gcm);
+		__m128i lengths = _mm_set_epi64x(0, (long long)((unsigned long long)ivlength * 8));
+		gcm->j0 = gcm_reflect(ghash_mul(_mm_xor_si128(gcm->hash, lengths), gcm->htable[0]));
 	}
+	gcm->counter = (uint32_t)_mm_extract_epi32(gcm->j0, 3);
+	gcm->counter = __builtin_bswap32(gcm->counter);
+	gcm->tag_mask = gcm_counter_block(gcm, gcm->counter++);
+	aes_ni_enc(&gcm->tag_mask, key_sched, ctx->keymode);
 	
-	__m128i * key_sched = load_key_expansion(epoch_key, keymode);
+	gcm->hash = _mm_setzero_si128();
+	gcm->partial = 0;
+	gcm->alength = 0;
+	gcm->mlength = 0;
+	gcm->phase = 0;
+}
+
+void aes_gcm_ni_aad(AESGCMContext * gcm, uint8_t * aad, unsigned long alength) {
+	size_t i = 0;
 	
-	ONE =  _mm_set_epi8(1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0);
+	if (gcm->phase) {
+		fprintf(stderr, "[%s] %s", __FILE__, aes_gcm_order_error());
+		exit(EXIT_FAILURE);
+	}
+	gcm->alength += alength;
 	
-	iv = _mm_loadu_si128((__m128i *) ivec);
-	for (size_t i = 0; i < mlength; i++) {
-		if (i != 0)
-			iv = _mm_add_epi8(iv, ONE);
-		feedback = iv;
-		aes_ni_enc(&feedback, key_sched, keymode);
-		data = _mm_xor_si128(feedback, _mm_loadu_si128(&((__m128i *)inpt)[i]));
-		_mm_storeu_si128(&((__m128i *)outt)[i], data);
+	while (gcm->partial && i < alength) {
+		gcm->block[gcm->partial++] = aad[i++];
+		if (gcm->partial == 16) {
+			gcm_flush_block(gcm);
+		}
+	}
+	
+	__m128i blocks[8];
+	while (alength - i >= 16) {
+		int count = 0;
+		for (; count < 8 && alength - i >= 16; count++, i += 16) {
+			blocks[count] = gcm_reflect(_mm_loadu_si128((__m128i *)(aad + i)));
+		}
+		gcm->hash = ghash_blocks(gcm, gcm->hash, blocks, count);
+	}
+	
+	while (i < alength) {
+		gcm->block[gcm->partial++] = aad[i++];
+	}
+}
+
+void aes_gcm_ni_enc_update(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, unsigned long mlength) {
+	gcm_update(gcm, inpt, outt, mlength, 0);
+}
+
+void aes_gcm_ni_dec_update(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, unsigned long clength) {
+	gcm_update(gcm, inpt, outt, clength, 1);
+}
+
+void aes_gcm_ni_enc_final(AESGCMContext * gcm, uint8_t * tag, unsigned long tlength) {
+	uint8_t full[16];
+	gcm_tag(gcm, full);
+	for (unsigned long b = 0; b < tlength && b < 16; b++) {
+		tag[b] = full[b];
+	}
+}
+
+int aes_gcm_ni_dec_final(AESGCMContext * gcm, const uint8_t * tag, unsigned long tlength) {
+	uint8_t full[16];
+	uint8_t diff = 0;
+	gcm_tag(gcm, full);
+	if (tlength == 0 || tlength > 16) {
+		return 0;
+	}
+	for (unsigned long b = 0; b < tlength; b++) {
+		diff |= full[b] ^ tag[b];
+	}
+	return diff == 0;
+}
+
+void aes_gcm_ni_begin_data(AESGCMContext * gcm, unsigned long length) {
+	gcm_begin_data(gcm, length);
+}
+
+void aes_gcm_ni_enc(uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_ni_key_context_init(&ctx, epoch_key, keymode);
+	aes_gcm_ni_enc_ctx(inpt, outt, mlength, aad, alength, ivec, ivlength, tag, &ctx);
+	aes_key_context_clear(&ctx);
+}
+
+void aes_gcm_ni_enc_ctx(uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx) {
+	aes_probe_cipher_entry("gcm_enc", ctx->keymode, mlength);
+	AESGCMContext gcm;
+	aes_gcm_ni_init(&gcm, ctx, ivec, ivlength);
+	aes_gcm_ni_aad(&gcm, aad, alength);
+	aes_gcm_ni_enc_update(&gcm, inpt, outt, mlength);
+	aes_gcm_ni_enc_final(&gcm, tag, 16);
+	aes_probe_cipher_return("gcm_enc", ctx->keymode, mlength);
+}
+
+int aes_gcm_ni_dec(uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_ni_key_context_init(&ctx, epoch_key, keymode);
+	int authentic = aes_gcm_ni_dec_ctx(inpt, outt, clength, aad, alength, ivec, ivlength, tag, &ctx);
+	aes_key_context_clear(&ctx);
+	return authentic;
+}
+
+int aes_gcm_ni_dec_ctx(uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx) {
+	aes_probe_cipher_entry("gcm_dec", ctx->keymode, clength);
+	AESGCMContext gcm;
+	aes_gcm_ni_init(&gcm, ctx, ivec, ivlength);
+	aes_gcm_ni_aad(&gcm, aad, alength);
+	aes_gcm_ni_dec_update(&gcm, inpt, outt, clength);
+	int authentic = aes_gcm_ni_dec_final(&gcm, tag, 16);
+	if (!authentic) {
+		// never hand out unauthenticated plain text
+		volatile uint8_t * raw = outt;
+		for (unsigned long b = 0; b < clength; b++) {
+			raw[b] = 0;
+		}
+	}
+	aes_probe_cipher_return("gcm_dec", ctx->keymode, clength);
+	return authentic;
+}
+
+#pragma mark - XTS Internals
+// multiplies the tweak by x^8, the byte shifted out at the top is folded back in (carry less times 0x87)
+static inline __m128i xts_mul8(__m128i tweak) {
+	__m128i top = _mm_srli_si128(tweak, 15);
+	top = _mm_xor_si128(_mm_xor_si128(top, _mm_slli_epi16(top, 1)), _mm_xor_si128(_mm_slli_epi16(top, 2), _mm_slli_epi16(top, 7)));
+	return _mm_xor_si128(_mm_slli_si128(tweak, 1), top);
+}
+
+// runs XTS on one data unit, `tweak` is the already encrypted tweak of the first block
+__attribute__((target("aes")))
+static inline __attribute__((always_inline)) void xts_kernel(uint8_t * inpt, uint8_t * outt, __m128i tweak, unsigned long length, const AESKeyContext * ctx, int decrypt, const AESKeyMode keymode) {
+	__m128i tweaks[8], blocks[8];
+	__m128i * key_sched = decrypt ? (__m128i *)ctx->dec_schedule : (__m128i *)ctx->enc_schedule;
+	size_t i = 0, t = 0, full = length / 16;
+	unsigned long rest = length % 16;
+	
+	if (length < 16) {
+		fprintf(stderr, "[%s] %s", __FILE__, aes_xts_length_error());
+		exit(EXIT_FAILURE);
+	}
+	// with ciphertext stealing the last full block is handled together with the partial one
+	size_t bulk = rest ? full - 1 : full;
+	
+	// the tweaks of the first eight blocks are serial, afterwards every tweak is x^8 times the one eight blocks before
+	tweaks[0] = tweak;
+	for (int b = 1; b < 8; b++) {
+		tweaks[b] = xts_double(tweaks[b - 1]);
+	}
+	
+	// eight blocks per iteration
+	for (; i + 8 <= bulk; i += 8) {
+		for (int b = 0; b < 8; b++) {
+			blocks[b] = _mm_xor_si128(_mm_loadu_si128(&((__m128i *)inpt)[i + b]), tweaks[b]);
+		}
+		if (decrypt) {
+			aes_ni_dec_8(blocks, key_sched, keymode);
+		} else {
+			aes_ni_enc_8(blocks, key_sched, keymode);
+		}
+		for (int b = 0; b < 8; b++) {
+			_mm_storeu_si128(&((__m128i *)outt)[i + b], _mm_xor_si128(blocks[b], tweaks[b]));
+			tweaks[b] = xts_mul8(tweaks[b]);
+		}
+	}
+	
+	// tail [up to seven blocks]
+	for (; i < bulk; i++, t++) {
+		blocks[0] = _mm_xor_si128(_mm_loadu_si128(&((__m128i *)inpt)[i]), tweaks[t]);
+		if (decrypt) {
+			aes_ni_dec(&blocks[0], key_sched, keymode);
+		} else {
+			aes_ni_enc(&blocks[0], key_sched, keymode);
+		}
+		_mm_storeu_si128(&((__m128i *)outt)[i], _mm_xor_si128(blocks[0], tweaks[t]));
+	}
+	
+	// ciphertext stealing: the last full block is processed with the tweak of the partial block when decrypting
+	if (rest) {
+		uint8_t stolen[16];
+		__m128i first = tweaks[t];
+		__m128i second = xts_double(first);
+		if (decrypt) {
+			__m128i swap = first;
+			first = second;
+			second = swap;
+		}
+		
+		blocks[0] = _mm_xor_si128(_mm_loadu_si128(&((__m128i *)inpt)[bulk]), first);
+		if (decrypt) {
+			aes_ni_dec(&blocks[0], key_sched, keymode);
+		} else {
+			aes_ni_enc(&blocks[0], key_sched, keymode);
+		}
+		_mm_storeu_si128((__m128i *)stolen, _mm_xor_si128(blocks[0], first));
+		
+		// the partial block takes the head of the processed block and lends it its own bytes (read before written)
+		for (unsigned long b = 0; b < rest; b++) {
+			uint8_t c = inpt[16 * full + b];
+			outt[16 * full + b] = stolen[b];
+			stolen[b] = c;
+		}
+		
+		blocks[0] = _mm_xor_si128(_mm_loadu_si128((__m128i *)stolen), second);
+		if (decrypt) {
+			aes_ni_dec(&blocks[0], key_sched, keymode);
+		} else {
+			aes_ni_enc(&blocks[0], key_sched, keymode);
+		}
+		_mm_storeu_si128(&((__m128i *)outt)[bulk], _mm_xor_si128(blocks[0], second));
+	}
+}
+
+__attribute__((target("aes")))
+static void xts_crypt(uint8_t * inpt, uint8_t * outt, __m128i tweak, unsigned long length, const AESKeyContext * ctx, int decrypt) {
+	aes_specialize(ctx->keymode, xts_kernel, inpt, outt, tweak, length, ctx, decrypt);
+}
+
+// encrypts the tweaks of eight sectors per iteration before running XTS on the sectors
+__attribute__((target("aes")))
+static void xts_sectors(AESXTSSector * sectors, size_t count, unsigned long sector_size, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx, int decrypt) {
+	__m128i tweaks[8];
+	__m128i * tweak_sched = (__m128i *)tweak_ctx->enc_schedule;
+	
+	for (size_t s = 0; s < count; s += 8) {
+		size_t n = count - s < 8 ? count - s : 8;
+		for (size_t b = 0; b < 8; b++) {
+			tweaks[b] = _mm_set_epi64x(0, b < n ? (long long)sectors[s + b].sector : 0);
+		}
+		aes_ni_enc_8(tweaks, tweak_sched, tweak_ctx->keymode);
+		for (size_t b = 0; b < n; b++) {
+			xts_crypt(sectors[s + b].inpt, sectors[s + b].outt, tweaks[b], sector_size, data_ctx, decrypt);
+		}
+	}
+}
+
+#pragma mark - XTS Core
+void aes_xts_ni_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext data_ctx, tweak_ctx;
+	aes_ni_key_context_init(&data_ctx, epoch_key, keymode);
+	aes_ni_key_context_init(&tweak_ctx, epoch_key + 4 * (keymode - 6), keymode);
+	aes_xts_ni_enc_ctx(inpt, outt, ivec, mlength, &data_ctx, &tweak_ctx);
+	aes_key_context_clear(&data_ctx);
+	aes_key_context_clear(&tweak_ctx);
+}
+
+void aes_xts_ni_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx) {
+	aes_probe_cipher_entry("xts_enc", data_ctx->keymode, mlength);
+	__m128i tweak = _mm_loadu_si128((__m128i *)ivec);
+	aes_ni_enc(&tweak, (__m128i *)tweak_ctx->enc_schedule, tweak_ctx->keymode);
+	xts_crypt(inpt, outt, tweak, mlength, data_ctx, 0);
+	aes_probe_cipher_return("xts_enc", data_ctx->keymode, mlength);
+}
+
+void aes_xts_ni_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext data_ctx, tweak_ctx;
+	aes_ni_key_context_init(&data_ctx, epoch_key, keymode);
+	aes_ni_key_context_init(&tweak_ctx, epoch_key + 4 * (keymode - 6), keymode);
+	aes_xts_ni_dec_ctx(inpt, outt, ivec, clength, &data_ctx, &tweak_ctx);
+	aes_key_context_clear(&data_ctx);
+	aes_key_context_clear(&tweak_ctx);
+}
+
+void aes_xts_ni_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx) {
+	aes_probe_cipher_entry("xts_dec", data_ctx->keymode, clength);
+	__m128i tweak = _mm_loadu_si128((__m128i *)ivec);
+	aes_ni_enc(&tweak, (__m128i *)tweak_ctx->enc_schedule, tweak_ctx->keymode);
+	xts_crypt(inpt, outt, tweak, clength, data_ctx, 1);
+	aes_probe_cipher_return("xts_dec", data_ctx->keymode, clength);
+}
+
+void aes_xts_ni_crypt_ctx(uint8_t * inpt, uint8_t * outt, __m128i tweak, unsigned long length, const AESKeyContext * ctx, int decrypt) {
+	xts_crypt(inpt, outt, tweak, length, ctx, decrypt);
+}
+
+void aes_xts_ni_enc_sectors(AESXTSSector * sectors, size_t count, unsigned long sector_size, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx) {
+	aes_probe_cipher_entry("xts_enc", data_ctx->keymode, count * sector_size);
+	xts_sectors(sectors, count, sector_size, data_ctx, tweak_ctx, 0);
+	aes_probe_cipher_return("xts_enc", data_ctx->keymode, count * sector_size);
+}
+
+void aes_xts_ni_dec_sectors(AESXTSSector * sectors, size_t count, unsigned long sector_size, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx) {
+	aes_probe_cipher_entry("xts_dec", data_ctx->keymode, count * sector_size);
+	xts_sectors(sectors, count, sector_size, data_ctx, tweak_ctx, 1);
+	aes_probe_cipher_return("xts_dec", data_ctx->keymode, count * sector_size);
+}
+
+#pragma mark - Small Message Internals
+/*!
+ @define SMALL_LANES
+ The amount of blocks the small message CTR and CBC decryption interleave (enough to hide the latency of `aesenc`
+ without spilling the round keys, which all stay in registers)
+ */
+#define SMALL_LANES 4
+
+// the rounds are a compile time constant in every caller, so the loops unroll and no key mode branch is left
+static inline __attribute__((always_inline)) void small_load_keys(__m128i * keys, const uint8_t (*schedule)[16], const int rounds) {
+#pragma GCC unroll 15
+	for (int r = 0; r <= rounds; r++) {
+		keys[r] = _mm_load_si128((const __m128i *)schedule[r]);
 	}
 }
+
+static inline __attribute__((always_inline)) __m128i small_enc(__m128i block, const __m128i * keys, const int rounds) {
+	block = _mm_xor_si128(block, keys[0]);
+#pragma GCC unroll 14
+	for (int r = 1; r < rounds; r++) {
+		block = _mm_aesenc_si128(block, keys[r]);
+	}
+	return _mm_aesenclast_si128(block, keys[rounds]);
+}
+
+// the round is the outer loop, so the blocks of one round are independent and overlap in the pipeline
+static inline __attribute__((always_inline)) void small_enc_lanes(__m128i * blocks, const __m128i * keys, const int rounds) {
+#pragma GCC unroll 4
+	for (int b = 0; b < SMALL_LANES; b++) {
+		blocks[b] = _mm_xor_si128(blocks[b], keys[0]);
+	}
+#pragma GCC unroll 14
+	for (int r = 1; r < rounds; r++) {
+#pragma GCC unroll 4
+	for (int b = 0; b < SMALL_LANES; b++) {
+			blocks[b] = _mm_aesenc_si128(blocks[b], keys[r]);
+		}
+	}
+#pragma GCC unroll 4
+	for (int b = 0; b < SMALL_LANES; b++) {
+		blocks[b] = _mm_aesenclast_si128(blocks[b], keys[rounds]);
+	}
+}
+
+static inline __attribute__((always_inline)) __m128i small_dec(__m128i block, const __m128i * keys, const int rounds) {
+	block = _mm_xor_si128(block, keys[0]);
+#pragma GCC unroll 14
+	for (int r = 1; r < rounds; r++) {
+		block = _mm_aesdec_si128(block, keys[r]);
+	}
+	return _mm_aesdeclast_si128(block, keys[rounds]);
+}
+
+static inline __attribute__((always_inline)) void small_dec_lanes(__m128i * blocks, const __m128i * keys, const int rounds) {
+#pragma GCC unroll 4
+	for (int b = 0; b < SMALL_LANES; b++) {
+		blocks[b] = _mm_xor_si128(blocks[b], keys[0]);
+	}
+#pragma GCC unroll 14
+	for (int r = 1; r < rounds; r++) {
+#pragma GCC unroll 4
+	for (int b = 0; b < SMALL_LANES; b++) {
+			blocks[b] = _mm_aesdec_si128(blocks[b], keys[r]);
+		}
+	}
+#pragma GCC unroll 4
+	for (int b = 0; b < SMALL_LANES; b++) {
+		blocks[b] = _mm_aesdeclast_si128(blocks[b], keys[rounds]);
+	}
+}
+
+static inline __attribute__((always_inline)) void small_ctr(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, const int rounds) {
+	__m128i keys[AES_MAX_ROUND_KEYS], blocks[SMALL_LANES];
+	uint64_t hi = aes_load_be64(ivec), lo = aes_load_be64(ivec + 8);
+	size_t i = 0, full = mlength / 16;
+
+	small_load_keys(keys, ctx->enc_schedule, rounds);
+	for (; i + SMALL_LANES <= full; i += SMALL_LANES) {
+#pragma GCC unroll 4
+	for (int b = 0; b < SMALL_LANES; b++) {
+			blocks[b] = ctr_block(hi, lo);
+			aes_ctr_increment(&hi, &lo, ctr_128);
+		}
+		small_enc_lanes(blocks, keys, rounds);
+#pragma GCC unroll 4
+	for (int b = 0; b < SMALL_LANES; b++) {
+			_mm_storeu_si128(&((__m128i *)outt)[i + b], _mm_xor_si128(blocks[b], _mm_loadu_si128(&((__m128i *)inpt)[i + b])));
+		}
+	}
+	for (; i < full; i++) {
+		blocks[0] = small_enc(ctr_block(hi, lo), keys, rounds);
+		aes_ctr_increment(&hi, &lo, ctr_128);
+		_mm_storeu_si128(&((__m128i *)outt)[i], _mm_xor_si128(blocks[0], _mm_loadu_si128(&((__m128i *)inpt)[i])));
+	}
+	if (mlength % 16) {
+		uint8_t stream[16];
+		_mm_storeu_si128((__m128i *)stream, small_enc(ctr_block(hi, lo), keys, rounds));
+		for (size_t b = full * 16; b < mlength; b++) {
+			outt[b] = inpt[b] ^ stream[b - full * 16];
+		}
+	}
+}
+
+static inline __attribute__((always_inline)) void small_cbc_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, const int rounds) {
+	__m128i keys[AES_MAX_ROUND_KEYS];
+	__m128i feedback = _mm_loadu_si128((__m128i *)ivec);
+
+	small_load_keys(keys, ctx->enc_schedule, rounds);
+	for (size_t i = 0; i < mlength / 16; i++) {
+		feedback = small_enc(_mm_xor_si128(_mm_loadu_si128(&((__m128i *)inpt)[i]), feedback), keys, rounds);
+		_mm_storeu_si128(&((__m128i *)outt)[i], feedback);
+	}
+}
+
+static inline __attribute__((always_inline)) void small_cbc_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx, const int rounds) {
+	__m128i keys[AES_MAX_ROUND_KEYS], cipher[SMALL_LANES], blocks[SMALL_LANES];
+	__m128i feedback = _mm_loadu_si128((__m128i *)ivec);
+	size_t i = 0, full = clength / 16;
+
+	small_load_keys(keys, ctx->dec_schedule, rounds);
+	// all cipher blocks of a group are loaded before any output is written (in place safe)
+	for (; i + SMALL_LANES <= full; i += SMALL_LANES) {
+#pragma GCC unroll 4
+	for (int b = 0; b < SMALL_LANES; b++) {
+			cipher[b] = _mm_loadu_si128(&((__m128i *)inpt)[i + b]);
+			blocks[b] = cipher[b];
+		}
+		small_dec_lanes(blocks, keys, rounds);
+#pragma GCC unroll 4
+	for (int b = 0; b < SMALL_LANES; b++) {
+			_mm_storeu_si128(&((__m128i *)outt)[i + b], _mm_xor_si128(blocks[b], b ? cipher[b - 1] : feedback));
+		}
+		feedback = cipher[SMALL_LANES - 1];
+	}
+	for (; i < full; i++) {
+		cipher[0] = _mm_loadu_si128(&((__m128i *)inpt)[i]);
+		_mm_storeu_si128(&((__m128i *)outt)[i], _mm_xor_si128(small_dec(cipher[0], keys, rounds), feedback));
+		feedback = cipher[0];
+	}
+}
+
+/*!
+ @define small_entry_points
+ Defines the small message CTR and CBC functions of one key size
+ */
+#define small_entry_points(bits, rounds)\
+			void aes_ctr_ni_##bits##_small_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {\
+				small_ctr(inpt, outt, ivec, mlength, ctx, rounds);\
+			}\
+			void aes_cbc_ni_##bits##_small_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {\
+				small_cbc_enc(inpt, outt, ivec, mlength, ctx, rounds);\
+			}\
+			void aes_cbc_ni_##bits##_small_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx) {\
+				small_cbc_dec(inpt, outt, ivec, clength, ctx, rounds);\
+			}
+
+#pragma mark - Small Message Core
+small_entry_points(128, 10)
+small_entry_points(192, 12)
+small_entry_points(256, 14)
+
+#endif /* protection */
@@ -25,7 +25,8 @@
 		#include <stdlib.h>
 		#include "AESCore.h"
 	#endif
-	# if __has_include(<wmmintrin.h>)
+	// the header exists for other architectures as well (e.g. clang), but may only be used on x86
+	#if __has_include(<wmmintrin.h>) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
 		#include <wmmintrin.h>
 		#include <emmintrin.h>
 		#include <smmintrin.h>
@@ -34,29 +35,141 @@
 #endif
 
 #ifdef intel_active
-#pragma mark - Key Management Internals
+#pragma mark - GCM Definitions
 /*!
- @name Key Management Internals
- Definitions pertaining to the Key Management (expansion)
+ @name GCM Definitions
+ Definitions of the Galois/Counter Mode implementation
  */
 ///@{
 /*!
- @typedef AESKeyMode
- 
- @brief An enum setting the key mode.
- 
- This enum allows to set which key mode for AES is being uesd: either 128 bits, 192 bits, or 256 bits. By setting this also the rounds of AES are defined
- 
- Possible values for the key mode and what it specifies:
- - aes_128: @code AES-128 [key = 128bits, AES rounds = 10] @endcode
- - aes_192: @code AES-192 [key = 192bits, AES rounds = 12] @endcode
- - aes_256: @code AES-256 [key = 256bits, AES rounds = 14] @endcode
+ @typedef AESGCMContext
+
+ @brief The state of one GCM message which is encrypted or decrypted incrementally.
+
+ Set up with `aes_gcm_ni_init` for every message (key and IV), fed with the associated data through `aes_gcm_ni_aad`
+ and with the message through `aes_gcm_ni_enc_update` or `aes_gcm_ni_dec_update` (in pieces of any length), and
+ completed with `aes_gcm_ni_enc_final` or `aes_gcm_ni_dec_final` which also wipe it. All GHASH values are held
+ byte reflected, i.e. in the order `pclmulqdq` multiplies them.
+
+ - htable: The hash key powers H^1 .. H^8
+ - hkarat: The XOR of the two halves of every power (the middle operand of the Karatsuba multiplication)
+ - hash: The GHASH accumulator
+ - j0: The pre-counter block (without the counter)
+ - tag_mask: The encrypted pre-counter block which masks the tag
+ - stream: The key stream of the current partial block
+ - block: The bytes of the current partial block which still have to be hashed
+ - counter: The 32 bit block counter of the next counter block
+ - partial: The amount of bytes of the current partial block which are already used
+ - alength: The length of the associated data [in bytes]
+ - mlength: The length of the message [in bytes]
+ - phase: Whether associated data (`0`) or message data (`1`) is being hashed
+ - ctx: The key context the message is encrypted with
  */
-typedef enum {
-	aes_128 = 10,
-	aes_192 = 12,
-	aes_256 = 14
-} AESKeyMode;
+typedef struct {
+	__m128i htable[8];
+	__m128i hkarat[8];
+	__m128i hash;
+	__m128i j0;
+	__m128i tag_mask;
+	uint8_t stream[16];
+	uint8_t block[16];
+	uint32_t counter;
+	unsigned int partial;
+	unsigned long long alength;
+	unsigned long long mlength;
+	int phase;
+	const AESKeyContext * ctx;
+} AESGCMContext;
+///@}
+
+#pragma mark - GCM and XTS Internals
+/*!
+ @name GCM and XTS Internals
+ The GHASH and tweak arithmetic on single blocks, shared by the AES-NI kernels and the wider ones in `AESvaes.c`
+ */
+///@{
+// GHASH works on bit reflected blocks, reversing the bytes leaves only a shift by one bit to handle the bit order
+static inline __m128i gcm_reflect(__m128i block) {
+	return _mm_shuffle_epi8(block, _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+
+// adds the unreduced (Karatsuba) product x * h onto the three accumulators
+__attribute__((target("pclmul")))
+static inline void ghash_mul_acc(__m128i x, __m128i h, __m128i hk, __m128i * lo, __m128i * mid, __m128i * hi) {
+	*lo = _mm_xor_si128(*lo, _mm_clmulepi64_si128(x, h, 0x00));
+	*hi = _mm_xor_si128(*hi, _mm_clmulepi64_si128(x, h, 0x11));
+	*mid = _mm_xor_si128(*mid, _mm_clmulepi64_si128(_mm_xor_si128(x, _mm_shuffle_epi32(x, 0x4e)), hk, 0x00));
+}
+
+// folds the accumulated products into one 256 bit product, shifts it by one bit and reduces it modulo the GCM polynomial
+static inline __m128i ghash_reduce(__m128i lo, __m128i mid, __m128i hi) {
+	__m128i t1, t2, t3;
+	mid = _mm_xor_si128(mid, _mm_xor_si128(lo, hi));
+	lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+	hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+	
+	// shift the product left by one bit (the bit reflected product is one bit short)
+	t1 = _mm_srli_epi32(lo, 31);
+	t2 = _mm_srli_epi32(hi, 31);
+	lo = _mm_slli_epi32(lo, 1);
+	hi = _mm_slli_epi32(hi, 1);
+	t3 = _mm_srli_si128(t1, 12);
+	t2 = _mm_slli_si128(t2, 4);
+	t1 = _mm_slli_si128(t1, 4);
+	lo = _mm_or_si128(lo, t1);
+	hi = _mm_or_si128(hi, _mm_or_si128(t2, t3));
+	
+	// reduce modulo x^128 + x^7 + x^2 + x + 1
+	t1 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(lo, 31), _mm_slli_epi32(lo, 30)), _mm_slli_epi32(lo, 25));
+	t2 = _mm_srli_si128(t1, 4);
+	lo = _mm_xor_si128(lo, _mm_slli_si128(t1, 12));
+	t3 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(lo, 1), _mm_srli_epi32(lo, 2)), _mm_srli_epi32(lo, 7));
+	lo = _mm_xor_si128(lo, _mm_xor_si128(t3, t2));
+	return _mm_xor_si128(hi, lo);
+}
+
+static inline __m128i ghash_karatsuba_key(__m128i h) {
+	return _mm_xor_si128(h, _mm_shuffle_epi32(h, 0x4e));
+}
+
+__attribute__((target("pclmul")))
+static inline __m128i ghash_mul(__m128i x, __m128i h) {
+	__m128i lo = _mm_setzero_si128(), mid = _mm_setzero_si128(), hi = _mm_setzero_si128();
+	ghash_mul_acc(x, h, ghash_karatsuba_key(h), &lo, &mid, &hi);
+	return ghash_reduce(lo, mid, hi);
+}
+
+// multiplies the (little endian) tweak by x, x^128 = x^7 + x^2 + x + 1
+static inline __m128i xts_double(__m128i tweak) {
+	// the top bit of each half decides what is carried into the other half (1) or folded into the low byte (0x87)
+	__m128i carry = _mm_shuffle_epi32(_mm_srai_epi32(tweak, 31), 0x13);
+	carry = _mm_and_si128(carry, _mm_set_epi32(0, 1, 0, 0x87));
+	return _mm_xor_si128(_mm_add_epi64(tweak, tweak), carry);
+}
+///@}
+
+#pragma mark - Key Management Core
+/*!
+ @name Key Management Core
+ Intel Intrinsic implementation of the key loading sequence
+ */
+///@{
+/*!
+ @brief Expands a user key into a reusable key context
+
+ Runs the key expansion for the passed key mode once and stores the encryption and decryption schedules inline in the
+ context. The context can then be passed to any of the `_ctx` functions for as many messages as needed without
+ paying for the key expansion again.
+
+ @see AESKeyMode for information regarding the modes.
+ @see AESKeyContext for information regarding the context.
+
+ @param ctx The (caller owned) context to fill
+ @param key The user key (`16`, `24`, or `32` bytes depending on the key mode)
+ @param keymode The AES version to use
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2), target("aes")))
+void aes_ni_key_context_init(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode);
 ///@}
 
 #pragma mark - Encryption and Decryption Core
@@ -75,9 +188,10 @@ typedef enum {
  @code
  char * fullMessage = ...;
  uint8_t * userKey = ...; // 128bits using AES-128
- __m128i * keySchedule = loadKeyExpansion(userKey, aes_128);
+ AESKeyContext ctx;
+ aes_ni_key_context_init(&ctx, userKey, aes_128);
  // Encrypt the first 16 bytes AES-128
- aes_ni_enc((__m128i *)fullMessage[0], keySchedule, aes_128);
+ aes_ni_enc((__m128i *)fullMessage, (__m128i *)ctx.enc_schedule, aes_128);
  @endcode
 
  @param data The data to encrypt
@@ -94,16 +208,19 @@ extern inline void aes_ni_enc(__m128i * data, __m128i * key_schedule, AESKeyMode
  
  @warning The decryption is done directly on the passed data array which must be 128 bits (16 bytes)
  
+ @note The key schedule is the decryption schedule (`dec_schedule` of an `AESKeyContext`), which holds the round keys in the order decryption consumes them with the inverse mix columns already applied to the inner round keys (equivalent inverse cipher)
+ 
  @code
  uint8_t * fullCipher = ...;
  uint8_t * userKey = ...; // 128bits using AES-128
- __m128i * keySchedule = loadKeyExpansion(userKey, aes_128);
+ AESKeyContext ctx;
+ aes_ni_key_context_init(&ctx, userKey, aes_128);
  // Decrypt the first 16 bytes AES-128
- aes_ni_dec((__m128i *)fullCipher[0], keySchedule, aes_128);
+ aes_ni_dec((__m128i *)fullCipher, (__m128i *)ctx.dec_schedule, aes_128);
  @endcode
  
  @param data The data to decrypt
- @param key_schedule The key schedule to use
+ @param key_schedule The decryption key schedule to use
  @param keymode The key mode specifying the key schedule length and AES mode
  */
 __attribute__((visibility("hidden"), nonnull(1, 2), target("aes")))
@@ -142,6 +259,20 @@ extern inline void aes_ni_dec(__m128i * data, __m128i * key_schedule, AESKeyMode
 __attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
 void aes_cbc_ni_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode);
 
+/*!
+ @brief Encrypts the data using Cipher Block Chain (CBC) AES with an already expanded key
+ 
+ Same as `aes_cbc_ni_enc` but uses the key schedule of the passed context instead of expanding the key on every call.
+ 
+ @param inpt The data to encrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC
+ @param mlength The length of the input message [in bytes] which is also the output (cipher) message length
+ @param ctx The key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_cbc_ni_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
 /*!
  @brief Decrypts the data using Cipher Block Chain (CBC) AES implemented directly on the Intel Chip
  
@@ -166,6 +297,59 @@ void aes_cbc_ni_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned lon
  */
 __attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
 void aes_cbc_ni_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Decrypts the data using Cipher Block Chain (CBC) AES with an already expanded key
+ 
+ Same as `aes_cbc_ni_dec` but uses the key schedule of the passed context instead of expanding the key on every call.
+ As CBC decryption has no dependency between blocks, eight blocks are decrypted in parallel per iteration.
+ 
+ @note The decryption can be done in place (`inpt == outt`)
+ 
+ @param inpt The data to decrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC decryption
+ @param clength The length of the input cipher [in bytes] which is also the output (message) length
+ @param ctx The key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_cbc_ni_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx);
+///@}
+
+#pragma mark - Multi-Buffer CBC Core
+/*!
+	@name Multi-Buffer CBC Core
+	Encrypting many independent messages using the Cipher Block Chain approach.
+ */
+///@{
+/*!
+ @brief Encrypts a batch of independent messages using CBC AES, interleaving eight messages at a time
+ 
+ CBC encryption of a single message is serial (every block depends on the previous cipher block), so a single
+ message can not keep the AES unit busy. This function runs eight independent messages (lanes) through the rounds
+ together. Whenever the message of a lane is done, the lane is refilled with the next job of the batch, so short
+ messages finish (and are reported) as soon as their last block is written instead of waiting on long ones.
+ 
+ @note CBC requires padding, which this function assumes you have already done
+ @warning All jobs must use a key context of the same key mode (see `AESCBCJob`)
+ 
+ @code
+ AESKeyContext ctx;
+ aes_ni_key_context_init(&ctx, userKey, aes_128);
+ for (size_t i = 0; i < records; i++) {
+	jobs[i] = (AESCBCJob){ msg[i], cipher[i], iv[i], len[i], &ctx, 0, &record[i] };
+ }
+ aes_cbc_ni_enc_mb(jobs, records, record_done);
+ @endcode
+ 
+ @param jobs The jobs to encrypt [processed in order]
+ @param count The number of jobs
+ @param on_complete Called with each job as soon as it is completed (may be `NULL`)
+ 
+ @see https://en.wikipedia.org/wiki/Block_cipher_mode_of_operation#Cipher_Block_Chaining_(CBC)
+ */
+__attribute__((visibility("hidden"), nonnull(1), target("aes")))
+void aes_cbc_ni_enc_mb(AESCBCJob * jobs, size_t count, void (*on_complete)(AESCBCJob * job));
 ///@}
 
 #pragma mark - CTR Core
@@ -198,6 +382,476 @@ void aes_cbc_ni_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned lon
  */
 __attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
 void aes_ctr_ni(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Encrypts or Decrypts the data using Counter Mode (CTR) AES with an already expanded key
+ 
+ Same as `aes_ctr_ni` but uses the key schedule of the passed context instead of expanding the key on every call.
+ The full 128 bits of the counter block are incremented (see `aes_ctr_ni_counter_ctx`).
+ 
+ @param inpt The data to decrypt/decrypt using AES and CTR
+ @param outt A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used during the CTR process
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_ctr_ni_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts or Decrypts the data using Counter Mode (CTR) AES with a selectable counter width
+ 
+ Same as `aes_ctr_ni_ctx` but only increments the lowest `width` bits of the (big endian) counter block. Eight counter
+ blocks are encrypted per iteration with their rounds interleaved to keep the AES unit busy, the remaining blocks are
+ handled one at a time.
+ 
+ @note The input length does not have to be a multiple of 16, only `mlength` bytes are read and written
+ 
+ @param inpt The data to decrypt/decrypt using AES and CTR
+ @param outt A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+ @param ivec The initial counter block to be used during the CTR process
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_ni_key_context_init`
+ @param width The amount of low order bits of the counter block which make up the counter
+ 
+ @see AESCounterWidth for information regarding the widths.
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_ctr_ni_counter_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, AESCounterWidth width);
+///@}
+
+#pragma mark - GCM Core
+/*!
+	@name GCM Core
+	The functions related to authenticated encryption using the Galois/Counter Mode approach.
+ */
+///@{
+/*!
+ @brief Encrypts and authenticates the data using Galois/Counter Mode (GCM) AES implemented directly on the Intel Chip
+
+ Encrypts the passed input data using CTR (with a 32 bit counter) and computes the authentication tag over the
+ associated data and the cipher text. GHASH runs on `pclmulqdq` with the powers H^1 .. H^8 of the hash key, eight
+ blocks are multiplied and summed before a single reduction (aggregated reduction). The AES rounds of every eight
+ counter blocks are interleaved with the GHASH of the previous eight cipher blocks, so the data is only read and
+ written once.
+
+ @note Requires a CPU with AES-NI and PCLMULQDQ (every CPU with AES-NI also supports PCLMULQDQ)
+ @warning Never use the same IV twice with the same key. No checks are run to ensure input, ivec, or epoch key are the correct lengths
+
+ @param inpt The data to encrypt
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param mlength The length of the input message [in bytes] which is also the output (cipher) message length
+ @param aad The additional authenticated data (authenticated, but not encrypted, may be `NULL` if `alength` is `0`)
+ @param alength The length of the additional authenticated data [in bytes]
+ @param ivec The IV (`12` bytes are recommended, any other length is hashed into the pre-counter block)
+ @param ivlength The length of the IV [in bytes]
+ @param tag The location where the `16` byte authentication tag will be written
+ @param epoch_key The key (either defined by the user or generated by the software) that will be used for the key expansion to make the key schedule
+ @param keymode The AES mode (also defines the key length and number of rounds)
+
+ @see https://en.wikipedia.org/wiki/Galois/Counter_Mode
+ */
+__attribute__((visibility("hidden"), nonnull(6, 8, 9), target("aes,pclmul")))
+void aes_gcm_ni_enc(uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Encrypts and authenticates the data using GCM AES with an already expanded key
+
+ Same as `aes_gcm_ni_enc` but uses the key schedule of the passed context instead of expanding the key on every call.
+
+ @param inpt The data to encrypt
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param mlength The length of the input message [in bytes] which is also the output (cipher) message length
+ @param aad The additional authenticated data (may be `NULL` if `alength` is `0`)
+ @param alength The length of the additional authenticated data [in bytes]
+ @param ivec The IV
+ @param ivlength The length of the IV [in bytes]
+ @param tag The location where the `16` byte authentication tag will be written
+ @param ctx The key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(6, 8, 9), target("aes,pclmul")))
+void aes_gcm_ni_enc_ctx(uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx);
+
+/*!
+ @brief Verifies and decrypts the data using Galois/Counter Mode (GCM) AES implemented directly on the Intel Chip
+
+ Decrypts the passed cipher text and checks the authentication tag over the associated data and the cipher text. The
+ GHASH of every eight cipher blocks is interleaved with their AES rounds. The tag is compared in constant time, if it
+ does not match the written plain text is wiped.
+
+ @param inpt The data to decrypt
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param clength The length of the input cipher [in bytes] which is also the output (message) length
+ @param aad The additional authenticated data (may be `NULL` if `alength` is `0`)
+ @param alength The length of the additional authenticated data [in bytes]
+ @param ivec The IV the data was encrypted with
+ @param ivlength The length of the IV [in bytes]
+ @param tag The `16` byte authentication tag to check
+ @param epoch_key The key (passed by the user) that will be used for the key expansion to make the key schedule
+ @param keymode The AES mode (also defines the key length and number of rounds)
+
+ @returns `1` if the tag matches (the data is authentic), `0` otherwise
+
+ @see https://en.wikipedia.org/wiki/Galois/Counter_Mode
+ */
+__attribute__((visibility("hidden"), nonnull(6, 8, 9), target("aes,pclmul")))
+int aes_gcm_ni_dec(uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Verifies and decrypts the data using GCM AES with an already expanded key
+
+ Same as `aes_gcm_ni_dec` but uses the key schedule of the passed context instead of expanding the key on every call.
+
+ @param inpt The data to decrypt
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param clength The length of the input cipher [in bytes] which is also the output (message) length
+ @param aad The additional authenticated data (may be `NULL` if `alength` is `0`)
+ @param alength The length of the additional authenticated data [in bytes]
+ @param ivec The IV the data was encrypted with
+ @param ivlength The length of the IV [in bytes]
+ @param tag The `16` byte authentication tag to check
+ @param ctx The key context set up with `aes_ni_key_context_init`
+
+ @returns `1` if the tag matches (the data is authentic), `0` otherwise
+ */
+__attribute__((visibility("hidden"), nonnull(6, 8, 9), target("aes,pclmul")))
+int aes_gcm_ni_dec_ctx(uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx);
+
+/*!
+ @brief Starts a GCM message
+
+ Derives the hash key and its powers from the key context and the pre-counter block from the IV.
+
+ @code
+ AESGCMContext gcm;
+ aes_gcm_ni_init(&gcm, &ctx, iv, 12);
+ aes_gcm_ni_aad(&gcm, header, header_length);
+ while ((n = read_chunk(chunk, out)) > 0) {
+	aes_gcm_ni_enc_update(&gcm, chunk, out, n);
+ }
+ aes_gcm_ni_enc_final(&gcm, tag, 16);
+ @endcode
+
+ @param gcm The (caller owned) message state to set up
+ @param ctx The key context set up with `aes_ni_key_context_init` (must stay valid until the message is finished)
+ @param ivec The IV
+ @param ivlength The length of the IV [in bytes]
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3), target("aes,pclmul")))
+void aes_gcm_ni_init(AESGCMContext * gcm, const AESKeyContext * ctx, uint8_t * ivec, unsigned long ivlength);
+
+/*!
+ @brief Adds additional authenticated data to a GCM message
+
+ May be called any number of times, but only before the first message data is passed.
+
+ @param gcm The message state
+ @param aad The additional authenticated data
+ @param alength The length of the additional authenticated data [in bytes]
+ */
+__attribute__((visibility("hidden"), nonnull(1), target("aes,pclmul")))
+void aes_gcm_ni_aad(AESGCMContext * gcm, uint8_t * aad, unsigned long alength);
+
+/*!
+ @brief Encrypts the next piece of a GCM message
+
+ The pieces may have any length, a partial block is completed by the next call.
+
+ @note The encryption can be done in place (`inpt == outt`)
+
+ @param gcm The message state
+ @param inpt The data to encrypt
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param mlength The length of the piece [in bytes] which is also the output length
+ */
+__attribute__((visibility("hidden"), nonnull(1), target("aes,pclmul")))
+void aes_gcm_ni_enc_update(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, unsigned long mlength);
+
+/*!
+ @brief Decrypts the next piece of a GCM message
+
+ The pieces may have any length, a partial block is completed by the next call.
+
+ @warning The plain text is not authentic before `aes_gcm_ni_dec_final` returned `1`
+
+ @param gcm The message state
+ @param inpt The data to decrypt
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param clength The length of the piece [in bytes] which is also the output length
+ */
+__attribute__((visibility("hidden"), nonnull(1), target("aes,pclmul")))
+void aes_gcm_ni_dec_update(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, unsigned long clength);
+
+/*!
+ @brief Finishes an encrypted GCM message and writes its authentication tag
+
+ @param gcm The message state (wiped afterwards)
+ @param tag The location where the tag will be written
+ @param tlength The length of the tag [in bytes, at most `16`; NIST SP 800-38D recommends `12` to `16`]
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2), target("aes,pclmul")))
+void aes_gcm_ni_enc_final(AESGCMContext * gcm, uint8_t * tag, unsigned long tlength);
+
+/*!
+ @brief Finishes a decrypted GCM message and checks its authentication tag
+
+ The tag is compared in constant time.
+
+ @param gcm The message state (wiped afterwards)
+ @param tag The authentication tag to check
+ @param tlength The length of the tag [in bytes, at most `16`]
+
+ @returns `1` if the tag matches (the data is authentic), `0` otherwise
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2), target("aes,pclmul")))
+int aes_gcm_ni_dec_final(AESGCMContext * gcm, const uint8_t * tag, unsigned long tlength);
+
+/*!
+ @brief Counts message data which the caller encrypts or decrypts itself
+
+ Closes the associated data (like the first update) and adds `length` bytes to the message length, so the wider
+ kernels (`AESvaes.c`) can run their full groups on the message state directly: they start at `counter` and leave
+ the GHASH of their cipher text in `hash`. Later updates continue after the counted data.
+
+ @param gcm The message state (without a pending partial block of message data)
+ @param length The length of the data the caller processes [in bytes]
+ */
+__attribute__((visibility("hidden"), nonnull(1), target("aes,pclmul")))
+void aes_gcm_ni_begin_data(AESGCMContext * gcm, unsigned long length);
+///@}
+
+#pragma mark - XTS Core
+/*!
+	@name XTS Core
+	The functions related to encrypting and decrypting storage sectors using the XEX Tweaked-codebook with ciphertext Stealing approach.
+ */
+///@{
+/*!
+ @brief Encrypts one data unit using XTS AES implemented directly on the Intel Chip
+
+ Encrypts the passed data unit (e.g. a disk sector) using XTS. The data key encrypts the blocks, the tweak key
+ encrypts the tweak. The tweaks of eight blocks are derived together (every one from the tweak eight blocks before,
+ so they do not depend on each other) and the eight blocks run through the rounds interleaved. A partial last
+ block is handled through ciphertext stealing.
+
+ @warning The length must be at least 16 bytes. No checks are run to ensure input, ivec, or epoch key are the correct lengths
+
+ @param inpt The data to encrypt
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param ivec The `16` byte tweak (IEEE P1619: the sector number as a little endian value)
+ @param mlength The length of the data unit [in bytes] which is also the output length
+ @param epoch_key The data key followed by the tweak key (`32`, `48`, or `64` bytes depending on the key mode)
+ @param keymode The AES mode of both keys (also defines the key length and number of rounds)
+
+ @see https://en.wikipedia.org/wiki/Disk_encryption_theory#XEX-based_tweaked-codebook_mode_with_ciphertext_stealing_(XTS)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_xts_ni_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Encrypts one data unit using XTS AES with already expanded keys
+
+ Same as `aes_xts_ni_enc` but uses the key schedules of the passed contexts instead of expanding the keys on every call.
+
+ @note The encryption can be done in place (`inpt == outt`)
+
+ @param inpt The data to encrypt
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param ivec The `16` byte tweak
+ @param mlength The length of the data unit [in bytes] which is also the output length
+ @param data_ctx The key context of the data key set up with `aes_ni_key_context_init`
+ @param tweak_ctx The key context of the tweak key set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5, 6), target("aes")))
+void aes_xts_ni_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx);
+
+/*!
+ @brief Decrypts one data unit using XTS AES implemented directly on the Intel Chip
+
+ Decrypts the passed data unit using XTS (see `aes_xts_ni_enc`).
+
+ @warning The length must be at least 16 bytes. No checks are run to ensure input, ivec, or epoch key are the correct lengths
+
+ @param inpt The data to decrypt
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param ivec The `16` byte tweak the data unit was encrypted with
+ @param clength The length of the data unit [in bytes] which is also the output length
+ @param epoch_key The data key followed by the tweak key (`32`, `48`, or `64` bytes depending on the key mode)
+ @param keymode The AES mode of both keys (also defines the key length and number of rounds)
+
+ @see https://en.wikipedia.org/wiki/Disk_encryption_theory#XEX-based_tweaked-codebook_mode_with_ciphertext_stealing_(XTS)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_xts_ni_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Decrypts one data unit using XTS AES with already expanded keys
+
+ Same as `aes_xts_ni_dec` but uses the key schedules of the passed contexts instead of expanding the keys on every call.
+
+ @note The decryption can be done in place (`inpt == outt`)
+
+ @param inpt The data to decrypt
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param ivec The `16` byte tweak the data unit was encrypted with
+ @param clength The length of the data unit [in bytes] which is also the output length
+ @param data_ctx The key context of the data key set up with `aes_ni_key_context_init`
+ @param tweak_ctx The key context of the tweak key set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5, 6), target("aes")))
+void aes_xts_ni_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx);
+
+/*!
+ @brief Runs XTS on one data unit (or its rest) from an already encrypted tweak
+
+ The kernel behind `aes_xts_ni_enc_ctx` and `aes_xts_ni_dec_ctx`, the wider kernels (`AESvaes.c`) hand it the blocks
+ after their last full group together with the tweak of the first of them.
+
+ @param inpt The data to encrypt/decrypt
+ @param outt The location where the result will be written
+ @param tweak The encrypted tweak of the first block (multiplied by x for every block before it)
+ @param length The length of the data [in bytes, at least `16`]
+ @param ctx The key context of the data key set up with `aes_ni_key_context_init`
+ @param decrypt `1` to decrypt, `0` to encrypt
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 5), target("aes")))
+void aes_xts_ni_crypt_ctx(uint8_t * inpt, uint8_t * outt, __m128i tweak, unsigned long length, const AESKeyContext * ctx, int decrypt);
+
+/*!
+ @brief Encrypts a batch of sectors using XTS AES
+
+ Encrypts every sector of the batch with the tweak derived from its sector number. The tweaks of eight sectors are
+ encrypted together, so the tweak setup of a sector costs about as much as one data block.
+
+ @code
+ AESKeyContext data_ctx, tweak_ctx;
+ aes_ni_key_context_init(&data_ctx, key, aes_256);
+ aes_ni_key_context_init(&tweak_ctx, key + 32, aes_256);
+ for (size_t i = 0; i < count; i++) {
+	sectors[i] = (AESXTSSector){ image + 4096 * i, out + 4096 * i, first_sector + i };
+ }
+ aes_xts_ni_enc_sectors(sectors, count, 4096, &data_ctx, &tweak_ctx);
+ @endcode
+
+ @param sectors The sectors to encrypt
+ @param count The number of sectors
+ @param sector_size The size of every sector [in bytes, at least `16`]
+ @param data_ctx The key context of the data key set up with `aes_ni_key_context_init`
+ @param tweak_ctx The key context of the tweak key set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 4, 5), target("aes")))
+void aes_xts_ni_enc_sectors(AESXTSSector * sectors, size_t count, unsigned long sector_size, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx);
+
+/*!
+ @brief Decrypts a batch of sectors using XTS AES
+
+ Decrypts every sector of the batch with the tweak derived from its sector number (see `aes_xts_ni_enc_sectors`).
+
+ @param sectors The sectors to decrypt
+ @param count The number of sectors
+ @param sector_size The size of every sector [in bytes, at least `16`]
+ @param data_ctx The key context of the data key set up with `aes_ni_key_context_init`
+ @param tweak_ctx The key context of the tweak key set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 4, 5), target("aes")))
+void aes_xts_ni_dec_sectors(AESXTSSector * sectors, size_t count, unsigned long sector_size, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx);
+///@}
+
+#pragma mark - Small Message Core
+/*!
+	@name Small Message Core
+	CTR and CBC functions specialized per key size for short messages (16 to about 1024 bytes), where the fixed cost of a call outweighs the throughput.
+ */
+///@{
+/*!
+ @brief Encrypts or Decrypts a short message using CTR AES-128 with an already expanded key
+
+ Same result as `aes_ctr_ni_ctx`, but the round count is fixed at compile time: the round keys are loaded into
+ registers once, the rounds are fully unrolled without any key mode branch, and four blocks are interleaved (instead
+ of eight, which would spill the round keys). Nothing is allocated. The `_192_` and `_256_` variants are the same for
+ the other key sizes.
+
+ @code
+ AESKeyContext ctx;
+ aes_ni_key_context_init(&ctx, userKey, aes_128);
+ for (size_t i = 0; i < payloads; i++) {
+	aes_ctr_ni_128_small_ctx(payload[i], out[i], nonce[i], len[i], &ctx);
+ }
+ @endcode
+
+ @warning The key mode of the context must match the function, it is not checked
+
+ @param inpt The data to encrypt/decrypt
+ @param outt A pointer to a `malloc`ed location where the encrypted/decrypted data will be written
+ @param ivec The `16` byte initial counter block (the full 128 bits are incremented)
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The AES-128 key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_ctr_ni_128_small_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+/*!
+ @brief Encrypts or Decrypts a short message using CTR AES-192 (see `aes_ctr_ni_128_small_ctx`)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_ctr_ni_192_small_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+/*!
+ @brief Encrypts or Decrypts a short message using CTR AES-256 (see `aes_ctr_ni_128_small_ctx`)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_ctr_ni_256_small_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts a short message using CBC AES-128 with an already expanded key
+
+ Same result as `aes_cbc_ni_enc_ctx` (only full blocks are processed), specialized like `aes_ctr_ni_128_small_ctx`.
+
+ @warning The key mode of the context must match the function, it is not checked
+
+ @param inpt The data to encrypt
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC
+ @param mlength The length of the input message [in bytes] which is also the output (cipher) message length
+ @param ctx The AES-128 key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_cbc_ni_128_small_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+/*!
+ @brief Encrypts a short message using CBC AES-192 (see `aes_cbc_ni_128_small_enc_ctx`)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_cbc_ni_192_small_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+/*!
+ @brief Encrypts a short message using CBC AES-256 (see `aes_cbc_ni_128_small_enc_ctx`)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_cbc_ni_256_small_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Decrypts a short message using CBC AES-128 with an already expanded key
+
+ Same result as `aes_cbc_ni_dec_ctx` (only full blocks are processed), specialized like `aes_ctr_ni_128_small_ctx`.
+
+ @note The decryption can be done in place (`inpt == outt`)
+ @warning The key mode of the context must match the function, it is not checked
+
+ @param inpt The data to decrypt
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC decryption
+ @param clength The length of the input cipher [in bytes] which is also the output (message) length
+ @param ctx The AES-128 key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_cbc_ni_128_small_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx);
+/*!
+ @brief Decrypts a short message using CBC AES-192 (see `aes_cbc_ni_128_small_dec_ctx`)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_cbc_ni_192_small_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx);
+/*!
+ @brief Decrypts a short message using CBC AES-256 (see `aes_cbc_ni_128_small_dec_ctx`)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes")))
+void aes_cbc_ni_256_small_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx);
 ///@}
 
 #endif /* protection */
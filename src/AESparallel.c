@@ -0,0 +1,380 @@
+//
+//  AESparallel.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -pthread.
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file AESparallel.c
+
+ The source file for the multi-threaded CTR and CBC decryption of very large buffers, split into chunks which run on
+ a persistent work-stealing thread pool
+
+ @compilerflag -fvisibility=hidden -pthread
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "AESparallel.h"
+#include "AESdispatch.h"
+#include "AESstream.h"
+
+#ifdef __SSE2__
+	#include <emmintrin.h>
+#endif
+
+#pragma mark - Internal Core
+/*!
+ @typedef AESPoolQueue
+
+ @brief The chunks one thread still has to process.
+
+ The range `[next, end)` of chunk indices is packed into one word (`next` in the low, `end` in the high 32 bits) so
+ the owner taking the lowest chunk and a thief taking the upper half both change it with a single compare and swap.
+ Every queue has its own cache line, the owners do not slow each other down.
+ */
+typedef struct {
+	uint64_t range __attribute__((aligned(64)));
+} AESPoolQueue;
+
+typedef enum {
+	pool_ctr,
+	pool_ctr_nt,
+	pool_cbc_dec,
+	pool_call
+} AESPoolTask;
+
+struct AESPool {
+	pthread_t * workers;
+	AESPoolQueue * queues;
+	unsigned int threads;
+	unsigned long chunk_size;
+
+	// the call being run, published under `lock` before the generation is bumped
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	unsigned long generation;
+	unsigned int busy;
+	int stop;
+
+	AESPoolTask task;
+	uint8_t * inpt;
+	uint8_t * outt;
+	uint8_t * ivec;
+	uint8_t (* ivecs)[16];
+	unsigned long length;
+	unsigned long chunk;
+	const AESKeyContext * ctx;
+	void (*fn)(void * arg, unsigned long index);
+	void * arg;
+};
+
+typedef struct {
+	AESPool * pool;
+	unsigned int id;
+} AESPoolWorker;
+
+static inline uint64_t range_pack(uint32_t next, uint32_t end) {
+	return ((uint64_t)end << 32) | next;
+}
+
+// takes the lowest chunk of the own queue
+static int queue_pop(AESPoolQueue * queue, uint32_t * index) {
+	uint64_t range = __atomic_load_n(&queue->range, __ATOMIC_ACQUIRE);
+	for (;;) {
+		uint32_t next = (uint32_t)range, end = (uint32_t)(range >> 32);
+		if (next >= end) {
+			return 0;
+		}
+		if (__atomic_compare_exchange_n(&queue->range, &range, range_pack(next + 1, end), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			*index = next;
+			return 1;
+		}
+	}
+}
+
+// moves the upper half (at least one chunk) of the victims queue into the (empty) queue of the thief
+static int queue_steal(AESPoolQueue * victim, AESPoolQueue * thief) {
+	uint64_t range = __atomic_load_n(&victim->range, __ATOMIC_ACQUIRE);
+	for (;;) {
+		uint32_t next = (uint32_t)range, end = (uint32_t)(range >> 32);
+		if (next >= end) {
+			return 0;
+		}
+		uint32_t split = end - (end - next + 1) / 2;
+		if (__atomic_compare_exchange_n(&victim->range, &range, range_pack(next, split), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			__atomic_store_n(&thief->range, range_pack(split, end), __ATOMIC_RELEASE);
+			return 1;
+		}
+	}
+}
+
+/*!
+ @define NT_SLICE
+ The size of the (L1 resident) buffer the key stream of `aes_ctr_parallel_nt_ctx` is produced in before it is streamed out
+ */
+#define NT_SLICE 4096
+
+// CTR through a stack buffer which is copied out with non-temporal stores, the output never enters the cache
+static void ctr_chunk_nt(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long offset, unsigned long length, const AESKeyContext * ctx) {
+	uint8_t slice[NT_SLICE] __attribute__((aligned(16)));
+
+	for (unsigned long done = 0; done < length; done += NT_SLICE) {
+		unsigned long bytes = length - done < NT_SLICE ? length - done : NT_SLICE;
+		aes_ctr_range_ctx(inpt + done, slice, ivec, offset + done, bytes, ctx);
+#ifdef __SSE2__
+		// the streaming stores need an aligned destination, the unaligned head and the partial tail are copied
+		unsigned long b = (16 - ((uintptr_t)(outt + done) & 15)) & 15;
+		if (b > bytes) {
+			b = bytes;
+		}
+		memcpy(outt + done, slice, b);
+		for (; b + 16 <= bytes; b += 16) {
+			_mm_stream_si128((__m128i *)(outt + done + b), _mm_loadu_si128((__m128i *)(slice + b)));
+		}
+		memcpy(outt + done + b, slice + b, bytes - b);
+#else
+		memcpy(outt + done, slice, bytes);
+#endif
+	}
+#ifdef __SSE2__
+	_mm_sfence();
+#endif
+	memset(slice, 0, sizeof(slice));
+}
+
+static void run_chunk(AESPool * pool, uint32_t index) {
+	unsigned long offset = (unsigned long)index * pool->chunk;
+	unsigned long length = pool->length - offset < pool->chunk ? pool->length - offset : pool->chunk;
+
+	switch (pool->task) {
+		case pool_call:
+			pool->fn(pool->arg, index);
+			break;
+		case pool_ctr:
+			aes_ctr_range_ctx(pool->inpt + offset, pool->outt + offset, pool->ivec, offset, length, pool->ctx);
+			break;
+		case pool_ctr_nt:
+			ctr_chunk_nt(pool->inpt + offset, pool->outt + offset, pool->ivec, offset, length, pool->ctx);
+			break;
+		case pool_cbc_dec:
+			aes_cbc_dec_ctx(pool->inpt + offset, pool->outt + offset, pool->ivecs[index], length, pool->ctx);
+			break;
+	}
+}
+
+// processes the own chunks, then steals from the other threads until every queue is empty
+static void pool_work(AESPool * pool, unsigned int id) {
+	AESPoolQueue * own = &pool->queues[id];
+	uint32_t index;
+
+	for (;;) {
+		while (queue_pop(own, &index)) {
+			run_chunk(pool, index);
+		}
+		unsigned int v = 1;
+		for (; v < pool->threads; v++) {
+			if (queue_steal(&pool->queues[(id + v) % pool->threads], own)) {
+				break;
+			}
+		}
+		if (v == pool->threads) {
+			return;
+		}
+	}
+}
+
+static void * pool_worker(void * arg) {
+	AESPoolWorker * worker = (AESPoolWorker *)arg;
+	AESPool * pool = worker->pool;
+	unsigned int id = worker->id;
+	unsigned long seen = 0;
+	free(worker);
+
+	for (;;) {
+		pthread_mutex_lock(&pool->lock);
+		while (!pool->stop && pool->generation == seen) {
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		}
+		if (pool->stop) {
+			pthread_mutex_unlock(&pool->lock);
+			return NULL;
+		}
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->lock);
+
+		pool_work(pool, id);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->busy == 0) {
+			pthread_cond_signal(&pool->done);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+static void pool_fail(void) {
+	fprintf(stderr, "[%s] %s", __FILE__, aes_pool_error());
+	exit(EXIT_FAILURE);
+}
+
+// runs the chunks `[0, chunks)` of the task set up in the pool
+static void pool_start(AESPool * pool, uint32_t chunks) {
+	// a single chunk (or thread) is not worth waking anyone up for
+	if (chunks <= 1 || pool->threads == 1) {
+		for (uint32_t c = 0; c < chunks; c++) {
+			run_chunk(pool, c);
+		}
+		return;
+	}
+
+	// every thread starts with an equal, contiguous share
+	for (unsigned int t = 0; t < pool->threads; t++) {
+		uint32_t first = (uint32_t)((uint64_t)chunks * t / pool->threads);
+		uint32_t last = (uint32_t)((uint64_t)chunks * (t + 1) / pool->threads);
+		__atomic_store_n(&pool->queues[t].range, range_pack(first, last), __ATOMIC_RELAXED);
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	pool->busy = pool->threads - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	// the calling thread is worker 0
+	pool_work(pool, 0);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->busy) {
+		pthread_cond_wait(&pool->done, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void pool_run(AESPool * pool, AESPoolTask task, uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long length, const AESKeyContext * ctx) {
+	unsigned long chunk = pool->chunk_size;
+
+	// the chunk indices are 32 bit, absurdly small chunks of a huge buffer are grown to fit
+	while ((length + chunk - 1) / chunk > UINT32_MAX) {
+		chunk *= 2;
+	}
+
+	pool->task = task;
+	pool->inpt = inpt;
+	pool->outt = outt;
+	pool->ivec = ivec;
+	pool->length = length;
+	pool->chunk = chunk;
+	pool->ctx = ctx;
+	uint32_t chunks = (uint32_t)((length + chunk - 1) / chunk);
+
+	if (task == pool_cbc_dec && chunks) {
+		// the IV of a chunk is the last cipher block of the chunk before it, decrypted in place that block may already
+		// be overwritten by the time the chunk runs, so all of them are taken before any chunk starts
+		pool->ivecs = malloc((size_t)chunks * 16);
+		if (!pool->ivecs) {
+			// without room for the IVs the buffer is still decrypted, just on the calling thread
+			uint8_t first[16];
+			memcpy(first, ivec, 16);
+			aes_cbc_dec_ctx(inpt, outt, first, length, ctx);
+			return;
+		}
+		memcpy(pool->ivecs[0], ivec, 16);
+		for (uint32_t c = 1; c < chunks; c++) {
+			memcpy(pool->ivecs[c], inpt + (unsigned long)c * chunk - 16, 16);
+		}
+	}
+
+	pool_start(pool, chunks);
+	free(pool->ivecs);
+	pool->ivecs = NULL;
+}
+
+#pragma mark - Thread Pool
+AESPool * aes_pool_create(unsigned int threads, unsigned long chunk_size) {
+	if (!threads) {
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = online > 0 ? (unsigned int)online : 1;
+	}
+	chunk_size &= ~15UL;
+	if (!chunk_size) {
+		chunk_size = AES_POOL_CHUNK_SIZE;
+	}
+
+	AESPool * pool = calloc(1, sizeof(AESPool));
+	if (!pool) {
+		pool_fail();
+	}
+	pool->threads = threads;
+	pool->chunk_size = chunk_size;
+	pool->workers = calloc(threads, sizeof(pthread_t));
+	if (!pool->workers || posix_memalign((void **)&pool->queues, 64, threads * sizeof(AESPoolQueue))) {
+		pool_fail();
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	// worker 0 is the calling thread, only the others are started
+	for (unsigned int t = 1; t < threads; t++) {
+		AESPoolWorker * worker = malloc(sizeof(AESPoolWorker));
+		if (!worker) {
+			pool_fail();
+		}
+		worker->pool = pool;
+		worker->id = t;
+		if (pthread_create(&pool->workers[t], NULL, pool_worker, worker)) {
+			pool_fail();
+		}
+	}
+	return pool;
+}
+
+void aes_pool_destroy(AESPool * pool) {
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (unsigned int t = 1; t < pool->threads; t++) {
+		pthread_join(pool->workers[t], NULL);
+	}
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->queues);
+	free(pool->workers);
+	free(pool);
+}
+
+unsigned int aes_pool_threads(const AESPool * pool) {
+	return pool->threads;
+}
+
+void aes_pool_for_each(AESPool * pool, uint32_t count, void (*fn)(void * arg, unsigned long index), void * arg) {
+	pool->task = pool_call;
+	pool->fn = fn;
+	pool->arg = arg;
+	pool_start(pool, count);
+}
+
+#pragma mark - Parallel CTR and CBC
+void aes_ctr_parallel_ctx(AESPool * pool, uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	pool_run(pool, pool_ctr, inpt, outt, ivec, mlength, ctx);
+}
+
+void aes_ctr_parallel_nt_ctx(AESPool * pool, uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	pool_run(pool, pool_ctr_nt, inpt, outt, ivec, mlength, ctx);
+}
+
+void aes_cbc_parallel_dec_ctx(AESPool * pool, uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx) {
+	// only full blocks are processed, like the backends do
+	pool_run(pool, pool_cbc_dec, inpt, outt, ivec, clength & ~15UL, ctx);
+}
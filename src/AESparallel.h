@@ -0,0 +1,163 @@
+//
+//  AESparallel.h
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -pthread
+// * * * * * * * * * * * * * * * * * * * *
+
+/*!
+ @file AESparallel.h
+
+ The header file for the multi-threaded CTR and CBC decryption of very large buffers, split into chunks which run on
+ a persistent work-stealing thread pool
+
+ @version 0.0.1
+ */
+
+#ifndef AESparallel_h
+#define AESparallel_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "AESCore.h"
+
+#pragma mark - Convenience Definitions
+/*!
+ @define AES_POOL_CHUNK_SIZE
+ The default chunk size [in bytes], small enough that the input and output of a chunk stay in the L2 cache
+ */
+#define AES_POOL_CHUNK_SIZE (64 * 1024)
+
+#pragma mark - Thread Pool
+/*!
+ @name Thread Pool
+ The persistent threads the parallel functions run on
+ */
+///@{
+/*!
+ @typedef AESPool
+
+ @brief A persistent pool of worker threads.
+
+ The threads are started once and sleep between calls. Every call splits its buffer into chunks of the configured
+ size and hands every thread an equal, contiguous share of them. A thread which runs out of chunks steals the upper
+ half of the remaining chunks of another thread, so slow or descheduled threads do not hold up the call. The calling
+ thread works on the chunks as well.
+
+ @warning A pool runs one call at a time, calls from several threads must be serialized by the caller
+ */
+typedef struct AESPool AESPool;
+
+/*!
+ @brief Starts a thread pool
+
+ @param threads The amount of threads working on a call including the calling thread (`0` for one per online CPU)
+ @param chunk_size The size of the chunks [in bytes, rounded down to a multiple of 16] (`0` for `AES_POOL_CHUNK_SIZE`)
+
+ @returns The pool, exits with `aes_pool_error` if the threads could not be started
+ */
+__attribute__((visibility("hidden")))
+AESPool * aes_pool_create(unsigned int threads, unsigned long chunk_size);
+
+/*!
+ @brief Stops the threads of a pool and frees it
+
+ @param pool The pool to stop
+ */
+__attribute__((visibility("hidden"), nonnull(1)))
+void aes_pool_destroy(AESPool * pool);
+
+/*!
+ @brief Returns the amount of threads working on a call (including the calling thread)
+
+ @param pool The pool
+
+ @returns The amount of threads
+ */
+__attribute__((visibility("hidden"), nonnull(1)))
+unsigned int aes_pool_threads(const AESPool * pool);
+
+/*!
+ @brief Runs a function for every index on all threads of the pool
+
+ The indices are distributed and stolen like the chunks of the cipher functions, every index is passed to exactly one
+ call of `fn`. Returns once all calls returned. This is the hook for work which does not map onto one contiguous
+ buffer (e.g. the chunks of a container, which each need their own IV and tag).
+
+ @param pool The pool to run on
+ @param count The amount of indices (`fn` is called for `0` to `count - 1`)
+ @param fn The function to run, called from several threads at once
+ @param arg Passed to every call of `fn`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 3)))
+void aes_pool_for_each(AESPool * pool, uint32_t count, void (*fn)(void * arg, unsigned long index), void * arg);
+///@}
+
+#pragma mark - Parallel CTR and CBC
+/*!
+ @name Parallel CTR and CBC
+ Chunk parallel CTR and CBC decryption on the active backend
+ */
+///@{
+/*!
+ @brief Encrypts or Decrypts the data using CTR AES on all threads of the pool
+
+ The counter block of every chunk is computed from its offset (see `aes_ctr_range_ctx`), so the chunks do not depend
+ on each other. The result is the same as the one of `aes_ctr_ctx`.
+
+ @note The data can be processed in place (`inpt == outt`)
+
+ @param pool The pool to run on
+ @param inpt The data to encrypt/decrypt
+ @param outt A pointer to a `malloc`ed location where the encrypted/decrypted data will be written
+ @param ivec The `16` byte initial counter block (the full 128 bits are incremented)
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 4, 6)))
+void aes_ctr_parallel_ctx(AESPool * pool, uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts or Decrypts the data using CTR AES on all threads of the pool, bypassing the cache for the output
+
+ Same as `aes_ctr_parallel_ctx`, but the key stream is produced in a small buffer on the stack and written out with
+ non-temporal (streaming) stores on x86. For outputs larger than the last level cache this avoids reading every
+ destination line before it is overwritten and keeps the output from evicting the input. For outputs which fit in
+ the cache, or which are read again right away, use `aes_ctr_parallel_ctx`.
+
+ @note The data can be processed in place (`inpt == outt`)
+
+ @param pool The pool to run on
+ @param inpt The data to encrypt/decrypt
+ @param outt A pointer to a `malloc`ed (or mapped) location where the encrypted/decrypted data will be written
+ @param ivec The `16` byte initial counter block (the full 128 bits are incremented)
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 4, 6)))
+void aes_ctr_parallel_nt_ctx(AESPool * pool, uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Decrypts the data using CBC AES on all threads of the pool
+
+ The IV of every chunk is the last cipher block of the chunk before it, so the chunks do not depend on each other.
+ The result is the same as the one of `aes_cbc_dec_ctx`.
+
+ @note The decryption can be done in place (`inpt == outt`), the IVs of the chunks are copied before any chunk is
+ decrypted
+
+ @param pool The pool to run on
+ @param inpt The data to decrypt
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC decryption
+ @param clength The length of the input cipher [in bytes, a multiple of 16] which is also the output length
+ @param ctx The key context set up with `aes_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 4, 6)))
+void aes_cbc_parallel_dec_ctx(AESPool * pool, uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx);
+///@}
+
+#endif /* AESparallel_h */
@@ -0,0 +1,64 @@
+//
+//  AESprobes.h
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * *
+// Compile with -DSIMPLECRYPT_NO_PROBES to leave the probes out
+// * * * * * * * * * * * * * * * * * * * *
+
+/*!
+ @file AESprobes.h
+
+ The static tracepoints (USDT, provider `simplecrypt`) on the key setup and the bulk mode functions, so `perf` or
+ `bpftrace` can be attached to a running process without rebuilding it
+
+ An unattached probe is a single `nop` in the code plus a note in the ELF file. Without `<sys/sdt.h>` (systemtap sdt
+ headers) or with `SIMPLECRYPT_NO_PROBES` defined the probes compile to nothing.
+
+ Probes and their arguments:
+ - key_entry, key_return: @code key size [bits] @endcode
+ - cipher_entry, cipher_return: @code mode (string, e.g. "cbc_dec"), key size [bits], length [bytes] @endcode
+
+ @code
+ perf list 'sdt_simplecrypt:*'                        # after perf buildid-cache --add <binary>
+ bpftrace -p <pid> tools/bpftrace/cipher_latency.bt   # per mode latency histograms
+ @endcode
+
+ @version 0.0.1
+ */
+
+#ifndef AESprobes_h
+#define AESprobes_h
+
+#include "AESCore.h"
+
+#if !defined(SIMPLECRYPT_NO_PROBES) && defined(__has_include)
+	#if __has_include(<sys/sdt.h>)
+		#include <sys/sdt.h>
+		#define probes_active
+	#endif
+#endif
+
+/*!
+ @define aes_probe_bits
+ The key size [in bits] of a key mode (`aes_128` has 10 rounds, every two more rounds add 64 bits)
+ */
+#define aes_probe_bits(keymode) ((int)(keymode) * 32 - 192)
+
+#ifdef probes_active
+	#define aes_probe_key_entry(keymode)\
+				STAP_PROBE1(simplecrypt, key_entry, aes_probe_bits(keymode))
+	#define aes_probe_key_return(keymode)\
+				STAP_PROBE1(simplecrypt, key_return, aes_probe_bits(keymode))
+	#define aes_probe_cipher_entry(mode, keymode, length)\
+				STAP_PROBE3(simplecrypt, cipher_entry, mode, aes_probe_bits(keymode), length)
+	#define aes_probe_cipher_return(mode, keymode, length)\
+				STAP_PROBE3(simplecrypt, cipher_return, mode, aes_probe_bits(keymode), length)
+#else
+	#define aes_probe_key_entry(keymode)
+	#define aes_probe_key_return(keymode)
+	#define aes_probe_cipher_entry(mode, keymode, length)
+	#define aes_probe_cipher_return(mode, keymode, length)
+#endif
+
+#endif /* AESprobes_h */
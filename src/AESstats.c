@@ -0,0 +1,217 @@
+//
+//  AESstats.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -pthread.
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file AESstats.c
+
+ The source file for the optional instrumentation of the dispatched calls
+
+ @compilerflag -fvisibility=hidden -pthread
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "AESstats.h"
+
+#pragma mark - Internal Core
+/*!
+ @typedef AESStatsSlot
+
+ @brief The counters of one thread.
+
+ Only the owning thread writes the slot (relaxed atomics, no read-modify-write), the snapshots read it concurrently.
+ The slot of a finished thread is handed to the next new thread, its counts stay in the sums.
+ */
+typedef struct AESStatsSlot {
+	AESStatsCounter ops[AES_STATS_OPS];
+	struct AESStatsSlot * next;
+	int owned;
+} __attribute__((aligned(64))) AESStatsSlot;
+
+// every counter is a uint64_t, the sums run over the counters of all operations as one array
+#define STATS_VALUES (sizeof(AESStatsCounter) * AES_STATS_OPS / sizeof(uint64_t))
+
+#ifdef SIMPLECRYPT_STATS
+int aes_stats_enabled = 1;
+#else
+int aes_stats_enabled = 0;
+#endif
+
+static pthread_mutex_t slots_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t slots_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slots_key;
+static AESStatsSlot * slots;
+static AESStats baseline;
+
+static pthread_once_t environment_once = PTHREAD_ONCE_INIT;
+
+static __thread AESStatsSlot * thread_slot;
+
+static void stats_from_environment(void) {
+	const char * setting = getenv("SIMPLECRYPT_STATS");
+	if (setting && *setting) {
+		aes_stats_enabled = strcmp(setting, "0") != 0;
+	}
+}
+
+static void slot_release(void * slot) {
+	pthread_mutex_lock(&slots_lock);
+	((AESStatsSlot *)slot)->owned = 0;
+	pthread_mutex_unlock(&slots_lock);
+}
+
+static void slots_key_create(void) {
+	pthread_key_create(&slots_key, slot_release);
+}
+
+// runs once per thread, a released slot is reused before a new one is allocated
+static AESStatsSlot * slot_acquire(void) {
+	AESStatsSlot * slot;
+
+	pthread_once(&slots_once, slots_key_create);
+	pthread_mutex_lock(&slots_lock);
+	for (slot = slots; slot && slot->owned; slot = slot->next);
+	if (!slot) {
+		slot = aligned_alloc(64, sizeof(AESStatsSlot));
+		if (slot) {
+			memset(slot, 0, sizeof(AESStatsSlot));
+			slot->next = slots;
+			slots = slot;
+		}
+	}
+	if (slot) {
+		slot->owned = 1;
+	}
+	pthread_mutex_unlock(&slots_lock);
+
+	if (slot) {
+		pthread_setspecific(slots_key, slot);
+	}
+	thread_slot = slot;
+	return slot;
+}
+
+// single writer, so a plain load and store is enough and no locked instruction is needed
+static inline void count(uint64_t * value, uint64_t amount) {
+	__atomic_store_n(value, __atomic_load_n(value, __ATOMIC_RELAXED) + amount, __ATOMIC_RELAXED);
+}
+
+static inline int size_bucket(unsigned long length) {
+	if (length <= 16) {
+		return 0;
+	}
+	int bucket = (64 - __builtin_clzll(length - 1) - 3) / 2;
+	return bucket < AES_STATS_SIZES ? bucket : AES_STATS_SIZES - 1;
+}
+
+static inline int tick_bucket(uint64_t ticks) {
+	int bucket = 63 - __builtin_clzll(ticks | 1);
+	return bucket < AES_STATS_TICKS ? bucket : AES_STATS_TICKS - 1;
+}
+
+// sums all slots without the baseline, the caller holds slots_lock
+static void slots_sum(AESStats * stats) {
+	memset(stats, 0, sizeof(AESStats));
+	for (AESStatsSlot * slot = slots; slot; slot = slot->next) {
+		const uint64_t * from = (const uint64_t *)slot->ops;
+		uint64_t * to = (uint64_t *)stats->ops;
+		for (size_t i = 0; i < STATS_VALUES; i++) {
+			to[i] += __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+		}
+		stats->threads += slot->owned;
+	}
+}
+
+#pragma mark - Collection
+void aes_stats_enable(int enabled) {
+	// the environment is only a default, it must not override an explicit switch later
+	aes_stats_init();
+	__atomic_store_n(&aes_stats_enabled, enabled != 0, __ATOMIC_RELAXED);
+}
+
+void aes_stats_snapshot(AESStats * stats) {
+	pthread_mutex_lock(&slots_lock);
+	slots_sum(stats);
+	const uint64_t * base = (const uint64_t *)baseline.ops;
+	uint64_t * to = (uint64_t *)stats->ops;
+	for (size_t i = 0; i < STATS_VALUES; i++) {
+		to[i] -= base[i];
+	}
+	pthread_mutex_unlock(&slots_lock);
+}
+
+void aes_stats_reset(void) {
+	// the slots are written by their threads only, a reset just moves the baseline
+	pthread_mutex_lock(&slots_lock);
+	slots_sum(&baseline);
+	pthread_mutex_unlock(&slots_lock);
+}
+
+const char * aes_stats_tick_source(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return "rdtsc";
+#elif defined(__aarch64__)
+	return "cntvct";
+#else
+	return "ns";
+#endif
+}
+
+int aes_stats_write_json(const AESStats * stats, FILE * file) {
+	const char * names[] = {"key_setup", "cbc_enc", "cbc_dec", "ctr", "gcm_enc", "gcm_dec"};
+	int ops = 0;
+
+	fprintf(file, "{\n  \"tick_source\": \"%s\",\n  \"threads\": %u,\n  \"size_limits\": [", aes_stats_tick_source(), stats->threads);
+	for (int s = 0; s < AES_STATS_SIZES - 1; s++) {
+		fprintf(file, "%s%lu", s ? ", " : "", 16UL << (2 * s));
+	}
+	fprintf(file, "],\n  \"ops\": {");
+
+	for (int op = 0; op < AES_STATS_OPS; op++) {
+		const AESStatsCounter * counter = &stats->ops[op];
+		int buckets = 0;
+		if (counter->calls == 0) {
+			continue;
+		}
+		fprintf(file, "%s\n    \"%s\": {\"calls\": %llu, \"bytes\": %llu, \"ticks\": %llu, \"histogram\": [",
+				ops++ ? "," : "", names[op], (unsigned long long)counter->calls, (unsigned long long)counter->bytes,
+				(unsigned long long)counter->ticks);
+		for (int s = 0; s < AES_STATS_SIZES; s++) {
+			for (int t = 0; t < AES_STATS_TICKS; t++) {
+				if (counter->histogram[s][t]) {
+					fprintf(file, "%s[%d, %d, %llu]", buckets++ ? ", " : "", s, t, (unsigned long long)counter->histogram[s][t]);
+				}
+			}
+		}
+		fprintf(file, "]}");
+	}
+	fprintf(file, "\n  }\n}\n");
+
+	return fflush(file) == 0 && !ferror(file);
+}
+
+#pragma mark - Instrumentation Internals
+void aes_stats_init(void) {
+	pthread_once(&environment_once, stats_from_environment);
+}
+
+void aes_stats_record(AESStatsOp op, unsigned long length, uint64_t ticks) {
+	AESStatsSlot * slot = thread_slot;
+	if (!slot && !(slot = slot_acquire())) {
+		return;
+	}
+
+	AESStatsCounter * counter = &slot->ops[op];
+	count(&counter->calls, 1);
+	count(&counter->bytes, length);
+	count(&counter->ticks, ticks);
+	count(&counter->histogram[size_bucket(length)][tick_bucket(ticks)], 1);
+}
@@ -0,0 +1,213 @@
+//
+//  AESstats.h
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -pthread
+// * * * * * * * * * * * * * * * * * * * *
+
+/*!
+ @file AESstats.h
+
+ The header file for the optional instrumentation of the dispatched calls (calls, bytes, key setups and per size
+ cycle histograms)
+
+ The counters are off by default. They are switched on at build time with `-DSIMPLECRYPT_STATS`, with the environment
+ variable `SIMPLECRYPT_STATS=1` (read on the first dispatched call), or at runtime with `aes_stats_enable`. While they
+ are off, every dispatched call pays one (predicted) branch on `aes_stats_enabled`.
+
+ Every thread counts into its own cache line aligned slot, so the counting threads never share a line and need no
+ lock. `aes_stats_snapshot` sums all slots on demand.
+
+ @version 0.0.1
+ */
+
+#ifndef AESstats_h
+#define AESstats_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "AESCore.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <x86intrin.h>
+#endif
+
+#pragma mark - Statistics
+/*!
+ @name Statistics
+ Definitions of the counted operations and the collected values
+ */
+///@{
+/*!
+ @typedef AESStatsOp
+
+ @brief An enum naming the counted operations (one per dispatched entry point).
+ */
+typedef enum {
+	aes_stats_key_setup = 0,
+	aes_stats_cbc_enc,
+	aes_stats_cbc_dec,
+	aes_stats_ctr,
+	aes_stats_gcm_enc,
+	aes_stats_gcm_dec
+} AESStatsOp;
+
+/*!
+ @define AES_STATS_OPS
+ The amount of counted operations (see `AESStatsOp`)
+ */
+#define AES_STATS_OPS 6
+
+/*!
+ @define AES_STATS_SIZES
+ The amount of message size buckets, bucket `s` holds the calls of up to `16 << 2s` bytes (16 B, 64 B, ..., 64 KiB),
+ the last bucket all larger ones
+ */
+#define AES_STATS_SIZES 8
+
+/*!
+ @define AES_STATS_TICKS
+ The amount of duration buckets per size, bucket `t` holds the calls which took `[2^t, 2^(t + 1))` ticks, the last
+ bucket all longer ones
+ */
+#define AES_STATS_TICKS 32
+
+/*!
+ @typedef AESStatsCounter
+
+ @brief The values collected for one operation.
+
+ The ticks are `rdtsc` reference cycles on x86, `cntvct_el0` counts on ARM and nanoseconds elsewhere (see
+ `aes_stats_tick_source`). Key setups are counted with a size of zero bytes.
+ */
+typedef struct {
+	uint64_t calls;
+	uint64_t bytes;
+	uint64_t ticks;
+	uint64_t histogram[AES_STATS_SIZES][AES_STATS_TICKS];
+} AESStatsCounter;
+
+/*!
+ @typedef AESStats
+
+ @brief A snapshot of the counters, summed over all threads.
+ */
+typedef struct {
+	AESStatsCounter ops[AES_STATS_OPS];
+	unsigned int threads;	// the threads currently holding a slot (which counted at least one call)
+} AESStats;
+///@}
+
+#pragma mark - Collection
+/*!
+ @name Collection
+ Switching the counters on and off and reading them
+ */
+///@{
+/*!
+ @brief Switches the counters on (`1`) or off (`0`) for all threads
+
+ Calls which are already running when the counters are switched are counted as the switch found them.
+
+ @param enabled `1` to count the following calls, `0` to stop counting
+ */
+__attribute__((visibility("hidden")))
+void aes_stats_enable(int enabled);
+
+/*!
+ @brief Sums the counters of all threads
+
+ Threads which still count while the snapshot is taken may be off by the calls they are in, every single value is
+ consistent on its own.
+
+ @param stats The (caller owned) snapshot to fill
+ */
+__attribute__((visibility("hidden"), nonnull(1)))
+void aes_stats_snapshot(AESStats * stats);
+
+/*!
+ @brief Sets all counters back to zero
+
+ The counts of every thread are kept, the following snapshots only report what was counted after the reset.
+ */
+__attribute__((visibility("hidden")))
+void aes_stats_reset(void);
+
+/*!
+ @brief Returns the name of the clock the ticks are counted in
+
+ @returns `rdtsc`, `cntvct` or `ns`
+ */
+__attribute__((visibility("hidden")))
+const char * aes_stats_tick_source(void);
+
+/*!
+ @brief Writes a snapshot as one JSON document
+
+ Every operation with at least one call is written with its calls, bytes, ticks and the non empty histogram buckets
+ (`[size bucket, tick bucket, calls]` triples).
+
+ @param stats The snapshot to write
+ @param file The stream to write to
+
+ @returns `1` on success, `0` if the stream could not be written (`errno` is set)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2)))
+int aes_stats_write_json(const AESStats * stats, FILE * file);
+///@}
+
+#pragma mark - Instrumentation Internals
+/*!
+ @name Instrumentation Internals
+ Used by the dispatched entry points, the counters are only touched after the `aes_stats_on` check
+ */
+///@{
+/*!
+ @var aes_stats_enabled
+ Whether the calls are counted, read once per dispatched call
+ */
+__attribute__((visibility("hidden")))
+extern int aes_stats_enabled;
+
+static inline int aes_stats_on(void) {
+	return __builtin_expect(__atomic_load_n(&aes_stats_enabled, __ATOMIC_RELAXED), 0);
+}
+
+static inline uint64_t aes_stats_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#elif defined(__aarch64__)
+	uint64_t ticks;
+	__asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+	return ticks;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/*!
+ @brief Reads the environment variable `SIMPLECRYPT_STATS` (once, later calls return immediately)
+
+ Called by the dispatcher before its first call checks `aes_stats_on`.
+ */
+__attribute__((visibility("hidden")))
+void aes_stats_init(void);
+
+/*!
+ @brief Counts one call into the slot of the calling thread
+
+ @param op The operation that was called
+ @param length The message length of the call [in bytes]
+ @param ticks How long the call took (difference of two `aes_stats_ticks`)
+ */
+__attribute__((visibility("hidden")))
+void aes_stats_record(AESStatsOp op, unsigned long length, uint64_t ticks);
+///@}
+
+#endif /* AESstats_h */
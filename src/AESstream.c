@@ -0,0 +1,225 @@
+//
+//  AESstream.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden.
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file AESstream.c
+
+ The source file for the streaming (init/update/final) CBC and CTR functions which encrypt messages arriving in
+ chunks of any size with constant memory
+
+ @compilerflag -fvisibility=hidden
+ @version 0.0.1
+ */
+
+#include <string.h>
+
+#include "AESstream.h"
+#include "AESdispatch.h"
+
+#pragma mark - Internal Core
+static void stream_wipe(AESStream * stream) {
+	volatile uint8_t * raw = (volatile uint8_t *)stream;
+	for (size_t i = 0; i < sizeof(AESStream); i++) {
+		raw[i] = 0;
+	}
+}
+
+#pragma mark - CBC Stream
+void aes_cbc_stream_init(AESStream * stream, uint8_t * key, AESKeyMode keymode, uint8_t * ivec) {
+	aes_key_context_init(&stream->key, key, keymode);
+	memcpy(stream->ivec, ivec, 16);
+	stream->buffered = 0;
+}
+
+unsigned long aes_cbc_stream_enc_update(AESStream * stream, uint8_t * inpt, uint8_t * outt, unsigned long mlength) {
+	unsigned long i = 0, written = 0;
+
+	// complete the block started by the previous chunk
+	if (stream->buffered) {
+		while (stream->buffered < 16 && i < mlength) {
+			stream->buffer[stream->buffered++] = inpt[i++];
+		}
+		if (stream->buffered < 16) {
+			return 0;
+		}
+		aes_cbc_enc_ctx(stream->buffer, outt, stream->ivec, 16, &stream->key);
+		memcpy(stream->ivec, outt, 16);
+		stream->buffered = 0;
+		written = 16;
+	}
+
+	// all complete blocks straight from the chunk
+	unsigned long full = (mlength - i) & ~15UL;
+	if (full) {
+		aes_cbc_enc_ctx(inpt + i, outt + written, stream->ivec, full, &stream->key);
+		memcpy(stream->ivec, outt + written + full - 16, 16);
+		i += full;
+		written += full;
+	}
+
+	while (i < mlength) {
+		stream->buffer[stream->buffered++] = inpt[i++];
+	}
+	return written;
+}
+
+unsigned long aes_cbc_stream_enc_final(AESStream * stream, uint8_t * outt) {
+	uint8_t pad = (uint8_t)(16 - stream->buffered);
+	for (unsigned int b = stream->buffered; b < 16; b++) {
+		stream->buffer[b] = pad;
+	}
+	aes_cbc_enc_ctx(stream->buffer, outt, stream->ivec, 16, &stream->key);
+	stream_wipe(stream);
+	return 16;
+}
+
+unsigned long aes_cbc_stream_dec_update(AESStream * stream, uint8_t * inpt, uint8_t * outt, unsigned long clength) {
+	unsigned long i = 0, written = 0;
+
+	// complete the buffered block, it is only decrypted once it is known not to be the last one
+	if (stream->buffered) {
+		while (stream->buffered < 16 && i < clength) {
+			stream->buffer[stream->buffered++] = inpt[i++];
+		}
+		if (stream->buffered < 16 || i == clength) {
+			return 0;
+		}
+		aes_cbc_dec_ctx(stream->buffer, outt, stream->ivec, 16, &stream->key);
+		memcpy(stream->ivec, stream->buffer, 16);
+		stream->buffered = 0;
+		written = 16;
+	}
+
+	// all complete blocks straight from the chunk, but the last block of the chunk is held back
+	unsigned long rest = clength - i;
+	unsigned long full = rest & ~15UL;
+	if (full == rest && full) {
+		full -= 16;
+	}
+	if (full) {
+		aes_cbc_dec_ctx(inpt + i, outt + written, stream->ivec, full, &stream->key);
+		memcpy(stream->ivec, inpt + i + full - 16, 16);
+		i += full;
+		written += full;
+	}
+
+	while (i < clength) {
+		stream->buffer[stream->buffered++] = inpt[i++];
+	}
+	return written;
+}
+
+int aes_cbc_stream_dec_final(AESStream * stream, uint8_t * outt, unsigned long * mlength) {
+	uint8_t block[16];
+
+	*mlength = 0;
+	if (stream->buffered != 16) {
+		stream_wipe(stream);
+		return 0;
+	}
+	aes_cbc_dec_ctx(stream->buffer, block, stream->ivec, 16, &stream->key);
+	stream_wipe(stream);
+
+	// the padding is checked without branching on its bytes (no padding oracle through the timing)
+	unsigned int pad = block[15];
+	unsigned int bad = ((pad - 1) >> 8) | ((16 - pad) >> 8);
+	for (unsigned int b = 0; b < 16; b++) {
+		// mask is all ones for the last `pad` bytes
+		unsigned int mask = 0u - (((15 - b) - pad) >> 8 & 1);
+		bad |= mask & (block[b] ^ pad);
+	}
+	if (bad & 0xff) {
+		memset(block, 0, 16);
+		return 0;
+	}
+
+	*mlength = 16 - pad;
+	memcpy(outt, block, *mlength);
+	memset(block, 0, 16);
+	return 1;
+}
+
+#pragma mark - CTR Stream
+void aes_ctr_stream_init(AESStream * stream, uint8_t * key, AESKeyMode keymode, uint8_t * ivec) {
+	aes_key_context_init(&stream->key, key, keymode);
+	memcpy(stream->ivec, ivec, 16);
+	stream->buffered = 0;
+}
+
+void aes_ctr_stream_update(AESStream * stream, uint8_t * inpt, uint8_t * outt, unsigned long mlength) {
+	static uint8_t zero[16];
+	unsigned long i = 0;
+
+	// use up the key stream of the partial block of the previous chunk
+	while (stream->buffered && i < mlength) {
+		outt[i] = inpt[i] ^ stream->buffer[stream->buffered];
+		stream->buffered = (stream->buffered + 1) % 16;
+		i++;
+	}
+
+	// all complete blocks straight from the chunk
+	unsigned long full = (mlength - i) & ~15UL;
+	if (full) {
+		aes_ctr_ctx(inpt + i, outt + i, stream->ivec, full, &stream->key);
+		aes_ctr_add(stream->ivec, full / 16);
+		i += full;
+	}
+
+	// start a partial block, its remaining key stream is kept for the next chunk
+	if (i < mlength) {
+		aes_ctr_ctx(zero, stream->buffer, stream->ivec, 16, &stream->key);
+		aes_ctr_add(stream->ivec, 1);
+		for (; i < mlength; i++) {
+			outt[i] = inpt[i] ^ stream->buffer[stream->buffered++];
+		}
+	}
+}
+
+void aes_ctr_stream_seek(AESStream * stream, uint8_t * ivec, unsigned long long offset) {
+	static uint8_t zero[16];
+	memcpy(stream->ivec, ivec, 16);
+	aes_ctr_add(stream->ivec, offset / 16);
+	stream->buffered = (unsigned int)(offset % 16);
+	
+	// the key stream of a block entered in the middle is generated right away, the update uses it from `buffered`
+	if (stream->buffered) {
+		aes_ctr_ctx(zero, stream->buffer, stream->ivec, 16, &stream->key);
+		aes_ctr_add(stream->ivec, 1);
+	}
+}
+
+void aes_ctr_stream_final(AESStream * stream) {
+	stream_wipe(stream);
+}
+
+#pragma mark - CTR Random Access
+void aes_ctr_range_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long long offset, unsigned long mlength, const AESKeyContext * ctx) {
+	static uint8_t zero[16];
+	uint8_t counter[16], stream[16];
+	unsigned long i = 0;
+	unsigned int skip = (unsigned int)(offset % 16);
+	
+	memcpy(counter, ivec, 16);
+	aes_ctr_add(counter, offset / 16);
+	
+	// leading partial block: only the key stream bytes from `skip` on belong to the range
+	if (skip && mlength) {
+		aes_ctr_ctx(zero, stream, counter, 16, ctx);
+		aes_ctr_add(counter, 1);
+		for (; skip < 16 && i < mlength; skip++, i++) {
+			outt[i] = inpt[i] ^ stream[skip];
+		}
+		memset(stream, 0, 16);
+	}
+	
+	// the backend handles the aligned blocks and the trailing partial block
+	if (i < mlength) {
+		aes_ctr_ctx(inpt + i, outt + i, counter, mlength - i, ctx);
+	}
+}
@@ -0,0 +1,235 @@
+//
+//  AESstream.h
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden
+// * * * * * * * * * * * * * * * * * * * *
+
+/*!
+ @file AESstream.h
+
+ The header file for the streaming (init/update/final) CBC and CTR functions which encrypt messages arriving in
+ chunks of any size with constant memory
+
+ @version 0.0.1
+ */
+
+#ifndef AESstream_h
+#define AESstream_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "AESCore.h"
+
+#pragma mark - Stream Definitions
+/*!
+ @name Stream Definitions
+ Definitions of the streaming state
+ */
+///@{
+/*!
+ @typedef AESStream
+
+ @brief The state carried between the chunks of one streamed message.
+
+ Holds the expanded key (in the format of the active backend), the chaining value and at most one block of data, so
+ a message of any length is processed in constant memory. Block aligned chunks are passed to the backend directly
+ without being copied; only the bytes of a block which is split between two chunks go through the buffer.
+
+ - key: The key context expanded by the active backend
+ - ivec: CBC: the last cipher block (the IV of the next block); CTR: the next counter block
+ - buffer: CBC: the bytes of the incomplete (or, when decrypting, held back last) block; CTR: the key stream of the
+   partial block
+ - buffered: CBC: the amount of bytes in the buffer; CTR: the amount of key stream bytes already used
+ */
+typedef struct {
+	AESKeyContext key;
+	uint8_t ivec[16];
+	uint8_t buffer[16];
+	unsigned int buffered;
+} AESStream;
+///@}
+
+#pragma mark - CBC Stream
+/*!
+ @name CBC Stream
+ Streaming Cipher Block Chain encryption and decryption with PKCS#7 padding on the active backend
+ */
+///@{
+/*!
+ @brief Starts a streamed CBC message
+
+ @param stream The (caller owned) state to set up
+ @param key The user key (`16`, `24`, or `32` bytes depending on the key mode)
+ @param keymode The AES version to use
+ @param ivec The `16` byte IV (Initial Vector) of the message
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 4)))
+void aes_cbc_stream_init(AESStream * stream, uint8_t * key, AESKeyMode keymode, uint8_t * ivec);
+
+/*!
+ @brief Encrypts the next chunk of a streamed CBC message
+
+ Encrypts all complete blocks and keeps the remaining bytes (less than one block) for the next call.
+
+ @code
+ AESStream stream;
+ aes_cbc_stream_init(&stream, userKey, aes_256, iv);
+ while ((n = read(in, chunk, sizeof(chunk))) > 0) {
+	write(out, cipher, aes_cbc_stream_enc_update(&stream, chunk, cipher, n));
+ }
+ write(out, cipher, aes_cbc_stream_enc_final(&stream, cipher));
+ @endcode
+
+ @warning The output must have room for `mlength + 15` bytes and must not overlap the input
+
+ @param stream The state of the message
+ @param inpt The chunk to encrypt
+ @param outt The location where the encrypted blocks will be written
+ @param mlength The length of the chunk [in bytes]
+
+ @returns The amount of bytes written to `outt` (a multiple of 16)
+ */
+__attribute__((visibility("hidden"), nonnull(1)))
+unsigned long aes_cbc_stream_enc_update(AESStream * stream, uint8_t * inpt, uint8_t * outt, unsigned long mlength);
+
+/*!
+ @brief Finishes a streamed CBC message
+
+ Pads the remaining bytes with PKCS#7 (always adding `1` to `16` bytes) and encrypts the last block. The state is
+ wiped afterwards.
+
+ @param stream The state of the message
+ @param outt The location where the last block will be written (`16` bytes)
+
+ @returns The amount of bytes written to `outt` (always `16`)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2)))
+unsigned long aes_cbc_stream_enc_final(AESStream * stream, uint8_t * outt);
+
+/*!
+ @brief Decrypts the next chunk of a streamed CBC message
+
+ Decrypts all complete blocks except the last one received so far, which is held back as it may carry the padding.
+
+ @warning The output must have room for `clength + 15` bytes and must not overlap the input
+
+ @param stream The state of the message
+ @param inpt The chunk to decrypt
+ @param outt The location where the decrypted blocks will be written
+ @param clength The length of the chunk [in bytes]
+
+ @returns The amount of bytes written to `outt` (a multiple of 16)
+ */
+__attribute__((visibility("hidden"), nonnull(1)))
+unsigned long aes_cbc_stream_dec_update(AESStream * stream, uint8_t * inpt, uint8_t * outt, unsigned long clength);
+
+/*!
+ @brief Finishes a streamed CBC message and removes the padding
+
+ Decrypts the held back block and checks its PKCS#7 padding without branching on the padding bytes. The state is
+ wiped afterwards.
+
+ @param stream The state of the message
+ @param outt The location where the rest of the message will be written (up to `15` bytes)
+ @param mlength Set to the amount of bytes written to `outt` (`0` if the padding is invalid)
+
+ @returns `1` if the message ended in a complete block with valid padding, `0` otherwise
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3)))
+int aes_cbc_stream_dec_final(AESStream * stream, uint8_t * outt, unsigned long * mlength);
+///@}
+
+#pragma mark - CTR Stream
+/*!
+ @name CTR Stream
+ Streaming CounTeR mode encryption and decryption on the active backend
+ */
+///@{
+/*!
+ @brief Starts a streamed CTR message
+
+ @param stream The (caller owned) state to set up
+ @param key The user key (`16`, `24`, or `32` bytes depending on the key mode)
+ @param keymode The AES version to use
+ @param ivec The `16` byte initial counter block (the full 128 bits are incremented)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 4)))
+void aes_ctr_stream_init(AESStream * stream, uint8_t * key, AESKeyMode keymode, uint8_t * ivec);
+
+/*!
+ @brief Encrypts or Decrypts the next chunk of a streamed CTR message
+
+ The chunks may have any length, the output is exactly as long as the input. Splitting a message into chunks gives
+ the same result as processing it at once.
+
+ @note The chunk can be processed in place (`inpt == outt`)
+
+ @param stream The state of the message
+ @param inpt The chunk to encrypt/decrypt
+ @param outt The location where the encrypted/decrypted chunk will be written
+ @param mlength The length of the chunk [in bytes] which is also the output length
+ */
+__attribute__((visibility("hidden"), nonnull(1)))
+void aes_ctr_stream_update(AESStream * stream, uint8_t * inpt, uint8_t * outt, unsigned long mlength);
+
+/*!
+ @brief Moves a streamed CTR message to a byte offset
+
+ The next update continues at `offset` bytes into the message. The counter block is computed from the initial
+ counter block instead of running the key stream up to the offset, so seeking costs one block at most.
+
+ @param stream The state of the message (set up with `aes_ctr_stream_init`)
+ @param ivec The `16` byte initial counter block the message was started with
+ @param offset The byte offset in the message to continue at
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2)))
+void aes_ctr_stream_seek(AESStream * stream, uint8_t * ivec, unsigned long long offset);
+
+/*!
+ @brief Finishes a streamed CTR message
+
+ Wipes the state (the key schedule and the unused key stream).
+
+ @param stream The state of the message
+ */
+__attribute__((visibility("hidden"), nonnull(1)))
+void aes_ctr_stream_final(AESStream * stream);
+///@}
+
+#pragma mark - CTR Random Access
+/*!
+ @name CTR Random Access
+ Encrypting and decrypting any byte range of a CTR message on the active backend
+ */
+///@{
+/*!
+ @brief Encrypts or Decrypts a byte range of a CTR message
+
+ Processes the bytes `[offset, offset + mlength)` of a message encrypted with `ivec`. The counter block of the first
+ byte is `ivec + offset / 16` (all 128 bits are incremented, as in `aes_ctr_ctx`), so reading a range of a large
+ object costs `O(mlength)` instead of `O(offset + mlength)`. Unaligned leading and trailing partial blocks are
+ handled, only `mlength` bytes are read and written.
+
+ @code
+ // read bytes [1000000, 1004096) of an encrypted blob
+ aes_ctr_range_ctx(blob + 1000000, plain, iv, 1000000, 4096, &ctx);
+ @endcode
+
+ @note The range can be processed in place (`inpt == outt`)
+
+ @param inpt The bytes of the range (the byte at `offset` of the message first)
+ @param outt A pointer to a `malloc`ed location where the encrypted/decrypted range will be written
+ @param ivec The `16` byte initial counter block of the message
+ @param offset The byte offset of the range in the message
+ @param mlength The length of the range [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(3, 6)))
+void aes_ctr_range_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long long offset, unsigned long mlength, const AESKeyContext * ctx);
+///@}
+
+#endif /* AESstream_h */
@@ -0,0 +1,954 @@
+//
+//  AESvaes.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -maes -mpclmul -msse4.1
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file AESvaes.c
+
+ The source file for the wide CBC decryption, CTR, GCM and XTS kernels implemented with the vector AES instructions
+ (VAES, with VPCLMULQDQ for GHASH and the XTS tweaks)
+
+ @compilerflag -fvisibility=hidden -maes -mpclmul -msse4.1
+ @version 0.0.1
+ */
+
+#include <string.h>
+
+#include "AESvaes.h"
+#include "AESprobes.h"
+
+#ifdef vaes_active
+#pragma mark - Internal Core Definitions
+/*!
+ @define VAES_GROUP_BLOCKS
+ The amount of blocks per iteration of both widths (eight 256 bit or four 512 bit registers)
+ */
+#define VAES_GROUP_BLOCKS 16
+
+#define VAES256_TARGET __attribute__((target("aes,vaes,avx2")))
+#define VAES512_TARGET __attribute__((target("aes,vaes,avx512f,avx512bw,avx512vl")))
+#define VPCLMUL256_TARGET __attribute__((target("aes,pclmul,vaes,vpclmulqdq,avx2")))
+#define VPCLMUL512_TARGET __attribute__((target("aes,pclmul,vaes,vpclmulqdq,avx512f,avx512bw,avx512vl")))
+
+#pragma mark - Internal Core
+// writes `count` consecutive (big endian, 128 bit) counter blocks, only used where the low half wraps
+static void ctr_blocks_slow(uint8_t * blocks, uint64_t hi, uint64_t lo, int count) {
+	for (int b = 0; b < count; b++) {
+		aes_store_be64(blocks + 16 * b, hi);
+		aes_store_be64(blocks + 16 * b + 8, lo);
+		aes_ctr_increment(&hi, &lo, ctr_128);
+	}
+}
+
+/*!
+ @typedef vaes_gcm_blocks
+
+ @brief A wide GCM kernel: runs `blocks` full blocks on the message state (from its counter, onto its hash).
+ */
+typedef void (*vaes_gcm_blocks)(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, size_t blocks, int decrypt);
+
+// the hash key powers in the order of the blocks of a group: block j is multiplied by H^(16 - j). Inlined so it is VEX
+// encoded like the wide kernels, a legacy SSE call between their vector instructions costs a state transition
+__attribute__((target("pclmul")))
+static inline __attribute__((always_inline)) void gcm_group_powers(const AESGCMContext * gcm, __m128i * powers) {
+	for (int p = 0; p < 8; p++) {
+		powers[8 + p] = gcm->htable[7 - p];
+	}
+	for (int p = 7; p >= 0; p--) {
+		powers[p] = ghash_mul(powers[p + 1], gcm->htable[0]);
+	}
+}
+
+// the powers of a group of which only the first `rest` blocks are used: block j is multiplied by H^(rest - j), the
+// unused (zero) blocks by anything
+static inline __attribute__((always_inline)) void gcm_tail_powers(const __m128i * powers, __m128i * tail, int rest) {
+	for (int j = 0; j < VAES_GROUP_BLOCKS; j++) {
+		tail[j] = j < rest ? powers[VAES_GROUP_BLOCKS - rest + j] : _mm_setzero_si128();
+	}
+}
+
+// the full blocks run on the wide kernel, the IV, the associated data, a partial last block and the tag on the AES-NI
+// message state. A message shorter than a group does not make up for the setup of the wide kernel and runs on AES-NI
+// as a whole
+__attribute__((target("aes,pclmul")))
+static void gcm_enc(vaes_gcm_blocks kernel, uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx) {
+	AESGCMContext gcm;
+	size_t blocks = mlength < 16 * VAES_GROUP_BLOCKS ? 0 : mlength / 16;
+	unsigned long bulk = (unsigned long)blocks * 16;
+
+	aes_gcm_ni_init(&gcm, ctx, ivec, ivlength);
+	aes_gcm_ni_aad(&gcm, aad, alength);
+	if (blocks) {
+		aes_gcm_ni_begin_data(&gcm, bulk);
+		kernel(&gcm, inpt, outt, blocks, 0);
+	}
+	aes_gcm_ni_enc_update(&gcm, inpt + bulk, outt + bulk, mlength - bulk);
+	aes_gcm_ni_enc_final(&gcm, tag, 16);
+}
+
+__attribute__((target("aes,pclmul")))
+static int gcm_dec(vaes_gcm_blocks kernel, uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx) {
+	AESGCMContext gcm;
+	size_t blocks = clength < 16 * VAES_GROUP_BLOCKS ? 0 : clength / 16;
+	unsigned long bulk = (unsigned long)blocks * 16;
+
+	aes_gcm_ni_init(&gcm, ctx, ivec, ivlength);
+	aes_gcm_ni_aad(&gcm, aad, alength);
+	if (blocks) {
+		aes_gcm_ni_begin_data(&gcm, bulk);
+		kernel(&gcm, inpt, outt, blocks, 1);
+	}
+	aes_gcm_ni_dec_update(&gcm, inpt + bulk, outt + bulk, clength - bulk);
+	int authentic = aes_gcm_ni_dec_final(&gcm, tag, 16);
+	if (!authentic) {
+		// never hand out unauthenticated plain text
+		volatile uint8_t * raw = outt;
+		for (unsigned long b = 0; b < clength; b++) {
+			raw[b] = 0;
+		}
+	}
+	return authentic;
+}
+
+// the full blocks of a data unit which run on the wide kernels (ciphertext stealing keeps the last full block), a unit
+// shorter than a group runs on AES-NI as a whole
+static inline size_t xts_blocks(unsigned long length) {
+	size_t full = length / 16;
+	size_t blocks = length % 16 && full ? full - 1 : full;
+	return blocks < VAES_GROUP_BLOCKS ? 0 : blocks;
+}
+
+#pragma mark - VAES AVX2 Internals
+// one AES encryption (decryption) of `count` registers [up to sixteen blocks], the round count is a constant
+VAES256_TARGET
+static inline __attribute__((always_inline)) void vaes256_enc(__m256i * blocks, const int count, const uint8_t (*schedule)[16], const AESKeyMode keymode) {
+	__m256i key = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)schedule[0]));
+#pragma GCC unroll 8
+	for (int b = 0; b < count; b++) {
+		blocks[b] = _mm256_xor_si256(blocks[b], key);
+	}
+#pragma GCC unroll 13
+	for (int r = 1; r < (int)keymode; r++) {
+		key = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)schedule[r]));
+#pragma GCC unroll 8
+		for (int b = 0; b < count; b++) {
+			blocks[b] = _mm256_aesenc_epi128(blocks[b], key);
+		}
+	}
+	key = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)schedule[keymode]));
+#pragma GCC unroll 8
+	for (int b = 0; b < count; b++) {
+		blocks[b] = _mm256_aesenclast_epi128(blocks[b], key);
+	}
+}
+
+VAES256_TARGET
+static inline __attribute__((always_inline)) void vaes256_dec(__m256i * blocks, const int count, const uint8_t (*schedule)[16], const AESKeyMode keymode) {
+	__m256i key = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)schedule[0]));
+#pragma GCC unroll 8
+	for (int b = 0; b < count; b++) {
+		blocks[b] = _mm256_xor_si256(blocks[b], key);
+	}
+#pragma GCC unroll 13
+	for (int r = 1; r < (int)keymode; r++) {
+		key = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)schedule[r]));
+#pragma GCC unroll 8
+		for (int b = 0; b < count; b++) {
+			blocks[b] = _mm256_aesdec_epi128(blocks[b], key);
+		}
+	}
+	key = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *)schedule[keymode]));
+#pragma GCC unroll 8
+	for (int b = 0; b < count; b++) {
+		blocks[b] = _mm256_aesdeclast_epi128(blocks[b], key);
+	}
+}
+
+// the load and store masks of a group of which only the first `rest` blocks are used, cut from a window of 32 all ones
+// and 32 zero words (two words per block)
+static const long long vaes256_mask_window[64] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+VAES256_TARGET
+static inline __attribute__((always_inline)) void vaes256_tail_masks(__m256i * masks, int rest) {
+	const long long * window = vaes256_mask_window + 32 - 2 * rest;
+#pragma GCC unroll 8
+	for (int b = 0; b < 8; b++) {
+		masks[b] = _mm256_loadu_si256((const __m256i *)(window + 4 * b));
+	}
+}
+
+// decrypts `count` registers of a group, `masks` (NULL for a full group) selects the blocks which are read and written
+VAES256_TARGET
+static inline __attribute__((always_inline)) __m128i vaes256_cbc_dec_group(uint8_t * inpt, uint8_t * outt, __m128i feedback, const __m256i * masks, const int count, const uint8_t (*schedule)[16], const AESKeyMode keymode) {
+	__m256i cipher[8], blocks[8];
+#pragma GCC unroll 8
+	for (int b = 0; b < count; b++) {
+		cipher[b] = masks ? _mm256_maskload_epi64((const long long *)inpt + 4 * b, masks[b]) : _mm256_loadu_si256((__m256i *)inpt + b);
+		blocks[b] = cipher[b];
+	}
+	vaes256_dec(blocks, count, schedule, keymode);
+
+	// the block before every block: [feedback, c0] for the first register, [high half of the last, low half] after
+	blocks[0] = _mm256_xor_si256(blocks[0], _mm256_permute2x128_si256(_mm256_castsi128_si256(feedback), cipher[0], 0x20));
+#pragma GCC unroll 7
+	for (int b = 1; b < count; b++) {
+		blocks[b] = _mm256_xor_si256(blocks[b], _mm256_permute2x128_si256(cipher[b - 1], cipher[b], 0x21));
+	}
+	// all cipher blocks of the group are loaded before the first store (in place safe)
+#pragma GCC unroll 8
+	for (int b = 0; b < count; b++) {
+		if (masks) {
+			_mm256_maskstore_epi64((long long *)outt + 4 * b, masks[b], blocks[b]);
+		} else {
+			_mm256_storeu_si256((__m256i *)outt + b, blocks[b]);
+		}
+	}
+	return _mm256_extracti128_si256(cipher[count - 1], 1);
+}
+
+VAES256_TARGET
+static inline __attribute__((always_inline)) void vaes256_cbc_dec_kernel(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx, const AESKeyMode keymode) {
+	__m128i feedback = _mm_loadu_si128((__m128i *)ivec);
+	size_t i = 0, full = clength / 16;
+
+	for (; i + VAES_GROUP_BLOCKS <= full; i += VAES_GROUP_BLOCKS) {
+		feedback = vaes256_cbc_dec_group(inpt + 16 * i, outt + 16 * i, feedback, NULL, 8, ctx->dec_schedule, keymode);
+	}
+
+	// tail [up to fifteen blocks] on as few registers as cover it, masked by 64 bit halves
+	if (i < full) {
+		__m256i masks[8];
+		int rest = (int)(full - i);
+		vaes256_tail_masks(masks, rest);
+		if (rest <= 2) {
+			vaes256_cbc_dec_group(inpt + 16 * i, outt + 16 * i, feedback, masks, 1, ctx->dec_schedule, keymode);
+		} else if (rest <= 4) {
+			vaes256_cbc_dec_group(inpt + 16 * i, outt + 16 * i, feedback, masks, 2, ctx->dec_schedule, keymode);
+		} else if (rest <= 8) {
+			vaes256_cbc_dec_group(inpt + 16 * i, outt + 16 * i, feedback, masks, 4, ctx->dec_schedule, keymode);
+		} else {
+			vaes256_cbc_dec_group(inpt + 16 * i, outt + 16 * i, feedback, masks, 8, ctx->dec_schedule, keymode);
+		}
+	}
+}
+
+// encrypts `count` registers of counter blocks and XORs `length` bytes (at most `32 * count`) of the input onto them
+VAES256_TARGET
+static inline __attribute__((always_inline)) void vaes256_ctr_group(uint8_t * inpt, uint8_t * outt, uint64_t hi, uint64_t lo, unsigned long length, const int count, const uint8_t (*schedule)[16], const AESKeyMode keymode) {
+	__m256i blocks[8];
+	const __m256i bswap = _mm256_broadcastsi128_si256(_mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+
+	if (lo <= UINT64_MAX - (VAES_GROUP_BLOCKS - 1)) {
+		// no carry into the high half within the group, the counters are the (little endian) base plus 0 .. 15
+		__m256i base = _mm256_broadcastsi128_si256(_mm_set_epi64x((long long)hi, (long long)lo));
+#pragma GCC unroll 8
+		for (int b = 0; b < count; b++) {
+			blocks[b] = _mm256_shuffle_epi8(_mm256_add_epi64(base, _mm256_set_epi64x(0, 2 * b + 1, 0, 2 * b)), bswap);
+		}
+	} else {
+		uint8_t counters[16 * VAES_GROUP_BLOCKS];
+		ctr_blocks_slow(counters, hi, lo, VAES_GROUP_BLOCKS);
+#pragma GCC unroll 8
+		for (int b = 0; b < count; b++) {
+			blocks[b] = _mm256_loadu_si256((__m256i *)counters + b);
+		}
+	}
+	vaes256_enc(blocks, count, schedule, keymode);
+
+	if (length == 32UL * count) {
+#pragma GCC unroll 8
+		for (int b = 0; b < count; b++) {
+			__m256i data = _mm256_loadu_si256((__m256i *)inpt + b);
+			_mm256_storeu_si256((__m256i *)outt + b, _mm256_xor_si256(blocks[b], data));
+		}
+	} else {
+		// AVX2 has no byte masks, the bytes of the message are copied through a buffer so nothing past it is touched
+		uint8_t buffer[16 * VAES_GROUP_BLOCKS];
+		memcpy(buffer, inpt, length);
+#pragma GCC unroll 8
+		for (int b = 0; b < count; b++) {
+			__m256i data = _mm256_loadu_si256((__m256i *)buffer + b);
+			_mm256_storeu_si256((__m256i *)buffer + b, _mm256_xor_si256(blocks[b], data));
+		}
+		memcpy(outt, buffer, length);
+	}
+}
+
+VAES256_TARGET
+static inline __attribute__((always_inline)) void vaes256_ctr_kernel(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, const AESKeyMode keymode) {
+	uint64_t hi = aes_load_be64(ivec), lo = aes_load_be64(ivec + 8);
+	unsigned long i = 0;
+
+	for (; i + 16 * VAES_GROUP_BLOCKS <= mlength; i += 16 * VAES_GROUP_BLOCKS) {
+		vaes256_ctr_group(inpt + i, outt + i, hi, lo, 16 * VAES_GROUP_BLOCKS, 8, ctx->enc_schedule, keymode);
+		lo += VAES_GROUP_BLOCKS;
+		hi += (lo < VAES_GROUP_BLOCKS);
+	}
+
+	// tail [up to 255 bytes] on as few registers as cover it
+	unsigned long rest = mlength - i;
+	if (rest == 0) {
+		return;
+	} else if (rest <= 32) {
+		vaes256_ctr_group(inpt + i, outt + i, hi, lo, rest, 1, ctx->enc_schedule, keymode);
+	} else if (rest <= 64) {
+		vaes256_ctr_group(inpt + i, outt + i, hi, lo, rest, 2, ctx->enc_schedule, keymode);
+	} else if (rest <= 128) {
+		vaes256_ctr_group(inpt + i, outt + i, hi, lo, rest, 4, ctx->enc_schedule, keymode);
+	} else {
+		vaes256_ctr_group(inpt + i, outt + i, hi, lo, rest, 8, ctx->enc_schedule, keymode);
+	}
+}
+
+// hashes `count` registers of (reflected) cipher blocks with a single reduction, `x` is added onto the first block
+VPCLMUL256_TARGET
+static inline __attribute__((always_inline)) __m128i vaes256_ghash_group(__m256i * cipher, const int count, __m128i x, const __m256i * hpow, const __m256i * hkarat) {
+	__m256i lo = _mm256_setzero_si256(), mid = _mm256_setzero_si256(), hi = _mm256_setzero_si256();
+	cipher[0] = _mm256_xor_si256(cipher[0], _mm256_inserti128_si256(_mm256_setzero_si256(), x, 0));
+#pragma GCC unroll 8
+	for (int b = 0; b < count; b++) {
+		lo = _mm256_xor_si256(lo, _mm256_clmulepi64_epi128(cipher[b], hpow[b], 0x00));
+		hi = _mm256_xor_si256(hi, _mm256_clmulepi64_epi128(cipher[b], hpow[b], 0x11));
+		mid = _mm256_xor_si256(mid, _mm256_clmulepi64_epi128(_mm256_xor_si256(cipher[b], _mm256_shuffle_epi32(cipher[b], 0x4e)), hkarat[b], 0x00));
+	}
+	// the products of both lanes are summed before the one reduction
+	return ghash_reduce(_mm_xor_si128(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1)),
+						_mm_xor_si128(_mm256_castsi256_si128(mid), _mm256_extracti128_si256(mid, 1)),
+						_mm_xor_si128(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1)));
+}
+
+// the hash key powers of a group in registers, with the XOR of their halves for the Karatsuba middle products
+VPCLMUL256_TARGET
+static inline __attribute__((always_inline)) void vaes256_gcm_load_powers(__m256i * hpow, __m256i * hkarat, const __m128i * powers) {
+#pragma GCC unroll 8
+	for (int b = 0; b < 8; b++) {
+		hpow[b] = _mm256_loadu_si256((__m256i *)&powers[2 * b]);
+		hkarat[b] = _mm256_xor_si256(hpow[b], _mm256_shuffle_epi32(hpow[b], 0x4e));
+	}
+}
+
+// encrypts and hashes `count` registers of a group from the counter of the message state, `masks` (NULL for a full
+// group) selects the blocks which are read and written, the others are hashed as zero
+VPCLMUL256_TARGET
+static inline __attribute__((always_inline)) __m128i vaes256_gcm_group(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, __m128i x, const __m256i * masks, const int count, const __m256i * hpow, const __m256i * hkarat, int decrypt, const AESKeyMode keymode) {
+	__m256i blocks[8], cipher[8];
+	const __m256i reflect = _mm256_broadcastsi128_si256(_mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+	// reflected, the 32 bit counter of the pre-counter block is the lowest word and counts with a plain 32 bit add
+	__m256i counters = _mm256_broadcastsi128_si256(_mm_insert_epi32(gcm_reflect(gcm->j0), (int)gcm->counter, 0));
+#pragma GCC unroll 8
+	for (int b = 0; b < count; b++) {
+		blocks[b] = _mm256_shuffle_epi8(_mm256_add_epi32(counters, _mm256_set_epi32(0, 0, 0, 2 * b + 1, 0, 0, 0, 2 * b)), reflect);
+	}
+
+	// the cipher text is hashed: the input when decrypting (read before the first store, in place safe)
+	if (decrypt) {
+#pragma GCC unroll 8
+		for (int b = 0; b < count; b++) {
+			__m256i data = masks ? _mm256_maskload_epi64((const long long *)inpt + 4 * b, masks[b]) : _mm256_loadu_si256((__m256i *)inpt + b);
+			cipher[b] = _mm256_shuffle_epi8(data, reflect);
+		}
+	}
+	vaes256_enc(blocks, count, gcm->ctx->enc_schedule, keymode);
+#pragma GCC unroll 8
+	for (int b = 0; b < count; b++) {
+		if (masks) {
+			blocks[b] = _mm256_xor_si256(blocks[b], _mm256_maskload_epi64((const long long *)inpt + 4 * b, masks[b]));
+			_mm256_maskstore_epi64((long long *)outt + 4 * b, masks[b], blocks[b]);
+		} else {
+			blocks[b] = _mm256_xor_si256(blocks[b], _mm256_loadu_si256((__m256i *)inpt + b));
+			_mm256_storeu_si256((__m256i *)outt + b, blocks[b]);
+		}
+		if (!decrypt) {
+			cipher[b] = _mm256_shuffle_epi8(masks ? _mm256_and_si256(blocks[b], masks[b]) : blocks[b], reflect);
+		}
+	}
+	return vaes256_ghash_group(cipher, count, x, hpow, hkarat);
+}
+
+VPCLMUL256_TARGET
+static inline __attribute__((always_inline)) void vaes256_gcm_kernel(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, size_t blocks, int decrypt, const AESKeyMode keymode) {
+	__m256i hpow[8], hkarat[8];
+	__m128i powers[VAES_GROUP_BLOCKS];
+	__m128i x = gcm->hash;
+	size_t i = 0;
+
+	gcm_group_powers(gcm, powers);
+	vaes256_gcm_load_powers(hpow, hkarat, powers);
+	for (; i + VAES_GROUP_BLOCKS <= blocks; i += VAES_GROUP_BLOCKS) {
+		x = vaes256_gcm_group(gcm, inpt + 16 * i, outt + 16 * i, x, NULL, 8, hpow, hkarat, decrypt, keymode);
+		gcm->counter += VAES_GROUP_BLOCKS;
+	}
+
+	// tail [up to fifteen blocks] masked on as few registers as cover it, hashed with the powers of its own length
+	if (i < blocks) {
+		__m256i masks[8];
+		__m128i tail[VAES_GROUP_BLOCKS];
+		int rest = (int)(blocks - i);
+		vaes256_tail_masks(masks, rest);
+		gcm_tail_powers(powers, tail, rest);
+		vaes256_gcm_load_powers(hpow, hkarat, tail);
+		if (rest <= 2) {
+			x = vaes256_gcm_group(gcm, inpt + 16 * i, outt + 16 * i, x, masks, 1, hpow, hkarat, decrypt, keymode);
+		} else if (rest <= 4) {
+			x = vaes256_gcm_group(gcm, inpt + 16 * i, outt + 16 * i, x, masks, 2, hpow, hkarat, decrypt, keymode);
+		} else if (rest <= 8) {
+			x = vaes256_gcm_group(gcm, inpt + 16 * i, outt + 16 * i, x, masks, 4, hpow, hkarat, decrypt, keymode);
+		} else {
+			x = vaes256_gcm_group(gcm, inpt + 16 * i, outt + 16 * i, x, masks, 8, hpow, hkarat, decrypt, keymode);
+		}
+		gcm->counter += (uint32_t)rest;
+	}
+	gcm->hash = x;
+}
+
+VPCLMUL256_TARGET
+static void vaes256_gcm(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, size_t blocks, int decrypt) {
+	aes_specialize(gcm->ctx->keymode, vaes256_gcm_kernel, gcm, inpt, outt, blocks, decrypt);
+}
+
+// multiplies both tweaks of a register by x^16, the two bytes shifted out at the top are folded back in (times 0x87)
+VPCLMUL256_TARGET
+static inline __m256i vaes256_xts_mul16(__m256i tweaks) {
+	__m256i top = _mm256_clmulepi64_epi128(_mm256_bsrli_epi128(tweaks, 14), _mm256_set1_epi64x(0x87), 0x00);
+	return _mm256_xor_si256(_mm256_bslli_epi128(tweaks, 2), top);
+}
+
+// runs `count` registers of a group through XTS, `masks` (NULL for a full group) selects the blocks which are read and
+// written
+VPCLMUL256_TARGET
+static inline __attribute__((always_inline)) void vaes256_xts_group(uint8_t * inpt, uint8_t * outt, const __m256i * tweaks, const __m256i * masks, const int count, const AESKeyContext * ctx, int decrypt, const AESKeyMode keymode) {
+	__m256i blocks[8];
+#pragma GCC unroll 8
+	for (int b = 0; b < count; b++) {
+		__m256i data = masks ? _mm256_maskload_epi64((const long long *)inpt + 4 * b, masks[b]) : _mm256_loadu_si256((__m256i *)inpt + b);
+		blocks[b] = _mm256_xor_si256(data, tweaks[b]);
+	}
+	if (decrypt) {
+		vaes256_dec(blocks, count, ctx->dec_schedule, keymode);
+	} else {
+		vaes256_enc(blocks, count, ctx->enc_schedule, keymode);
+	}
+#pragma GCC unroll 8
+	for (int b = 0; b < count; b++) {
+		if (masks) {
+			_mm256_maskstore_epi64((long long *)outt + 4 * b, masks[b], _mm256_xor_si256(blocks[b], tweaks[b]));
+		} else {
+			_mm256_storeu_si256((__m256i *)outt + b, _mm256_xor_si256(blocks[b], tweaks[b]));
+		}
+	}
+}
+
+// runs XTS on one data unit, `tweak` is the already encrypted tweak of the first block
+VPCLMUL256_TARGET
+static inline __attribute__((always_inline)) void vaes256_xts_kernel(uint8_t * inpt, uint8_t * outt, __m128i tweak, unsigned long length, const AESKeyContext * ctx, int decrypt, const AESKeyMode keymode) {
+	__m256i tweaks[8];
+	size_t i = 0, blocks = xts_blocks(length);
+
+	if (blocks) {
+		// the tweaks of the first group are serial, afterwards every tweak is x^16 times the one a group before
+		__m128i serial[VAES_GROUP_BLOCKS];
+		serial[0] = tweak;
+		for (int b = 1; b < VAES_GROUP_BLOCKS; b++) {
+			serial[b] = xts_double(serial[b - 1]);
+		}
+#pragma GCC unroll 8
+		for (int b = 0; b < 8; b++) {
+			tweaks[b] = _mm256_loadu_si256((__m256i *)&serial[2 * b]);
+		}
+
+		for (; i + VAES_GROUP_BLOCKS <= blocks; i += VAES_GROUP_BLOCKS) {
+			vaes256_xts_group(inpt + 16 * i, outt + 16 * i, tweaks, NULL, 8, ctx, decrypt, keymode);
+#pragma GCC unroll 8
+			for (int b = 0; b < 8; b++) {
+				tweaks[b] = vaes256_xts_mul16(tweaks[b]);
+			}
+		}
+		tweak = _mm256_castsi256_si128(tweaks[0]);
+
+		// tail [up to fifteen blocks] masked on as few registers as cover it, the tweak of the block after it is picked
+		// from the group
+		if (i < blocks) {
+			__m256i masks[8];
+			int rest = (int)(blocks - i);
+			vaes256_tail_masks(masks, rest);
+			if (rest <= 2) {
+				vaes256_xts_group(inpt + 16 * i, outt + 16 * i, tweaks, masks, 1, ctx, decrypt, keymode);
+			} else if (rest <= 4) {
+				vaes256_xts_group(inpt + 16 * i, outt + 16 * i, tweaks, masks, 2, ctx, decrypt, keymode);
+			} else if (rest <= 8) {
+				vaes256_xts_group(inpt + 16 * i, outt + 16 * i, tweaks, masks, 4, ctx, decrypt, keymode);
+			} else {
+				vaes256_xts_group(inpt + 16 * i, outt + 16 * i, tweaks, masks, 8, ctx, decrypt, keymode);
+			}
+#pragma GCC unroll 8
+			for (int b = 0; b < 8; b++) {
+				_mm256_storeu_si256((__m256i *)&serial[2 * b], tweaks[b]);
+			}
+			tweak = serial[rest];
+		}
+	}
+
+	// the last full block and the stolen partial one on the AES-NI kernel, which also rejects too short units
+	unsigned long done = (unsigned long)blocks * 16;
+	if (done < length || length < 16) {
+		aes_xts_ni_crypt_ctx(inpt + done, outt + done, tweak, length - done, ctx, decrypt);
+	}
+}
+
+#pragma mark - VAES AVX2 Core
+void aes_cbc_vaes256_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx) {
+	aes_probe_cipher_entry("cbc_dec", ctx->keymode, clength);
+	aes_specialize(ctx->keymode, vaes256_cbc_dec_kernel, inpt, outt, ivec, clength, ctx);
+	aes_probe_cipher_return("cbc_dec", ctx->keymode, clength);
+}
+
+void aes_ctr_vaes256_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	aes_probe_cipher_entry("ctr", ctx->keymode, mlength);
+	aes_specialize(ctx->keymode, vaes256_ctr_kernel, inpt, outt, ivec, mlength, ctx);
+	aes_probe_cipher_return("ctr", ctx->keymode, mlength);
+}
+
+void aes_gcm_vaes256_enc_ctx(uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx) {
+	aes_probe_cipher_entry("gcm_enc", ctx->keymode, mlength);
+	gcm_enc(vaes256_gcm, inpt, outt, mlength, aad, alength, ivec, ivlength, tag, ctx);
+	aes_probe_cipher_return("gcm_enc", ctx->keymode, mlength);
+}
+
+int aes_gcm_vaes256_dec_ctx(uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx) {
+	aes_probe_cipher_entry("gcm_dec", ctx->keymode, clength);
+	int authentic = gcm_dec(vaes256_gcm, inpt, outt, clength, aad, alength, ivec, ivlength, tag, ctx);
+	aes_probe_cipher_return("gcm_dec", ctx->keymode, clength);
+	return authentic;
+}
+
+void aes_xts_vaes256_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx) {
+	aes_probe_cipher_entry("xts_enc", data_ctx->keymode, mlength);
+	__m128i tweak = _mm_loadu_si128((__m128i *)ivec);
+	aes_ni_enc(&tweak, (__m128i *)tweak_ctx->enc_schedule, tweak_ctx->keymode);
+	aes_specialize(data_ctx->keymode, vaes256_xts_kernel, inpt, outt, tweak, mlength, data_ctx, 0);
+	aes_probe_cipher_return("xts_enc", data_ctx->keymode, mlength);
+}
+
+void aes_xts_vaes256_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx) {
+	aes_probe_cipher_entry("xts_dec", data_ctx->keymode, clength);
+	__m128i tweak = _mm_loadu_si128((__m128i *)ivec);
+	aes_ni_enc(&tweak, (__m128i *)tweak_ctx->enc_schedule, tweak_ctx->keymode);
+	aes_specialize(data_ctx->keymode, vaes256_xts_kernel, inpt, outt, tweak, clength, data_ctx, 1);
+	aes_probe_cipher_return("xts_dec", data_ctx->keymode, clength);
+}
+
+#pragma mark - VAES AVX-512 Internals
+VAES512_TARGET
+static inline __attribute__((always_inline)) void vaes512_load_keys(__m512i * keys, const uint8_t (*schedule)[16], const AESKeyMode keymode) {
+#pragma GCC unroll 15
+	for (int r = 0; r <= (int)keymode; r++) {
+		keys[r] = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i *)schedule[r]));
+	}
+}
+
+// one AES encryption (decryption) of `count` registers [up to sixteen blocks] with the round keys held in registers
+VAES512_TARGET
+static inline __attribute__((always_inline)) void vaes512_enc(__m512i * blocks, const int count, const __m512i * keys, const AESKeyMode keymode) {
+#pragma GCC unroll 4
+	for (int b = 0; b < count; b++) {
+		blocks[b] = _mm512_xor_si512(blocks[b], keys[0]);
+	}
+#pragma GCC unroll 13
+	for (int r = 1; r < (int)keymode; r++) {
+#pragma GCC unroll 4
+		for (int b = 0; b < count; b++) {
+			blocks[b] = _mm512_aesenc_epi128(blocks[b], keys[r]);
+		}
+	}
+#pragma GCC unroll 4
+	for (int b = 0; b < count; b++) {
+		blocks[b] = _mm512_aesenclast_epi128(blocks[b], keys[keymode]);
+	}
+}
+
+VAES512_TARGET
+static inline __attribute__((always_inline)) void vaes512_dec(__m512i * blocks, const int count, const __m512i * keys, const AESKeyMode keymode) {
+#pragma GCC unroll 4
+	for (int b = 0; b < count; b++) {
+		blocks[b] = _mm512_xor_si512(blocks[b], keys[0]);
+	}
+#pragma GCC unroll 13
+	for (int r = 1; r < (int)keymode; r++) {
+#pragma GCC unroll 4
+		for (int b = 0; b < count; b++) {
+			blocks[b] = _mm512_aesdec_epi128(blocks[b], keys[r]);
+		}
+	}
+#pragma GCC unroll 4
+	for (int b = 0; b < count; b++) {
+		blocks[b] = _mm512_aesdeclast_epi128(blocks[b], keys[keymode]);
+	}
+}
+
+// the load and store masks of a group of which only the first `rest` blocks are used, two mask bits per block
+static inline void vaes512_tail_masks(__mmask8 * masks, int rest) {
+	for (int b = 0; b < 4; b++) {
+		int blocks = rest - 4 * b;
+		masks[b] = blocks >= 4 ? 0xff : blocks > 0 ? (__mmask8)((1u << (2 * blocks)) - 1) : 0;
+	}
+}
+
+// decrypts `count` registers of a group, `masks` selects the 64 bit halves of the blocks which are read and written
+VAES512_TARGET
+static inline __attribute__((always_inline)) __m128i vaes512_cbc_dec_group(uint8_t * inpt, uint8_t * outt, __m128i feedback, const __mmask8 * masks, const int count, const __m512i * keys, const AESKeyMode keymode) {
+	__m512i cipher[4], blocks[4];
+#pragma GCC unroll 4
+	for (int b = 0; b < count; b++) {
+		cipher[b] = _mm512_maskz_loadu_epi64(masks[b], (__m512i *)inpt + b);
+		blocks[b] = cipher[b];
+	}
+	vaes512_dec(blocks, count, keys, keymode);
+
+	// the block before every block: the last block of the previous register followed by the first three of this one
+	blocks[0] = _mm512_xor_si512(blocks[0], _mm512_alignr_epi64(cipher[0], _mm512_broadcast_i32x4(feedback), 6));
+#pragma GCC unroll 3
+	for (int b = 1; b < count; b++) {
+		blocks[b] = _mm512_xor_si512(blocks[b], _mm512_alignr_epi64(cipher[b], cipher[b - 1], 6));
+	}
+	// all cipher blocks of the group are loaded before the first store (in place safe)
+#pragma GCC unroll 4
+	for (int b = 0; b < count; b++) {
+		_mm512_mask_storeu_epi64((__m512i *)outt + b, masks[b], blocks[b]);
+	}
+	return _mm512_extracti32x4_epi32(cipher[count - 1], 3);
+}
+
+VAES512_TARGET
+static inline __attribute__((always_inline)) void vaes512_cbc_dec_kernel(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx, const AESKeyMode keymode) {
+	__m512i keys[AES_MAX_ROUND_KEYS];
+	const __mmask8 all[4] = {0xff, 0xff, 0xff, 0xff};
+	__m128i feedback = _mm_loadu_si128((__m128i *)ivec);
+	size_t i = 0, full = clength / 16;
+
+	vaes512_load_keys(keys, ctx->dec_schedule, keymode);
+	for (; i + VAES_GROUP_BLOCKS <= full; i += VAES_GROUP_BLOCKS) {
+		feedback = vaes512_cbc_dec_group(inpt + 16 * i, outt + 16 * i, feedback, all, 4, keys, keymode);
+	}
+
+	// tail [up to fifteen blocks] on as few registers as cover it
+	if (i < full) {
+		__mmask8 masks[4];
+		int rest = (int)(full - i);
+		vaes512_tail_masks(masks, rest);
+		if (rest <= 4) {
+			vaes512_cbc_dec_group(inpt + 16 * i, outt + 16 * i, feedback, masks, 1, keys, keymode);
+		} else if (rest <= 8) {
+			vaes512_cbc_dec_group(inpt + 16 * i, outt + 16 * i, feedback, masks, 2, keys, keymode);
+		} else {
+			vaes512_cbc_dec_group(inpt + 16 * i, outt + 16 * i, feedback, masks, 4, keys, keymode);
+		}
+	}
+}
+
+// encrypts `count` registers of counter blocks and XORs `length` bytes (at most `64 * count`) of the input onto them
+VAES512_TARGET
+static inline __attribute__((always_inline)) void vaes512_ctr_group(uint8_t * inpt, uint8_t * outt, uint64_t hi, uint64_t lo, unsigned long length, const int count, const __m512i * keys, const AESKeyMode keymode) {
+	__m512i blocks[4];
+	const __m512i bswap = _mm512_broadcast_i32x4(_mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+
+	if (lo <= UINT64_MAX - (VAES_GROUP_BLOCKS - 1)) {
+		// no carry into the high half within the group, the counters are the (little endian) base plus 0 .. 15
+		__m512i base = _mm512_broadcast_i32x4(_mm_set_epi64x((long long)hi, (long long)lo));
+#pragma GCC unroll 4
+		for (int b = 0; b < count; b++) {
+			__m512i step = _mm512_set_epi64(0, 4 * b + 3, 0, 4 * b + 2, 0, 4 * b + 1, 0, 4 * b);
+			blocks[b] = _mm512_shuffle_epi8(_mm512_add_epi64(base, step), bswap);
+		}
+	} else {
+		uint8_t counters[16 * VAES_GROUP_BLOCKS];
+		ctr_blocks_slow(counters, hi, lo, VAES_GROUP_BLOCKS);
+#pragma GCC unroll 4
+		for (int b = 0; b < count; b++) {
+			blocks[b] = _mm512_loadu_si512((__m512i *)counters + b);
+		}
+	}
+	vaes512_enc(blocks, count, keys, keymode);
+
+	if (length == 64UL * count) {
+#pragma GCC unroll 4
+		for (int b = 0; b < count; b++) {
+			__m512i data = _mm512_loadu_si512((__m512i *)inpt + b);
+			_mm512_storeu_si512((__m512i *)outt + b, _mm512_xor_si512(blocks[b], data));
+		}
+	} else {
+		// byte masks, the bytes past the message are neither read nor written
+#pragma GCC unroll 4
+		for (int b = 0; b < count; b++) {
+			long bytes = (long)length - 64 * b;
+			__mmask64 mask = bytes >= 64 ? ~0ULL : bytes > 0 ? (1ULL << bytes) - 1 : 0;
+			__m512i data = _mm512_maskz_loadu_epi8(mask, (__m512i *)inpt + b);
+			_mm512_mask_storeu_epi8((__m512i *)outt + b, mask, _mm512_xor_si512(blocks[b], data));
+		}
+	}
+}
+
+VAES512_TARGET
+static inline __attribute__((always_inline)) void vaes512_ctr_kernel(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, const AESKeyMode keymode) {
+	__m512i keys[AES_MAX_ROUND_KEYS];
+	uint64_t hi = aes_load_be64(ivec), lo = aes_load_be64(ivec + 8);
+	unsigned long i = 0;
+
+	vaes512_load_keys(keys, ctx->enc_schedule, keymode);
+	for (; i + 16 * VAES_GROUP_BLOCKS <= mlength; i += 16 * VAES_GROUP_BLOCKS) {
+		vaes512_ctr_group(inpt + i, outt + i, hi, lo, 16 * VAES_GROUP_BLOCKS, 4, keys, keymode);
+		lo += VAES_GROUP_BLOCKS;
+		hi += (lo < VAES_GROUP_BLOCKS);
+	}
+
+	// tail [up to 255 bytes] on as few registers as cover it
+	unsigned long rest = mlength - i;
+	if (rest == 0) {
+		return;
+	} else if (rest <= 64) {
+		vaes512_ctr_group(inpt + i, outt + i, hi, lo, rest, 1, keys, keymode);
+	} else if (rest <= 128) {
+		vaes512_ctr_group(inpt + i, outt + i, hi, lo, rest, 2, keys, keymode);
+	} else {
+		vaes512_ctr_group(inpt + i, outt + i, hi, lo, rest, 4, keys, keymode);
+	}
+}
+
+// hashes `count` registers of (reflected) cipher blocks with a single reduction, `x` is added onto the first block
+VPCLMUL512_TARGET
+static inline __attribute__((always_inline)) __m128i vaes512_ghash_group(__m512i * cipher, const int count, __m128i x, const __m512i * hpow, const __m512i * hkarat) {
+	__m512i lo = _mm512_setzero_si512(), mid = _mm512_setzero_si512(), hi = _mm512_setzero_si512();
+	cipher[0] = _mm512_xor_si512(cipher[0], _mm512_inserti32x4(_mm512_setzero_si512(), x, 0));
+#pragma GCC unroll 4
+	for (int b = 0; b < count; b++) {
+		lo = _mm512_xor_si512(lo, _mm512_clmulepi64_epi128(cipher[b], hpow[b], 0x00));
+		hi = _mm512_xor_si512(hi, _mm512_clmulepi64_epi128(cipher[b], hpow[b], 0x11));
+		mid = _mm512_xor_si512(mid, _mm512_clmulepi64_epi128(_mm512_xor_si512(cipher[b], _mm512_shuffle_epi32(cipher[b], (_MM_PERM_ENUM)0x4e)), hkarat[b], 0x00));
+	}
+	// the products of all four lanes are summed before the one reduction
+	__m256i lo2 = _mm256_xor_si256(_mm512_castsi512_si256(lo), _mm512_extracti64x4_epi64(lo, 1));
+	__m256i mid2 = _mm256_xor_si256(_mm512_castsi512_si256(mid), _mm512_extracti64x4_epi64(mid, 1));
+	__m256i hi2 = _mm256_xor_si256(_mm512_castsi512_si256(hi), _mm512_extracti64x4_epi64(hi, 1));
+	return ghash_reduce(_mm_xor_si128(_mm256_castsi256_si128(lo2), _mm256_extracti128_si256(lo2, 1)),
+						_mm_xor_si128(_mm256_castsi256_si128(mid2), _mm256_extracti128_si256(mid2, 1)),
+						_mm_xor_si128(_mm256_castsi256_si128(hi2), _mm256_extracti128_si256(hi2, 1)));
+}
+
+// the hash key powers of a group in registers, with the XOR of their halves for the Karatsuba middle products
+VPCLMUL512_TARGET
+static inline __attribute__((always_inline)) void vaes512_gcm_load_powers(__m512i * hpow, __m512i * hkarat, const __m128i * powers) {
+#pragma GCC unroll 4
+	for (int b = 0; b < 4; b++) {
+		hpow[b] = _mm512_loadu_si512((__m512i *)&powers[4 * b]);
+		hkarat[b] = _mm512_xor_si512(hpow[b], _mm512_shuffle_epi32(hpow[b], (_MM_PERM_ENUM)0x4e));
+	}
+}
+
+// encrypts and hashes `count` registers of a group from the counter of the message state, `masks` selects the 64 bit
+// halves of the blocks which are read and written, the others are hashed as zero
+VPCLMUL512_TARGET
+static inline __attribute__((always_inline)) __m128i vaes512_gcm_group(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, __m128i x, const __mmask8 * masks, const int count, const __m512i * hpow, const __m512i * hkarat, const __m512i * keys, int decrypt, const AESKeyMode keymode) {
+	__m512i blocks[4], cipher[4];
+	const __m512i reflect = _mm512_broadcast_i32x4(_mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+	// reflected, the 32 bit counter of the pre-counter block is the lowest word and counts with a plain 32 bit add
+	__m512i counters = _mm512_broadcast_i32x4(_mm_insert_epi32(gcm_reflect(gcm->j0), (int)gcm->counter, 0));
+#pragma GCC unroll 4
+	for (int b = 0; b < count; b++) {
+		__m512i step = _mm512_set_epi32(0, 0, 0, 4 * b + 3, 0, 0, 0, 4 * b + 2, 0, 0, 0, 4 * b + 1, 0, 0, 0, 4 * b);
+		blocks[b] = _mm512_shuffle_epi8(_mm512_add_epi32(counters, step), reflect);
+	}
+
+	// the cipher text is hashed: the input when decrypting (read before the first store, in place safe)
+	if (decrypt) {
+#pragma GCC unroll 4
+		for (int b = 0; b < count; b++) {
+			cipher[b] = _mm512_shuffle_epi8(_mm512_maskz_loadu_epi64(masks[b], (__m512i *)inpt + b), reflect);
+		}
+	}
+	vaes512_enc(blocks, count, keys, keymode);
+#pragma GCC unroll 4
+	for (int b = 0; b < count; b++) {
+		blocks[b] = _mm512_xor_si512(blocks[b], _mm512_maskz_loadu_epi64(masks[b], (__m512i *)inpt + b));
+		_mm512_mask_storeu_epi64((__m512i *)outt + b, masks[b], blocks[b]);
+		if (!decrypt) {
+			cipher[b] = _mm512_shuffle_epi8(_mm512_maskz_mov_epi64(masks[b], blocks[b]), reflect);
+		}
+	}
+	return vaes512_ghash_group(cipher, count, x, hpow, hkarat);
+}
+
+VPCLMUL512_TARGET
+static inline __attribute__((always_inline)) void vaes512_gcm_kernel(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, size_t blocks, int decrypt, const AESKeyMode keymode) {
+	__m512i keys[AES_MAX_ROUND_KEYS], hpow[4], hkarat[4];
+	const __mmask8 all[4] = {0xff, 0xff, 0xff, 0xff};
+	__m128i powers[VAES_GROUP_BLOCKS];
+	__m128i x = gcm->hash;
+	size_t i = 0;
+
+	vaes512_load_keys(keys, gcm->ctx->enc_schedule, keymode);
+	gcm_group_powers(gcm, powers);
+	vaes512_gcm_load_powers(hpow, hkarat, powers);
+	for (; i + VAES_GROUP_BLOCKS <= blocks; i += VAES_GROUP_BLOCKS) {
+		x = vaes512_gcm_group(gcm, inpt + 16 * i, outt + 16 * i, x, all, 4, hpow, hkarat, keys, decrypt, keymode);
+		gcm->counter += VAES_GROUP_BLOCKS;
+	}
+
+	// tail [up to fifteen blocks] masked on as few registers as cover it, hashed with the powers of its own length
+	if (i < blocks) {
+		__mmask8 masks[4];
+		__m128i tail[VAES_GROUP_BLOCKS];
+		int rest = (int)(blocks - i);
+		vaes512_tail_masks(masks, rest);
+		gcm_tail_powers(powers, tail, rest);
+		vaes512_gcm_load_powers(hpow, hkarat, tail);
+		if (rest <= 4) {
+			x = vaes512_gcm_group(gcm, inpt + 16 * i, outt + 16 * i, x, masks, 1, hpow, hkarat, keys, decrypt, keymode);
+		} else if (rest <= 8) {
+			x = vaes512_gcm_group(gcm, inpt + 16 * i, outt + 16 * i, x, masks, 2, hpow, hkarat, keys, decrypt, keymode);
+		} else {
+			x = vaes512_gcm_group(gcm, inpt + 16 * i, outt + 16 * i, x, masks, 4, hpow, hkarat, keys, decrypt, keymode);
+		}
+		gcm->counter += (uint32_t)rest;
+	}
+	gcm->hash = x;
+}
+
+VPCLMUL512_TARGET
+static void vaes512_gcm(AESGCMContext * gcm, uint8_t * inpt, uint8_t * outt, size_t blocks, int decrypt) {
+	aes_specialize(gcm->ctx->keymode, vaes512_gcm_kernel, gcm, inpt, outt, blocks, decrypt);
+}
+
+// multiplies the four tweaks of a register by x^16, the two bytes shifted out at the top are folded back in (times 0x87)
+VPCLMUL512_TARGET
+static inline __m512i vaes512_xts_mul16(__m512i tweaks) {
+	__m512i top = _mm512_clmulepi64_epi128(_mm512_bsrli_epi128(tweaks, 14), _mm512_set1_epi64(0x87), 0x00);
+	return _mm512_xor_si512(_mm512_bslli_epi128(tweaks, 2), top);
+}
+
+// runs `count` registers of a group through XTS, `masks` selects the 64 bit halves of the blocks which are read and
+// written
+VPCLMUL512_TARGET
+static inline __attribute__((always_inline)) void vaes512_xts_group(uint8_t * inpt, uint8_t * outt, const __m512i * tweaks, const __mmask8 * masks, const int count, const __m512i * keys, int decrypt, const AESKeyMode keymode) {
+	__m512i blocks[4];
+#pragma GCC unroll 4
+	for (int b = 0; b < count; b++) {
+		blocks[b] = _mm512_xor_si512(_mm512_maskz_loadu_epi64(masks[b], (__m512i *)inpt + b), tweaks[b]);
+	}
+	if (decrypt) {
+		vaes512_dec(blocks, count, keys, keymode);
+	} else {
+		vaes512_enc(blocks, count, keys, keymode);
+	}
+#pragma GCC unroll 4
+	for (int b = 0; b < count; b++) {
+		_mm512_mask_storeu_epi64((__m512i *)outt + b, masks[b], _mm512_xor_si512(blocks[b], tweaks[b]));
+	}
+}
+
+// runs XTS on one data unit, `tweak` is the already encrypted tweak of the first block
+VPCLMUL512_TARGET
+static inline __attribute__((always_inline)) void vaes512_xts_kernel(uint8_t * inpt, uint8_t * outt, __m128i tweak, unsigned long length, const AESKeyContext * ctx, int decrypt, const AESKeyMode keymode) {
+	__m512i keys[AES_MAX_ROUND_KEYS], tweaks[4];
+	const __mmask8 all[4] = {0xff, 0xff, 0xff, 0xff};
+	size_t i = 0, blocks = xts_blocks(length);
+
+	if (blocks) {
+		// the tweaks of the first group are serial, afterwards every tweak is x^16 times the one a group before
+		__m128i serial[VAES_GROUP_BLOCKS];
+		serial[0] = tweak;
+		for (int b = 1; b < VAES_GROUP_BLOCKS; b++) {
+			serial[b] = xts_double(serial[b - 1]);
+		}
+#pragma GCC unroll 4
+		for (int b = 0; b < 4; b++) {
+			tweaks[b] = _mm512_loadu_si512((__m512i *)&serial[4 * b]);
+		}
+		vaes512_load_keys(keys, decrypt ? ctx->dec_schedule : ctx->enc_schedule, keymode);
+
+		for (; i + VAES_GROUP_BLOCKS <= blocks; i += VAES_GROUP_BLOCKS) {
+			vaes512_xts_group(inpt + 16 * i, outt + 16 * i, tweaks, all, 4, keys, decrypt, keymode);
+#pragma GCC unroll 4
+			for (int b = 0; b < 4; b++) {
+				tweaks[b] = vaes512_xts_mul16(tweaks[b]);
+			}
+		}
+		tweak = _mm512_castsi512_si128(tweaks[0]);
+
+		// tail [up to fifteen blocks] masked on as few registers as cover it, the tweak of the block after it is picked
+		// from the group
+		if (i < blocks) {
+			__mmask8 masks[4];
+			int rest = (int)(blocks - i);
+			vaes512_tail_masks(masks, rest);
+			if (rest <= 4) {
+				vaes512_xts_group(inpt + 16 * i, outt + 16 * i, tweaks, masks, 1, keys, decrypt, keymode);
+			} else if (rest <= 8) {
+				vaes512_xts_group(inpt + 16 * i, outt + 16 * i, tweaks, masks, 2, keys, decrypt, keymode);
+			} else {
+				vaes512_xts_group(inpt + 16 * i, outt + 16 * i, tweaks, masks, 4, keys, decrypt, keymode);
+			}
+#pragma GCC unroll 4
+			for (int b = 0; b < 4; b++) {
+				_mm512_storeu_si512((__m512i *)&serial[4 * b], tweaks[b]);
+			}
+			tweak = serial[rest];
+		}
+	}
+
+	// the last full block and the stolen partial one on the AES-NI kernel, which also rejects too short units
+	unsigned long done = (unsigned long)blocks * 16;
+	if (done < length || length < 16) {
+		aes_xts_ni_crypt_ctx(inpt + done, outt + done, tweak, length - done, ctx, decrypt);
+	}
+}
+
+#pragma mark - VAES AVX-512 Core
+void aes_cbc_vaes512_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx) {
+	aes_probe_cipher_entry("cbc_dec", ctx->keymode, clength);
+	aes_specialize(ctx->keymode, vaes512_cbc_dec_kernel, inpt, outt, ivec, clength, ctx);
+	aes_probe_cipher_return("cbc_dec", ctx->keymode, clength);
+}
+
+void aes_ctr_vaes512_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	aes_probe_cipher_entry("ctr", ctx->keymode, mlength);
+	aes_specialize(ctx->keymode, vaes512_ctr_kernel, inpt, outt, ivec, mlength, ctx);
+	aes_probe_cipher_return("ctr", ctx->keymode, mlength);
+}
+
+void aes_gcm_vaes512_enc_ctx(uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx) {
+	aes_probe_cipher_entry("gcm_enc", ctx->keymode, mlength);
+	gcm_enc(vaes512_gcm, inpt, outt, mlength, aad, alength, ivec, ivlength, tag, ctx);
+	aes_probe_cipher_return("gcm_enc", ctx->keymode, mlength);
+}
+
+int aes_gcm_vaes512_dec_ctx(uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx) {
+	aes_probe_cipher_entry("gcm_dec", ctx->keymode, clength);
+	int authentic = gcm_dec(vaes512_gcm, inpt, outt, clength, aad, alength, ivec, ivlength, tag, ctx);
+	aes_probe_cipher_return("gcm_dec", ctx->keymode, clength);
+	return authentic;
+}
+
+void aes_xts_vaes512_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx) {
+	aes_probe_cipher_entry("xts_enc", data_ctx->keymode, mlength);
+	__m128i tweak = _mm_loadu_si128((__m128i *)ivec);
+	aes_ni_enc(&tweak, (__m128i *)tweak_ctx->enc_schedule, tweak_ctx->keymode);
+	aes_specialize(data_ctx->keymode, vaes512_xts_kernel, inpt, outt, tweak, mlength, data_ctx, 0);
+	aes_probe_cipher_return("xts_enc", data_ctx->keymode, mlength);
+}
+
+void aes_xts_vaes512_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx) {
+	aes_probe_cipher_entry("xts_dec", data_ctx->keymode, clength);
+	__m128i tweak = _mm_loadu_si128((__m128i *)ivec);
+	aes_ni_enc(&tweak, (__m128i *)tweak_ctx->enc_schedule, tweak_ctx->keymode);
+	aes_specialize(data_ctx->keymode, vaes512_xts_kernel, inpt, outt, tweak, clength, data_ctx, 1);
+	aes_probe_cipher_return("xts_dec", data_ctx->keymode, clength);
+}
+
+#endif /* protection */
@@ -0,0 +1,257 @@
+//
+//  AESvaes.h
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -maes -mpclmul -msse4.1
+// * * * * * * * * * * * * * * * * * * * *
+
+/*!
+ @file AESvaes.h
+
+ The header file for the wide CBC decryption, CTR, GCM and XTS kernels implemented with the vector AES instructions
+ (VAES), which run one AES round on two (AVX2, 256 bit) or four (AVX-512, 512 bit) blocks per instruction. GHASH and
+ the XTS tweaks use the carry less multiplication of the same width (VPCLMULQDQ).
+
+ The kernels use the key contexts of the AES-NI implementation (`aes_ni_key_context_init`) and leave the parts which
+ are not whole blocks to its kernels (the GCM setup, partial block and tag, the stolen block of XTS), as well as GCM
+ messages and XTS data units shorter than a group of sixteen blocks. The functions of both widths carry their own
+ `target` attributes so the file builds with the same flags as `AESni.c`. Which width may be called is up to the caller
+ (see `aes_backend_vaes` in `AESdispatch.h`, which probes the CPU and the OS).
+
+ @version 0.0.1
+ */
+
+#ifndef AESvaes_h
+#define AESvaes_h
+
+#include "AESni.h"
+
+// the VAES intrinsics (and the target names) exist since GCC 8 and clang 6
+#ifdef intel_active
+	#if __has_include(<immintrin.h>) && (defined(__clang__) ? __clang_major__ >= 6 : __GNUC__ >= 8)
+		#include <immintrin.h>
+		#define vaes_active
+	#endif
+#endif
+
+#ifdef vaes_active
+#pragma mark - VAES AVX2
+/*!
+ @name VAES AVX2
+ Sixteen blocks per iteration in eight 256 bit registers, for CPUs with VAES and AVX2 (e.g. Zen 3, Alder Lake)
+
+ A rest of less than sixteen blocks runs on as few registers as cover it. AVX2 only masks loads and stores by 64 bit
+ words, so whole blocks are masked and the bytes of a partial CTR block are copied through a buffer. GCM and XTS need
+ VPCLMULQDQ as well (every CPU with VAES so far has it).
+ */
+///@{
+/*!
+ @brief Decrypts the data using CBC AES with 256 bit VAES
+
+ Same as `aes_cbc_ni_dec_ctx`, every cipher block is XORed onto the block after it straight from the registers (lane
+ permute), so the decryption can be done in place (`inpt == outt`).
+
+ @param inpt The cipher to decrypt
+ @param outt The location where the decrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC decryption
+ @param clength The length of the input cipher [in bytes] (only full blocks are processed)
+ @param ctx The key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes,vaes,avx2")))
+void aes_cbc_vaes256_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts or Decrypts the data using CTR AES with 256 bit VAES
+
+ Same as `aes_ctr_ni_ctx` (the full 128 bits of the counter block are incremented).
+
+ @param inpt The data to encrypt/decrypt
+ @param outt The location where the encrypted/decrypted data will be written
+ @param ivec The initial counter block (it is not changed)
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes,vaes,avx2")))
+void aes_ctr_vaes256_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts the data using GCM AES with 256 bit VAES
+
+ Same as `aes_gcm_ni_enc_ctx`, sixteen blocks are encrypted and hashed per iteration with a single GHASH reduction.
+
+ @param inpt The data to encrypt
+ @param outt The location where the encrypted data will be written
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param aad The additional authenticated data
+ @param alength The length of the additional authenticated data [in bytes]
+ @param ivec The IV (`12` bytes recommended)
+ @param ivlength The length of the IV [in bytes]
+ @param tag The location where the `16` byte tag will be written
+ @param ctx The key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(6, 8, 9), target("aes,pclmul,vaes,vpclmulqdq,avx2")))
+void aes_gcm_vaes256_enc_ctx(uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx);
+
+/*!
+ @brief Decrypts the data using GCM AES with 256 bit VAES and verifies the tag
+
+ Same as `aes_gcm_ni_dec_ctx`, the output is wiped if the tag does not match.
+
+ @param inpt The cipher to decrypt
+ @param outt The location where the decrypted data will be written
+ @param clength The length of the input cipher [in bytes] which is also the output length
+ @param aad The additional authenticated data
+ @param alength The length of the additional authenticated data [in bytes]
+ @param ivec The IV the message was encrypted with
+ @param ivlength The length of the IV [in bytes]
+ @param tag The `16` byte tag to verify
+ @param ctx The key context set up with `aes_ni_key_context_init`
+
+ @returns `1` if the tag matches (the data is authentic), `0` otherwise
+ */
+__attribute__((visibility("hidden"), nonnull(6, 8, 9), target("aes,pclmul,vaes,vpclmulqdq,avx2")))
+int aes_gcm_vaes256_dec_ctx(uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts one data unit using XTS AES with 256 bit VAES
+
+ Same as `aes_xts_ni_enc_ctx`, the tweaks of a group are advanced together by x^16. The encryption can be
+ done in place (`inpt == outt`).
+
+ @param inpt The data to encrypt
+ @param outt The location where the encrypted data will be written
+ @param ivec The `16` byte tweak
+ @param mlength The length of the data unit [in bytes, at least `16`] which is also the output length
+ @param data_ctx The key context of the data key set up with `aes_ni_key_context_init`
+ @param tweak_ctx The key context of the tweak key set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5, 6), target("aes,pclmul,vaes,vpclmulqdq,avx2")))
+void aes_xts_vaes256_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx);
+
+/*!
+ @brief Decrypts one data unit using XTS AES with 256 bit VAES
+
+ Same as `aes_xts_ni_dec_ctx`. The decryption can be done in place (`inpt == outt`).
+
+ @param inpt The data to decrypt
+ @param outt The location where the decrypted data will be written
+ @param ivec The `16` byte tweak the data unit was encrypted with
+ @param clength The length of the data unit [in bytes, at least `16`] which is also the output length
+ @param data_ctx The key context of the data key set up with `aes_ni_key_context_init`
+ @param tweak_ctx The key context of the tweak key set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5, 6), target("aes,pclmul,vaes,vpclmulqdq,avx2")))
+void aes_xts_vaes256_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx);
+///@}
+
+#pragma mark - VAES AVX-512
+/*!
+ @name VAES AVX-512
+ Sixteen blocks per iteration in four 512 bit registers, for CPUs with VAES, AVX-512F, BW and VL (e.g. Ice Lake,
+ Zen 4)
+
+ All round keys are held in registers. A rest of less than sixteen blocks goes through the same kernel with masked
+ loads and stores (blocks for CBC, GCM and XTS, bytes for CTR), so nothing outside the message is read or written.
+ */
+///@{
+/*!
+ @brief Decrypts the data using CBC AES with 512 bit VAES
+
+ Same as `aes_cbc_vaes256_dec_ctx` on four blocks per register.
+
+ @param inpt The cipher to decrypt
+ @param outt The location where the decrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC decryption
+ @param clength The length of the input cipher [in bytes] (only full blocks are processed)
+ @param ctx The key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes,vaes,avx512f,avx512bw,avx512vl")))
+void aes_cbc_vaes512_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts or Decrypts the data using CTR AES with 512 bit VAES
+
+ Same as `aes_ctr_vaes256_ctx` on four blocks per register.
+
+ @param inpt The data to encrypt/decrypt
+ @param outt The location where the encrypted/decrypted data will be written
+ @param ivec The initial counter block (it is not changed)
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("aes,vaes,avx512f,avx512bw,avx512vl")))
+void aes_ctr_vaes512_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts the data using GCM AES with 512 bit VAES
+
+ Same as `aes_gcm_ni_enc_ctx`, sixteen blocks are encrypted and hashed per iteration with a single GHASH reduction.
+
+ @param inpt The data to encrypt
+ @param outt The location where the encrypted data will be written
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param aad The additional authenticated data
+ @param alength The length of the additional authenticated data [in bytes]
+ @param ivec The IV (`12` bytes recommended)
+ @param ivlength The length of the IV [in bytes]
+ @param tag The location where the `16` byte tag will be written
+ @param ctx The key context set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(6, 8, 9), target("aes,pclmul,vaes,vpclmulqdq,avx512f,avx512bw,avx512vl")))
+void aes_gcm_vaes512_enc_ctx(uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx);
+
+/*!
+ @brief Decrypts the data using GCM AES with 512 bit VAES and verifies the tag
+
+ Same as `aes_gcm_ni_dec_ctx`, the output is wiped if the tag does not match.
+
+ @param inpt The cipher to decrypt
+ @param outt The location where the decrypted data will be written
+ @param clength The length of the input cipher [in bytes] which is also the output length
+ @param aad The additional authenticated data
+ @param alength The length of the additional authenticated data [in bytes]
+ @param ivec The IV the message was encrypted with
+ @param ivlength The length of the IV [in bytes]
+ @param tag The `16` byte tag to verify
+ @param ctx The key context set up with `aes_ni_key_context_init`
+
+ @returns `1` if the tag matches (the data is authentic), `0` otherwise
+ */
+__attribute__((visibility("hidden"), nonnull(6, 8, 9), target("aes,pclmul,vaes,vpclmulqdq,avx512f,avx512bw,avx512vl")))
+int aes_gcm_vaes512_dec_ctx(uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts one data unit using XTS AES with 512 bit VAES
+
+ Same as `aes_xts_ni_enc_ctx`, the tweaks of a group are advanced together by x^16. The encryption can be
+ done in place (`inpt == outt`).
+
+ @param inpt The data to encrypt
+ @param outt The location where the encrypted data will be written
+ @param ivec The `16` byte tweak
+ @param mlength The length of the data unit [in bytes, at least `16`] which is also the output length
+ @param data_ctx The key context of the data key set up with `aes_ni_key_context_init`
+ @param tweak_ctx The key context of the tweak key set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5, 6), target("aes,pclmul,vaes,vpclmulqdq,avx512f,avx512bw,avx512vl")))
+void aes_xts_vaes512_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx);
+
+/*!
+ @brief Decrypts one data unit using XTS AES with 512 bit VAES
+
+ Same as `aes_xts_ni_dec_ctx`. The decryption can be done in place (`inpt == outt`).
+
+ @param inpt The data to decrypt
+ @param outt The location where the decrypted data will be written
+ @param ivec The `16` byte tweak the data unit was encrypted with
+ @param clength The length of the data unit [in bytes, at least `16`] which is also the output length
+ @param data_ctx The key context of the data key set up with `aes_ni_key_context_init`
+ @param tweak_ctx The key context of the tweak key set up with `aes_ni_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5, 6), target("aes,pclmul,vaes,vpclmulqdq,avx512f,avx512bw,avx512vl")))
+void aes_xts_vaes512_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * data_ctx, const AESKeyContext * tweak_ctx);
+///@}
+#endif
+
+#endif /* AESvaes_h */
@@ -0,0 +1,369 @@
+//
+//  AESvpaes.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -mssse3.
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file AESvpaes.c
+
+ The source file for the AES encryption (basic as well as CBC and CTR mode) implemented with SSSE3 vector permutes
+
+ Every byte is mapped into the tower field GF((2^4)^2), where the inversion of SubBytes only needs arithmetic on
+ nibbles: products go through log / exp tables of GF(2^4) and all lookups are `pshufb` with a 16 byte table held in
+ a register, which is why there are no data dependent memory accesses. The linear parts of the S-box (the basis
+ change and the affine transformation) and the multiplications of MixColumns are folded into the lookup tables on
+ the way in and out of the tower field.
+
+ @compilerflag -fvisibility=hidden -mssse3
+ @version 0.0.1
+ */
+
+#include "AESvpaes.h"
+
+#ifdef vpaes_active
+#pragma mark - Constants
+// GF(2^4) [x^4 + x + 1]: log (0 -> 0xc0), negated log (0 -> 0xc0), exp, and nu * j^2 for the norm
+static const uint8_t vp_field[4][16] __attribute__((aligned(16))) = {
+	{0xc0, 0x00, 0x01, 0x04, 0x02, 0x08, 0x05, 0x0a, 0x03, 0x0e, 0x09, 0x07, 0x06, 0x0d, 0x0b, 0x0c},
+	{0xc0, 0x00, 0x0e, 0x0b, 0x0d, 0x07, 0x0a, 0x05, 0x0c, 0x01, 0x06, 0x08, 0x09, 0x02, 0x04, 0x03},
+	{0x01, 0x02, 0x04, 0x08, 0x03, 0x06, 0x0c, 0x0b, 0x05, 0x0a, 0x07, 0x0e, 0x0f, 0x0d, 0x09, 0x00},
+	{0x00, 0x08, 0x06, 0x0e, 0x0b, 0x03, 0x0d, 0x05, 0x0a, 0x02, 0x0c, 0x04, 0x01, 0x09, 0x07, 0x0f}
+};
+
+// AES byte -> tower coordinates a and b [each indexed by the low and the high nibble]
+static const uint8_t vp_enc_in[4][16] __attribute__((aligned(16))) = {
+	{0x00, 0x01, 0x00, 0x01, 0x06, 0x07, 0x06, 0x07, 0x0c, 0x0d, 0x0c, 0x0d, 0x0a, 0x0b, 0x0a, 0x0b},
+	{0x00, 0x0c, 0x05, 0x09, 0x04, 0x08, 0x01, 0x0d, 0x05, 0x09, 0x00, 0x0c, 0x01, 0x0d, 0x04, 0x08},
+	{0x00, 0x01, 0x02, 0x03, 0x02, 0x03, 0x00, 0x01, 0x08, 0x09, 0x0a, 0x0b, 0x0a, 0x0b, 0x08, 0x09},
+	{0x00, 0x0f, 0x08, 0x07, 0x07, 0x08, 0x0f, 0x00, 0x0b, 0x04, 0x03, 0x0c, 0x0c, 0x03, 0x04, 0x0b}
+};
+
+// inverted coordinates b' and a' -> S(x) and 2 * S(x) [the affine constant is folded into the tables]
+static const uint8_t vp_enc_out[4][16] __attribute__((aligned(16))) = {
+	{0x63, 0x31, 0x5d, 0x0f, 0x06, 0x54, 0x38, 0x6a, 0x03, 0x51, 0x3d, 0x6f, 0x66, 0x34, 0x58, 0x0a},
+	{0x00, 0x4d, 0x8c, 0xc1, 0xce, 0x83, 0x42, 0x0f, 0x56, 0x1b, 0xda, 0x97, 0x98, 0xd5, 0x14, 0x59},
+	{0xc6, 0x62, 0xba, 0x1e, 0x0c, 0xa8, 0x70, 0xd4, 0x06, 0xa2, 0x7a, 0xde, 0xcc, 0x68, 0xb0, 0x14},
+	{0x00, 0x9a, 0x03, 0x99, 0x87, 0x1d, 0x84, 0x1e, 0xac, 0x36, 0xaf, 0x35, 0x2b, 0xb1, 0x28, 0xb2}
+};
+
+// AES byte -> tower coordinates of the inverse affine transformation
+static const uint8_t vp_dec_in[4][16] __attribute__((aligned(16))) = {
+	{0x07, 0x0f, 0x08, 0x00, 0x0f, 0x07, 0x00, 0x08, 0x0f, 0x07, 0x00, 0x08, 0x07, 0x0f, 0x08, 0x00},
+	{0x00, 0x06, 0x09, 0x0f, 0x09, 0x0f, 0x00, 0x06, 0x02, 0x04, 0x0b, 0x0d, 0x0b, 0x0d, 0x02, 0x04},
+	{0x03, 0x0e, 0x05, 0x08, 0x02, 0x0f, 0x04, 0x09, 0x09, 0x04, 0x0f, 0x02, 0x08, 0x05, 0x0e, 0x03},
+	{0x00, 0x01, 0x0e, 0x0f, 0x06, 0x07, 0x08, 0x09, 0x0b, 0x0a, 0x05, 0x04, 0x0d, 0x0c, 0x03, 0x02}
+};
+
+// inverted coordinates b' and a' -> S^-1(x), 14 * S^-1(x), 11 * S^-1(x), 13 * S^-1(x), and 9 * S^-1(x)
+static const uint8_t vp_dec_out[10][16] __attribute__((aligned(16))) = {
+	{0x00, 0xa2, 0x02, 0xa0, 0xb8, 0x1a, 0xba, 0x18, 0xdb, 0x79, 0xd9, 0x7b, 0x63, 0xc1, 0x61, 0xc3},
+	{0x00, 0xa3, 0x5e, 0xfd, 0x58, 0xfb, 0x06, 0xa5, 0x8b, 0x28, 0xd5, 0x76, 0xd3, 0x70, 0x8d, 0x2e},
+	{0x00, 0x86, 0x1c, 0x9a, 0x0a, 0x8c, 0x16, 0x90, 0x6e, 0xe8, 0x72, 0xf4, 0x64, 0xe2, 0x78, 0xfe},
+	{0x00, 0x88, 0x19, 0x91, 0x3d, 0xb5, 0x24, 0xac, 0x23, 0xab, 0x3a, 0xb2, 0x1e, 0x96, 0x07, 0x8f},
+	{0x00, 0x9a, 0x16, 0x8c, 0x64, 0xfe, 0x72, 0xe8, 0xf4, 0x6e, 0xe2, 0x78, 0x90, 0x0a, 0x86, 0x1c},
+	{0x00, 0x91, 0x24, 0xb5, 0x1e, 0x8f, 0x3a, 0xab, 0xb2, 0x23, 0x96, 0x07, 0xac, 0x3d, 0x88, 0x19},
+	{0x00, 0x7b, 0x1a, 0x61, 0xd9, 0xa2, 0xc3, 0xb8, 0x18, 0x63, 0x02, 0x79, 0xc1, 0xba, 0xdb, 0xa0},
+	{0x00, 0x76, 0xfb, 0x8d, 0xd5, 0xa3, 0x2e, 0x58, 0xa5, 0xd3, 0x5e, 0x28, 0x70, 0x06, 0x8b, 0xfd},
+	{0x00, 0xc5, 0x12, 0xd7, 0x0f, 0xca, 0x1d, 0xd8, 0x59, 0x9c, 0x4b, 0x8e, 0x56, 0x93, 0x44, 0x81},
+	{0x00, 0xcc, 0x98, 0x54, 0xae, 0x62, 0x36, 0xfa, 0xbf, 0x73, 0x27, 0xeb, 0x11, 0xdd, 0x89, 0x45}
+};
+// ShiftRows, InvShiftRows, and the rotations of the bytes within a column by one, two, and three rows
+static const uint8_t vp_permute[5][16] __attribute__((aligned(16))) = {
+	{ 0,  5, 10, 15,  4,  9, 14,  3,  8, 13,  2,  7, 12,  1,  6, 11},
+	{ 0, 13, 10,  7,  4,  1, 14, 11,  8,  5,  2, 15, 12,  9,  6,  3},
+	{ 1,  2,  3,  0,  5,  6,  7,  4,  9, 10, 11,  8, 13, 14, 15, 12},
+	{ 2,  3,  0,  1,  6,  7,  4,  5, 10, 11,  8,  9, 14, 15, 12, 13},
+	{ 3,  0,  1,  2,  7,  4,  5,  6, 11,  8,  9, 10, 15, 12, 13, 14}
+};
+
+#define vp_table(t, i) _mm_load_si128((const __m128i *)(t)[i])
+#define vp_lookup(t, i, x) _mm_shuffle_epi8(vp_table(t, i), (x))
+
+#pragma mark - Tower Field Internals
+// product of two elements given by their logs, a 0xc0 log (zero element) saturates and makes pshufb return zero
+static inline __m128i vp_mul(__m128i la, __m128i lb) {
+	__m128i s = _mm_adds_epu8(la, lb);
+	s = _mm_min_epu8(s, _mm_sub_epi8(s, _mm_set1_epi8(15)));
+	return vp_lookup(vp_field, 2, s);
+}
+
+/*!
+ @brief Inverts every byte of x in GF(2^8) after the passed linear transformation
+
+ For x = a * Y + b * Y^16 (normal basis over GF(2^4)) the inverse is x^16 / N with the norm N = nu * (a + b)^2 + a * b,
+ i.e. the coordinates swap and are divided by N. The inverted coordinates are returned as separate nibbles.
+ */
+static inline void vp_invert(__m128i x, const uint8_t (*in)[16], __m128i * inv_a, __m128i * inv_b) {
+	const __m128i mask = _mm_set1_epi8(0x0f);
+	const __m128i lo = _mm_and_si128(x, mask);
+	const __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+	const __m128i a = _mm_xor_si128(vp_lookup(in, 0, lo), vp_lookup(in, 1, hi));
+	const __m128i b = _mm_xor_si128(vp_lookup(in, 2, lo), vp_lookup(in, 3, hi));
+	const __m128i la = vp_lookup(vp_field, 0, a);
+	const __m128i lb = vp_lookup(vp_field, 0, b);
+	const __m128i norm = _mm_xor_si128(vp_lookup(vp_field, 3, _mm_xor_si128(a, b)), vp_mul(la, lb));
+	const __m128i lnorm = vp_lookup(vp_field, 1, norm);
+
+	*inv_a = vp_mul(lb, lnorm);
+	*inv_b = vp_mul(la, lnorm);
+}
+
+// one of the linear output transformations [rows 2 * i and 2 * i + 1 of the table]
+static inline __m128i vp_output(const uint8_t (*out)[16], int i, __m128i inv_a, __m128i inv_b) {
+	return _mm_xor_si128(vp_lookup(out, 2 * i, inv_b), vp_lookup(out, 2 * i + 1, inv_a));
+}
+
+static inline __m128i vp_sub_bytes(__m128i x) {
+	__m128i inv_a, inv_b;
+	vp_invert(x, vp_enc_in, &inv_a, &inv_b);
+	return vp_output(vp_enc_out, 0, inv_a, inv_b);
+}
+
+static uint32_t vp_sub_word(uint32_t inp) {
+	return (uint32_t)_mm_cvtsi128_si32(vp_sub_bytes(_mm_cvtsi32_si128((int)inp)));
+}
+
+#pragma mark - Round Internals
+static inline __m128i vp_enc_round(__m128i x, __m128i key) {
+	__m128i inv_a, inv_b, s, s2, s3;
+
+	vp_invert(_mm_shuffle_epi8(x, vp_table(vp_permute, 0)), vp_enc_in, &inv_a, &inv_b);
+	s = vp_output(vp_enc_out, 0, inv_a, inv_b);
+	s2 = vp_output(vp_enc_out, 1, inv_a, inv_b);
+	s3 = _mm_xor_si128(s, s2);
+	// MixColumns: 2 * s[r] + 3 * s[r + 1] + s[r + 2] + s[r + 3]
+	x = _mm_xor_si128(s2, _mm_shuffle_epi8(s3, vp_table(vp_permute, 2)));
+	x = _mm_xor_si128(x, _mm_shuffle_epi8(s, vp_table(vp_permute, 3)));
+	x = _mm_xor_si128(x, _mm_shuffle_epi8(s, vp_table(vp_permute, 4)));
+	return _mm_xor_si128(x, key);
+}
+
+static inline __m128i vp_enc_last(__m128i x, __m128i key) {
+	return _mm_xor_si128(vp_sub_bytes(_mm_shuffle_epi8(x, vp_table(vp_permute, 0))), key);
+}
+
+// InvMixColumns of the inverse S-box output, shared by the rounds and the setup of the decryption schedule
+static inline __m128i vp_dec_mix(__m128i inv_a, __m128i inv_b) {
+	__m128i x;
+	// 14 * s[r] + 11 * s[r + 1] + 13 * s[r + 2] + 9 * s[r + 3]
+	x = vp_output(vp_dec_out, 1, inv_a, inv_b);
+	x = _mm_xor_si128(x, _mm_shuffle_epi8(vp_output(vp_dec_out, 2, inv_a, inv_b), vp_table(vp_permute, 2)));
+	x = _mm_xor_si128(x, _mm_shuffle_epi8(vp_output(vp_dec_out, 3, inv_a, inv_b), vp_table(vp_permute, 3)));
+	return _mm_xor_si128(x, _mm_shuffle_epi8(vp_output(vp_dec_out, 4, inv_a, inv_b), vp_table(vp_permute, 4)));
+}
+
+static inline __m128i vp_dec_round(__m128i x, __m128i key) {
+	__m128i inv_a, inv_b;
+	vp_invert(_mm_shuffle_epi8(x, vp_table(vp_permute, 1)), vp_dec_in, &inv_a, &inv_b);
+	return _mm_xor_si128(vp_dec_mix(inv_a, inv_b), key);
+}
+
+static inline __m128i vp_dec_last(__m128i x, __m128i key) {
+	__m128i inv_a, inv_b;
+	vp_invert(_mm_shuffle_epi8(x, vp_table(vp_permute, 1)), vp_dec_in, &inv_a, &inv_b);
+	return _mm_xor_si128(vp_output(vp_dec_out, 0, inv_a, inv_b), key);
+}
+
+#pragma mark - Internal Core
+// four independent blocks with their rounds interleaved
+static inline void aes_vpaes_enc_4(__m128i * blocks, __m128i * key_schedule, AESKeyMode keymode) {
+	for (int b = 0; b < 4; b++) {
+		blocks[b] = _mm_xor_si128(blocks[b], key_schedule[0]);
+	}
+	for (int r = 1; r < (int)keymode; r++) {
+		for (int b = 0; b < 4; b++) {
+			blocks[b] = vp_enc_round(blocks[b], key_schedule[r]);
+		}
+	}
+	for (int b = 0; b < 4; b++) {
+		blocks[b] = vp_enc_last(blocks[b], key_schedule[keymode]);
+	}
+}
+
+static inline void aes_vpaes_dec_4(__m128i * blocks, __m128i * key_schedule, AESKeyMode keymode) {
+	for (int b = 0; b < 4; b++) {
+		blocks[b] = _mm_xor_si128(blocks[b], key_schedule[0]);
+	}
+	for (int r = 1; r < (int)keymode; r++) {
+		for (int b = 0; b < 4; b++) {
+			blocks[b] = vp_dec_round(blocks[b], key_schedule[r]);
+		}
+	}
+	for (int b = 0; b < 4; b++) {
+		blocks[b] = vp_dec_last(blocks[b], key_schedule[keymode]);
+	}
+}
+
+#pragma mark - Key Management Core
+void aes_vpaes_key_context_init(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode) {
+	__m128i * enc_sched = (__m128i *)ctx->enc_schedule;
+	__m128i * dec_sched = (__m128i *)ctx->dec_schedule;
+
+	switch(keymode) {
+		case aes_128:
+		case aes_192:
+		case aes_256:
+			aes_expand_key_with(ctx->enc_schedule, key, keymode, vp_sub_word);
+			break;
+		default:
+			fprintf(stderr, "[%s] %s", __FILE__, aes_mode_error());
+			exit(EXIT_FAILURE);
+			break;
+	}
+
+	// equivalent inverse cipher: InvMixColumns(k) is the mixing step of a decryption round run on S(k)
+	dec_sched[0] = enc_sched[keymode];
+	for (int i = 1; i < (int)keymode; i++) {
+		__m128i inv_a, inv_b;
+		vp_invert(vp_sub_bytes(enc_sched[keymode - i]), vp_dec_in, &inv_a, &inv_b);
+		dec_sched[i] = vp_dec_mix(inv_a, inv_b);
+	}
+	dec_sched[keymode] = enc_sched[0];
+	ctx->keymode = keymode;
+}
+
+#pragma mark - Encryption and Decryption Core
+void aes_vpaes_enc(__m128i * data, __m128i * key_schedule, AESKeyMode keymode) {
+	__m128i x = _mm_xor_si128(*data, key_schedule[0]);
+	for (int r = 1; r < (int)keymode; r++) {
+		x = vp_enc_round(x, key_schedule[r]);
+	}
+	*data = vp_enc_last(x, key_schedule[keymode]);
+}
+
+void aes_vpaes_dec(__m128i * data, __m128i * key_schedule, AESKeyMode keymode) {
+	__m128i x = _mm_xor_si128(*data, key_schedule[0]);
+	for (int r = 1; r < (int)keymode; r++) {
+		x = vp_dec_round(x, key_schedule[r]);
+	}
+	*data = vp_dec_last(x, key_schedule[keymode]);
+}
+
+#pragma mark - CBC Core
+void aes_cbc_vpaes_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_vpaes_key_context_init(&ctx, epoch_key, keymode);
+	aes_cbc_vpaes_enc_ctx(inpt, outt, ivec, mlength, &ctx);
+	aes_key_context_clear(&ctx);
+}
+
+void aes_cbc_vpaes_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	__m128i feedback;
+	__m128i * key_sched = (__m128i *)ctx->enc_schedule;
+	AESKeyMode keymode = ctx->keymode;
+
+	// only full blocks are processed, a trailing partial block is never read or written
+	mlength /= 16;
+
+	feedback = _mm_loadu_si128((__m128i *)ivec);
+	for (size_t i = 0; i < mlength; i++) {
+		feedback = _mm_xor_si128(_mm_loadu_si128(&((__m128i *)inpt)[i]), feedback);
+		aes_vpaes_enc(&feedback, key_sched, keymode);
+		_mm_storeu_si128(&((__m128i *)outt)[i], feedback);
+	}
+}
+
+void aes_cbc_vpaes_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_vpaes_key_context_init(&ctx, epoch_key, keymode);
+	aes_cbc_vpaes_dec_ctx(inpt, outt, ivec, clength, &ctx);
+	aes_key_context_clear(&ctx);
+}
+
+void aes_cbc_vpaes_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx) {
+	__m128i feedback, data, last_in;
+	__m128i * key_sched = (__m128i *)ctx->dec_schedule;
+	AESKeyMode keymode = ctx->keymode;
+	size_t i = 0;
+
+	// only full blocks are processed, a trailing partial block is never read or written
+	clength /= 16;
+
+	feedback = _mm_loadu_si128((__m128i *)ivec);
+	// four blocks per iteration, all cipher blocks are loaded before any output is written (in place safe)
+	for (; i + 4 <= clength; i += 4) {
+		__m128i cipher[4], blocks[4];
+		for (int b = 0; b < 4; b++) {
+			cipher[b] = _mm_loadu_si128(&((__m128i *)inpt)[i + b]);
+			blocks[b] = cipher[b];
+		}
+		aes_vpaes_dec_4(blocks, key_sched, keymode);
+		_mm_storeu_si128(&((__m128i *)outt)[i], _mm_xor_si128(blocks[0], feedback));
+		for (int b = 1; b < 4; b++) {
+			_mm_storeu_si128(&((__m128i *)outt)[i + b], _mm_xor_si128(blocks[b], cipher[b - 1]));
+		}
+		feedback = cipher[3];
+	}
+
+	// tail [up to three blocks]
+	for (; i < clength; i++) {
+		last_in = _mm_loadu_si128(&((__m128i *)inpt)[i]);
+		data = last_in;
+		aes_vpaes_dec(&data, key_sched, keymode);
+		_mm_storeu_si128(&((__m128i *)outt)[i], _mm_xor_si128(data, feedback));
+		feedback = last_in;
+	}
+}
+
+#pragma mark - CTR Core
+void aes_ctr_vpaes(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode) {
+	AESKeyContext ctx;
+	aes_vpaes_key_context_init(&ctx, epoch_key, keymode);
+	aes_ctr_vpaes_ctx(inpt, outt, ivec, mlength, &ctx);
+	aes_key_context_clear(&ctx);
+}
+
+void aes_ctr_vpaes_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx) {
+	aes_ctr_vpaes_counter_ctx(inpt, outt, ivec, mlength, ctx, ctr_128);
+}
+
+#pragma mark - CTR Internals
+// the big endian counter block of the two host order halves (see `aes_load_be64`)
+static inline __m128i ctr_block(uint64_t hi, uint64_t lo) {
+	return _mm_set_epi64x((long long)__builtin_bswap64(lo), (long long)__builtin_bswap64(hi));
+}
+
+void aes_ctr_vpaes_counter_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, AESCounterWidth width) {
+	__m128i blocks[4];
+	__m128i * key_sched = (__m128i *)ctx->enc_schedule;
+	AESKeyMode keymode = ctx->keymode;
+	uint64_t hi = aes_load_be64(ivec), lo = aes_load_be64(ivec + 8);
+	size_t i = 0, full = mlength / 16;
+
+	// four blocks per iteration, the tail runs through the same path with unused counter blocks
+	for (; i < full; i += 4) {
+		const size_t n = (full - i < 4) ? full - i : 4;
+		for (int b = 0; b < 4; b++) {
+			blocks[b] = ctr_block(hi, lo);
+			aes_ctr_increment(&hi, &lo, width);
+		}
+		aes_vpaes_enc_4(blocks, key_sched, keymode);
+		for (size_t b = 0; b < n; b++) {
+			_mm_storeu_si128(&((__m128i *)outt)[i + b], _mm_xor_si128(blocks[b], _mm_loadu_si128(&((__m128i *)inpt)[i + b])));
+		}
+		if (n < 4) {
+			// the first unused counter block is the keystream of the partial last block
+			blocks[0] = blocks[n];
+			break;
+		}
+	}
+
+	// partial last block
+	if (mlength % 16) {
+		uint8_t stream[16];
+		if (full % 4 == 0) {
+			blocks[0] = ctr_block(hi, lo);
+			aes_vpaes_enc(&blocks[0], key_sched, keymode);
+		}
+		_mm_storeu_si128((__m128i *)stream, blocks[0]);
+		for (size_t b = full * 16; b < mlength; b++) {
+			outt[b] = inpt[b] ^ stream[b - full * 16];
+		}
+	}
+}
+
+#endif /* protection */
@@ -0,0 +1,239 @@
+//
+//  AESvpaes.h
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * *
+// Compile with -fvisibility=hidden -mssse3
+// * * * * * * * * * * * * * * * * * * * *
+
+/*!
+ @file AESvpaes.h
+
+ The header file for the AES encryption (basic as well as CBC and CTR mode) implemented with SSSE3 vector permutes
+ (for x86 CPUs without AES-NI)
+
+ @version 0.0.1
+ */
+#ifndef AESvpaes_h
+#define AESvpaes_h
+
+#ifdef __has_include
+	#if __has_include(<stdio.h>)
+		#include <stdio.h>
+		#include <stdlib.h>
+		#include "AESCore.h"
+	#endif
+	#if __has_include(<tmmintrin.h>) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86))
+		#include <emmintrin.h>
+		#include <tmmintrin.h>
+		#define vpaes_active
+	#endif
+#endif
+
+#ifdef vpaes_active
+#pragma mark - Key Management Core
+/*!
+ @name Key Management Core
+ Vector permute implementation of the key loading sequence
+ */
+///@{
+/*!
+ @brief Expands a user key into a reusable key context
+
+ Runs the key expansion for the passed key mode once and stores the encryption and decryption schedules inline in the
+ context. The schedules have the same layout as the ones of `aes_ni_key_context_init`, but SubWord runs through the
+ vector permute S-box so the expansion does not leak the key through the cache either.
+
+ @see AESKeyMode for information regarding the modes.
+ @see AESKeyContext for information regarding the context.
+
+ @param ctx The (caller owned) context to fill
+ @param key The user key (`16`, `24`, or `32` bytes depending on the key mode)
+ @param keymode The AES version to use
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2), target("ssse3")))
+void aes_vpaes_key_context_init(AESKeyContext * ctx, uint8_t * key, AESKeyMode keymode);
+///@}
+
+#pragma mark - Encryption and Decryption Core
+/*!
+	@name Encryption and Decryption Core
+	The core functions of AES encryption and decryption
+ */
+///@{
+/*!
+ @brief Encrypts the data using AES implemented with SSSE3 vector permutes
+
+ Encrypts the data passed with the specified Key Schedule through AES using the key length set. SubBytes is computed
+ as an inversion in the tower field GF((2^4)^2) where every step is a `pshufb` lookup indexed by a nibble, so the
+ function runs in constant time.
+
+ @warning The encryption is done directly on the passed data array which must be 128 bits (16 bytes)
+
+ @param data The data to encrypt
+ @param key_schedule The key schedule to use
+ @param keymode The key mode specifying the key schedule length and AES mode
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2), target("ssse3")))
+void aes_vpaes_enc(__m128i * data, __m128i * key_schedule, AESKeyMode keymode);
+
+/*!
+ @brief Decrypts the data using AES implemented with SSSE3 vector permutes
+
+ Decrypts the data passed with the specified Key Schedule through AES using the key length set, in constant time.
+
+ @warning The decryption is done directly on the passed data array which must be 128 bits (16 bytes)
+
+ @note The key schedule is the decryption schedule (`dec_schedule` of an `AESKeyContext`) in the equivalent inverse
+ cipher form (see `aes_ni_dec`)
+
+ @param data The data to decrypt
+ @param key_schedule The decryption key schedule to use
+ @param keymode The key mode specifying the key schedule length and AES mode
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2), target("ssse3")))
+void aes_vpaes_dec(__m128i * data, __m128i * key_schedule, AESKeyMode keymode);
+///@}
+
+#pragma mark - CBC Core
+/*!
+	@name CBC Core
+	The functions related to encrypting and decrypting using the Cipher Block Chain approach.
+ */
+///@{
+/*!
+ @brief Encrypts the data using Cipher Block Chain (CBC) AES implemented with SSSE3 vector permutes
+
+ Encrypts the passed input data using CBC.
+
+ @note CBC requires padding, which this function assumes you have already done
+ @warning The input length <b>must</b> be a multiple of 16 (use padding if necessary) . No checks are run to ensure input, ivec, or epoch key are the correct lengths
+
+ @param inpt The data to encrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC
+ @param mlength The length of the input message [in bytes] which is also the output (cipher) message length
+ @param epoch_key The key (either defined by the user or generated by the software) that will be used for the key expansion to make the key schedule
+ @param keymode The AES mode (also defines the key length and number of rounds)
+
+ @see https://en.wikipedia.org/wiki/Block_cipher_mode_of_operation#Cipher_Block_Chaining_(CBC)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("ssse3")))
+void aes_cbc_vpaes_enc(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Encrypts the data using Cipher Block Chain (CBC) AES with an already expanded key
+
+ Same as `aes_cbc_vpaes_enc` but uses the key schedule of the passed context instead of expanding the key on every call.
+
+ @param inpt The data to encrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC
+ @param mlength The length of the input message [in bytes] which is also the output (cipher) message length
+ @param ctx The key context set up with `aes_vpaes_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("ssse3")))
+void aes_cbc_vpaes_enc_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Decrypts the data using Cipher Block Chain (CBC) AES implemented with SSSE3 vector permutes
+
+ Decrypts the passed input data using CBC.
+
+ @note CBC requires padding, which this function assumes you will remove yourself after returning
+ @warning The input length <b>must</b> be a multiple of 16. No checks are run to ensure input, ivec, or epoch key are the correct lengths
+
+ @param inpt The data to decrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC decryption
+ @param clength The length of the input cipher [in bytes] which is also the output (message) length
+ @param epoch_key The key (passed by the user) that will be used for the key expansion to make the key schedule to decrypt
+ @param keymode The AES mode (also defines the key length and number of rounds)
+
+ @see https://en.wikipedia.org/wiki/Block_cipher_mode_of_operation#Cipher_Block_Chaining_(CBC)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("ssse3")))
+void aes_cbc_vpaes_dec(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Decrypts the data using Cipher Block Chain (CBC) AES with an already expanded key
+
+ Same as `aes_cbc_vpaes_dec` but uses the key schedule of the passed context instead of expanding the key on every
+ call. Four blocks are decrypted per iteration with their rounds interleaved.
+
+ @note The decryption can be done in place (`inpt == outt`)
+
+ @param inpt The data to decrypt using AES and CBC
+ @param outt A pointer to a `malloc`ed location where the decrypted data will be written
+ @param ivec The IV (Initial Vector) to be used for CBC decryption
+ @param clength The length of the input cipher [in bytes] which is also the output (message) length
+ @param ctx The key context set up with `aes_vpaes_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("ssse3")))
+void aes_cbc_vpaes_dec_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long clength, const AESKeyContext * ctx);
+///@}
+
+#pragma mark - CTR Core
+/*!
+	@name CTR Core
+	The functions related to encrypting and decrypting using the CounTeR approach.
+ */
+///@{
+/*!
+ @brief Encrypts or Decrypts the data using Counter Mode (CTR) AES implemented with SSSE3 vector permutes
+
+ Encrypts or Decrypts the passed input data using CTR.
+
+ @note Due to the nature of CTR, encryption and decryption are the same so that does not have to be specified. If a non encrypted message is passed it will be encrypted, if an encrypted message is passed it will be decrypted
+ @warning No checks are run to ensure input, ivec, or epoch key are the correct lengths
+
+ @param inpt The data to decrypt/decrypt using AES and CTR
+ @param outt A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used during the CTR process
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param epoch_key The key (passed by the user) that will be used for the key expansion to make the key schedule to encrypt/decrypt
+ @param keymode The AES mode (also defines the key length and number of rounds)
+
+ @see https://en.wikipedia.org/wiki/Block_cipher_mode_of_operation#Counter_(CTR)
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("ssse3")))
+void aes_ctr_vpaes(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, uint8_t * epoch_key, AESKeyMode keymode);
+
+/*!
+ @brief Encrypts or Decrypts the data using Counter Mode (CTR) AES with an already expanded key
+
+ Same as `aes_ctr_vpaes` but uses the key schedule of the passed context instead of expanding the key on every call.
+ The full 128 bits of the counter block are incremented (see `aes_ctr_vpaes_counter_ctx`).
+
+ @param inpt The data to decrypt/decrypt using AES and CTR
+ @param outt A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+ @param ivec The IV (Initial Vector) to be used during the CTR process
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_vpaes_key_context_init`
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("ssse3")))
+void aes_ctr_vpaes_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx);
+
+/*!
+ @brief Encrypts or Decrypts the data using Counter Mode (CTR) AES with a selectable counter width
+
+ Same as `aes_ctr_vpaes_ctx` but only increments the lowest `width` bits of the (big endian) counter block. Four
+ counter blocks are encrypted per iteration with their rounds interleaved.
+
+ @note The input length does not have to be a multiple of 16, only `mlength` bytes are read and written
+
+ @param inpt The data to decrypt/decrypt using AES and CTR
+ @param outt A pointer to a `malloc`ed location where the decrypted/encrypted data will be written
+ @param ivec The initial counter block to be used during the CTR process
+ @param mlength The length of the input [in bytes] which is also the output length
+ @param ctx The key context set up with `aes_vpaes_key_context_init`
+ @param width The amount of low order bits of the counter block which make up the counter
+
+ @see AESCounterWidth for information regarding the widths.
+ */
+__attribute__((visibility("hidden"), nonnull(1, 2, 3, 5), target("ssse3")))
+void aes_ctr_vpaes_counter_ctx(uint8_t * inpt, uint8_t * outt, uint8_t * ivec, unsigned long mlength, const AESKeyContext * ctx, AESCounterWidth width);
+///@}
+
+#endif /* protection */
+#endif /* AESvpaes_h */
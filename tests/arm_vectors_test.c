@@ -0,0 +1,220 @@
+//
+//  arm_vectors_test.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Cross compile for aarch64 and run under user mode emulation with:
+// aarch64-linux-gnu-gcc -O2 -march=armv8-a+crypto -static -I../src arm_vectors_test.c ../src/AESarm.c ../src/AESCore.c -o arm_vectors_test
+// qemu-aarch64 ./arm_vectors_test
+// or compile natively on ARM hardware with:
+// cc -O2 -march=armv8-a+crypto -I../src arm_vectors_test.c ../src/AESarm.c ../src/AESCore.c
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file arm_vectors_test.c
+
+ Checks the ARMv8 crypto extension backend against the FIPS 197 (appendix C) single block vectors and the
+ NIST SP 800-38A CBC and CTR vectors (F.2 and F.5) for every key size.
+
+ The NIST messages are four blocks long, shorter than one group of the eight block CBC decryption and CTR pipelines.
+ A longer message, decrypted in place and at every length up to three groups, is thus checked against the single
+ block functions, as is the carry of the 32, 64 and 128 bit counters across a group.
+
+ Exits with `0` if every check passed.
+
+ @version 0.0.1
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "AESarm.h"
+
+#ifdef arm_active
+
+#define LONG_BLOCKS 24
+
+static int failures;
+
+#define check(condition, ...) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: check failed: ", __FILE__, __LINE__); \
+		fprintf(stderr, __VA_ARGS__); \
+		fprintf(stderr, "\n"); \
+		failures++; \
+	} \
+} while (0)
+
+#pragma mark - Test Vectors
+/*!
+ @typedef ARMVector
+
+ @brief The vectors of one key size, all fields in hex.
+ */
+typedef struct {
+	AESKeyMode keymode;
+	const char * fips_cipher;
+	const char * key;
+	const char * cbc_cipher;
+	const char * ctr_cipher;
+} ARMVector;
+
+#define FIPS_KEY "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+#define FIPS_PLAIN "00112233445566778899aabbccddeeff"
+#define NIST_PLAIN "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51" \
+	"30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710"
+#define CBC_IV "000102030405060708090a0b0c0d0e0f"
+#define CTR_IV "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff"
+
+static const ARMVector vectors[] = {
+	{aes_128, "69c4e0d86a7b0430d8cdb78070b4c55a",
+		"2b7e151628aed2a6abf7158809cf4f3c",
+		"7649abac8119b246cee98e9b12e9197d5086cb9b507219ee95db113a917678b273bed6b8e3c1743b7116e69e222295163ff1caa1681fac09120eca307586e1a7",
+		"874d6191b620e3261bef6864990db6ce9806f66b7970fdff8617187bb9fffdff5ae4df3edbd5d35e5b4f09020db03eab1e031dda2fbe03d1792170a0f3009cee"},
+	{aes_192, "dda97ca4864cdfe06eaf70a0ec0d7191",
+		"8e73b0f7da0e6452c810f32b809079e562f8ead2522c6b7b",
+		"4f021db243bc633d7178183a9fa071e8b4d9ada9ad7dedf4e5e738763f69145a571b242012fb7ae07fa9baac3df102e008b0e27988598881d920a9e64f5615cd",
+		"1abc932417521ca24f2b0459fe7e6e0b090339ec0aa6faefd5ccc2c6f4ce8e941e36b26bd1ebc670d1bd1d665620abf74f78a7f6d29809585a97daec58c6b050"},
+	{aes_256, "8ea2b7ca516745bfeafc49904b496089",
+		"603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4",
+		"f58c4c04d6e5f1ba779eabfb5f7bfbd69cfc4e967edb808d679f777bc6702c7d39f23369a9d9bacfa530e26304231461b2eb05e2c39be9fcda6c19078c6a9d1b",
+		"601ec313775789a5b7a7f504bbf3d228f443e3ca4d62b59aca84e990cacaf5c52b0930daa23de94ce87017ba2d84988ddfc9c58db67aada613c2dd08457941a6"},
+};
+
+static unsigned long decode_hex(const char * hex, uint8_t * out) {
+	unsigned long length = strlen(hex) / 2;
+	for (unsigned long i = 0; i < length; i++) {
+		unsigned int byte;
+		sscanf(hex + 2 * i, "%2x", &byte);
+		out[i] = (uint8_t)byte;
+	}
+	return length;
+}
+
+static int bits(AESKeyMode keymode) {
+	return (keymode - 6) * 32;
+}
+
+#pragma mark - Known Answers
+static void check_fips(const ARMVector * vector) {
+	uint8_t key[32], plain[16], expect[16], block[16];
+	AESKeyContext ctx;
+
+	decode_hex(FIPS_KEY, key);
+	decode_hex(FIPS_PLAIN, plain);
+	decode_hex(vector->fips_cipher, expect);
+	aes_arm_key_context_init(&ctx, key, vector->keymode);
+
+	uint8x16_t data = vld1q_u8(plain);
+	aes_arm_enc(&data, (uint8x16_t *)ctx.enc_schedule, vector->keymode);
+	vst1q_u8(block, data);
+	check(memcmp(block, expect, 16) == 0, "AES-%d FIPS 197 encryption", bits(vector->keymode));
+
+	aes_arm_dec(&data, (uint8x16_t *)ctx.dec_schedule, vector->keymode);
+	vst1q_u8(block, data);
+	check(memcmp(block, plain, 16) == 0, "AES-%d FIPS 197 decryption", bits(vector->keymode));
+}
+
+static void check_nist(const ARMVector * vector) {
+	uint8_t key[32], plain[64], cbc[64], ctr[64], ivec[16], out[64];
+	AESKeyContext ctx;
+
+	decode_hex(vector->key, key);
+	decode_hex(NIST_PLAIN, plain);
+	decode_hex(vector->cbc_cipher, cbc);
+	decode_hex(vector->ctr_cipher, ctr);
+	aes_arm_key_context_init(&ctx, key, vector->keymode);
+
+	decode_hex(CBC_IV, ivec);
+	aes_cbc_arm_enc_ctx(plain, out, ivec, 64, &ctx);
+	check(memcmp(out, cbc, 64) == 0, "AES-%d SP 800-38A CBC encryption", bits(vector->keymode));
+	decode_hex(CBC_IV, ivec);
+	aes_cbc_arm_dec_ctx(cbc, out, ivec, 64, &ctx);
+	check(memcmp(out, plain, 64) == 0, "AES-%d SP 800-38A CBC decryption", bits(vector->keymode));
+
+	decode_hex(CTR_IV, ivec);
+	aes_ctr_arm_ctx(plain, out, ivec, 64, &ctx);
+	check(memcmp(out, ctr, 64) == 0, "AES-%d SP 800-38A CTR encryption", bits(vector->keymode));
+	decode_hex(CTR_IV, ivec);
+	aes_ctr_arm_ctx(ctr, out, ivec, 64, &ctx);
+	check(memcmp(out, plain, 64) == 0, "AES-%d SP 800-38A CTR decryption", bits(vector->keymode));
+}
+
+#pragma mark - Pipelines
+// the low `width` bits of the big endian counter block plus one
+static void counter_increment(uint8_t * counter, AESCounterWidth width) {
+	for (int b = 15; b >= 16 - (int)width / 8; b--) {
+		if (++counter[b]) {
+			break;
+		}
+	}
+}
+
+// the pipelines against the (known answer checked) single block functions, for every length up to three groups
+static void check_pipelines(const ARMVector * vector) {
+	static const AESCounterWidth widths[] = {ctr_32, ctr_64, ctr_128};
+	uint8_t key[32], ivec[16], counter[16], plain[LONG_BLOCKS * 16], cipher[LONG_BLOCKS * 16], expect[LONG_BLOCKS * 16], out[LONG_BLOCKS * 16];
+	AESKeyContext ctx;
+
+	decode_hex(vector->key, key);
+	aes_arm_key_context_init(&ctx, key, vector->keymode);
+	for (int i = 0; i < LONG_BLOCKS * 16; i++) {
+		plain[i] = (uint8_t)(i * 131 + 7);
+	}
+
+	// CBC encryption is serial, so it is already checked by the NIST vectors
+	decode_hex(CBC_IV, ivec);
+	aes_cbc_arm_enc_ctx(plain, cipher, ivec, sizeof(cipher), &ctx);
+	for (int blocks = 0; blocks <= LONG_BLOCKS; blocks++) {
+		decode_hex(CBC_IV, ivec);
+		memcpy(out, cipher, (size_t)blocks * 16);
+		aes_cbc_arm_dec_ctx(out, out, ivec, (unsigned long)blocks * 16, &ctx);
+		check(memcmp(out, plain, (size_t)blocks * 16) == 0, "AES-%d in place CBC decryption of %d blocks", bits(vector->keymode), blocks);
+	}
+
+	for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+		// the low 64 bits are all ones but for the last two, so the counter wraps in the middle of the first group and
+		// every width wraps differently (32 bits: bytes 8 to 11 stay all ones, 64 bits: they wrap too, 128 bits: byte 7 is carried into)
+		decode_hex(CTR_IV, ivec);
+		memset(ivec + 8, 0xff, 8);
+		ivec[15] = 0xfc;
+		memcpy(counter, ivec, 16);
+		for (int b = 0; b < LONG_BLOCKS; b++) {
+			uint8x16_t data = vld1q_u8(counter);
+			aes_arm_enc(&data, (uint8x16_t *)ctx.enc_schedule, vector->keymode);
+			vst1q_u8(expect + 16 * b, data);
+			for (int i = 0; i < 16; i++) {
+				expect[16 * b + i] ^= plain[16 * b + i];
+			}
+			counter_increment(counter, widths[w]);
+		}
+		for (unsigned long length = 0; length <= sizeof(plain); length += length < 48 ? 1 : 13) {
+			uint8_t start[16];
+			memcpy(start, ivec, 16);
+			aes_ctr_arm_counter_ctx(plain, out, start, length, &ctx, widths[w]);
+			check(memcmp(out, expect, length) == 0, "AES-%d CTR with a %d bit counter over %lu bytes", bits(vector->keymode), widths[w], length);
+		}
+	}
+}
+
+int main(void) {
+	for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		check_fips(&vectors[i]);
+		check_nist(&vectors[i]);
+		check_pipelines(&vectors[i]);
+	}
+
+	printf("arm_vectors_test: %s\n", failures ? "FAILED" : "ok");
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#else
+
+int main(void) {
+	printf("arm_vectors_test: skipped (not built for ARM with the crypto extension)\n");
+	return EXIT_SUCCESS;
+}
+
+#endif
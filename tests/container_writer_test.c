@@ -0,0 +1,92 @@
+//
+//  container_writer_test.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with:
+// cc -O2 -pthread -maes -mpclmul -msse4.1 -mssse3 -I../src container_writer_test.c ../src/AEScontainer.c ../src/AESparallel.c ../src/AESstream.c ../src/AESdispatch.c ../src/AESstats.c ../src/AESvaes.c ../src/AESni.c ../src/AESvpaes.c ../src/AESbs.c ../src/AESgen.c ../src/AESarm.c ../src/AESCore.c
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file container_writer_test.c
+
+ Checks that a container writer which failed to open (or was already closed) refuses further writes and closes with
+ `EBADF` instead of looping on an empty chunk buffer or closing a descriptor it does not own. The generic backend is
+ forced, so the GCM container is refused with `ENOTSUP`.
+
+ Exits with `0` if every check passed.
+
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "AEScontainer.h"
+#include "AESdispatch.h"
+
+static int failures;
+
+#define check(condition) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+		failures++; \
+	} \
+} while (0)
+
+// every call on a writer which is not open fails with EBADF and leaves stdin (the zeroed fd) open
+static void check_not_open(AESContainerWriter * writer) {
+	uint8_t data[100] = {0};
+
+	errno = 0;
+	check(aes_container_write(writer, data, sizeof(data)) == 0 && errno == EBADF);
+	errno = 0;
+	check(aes_container_write(writer, data, 0) == 0 && errno == EBADF);
+	errno = 0;
+	check(aes_container_writer_close(writer) == 0 && errno == EBADF);
+	check(fcntl(STDIN_FILENO, F_GETFD) != -1);
+}
+
+int main(void) {
+	uint8_t key[32] = {0}, nonce[16] = {0};
+	char path[] = "/tmp/container_writer_testXXXXXX";
+	AESContainerWriter writer;
+	AESKeyContext ctx;
+
+	// the backend is bound on the first dispatched call
+	setenv("SIMPLECRYPT_BACKEND", "gen", 1);
+	aes_key_context_init(&ctx, key, aes_256);
+	check(strcmp(aes_backend_name(), "gen") == 0);
+
+	int fd = mkstemp(path);
+	check(fd >= 0);
+	close(fd);
+
+	// invalid chunk size
+	errno = 0;
+	check(aes_container_writer_open(&writer, path, container_ctr, 0, nonce, &ctx) == 0 && errno == EINVAL);
+	check_not_open(&writer);
+
+	// no GCM on the generic backend
+	errno = 0;
+	check(aes_container_writer_open(&writer, path, container_gcm, 4096, nonce, &ctx) == 0 && errno == ENOTSUP);
+	check_not_open(&writer);
+
+	// the file can not be created
+	errno = 0;
+	check(aes_container_writer_open(&writer, "/nonexistent/container.sct", container_ctr, 4096, nonce, &ctx) == 0 && errno == ENOENT);
+	check_not_open(&writer);
+
+	// closed twice
+	check(aes_container_writer_open(&writer, path, container_ctr, 4096, nonce, &ctx) == 1);
+	check(aes_container_write(&writer, key, sizeof(key)) == 1);
+	check(aes_container_writer_close(&writer) == 1);
+	check_not_open(&writer);
+
+	unlink(path);
+	printf("container_writer_test: %s\n", failures ? "FAILED" : "ok");
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+//
+//  gcm_vectors_test.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with:
+// cc -O2 -pthread -maes -mpclmul -msse4.1 -mssse3 -I../src gcm_vectors_test.c ../src/AESdispatch.c ../src/AESstats.c ../src/AESvaes.c ../src/AESni.c ../src/AESvpaes.c ../src/AESbs.c ../src/AESgen.c ../src/AESarm.c ../src/AESCore.c
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file gcm_vectors_test.c
+
+ Checks the GCM implementations against the test vectors of McGrew and Viega (The Galois/Counter Mode of Operation,
+ test cases 1 to 18, as used by NIST SP 800-38D). They cover an empty message, additional authenticated data, a
+ partial last block and 64 and 480 bit IVs for every key size.
+
+ Every vector is run through the one shot and the incremental (init/aad/update/final) AES-NI functions, the latter
+ fed in uneven pieces, and through the VAES functions where the CPU has them. As the vectors are shorter than one
+ group of the wide kernels, a longer message is then checked to come out the same on every path, which covers the
+ 8 block AES-NI loop and the VAES groups continuing on the shared message state.
+
+ Exits with `0` if every check passed.
+
+ @version 0.0.1
+ */
+
+#include <string.h>
+
+#include "AESni.h"
+#include "AESvaes.h"
+#include "AESdispatch.h"
+
+#define BULK_BYTES 4099
+
+static int failures;
+
+#define check(condition, ...) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: check failed: ", __FILE__, __LINE__); \
+		fprintf(stderr, __VA_ARGS__); \
+		fprintf(stderr, "\n"); \
+		failures++; \
+	} \
+} while (0)
+
+#pragma mark - Test Vectors
+/*!
+ @typedef GCMVector
+
+ @brief One test case, all fields in hex.
+ */
+typedef struct {
+	int number;
+	const char * key;
+	const char * ivec;
+	const char * plain;
+	const char * aad;
+	const char * cipher;
+	const char * tag;
+} GCMVector;
+
+#define K128 "feffe9928665731c6d6a8f9467308308"
+#define K192 K128 "feffe9928665731c"
+#define K256 K128 K128
+#define ZERO128 "00000000000000000000000000000000"
+#define ZERO192 ZERO128 "0000000000000000"
+#define ZERO256 ZERO128 ZERO128
+#define ZERO_IV "000000000000000000000000"
+#define IV96 "cafebabefacedbaddecaf888"
+#define IV64 "cafebabefacedbad"
+#define IV480 "9313225df88406e555909c5aff5269aa6a7a9538534f7da1e4c303d2a318a728c3c0c95156809539fcf0e2429a6b525416aedbf5a0de6a57a637b39b"
+#define PLAIN60 "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a721c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39"
+#define PLAIN64 PLAIN60 "1aafd255"
+#define AAD "feedfacedeadbeeffeedfacedeadbeefabaddad2"
+
+static const GCMVector vectors[] = {
+	{ 1, ZERO128, ZERO_IV, "", "", "", "58e2fccefa7e3061367f1d57a4e7455a"},
+	{ 2, ZERO128, ZERO_IV, ZERO128, "", "0388dace60b6a392f328c2b971b2fe78", "ab6e47d42cec13bdf53a67b21257bddf"},
+	{ 3, K128, IV96, PLAIN64, "",
+		"42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091473f5985",
+		"4d5c2af327cd64a62cf35abd2ba6fab4"},
+	{ 4, K128, IV96, PLAIN60, AAD,
+		"42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091",
+		"5bc94fbc3221a5db94fae95ae7121a47"},
+	{ 5, K128, IV64, PLAIN60, AAD,
+		"61353b4c2806934a777ff51fa22a4755699b2a714fcdc6f83766e5f97b6c742373806900e49f24b22b097544d4896b424989b5e1ebac0f07c23f4598",
+		"3612d2e79e3b0785561be14aaca2fccb"},
+	{ 6, K128, IV480, PLAIN60, AAD,
+		"8ce24998625615b603a033aca13fb894be9112a5c3a211a8ba262a3cca7e2ca701e4a9a4fba43c90ccdcb281d48c7c6fd62875d2aca417034c34aee5",
+		"619cc5aefffe0bfa462af43c1699d050"},
+	{ 7, ZERO192, ZERO_IV, "", "", "", "cd33b28ac773f74ba00ed1f312572435"},
+	{ 8, ZERO192, ZERO_IV, ZERO128, "", "98e7247c07f0fe411c267e4384b0f600", "2ff58d80033927ab8ef4d4587514f0fb"},
+	{ 9, K192, IV96, PLAIN64, "",
+		"3980ca0b3c00e841eb06fac4872a2757859e1ceaa6efd984628593b40ca1e19c7d773d00c144c525ac619d18c84a3f4718e2448b2fe324d9ccda2710acade256",
+		"9924a7c8587336bfb118024db8674a14"},
+	{10, K192, IV96, PLAIN60, AAD,
+		"3980ca0b3c00e841eb06fac4872a2757859e1ceaa6efd984628593b40ca1e19c7d773d00c144c525ac619d18c84a3f4718e2448b2fe324d9ccda2710",
+		"2519498e80f1478f37ba55bd6d27618c"},
+	{11, K192, IV64, PLAIN60, AAD,
+		"0f10f599ae14a154ed24b36e25324db8c566632ef2bbb34f8347280fc4507057fddc29df9a471f75c66541d4d4dad1c9e93a19a58e8b473fa0f062f7",
+		"65dcc57fcf623a24094fcca40d3533f8"},
+	{12, K192, IV480, PLAIN60, AAD,
+		"d27e88681ce3243c4830165a8fdcf9ff1de9a1d8e6b447ef6ef7b79828666e4581e79012af34ddd9e2f037589b292db3e67c036745fa22e7e9b7373b",
+		"dcf566ff291c25bbb8568fc3d376a6d9"},
+	{13, ZERO256, ZERO_IV, "", "", "", "530f8afbc74536b9a963b4f1c4cb738b"},
+	{14, ZERO256, ZERO_IV, ZERO128, "", "cea7403d4d606b6e074ec5d3baf39d18", "d0d1c8a799996bf0265b98b5d48ab919"},
+	{15, K256, IV96, PLAIN64, "",
+		"522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662898015ad",
+		"b094dac5d93471bdec1a502270e3cc6c"},
+	{16, K256, IV96, PLAIN60, AAD,
+		"522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662",
+		"76fc6ece0f4e1768cddf8853bb2d551b"},
+	{17, K256, IV64, PLAIN60, AAD,
+		"c3762df1ca787d32ae47c13bf19844cbaf1ae14d0b976afac52ff7d79bba9de0feb582d33934a4f0954cc2363bc73f7862ac430e64abe499f47c9b1f",
+		"3a337dbf46a792c45e454913fe2ea8f2"},
+	{18, K256, IV480, PLAIN60, AAD,
+		"5a8def2f0c9e53f1f75d7853659e2a20eeb2b22aafde6419a058ab4f6f746bf40fc0c3b780f244452da3ebf1c5d82cdea2418997200ef82e44ae7e3f",
+		"a44a8266ee1c8eb0c8b5d4cf5ae9f19a"},
+};
+
+/*!
+ @typedef GCMDecoded
+
+ @brief A test case in binary.
+ */
+typedef struct {
+	uint8_t key[32], ivec[60], plain[64], aad[20], cipher[64], tag[16];
+	unsigned long klength, ivlength, mlength, alength;
+	AESKeyContext ctx;
+} GCMDecoded;
+
+static unsigned long decode_hex(const char * hex, uint8_t * out) {
+	unsigned long length = strlen(hex) / 2;
+	for (unsigned long i = 0; i < length; i++) {
+		unsigned int byte;
+		sscanf(hex + 2 * i, "%2x", &byte);
+		out[i] = (uint8_t)byte;
+	}
+	return length;
+}
+
+static void decode_vector(const GCMVector * vector, GCMDecoded * decoded) {
+	memset(decoded, 0, sizeof(GCMDecoded));
+	decoded->klength = decode_hex(vector->key, decoded->key);
+	decoded->ivlength = decode_hex(vector->ivec, decoded->ivec);
+	decoded->mlength = decode_hex(vector->plain, decoded->plain);
+	decoded->alength = decode_hex(vector->aad, decoded->aad);
+	decode_hex(vector->cipher, decoded->cipher);
+	decode_hex(vector->tag, decoded->tag);
+	aes_ni_key_context_init(&decoded->ctx, decoded->key, decoded->klength == 16 ? aes_128 : decoded->klength == 24 ? aes_192 : aes_256);
+}
+
+#pragma mark - One Shot
+typedef void (*GCMEncrypt)(uint8_t * inpt, uint8_t * outt, unsigned long mlength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, uint8_t * tag, const AESKeyContext * ctx);
+typedef int (*GCMDecrypt)(uint8_t * inpt, uint8_t * outt, unsigned long clength, uint8_t * aad, unsigned long alength, uint8_t * ivec, unsigned long ivlength, const uint8_t * tag, const AESKeyContext * ctx);
+
+static void check_one_shot(const char * name, GCMEncrypt encrypt, GCMDecrypt decrypt, int number, GCMDecoded * v) {
+	uint8_t out[64], tag[16];
+
+	encrypt(v->plain, out, v->mlength, v->aad, v->alength, v->ivec, v->ivlength, tag, &v->ctx);
+	check(memcmp(out, v->cipher, v->mlength) == 0, "%s test case %d cipher text", name, number);
+	check(memcmp(tag, v->tag, 16) == 0, "%s test case %d tag", name, number);
+
+	check(decrypt(v->cipher, out, v->mlength, v->aad, v->alength, v->ivec, v->ivlength, v->tag, &v->ctx) == 1, "%s test case %d authentic", name, number);
+	check(memcmp(out, v->plain, v->mlength) == 0, "%s test case %d plain text", name, number);
+
+	memcpy(tag, v->tag, 16);
+	tag[15] ^= 1;
+	check(decrypt(v->cipher, out, v->mlength, v->aad, v->alength, v->ivec, v->ivlength, tag, &v->ctx) == 0, "%s test case %d forged tag", name, number);
+}
+
+#pragma mark - Incremental
+// the message is fed in pieces of 1, 15, 17, ... bytes so every call starts and ends in a different place of a block
+static void check_incremental(int number, GCMDecoded * v) {
+	const unsigned long pieces[] = {1, 15, 17, 5, 64};
+	uint8_t out[64], tag[16];
+	AESGCMContext gcm;
+
+	aes_gcm_ni_init(&gcm, &v->ctx, v->ivec, v->ivlength);
+	unsigned long split = v->alength / 3;
+	aes_gcm_ni_aad(&gcm, v->aad, split);
+	aes_gcm_ni_aad(&gcm, v->aad + split, v->alength - split);
+	for (unsigned long done = 0, p = 0; done < v->mlength; done += pieces[p++]) {
+		unsigned long n = pieces[p] < v->mlength - done ? pieces[p] : v->mlength - done;
+		aes_gcm_ni_enc_update(&gcm, v->plain + done, out + done, n);
+	}
+	aes_gcm_ni_enc_final(&gcm, tag, 16);
+	check(memcmp(out, v->cipher, v->mlength) == 0, "incremental test case %d cipher text", number);
+	check(memcmp(tag, v->tag, 16) == 0, "incremental test case %d tag", number);
+
+	aes_gcm_ni_init(&gcm, &v->ctx, v->ivec, v->ivlength);
+	aes_gcm_ni_aad(&gcm, v->aad, v->alength);
+	for (unsigned long done = 0, p = 0; done < v->mlength; done += pieces[p++]) {
+		unsigned long n = pieces[p] < v->mlength - done ? pieces[p] : v->mlength - done;
+		aes_gcm_ni_dec_update(&gcm, v->cipher + done, out + done, n);
+	}
+	check(aes_gcm_ni_dec_final(&gcm, v->tag, 16) == 1, "incremental test case %d authentic", number);
+	check(memcmp(out, v->plain, v->mlength) == 0, "incremental test case %d plain text", number);
+
+	// a truncated tag is checked on its first bytes only
+	aes_gcm_ni_init(&gcm, &v->ctx, v->ivec, v->ivlength);
+	aes_gcm_ni_aad(&gcm, v->aad, v->alength);
+	aes_gcm_ni_dec_update(&gcm, v->cipher, out, v->mlength);
+	check(aes_gcm_ni_dec_final(&gcm, v->tag, 12) == 1, "incremental test case %d 96 bit tag", number);
+}
+
+#pragma mark - Bulk Consistency
+// one long message through every path, the incremental one in pieces that leave the wide kernels unaligned
+static void check_bulk(GCMDecoded * v, const char ** names, GCMEncrypt * encrypts, int paths) {
+	static uint8_t plain[BULK_BYTES], expect[BULK_BYTES], out[BULK_BYTES];
+	uint8_t expect_tag[16], tag[16];
+	AESGCMContext gcm;
+
+	for (unsigned long i = 0; i < BULK_BYTES; i++) {
+		plain[i] = (uint8_t)(i * 131 + 7);
+	}
+	aes_gcm_ni_enc_ctx(plain, expect, BULK_BYTES, v->aad, v->alength, v->ivec, v->ivlength, expect_tag, &v->ctx);
+
+	aes_gcm_ni_init(&gcm, &v->ctx, v->ivec, v->ivlength);
+	aes_gcm_ni_aad(&gcm, v->aad, v->alength);
+	for (unsigned long done = 0, n = 3; done < BULK_BYTES; done += n, n = n * 2 + 1) {
+		if (n > BULK_BYTES - done) {
+			n = BULK_BYTES - done;
+		}
+		aes_gcm_ni_enc_update(&gcm, plain + done, out + done, n);
+	}
+	aes_gcm_ni_enc_final(&gcm, tag, 16);
+	check(memcmp(out, expect, BULK_BYTES) == 0 && memcmp(tag, expect_tag, 16) == 0, "incremental bulk message");
+
+	for (int p = 0; p < paths; p++) {
+		encrypts[p](plain, out, BULK_BYTES, v->aad, v->alength, v->ivec, v->ivlength, tag, &v->ctx);
+		check(memcmp(out, expect, BULK_BYTES) == 0 && memcmp(tag, expect_tag, 16) == 0, "%s bulk message", names[p]);
+	}
+}
+
+int main(void) {
+	const char * names[3] = {"ni"};
+	GCMEncrypt encrypts[3] = {aes_gcm_ni_enc_ctx};
+	GCMDecrypt decrypts[3] = {aes_gcm_ni_dec_ctx};
+	int paths = 1;
+	GCMDecoded v;
+
+	if (!aes_backend_available(aes_backend_ni)) {
+		printf("gcm_vectors_test: skipped (no AES-NI)\n");
+		return EXIT_SUCCESS;
+	}
+	if (__builtin_cpu_supports("vaes") && __builtin_cpu_supports("vpclmulqdq") && __builtin_cpu_supports("avx2")) {
+		names[paths] = "vaes256";
+		encrypts[paths] = aes_gcm_vaes256_enc_ctx;
+		decrypts[paths++] = aes_gcm_vaes256_dec_ctx;
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) {
+			names[paths] = "vaes512";
+			encrypts[paths] = aes_gcm_vaes512_enc_ctx;
+			decrypts[paths++] = aes_gcm_vaes512_dec_ctx;
+		}
+	}
+
+	for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		decode_vector(&vectors[i], &v);
+		for (int p = 0; p < paths; p++) {
+			check_one_shot(names[p], encrypts[p], decrypts[p], vectors[i].number, &v);
+		}
+		check_incremental(vectors[i].number, &v);
+		// test cases 4, 5 and 6 (and their longer keys) cover the AAD and the IV lengths
+		if (vectors[i].number % 6 == 0) {
+			for (int n = 3; n >= 0; n--) {
+				decode_vector(&vectors[i - (size_t)n], &v);
+				check_bulk(&v, names + 1, encrypts + 1, paths - 1);
+			}
+		}
+	}
+
+	printf("gcm_vectors_test: %s (%s)\n", failures ? "FAILED" : "ok", paths == 3 ? "ni, vaes256, vaes512" : paths == 2 ? "ni, vaes256" : "ni");
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,80 @@
+//
+//  parallel_cbc_test.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with:
+// cc -O2 -pthread -maes -mpclmul -msse4.1 -mssse3 -I../src parallel_cbc_test.c ../src/AESparallel.c ../src/AESstream.c ../src/AESdispatch.c ../src/AESstats.c ../src/AESvaes.c ../src/AESni.c ../src/AESvpaes.c ../src/AESbs.c ../src/AESgen.c ../src/AESarm.c ../src/AESCore.c
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file parallel_cbc_test.c
+
+ Checks that the chunk parallel CBC decryption gives the same plain text as `aes_cbc_dec_ctx`, into a separate
+ buffer and in place, for lengths around the chunk boundaries and several thread counts.
+
+ Exits with `0` if every check passed.
+
+ @version 0.0.1
+ */
+
+#include <string.h>
+
+#include "AESparallel.h"
+#include "AESdispatch.h"
+
+#define CHUNK_SIZE 4096
+#define MAX_BYTES (9 * CHUNK_SIZE + 48)
+
+static int failures;
+
+#define check(condition, ...) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: check failed: ", __FILE__, __LINE__); \
+		fprintf(stderr, __VA_ARGS__); \
+		fprintf(stderr, "\n"); \
+		failures++; \
+	} \
+} while (0)
+
+int main(void) {
+	static uint8_t cipher[MAX_BYTES], expect[MAX_BYTES], out[MAX_BYTES];
+	const unsigned int threads[] = {1, 2, 3, 8};
+	const unsigned long lengths[] = {0, 16, CHUNK_SIZE - 16, CHUNK_SIZE, CHUNK_SIZE + 16, 2 * CHUNK_SIZE, 5 * CHUNK_SIZE + 32, MAX_BYTES};
+	uint8_t key[32], ivec[16], start[16];
+	AESKeyContext ctx;
+
+	for (int i = 0; i < 32; i++) {
+		key[i] = (uint8_t)(i * 7 + 1);
+	}
+	for (int i = 0; i < 16; i++) {
+		ivec[i] = (uint8_t)(i * 13 + 5);
+	}
+	for (unsigned long i = 0; i < MAX_BYTES; i++) {
+		cipher[i] = (uint8_t)(i * 131 + 7);
+	}
+	aes_key_context_init(&ctx, key, aes_256);
+
+	for (size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); t++) {
+		AESPool * pool = aes_pool_create(threads[t], CHUNK_SIZE);
+		for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+			unsigned long length = lengths[l];
+			memcpy(start, ivec, 16);
+			aes_cbc_dec_ctx(cipher, expect, start, length, &ctx);
+
+			memcpy(start, ivec, 16);
+			aes_cbc_parallel_dec_ctx(pool, cipher, out, start, length, &ctx);
+			check(memcmp(out, expect, length) == 0, "%u threads, %lu bytes", threads[t], length);
+			check(memcmp(start, ivec, 16) == 0, "%u threads, %lu bytes, the IV is left alone", threads[t], length);
+
+			memcpy(out, cipher, length);
+			aes_cbc_parallel_dec_ctx(pool, out, out, start, length, &ctx);
+			check(memcmp(out, expect, length) == 0, "%u threads, %lu bytes in place", threads[t], length);
+		}
+		aes_pool_destroy(pool);
+	}
+
+	printf("parallel_cbc_test: %s (%s)\n", failures ? "FAILED" : "ok", aes_backend_name());
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+//
+//  vaes_tail_test.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with:
+// cc -O2 -maes -mpclmul -msse4.1 -mssse3 -I../src vaes_tail_test.c ../src/AESvaes.c ../src/AESni.c ../src/AESCore.c
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file vaes_tail_test.c
+
+ Checks the rest of less than sixteen blocks behind the groups of the wide kernels: the CBC decryption, CTR, GCM and
+ XTS functions of both VAES widths (where the CPU has them) against the AES-NI functions, for every message length up
+ to three groups and every key size, into a separate buffer and in place. The bytes behind the message must be left
+ alone.
+
+ Exits with `0` if every check passed.
+
+ @version 0.0.1
+ */
+
+#include <string.h>
+
+#include "AESni.h"
+#include "AESvaes.h"
+
+#ifdef vaes_active
+
+#define MAX_BYTES (3 * 256 + 40)
+#define GUARD_BYTES 64
+#define GUARD 0x5a
+
+static int failures;
+
+#define check(condition, ...) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: check failed: ", __FILE__, __LINE__); \
+		fprintf(stderr, __VA_ARGS__); \
+		fprintf(stderr, "\n"); \
+		failures++; \
+	} \
+} while (0)
+
+/*!
+ @typedef VAESWidth
+
+ @brief The functions of one VAES width.
+ */
+typedef struct {
+	const char * name;
+	void (*cbc_dec)(uint8_t *, uint8_t *, uint8_t *, unsigned long, const AESKeyContext *);
+	void (*ctr)(uint8_t *, uint8_t *, uint8_t *, unsigned long, const AESKeyContext *);
+	void (*gcm_enc)(uint8_t *, uint8_t *, unsigned long, uint8_t *, unsigned long, uint8_t *, unsigned long, uint8_t *, const AESKeyContext *);
+	int (*gcm_dec)(uint8_t *, uint8_t *, unsigned long, uint8_t *, unsigned long, uint8_t *, unsigned long, const uint8_t *, const AESKeyContext *);
+	void (*xts_enc)(uint8_t *, uint8_t *, uint8_t *, unsigned long, const AESKeyContext *, const AESKeyContext *);
+	void (*xts_dec)(uint8_t *, uint8_t *, uint8_t *, unsigned long, const AESKeyContext *, const AESKeyContext *);
+} VAESWidth;
+
+static const VAESWidth widths[] = {
+	{"vaes256", aes_cbc_vaes256_dec_ctx, aes_ctr_vaes256_ctx, aes_gcm_vaes256_enc_ctx, aes_gcm_vaes256_dec_ctx, aes_xts_vaes256_enc_ctx, aes_xts_vaes256_dec_ctx},
+	{"vaes512", aes_cbc_vaes512_dec_ctx, aes_ctr_vaes512_ctx, aes_gcm_vaes512_enc_ctx, aes_gcm_vaes512_dec_ctx, aes_xts_vaes512_enc_ctx, aes_xts_vaes512_dec_ctx},
+};
+
+static int bits(AESKeyMode keymode) {
+	return (keymode - 6) * 32;
+}
+
+// the message and the untouched guard bytes behind it
+static int same(const uint8_t * out, const uint8_t * expect, unsigned long length) {
+	if (memcmp(out, expect, length) != 0) {
+		return 0;
+	}
+	for (int i = 0; i < GUARD_BYTES; i++) {
+		if (out[length + i] != GUARD) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// `out` holds a copy of `inpt` (in place) or only the guard
+static void prepare(uint8_t * out, const uint8_t * inpt, unsigned long length, int in_place) {
+	memset(out, GUARD, MAX_BYTES + GUARD_BYTES);
+	if (in_place) {
+		memcpy(out, inpt, length);
+	}
+}
+
+static void check_length(const VAESWidth * width, unsigned long length, AESKeyContext * ctx, AESKeyContext * tweak_ctx, uint8_t * key) {
+	static uint8_t plain[MAX_BYTES], cipher[MAX_BYTES], expect[MAX_BYTES], out[MAX_BYTES + GUARD_BYTES];
+	uint8_t ivec[16], start[16], expect_tag[16], tag[16], aad[13];
+	int keybits = bits(ctx->keymode);
+
+	for (unsigned long i = 0; i < length; i++) {
+		plain[i] = (uint8_t)(i * 131 + length);
+	}
+	for (int i = 0; i < 16; i++) {
+		ivec[i] = key[i] ^ 0xa5;
+	}
+	memcpy(aad, key + 16, sizeof(aad));
+
+	for (int in_place = 0; in_place < 2; in_place++) {
+		// CBC decryption of the whole blocks
+		unsigned long blocks = length & ~15UL;
+		memcpy(start, ivec, 16);
+		aes_cbc_ni_dec_ctx(plain, expect, start, blocks, ctx);
+		prepare(out, plain, blocks, in_place);
+		memcpy(start, ivec, 16);
+		width->cbc_dec(in_place ? out : plain, out, start, blocks, ctx);
+		check(same(out, expect, blocks), "%s AES-%d CBC decryption of %lu bytes%s", width->name, keybits, blocks, in_place ? " in place" : "");
+
+		// CTR, every third length from a counter whose low half wraps within the first group
+		if (length % 3 == 0) {
+			memset(ivec + 8, 0xff, 8);
+			ivec[15] = (uint8_t)(0xff - length % 16);
+		}
+		memcpy(start, ivec, 16);
+		aes_ctr_ni_ctx(plain, expect, start, length, ctx);
+		prepare(out, plain, length, in_place);
+		memcpy(start, ivec, 16);
+		width->ctr(in_place ? out : plain, out, start, length, ctx);
+		check(same(out, expect, length), "%s AES-%d CTR of %lu bytes%s", width->name, keybits, length, in_place ? " in place" : "");
+
+		// GCM
+		aes_gcm_ni_enc_ctx(plain, cipher, length, aad, sizeof(aad), ivec, 12, expect_tag, ctx);
+		prepare(out, plain, length, in_place);
+		width->gcm_enc(in_place ? out : plain, out, length, aad, sizeof(aad), ivec, 12, tag, ctx);
+		check(same(out, cipher, length) && memcmp(tag, expect_tag, 16) == 0, "%s AES-%d GCM encryption of %lu bytes%s", width->name, keybits, length, in_place ? " in place" : "");
+		prepare(out, cipher, length, in_place);
+		int authentic = width->gcm_dec(in_place ? out : cipher, out, length, aad, sizeof(aad), ivec, 12, expect_tag, ctx);
+		check(authentic && same(out, plain, length), "%s AES-%d GCM decryption of %lu bytes%s", width->name, keybits, length, in_place ? " in place" : "");
+
+		// XTS, a data unit has at least one block
+		if (length < 16) {
+			continue;
+		}
+		aes_xts_ni_enc_ctx(plain, cipher, ivec, length, ctx, tweak_ctx);
+		prepare(out, plain, length, in_place);
+		width->xts_enc(in_place ? out : plain, out, ivec, length, ctx, tweak_ctx);
+		check(same(out, cipher, length), "%s AES-%d XTS encryption of %lu bytes%s", width->name, keybits, length, in_place ? " in place" : "");
+		prepare(out, cipher, length, in_place);
+		width->xts_dec(in_place ? out : cipher, out, ivec, length, ctx, tweak_ctx);
+		check(same(out, plain, length), "%s AES-%d XTS decryption of %lu bytes%s", width->name, keybits, length, in_place ? " in place" : "");
+	}
+}
+
+int main(void) {
+	static const AESKeyMode modes[] = {aes_128, aes_192, aes_256};
+	int count = 0;
+
+	if (__builtin_cpu_supports("vaes") && __builtin_cpu_supports("vpclmulqdq") && __builtin_cpu_supports("avx2")) {
+		count = 1;
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) {
+			count = 2;
+		}
+	}
+	if (count == 0) {
+		printf("vaes_tail_test: skipped (no VAES on this CPU)\n");
+		return EXIT_SUCCESS;
+	}
+
+	for (int w = 0; w < count; w++) {
+		for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+			uint8_t key[64];
+			AESKeyContext ctx, tweak_ctx;
+			for (int i = 0; i < 64; i++) {
+				key[i] = (uint8_t)(i * 29 + 11 * m + 3);
+			}
+			aes_ni_key_context_init(&ctx, key, modes[m]);
+			aes_ni_key_context_init(&tweak_ctx, key + 32, modes[m]);
+			for (unsigned long length = 0; length <= MAX_BYTES; length++) {
+				check_length(&widths[w], length, &ctx, &tweak_ctx, key);
+			}
+		}
+	}
+
+	printf("vaes_tail_test: %s (%s)\n", failures ? "FAILED" : "ok", count == 2 ? "vaes256, vaes512" : "vaes256");
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#else
+
+int main(void) {
+	printf("vaes_tail_test: skipped (the compiler has no VAES)\n");
+	return EXIT_SUCCESS;
+}
+
+#endif
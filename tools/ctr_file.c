@@ -0,0 +1,114 @@
+//
+//  ctr_file.c
+//  SimpleCrypt
+//
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+// Compile with:
+// cc -O2 -pthread -maes -mpclmul -msse4.1 -mssse3 -I../src ctr_file.c ../src/AESfile.c ../src/AESparallel.c ../src/AESstream.c ../src/AESdispatch.c ../src/AESstats.c ../src/AESvaes.c ../src/AESni.c ../src/AESvpaes.c ../src/AESbs.c ../src/AESgen.c ../src/AESarm.c ../src/AESCore.c -o ctr_file
+// * * * * * * * * * * * * * * * * * * * * * * * * * *
+//
+
+/*!
+ @file ctr_file.c
+
+ Command line tool which encrypts or decrypts a file with CTR AES, in place or to a new file.
+
+ @code
+ ctr_file [-t threads] [-c chunk size] <key file> <iv hex> <input> [output]
+ @endcode
+
+ The key file holds the raw `16`, `24`, or `32` byte key (the key is not passed on the command line, where every user
+ could read it from the process list). The IV is `32` hex digits. Without an output the input is overwritten.
+
+ @version 0.0.1
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include "AESfile.h"
+#include "AESdispatch.h"
+
+static void usage(const char * name) {
+	fprintf(stderr, "usage: %s [-t threads] [-c chunk size] <key file> <iv hex> <input> [output]\n", name);
+	exit(EXIT_FAILURE);
+}
+
+static int parse_hex(const char * hex, uint8_t * out, size_t bytes) {
+	if (strlen(hex) != 2 * bytes) {
+		return 0;
+	}
+	for (size_t i = 0; i < bytes; i++) {
+		unsigned int byte;
+		if (sscanf(hex + 2 * i, "%2x", &byte) != 1) {
+			return 0;
+		}
+		out[i] = (uint8_t)byte;
+	}
+	return 1;
+}
+
+int main(int argc, char ** argv) {
+	unsigned int threads = 0;
+	unsigned long chunk = 0;
+	uint8_t key[33], ivec[16];
+	AESKeyMode keymode;
+	AESKeyContext ctx;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:c:")) != -1) {
+		switch (opt) {
+			case 't':
+				threads = (unsigned int)strtoul(optarg, NULL, 0);
+				break;
+			case 'c':
+				chunk = strtoul(optarg, NULL, 0);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (argc - optind < 3 || argc - optind > 4) {
+		usage(argv[0]);
+	}
+
+	FILE * keyfile = fopen(argv[optind], "rb");
+	if (!keyfile) {
+		perror(argv[optind]);
+		return EXIT_FAILURE;
+	}
+	size_t keylength = fread(key, 1, sizeof(key), keyfile);
+	fclose(keyfile);
+	switch (keylength) {
+		case 16:
+			keymode = aes_128;
+			break;
+		case 24:
+			keymode = aes_192;
+			break;
+		case 32:
+			keymode = aes_256;
+			break;
+		default:
+			fprintf(stderr, "%s: the key file must hold 16, 24, or 32 bytes\n", argv[optind]);
+			return EXIT_FAILURE;
+	}
+	if (!parse_hex(argv[optind + 1], ivec, 16)) {
+		fprintf(stderr, "%s: the iv must be 32 hex digits\n", argv[optind + 1]);
+		return EXIT_FAILURE;
+	}
+
+	aes_key_context_init(&ctx, key, keymode);
+	memset(key, 0, sizeof(key));
+	AESPool * pool = aes_pool_create(threads, chunk);
+
+	const char * outpath = argc - optind == 4 ? argv[optind + 3] : NULL;
+	int ok = aes_ctr_file(pool, argv[optind + 2], outpath, ivec, &ctx);
+	if (!ok) {
+		perror(argv[0]);
+	}
+
+	aes_pool_destroy(pool);
+	aes_key_context_clear(&ctx);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}